@@ -0,0 +1,173 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_ALGORITHM_HEAP_H
+#define TOY_ALGORITHM_HEAP_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+
+#include "toy/core/type_traits.h"
+
+namespace toy
+{
+
+// d-ary heap ------------------------------------------------------------------
+// the heap algorithms of <algorithm> for a heap with D children per node. The
+// children of i are D * i + 1 ... D * i + D, with D = 4 a node's children
+// share a cache line for small T and the heap is half as deep as a binary
+// one, so a pop touches fewer lines at the cost of a few more compares.
+// As with std::push_heap, comp is a "less": the top is the largest element
+//
+//	push_dary_heap<4>(v.begin(), v.end(), std::greater<>());
+
+namespace detail
+{
+
+struct heap_no_notify
+{
+	template<class RandomIt>
+	void operator()(RandomIt) const noexcept {}
+};
+
+// move 'value' from the hole at 'hole' towards the root. notify(it) is called
+// for every element put at 'it', so an indexed heap can keep its positions
+template<size_t D, class RandomIt, class T, class Compare, class Notify>
+inline void dary_sift_up(RandomIt first, ptrdiff_t hole, T&& value, Compare& comp, Notify& notify)
+{
+	while (hole > 0)
+	{
+		ptrdiff_t parent = (hole - 1) / ptrdiff_t(D);
+		if (!comp(first[parent], value))
+			break;
+		first[hole] = toy::move(first[parent]);
+		notify(first + hole);
+		hole = parent;
+	}
+	first[hole] = toy::forward<T>(value);
+	notify(first + hole);
+}
+
+// move 'value' from the hole at 'hole' towards the leaves of the heap [0, len)
+template<size_t D, class RandomIt, class T, class Compare, class Notify>
+inline void dary_sift_down(RandomIt first, ptrdiff_t len, ptrdiff_t hole, T&& value, Compare& comp, Notify& notify)
+{
+	for (;;)
+	{
+		ptrdiff_t child = ptrdiff_t(D) * hole + 1;
+		if (child >= len)
+			break;
+
+		ptrdiff_t last = child + ptrdiff_t(D) < len ? child + ptrdiff_t(D) : len;
+		ptrdiff_t best = child;
+		for (ptrdiff_t c = child + 1; c < last; ++c)
+			best = comp(first[best], first[c]) ? c : best;	// a cmov, not a branch
+
+		if (!comp(value, first[best]))
+			break;
+		first[hole] = toy::move(first[best]);
+		notify(first + hole);
+		hole = best;
+	}
+	first[hole] = toy::forward<T>(value);
+	notify(first + hole);
+}
+
+// pop: move the hole at the root down to a leaf along the larger children,
+// then sift 'value' up from there. 'value' comes from the bottom of the heap
+// and usually belongs near it, so this saves the compare with it per level
+template<size_t D, class RandomIt, class T, class Compare, class Notify>
+inline void dary_pop_sift(RandomIt first, ptrdiff_t len, T&& value, Compare& comp, Notify& notify)
+{
+	ptrdiff_t hole = 0;
+	for (;;)
+	{
+		ptrdiff_t child = ptrdiff_t(D) * hole + 1;
+		if (child >= len)
+			break;
+
+		ptrdiff_t last = child + ptrdiff_t(D) < len ? child + ptrdiff_t(D) : len;
+		ptrdiff_t best = child;
+		for (ptrdiff_t c = child + 1; c < last; ++c)
+			best = comp(first[best], first[c]) ? c : best;
+
+		first[hole] = toy::move(first[best]);
+		notify(first + hole);
+		hole = best;
+	}
+	dary_sift_up<D>(first, hole, toy::forward<T>(value), comp, notify);
+}
+
+}	// namespace detail
+
+// [first, last - 1) is a heap, push *(last - 1) into it
+template<size_t D = 4, class RandomIt, class Compare = std::less<>>
+inline void push_dary_heap(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+	static_assert(D >= 2, "a d-ary heap has at least 2 children per node");
+	ptrdiff_t hole = static_cast<ptrdiff_t>(last - first) - 1;
+	if (hole <= 0)
+		return;
+	auto value = toy::move(first[hole]);
+	detail::heap_no_notify notify;
+	detail::dary_sift_up<D>(first, hole, toy::move(value), comp, notify);
+}
+
+// move the top to *(last - 1), [first, last - 1) stays a heap
+template<size_t D = 4, class RandomIt, class Compare = std::less<>>
+inline void pop_dary_heap(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+	static_assert(D >= 2, "a d-ary heap has at least 2 children per node");
+	ptrdiff_t len = static_cast<ptrdiff_t>(last - first) - 1;
+	if (len <= 0)
+		return;
+	auto value = toy::move(first[len]);
+	first[len] = toy::move(first[0]);
+	detail::heap_no_notify notify;
+	detail::dary_pop_sift<D>(first, len, toy::move(value), comp, notify);
+}
+
+// Floyd's bottom-up build, O(n): sift down every inner node, the last first
+template<size_t D = 4, class RandomIt, class Compare = std::less<>>
+inline void make_dary_heap(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+	static_assert(D >= 2, "a d-ary heap has at least 2 children per node");
+	ptrdiff_t len = static_cast<ptrdiff_t>(last - first);
+	detail::heap_no_notify notify;
+	for (ptrdiff_t i = (len - 2) / ptrdiff_t(D); len > 1 && i >= 0; --i)
+	{
+		auto value = toy::move(first[i]);
+		detail::dary_sift_down<D>(first, len, i, toy::move(value), comp, notify);
+	}
+}
+
+// the end of the longest prefix of [first, last) that is a heap
+template<size_t D = 4, class RandomIt, class Compare = std::less<>>
+inline RandomIt is_dary_heap_until(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+	ptrdiff_t len = static_cast<ptrdiff_t>(last - first);
+	for (ptrdiff_t i = 1; i < len; ++i)
+		if (comp(first[(i - 1) / ptrdiff_t(D)], first[i]))
+			return first + i;
+	return last;
+}
+
+template<size_t D = 4, class RandomIt, class Compare = std::less<>>
+inline bool is_dary_heap(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+	return is_dary_heap_until<D>(first, last, comp) == last;
+}
+
+// ascending order by comp, from a heap
+template<size_t D = 4, class RandomIt, class Compare = std::less<>>
+inline void sort_dary_heap(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+	for (; last - first > 1; --last)
+		pop_dary_heap<D>(first, last, comp);
+}
+
+}	// namespace toy
+
+#endif // TOY_ALGORITHM_HEAP_H
@@ -0,0 +1,273 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_ALGORITHM_PARALLEL_SORT_H
+#define TOY_ALGORITHM_PARALLEL_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+#include "toy/algorithm/sort.h"
+#include "toy/core/utility.h"
+#include "toy/core/vector.h"
+#include "toy/utility/thread_pool.h"
+
+namespace toy
+{
+
+// parallel sorting ------------------------------------------------------------
+//
+//	parallel_sort   sample sort on a thread_pool, not stable
+//	parallel_merge  merge of two sorted ranges, the output split among workers
+//
+// Both take the pool to run on, thread_pool::global() when it is left out,
+// and a grain: the fewest elements worth handing to a worker. Below it, and
+// on a pool of one thread, they do what toy::sort and a plain merge do.
+
+namespace detail
+{
+
+constexpr size_t parallel_sort_oversample = 32;		// samples per bucket
+constexpr size_t parallel_sort_splitters  = 127;	// 255 buckets with the equal ones, the bucket of an element fits a byte
+
+// the bucket of value among 2 * count + 1: bucket 2i holds the values between
+// splitter i - 1 and splitter i, bucket 2i + 1 the values equal to splitter i.
+// The search has no branch on the comparison, count is at least 1
+template<class T, class Compare>
+inline size_t sample_sort_bucket(const T& value, const T* splitters, size_t count, Compare& comp)
+{
+	const T* base = splitters;
+	for (size_t len = count; len > 1;)
+	{
+		size_t half = len / 2;
+		base = comp(value, base[half]) ? base : base + half;
+		len -= half;
+	}
+	size_t above = static_cast<size_t>(base - splitters) + !comp(value, *base);	// splitters not greater than value
+	size_t equal = above > 0 && !comp(splitters[above - 1], value);
+	return 2 * above - equal;
+}
+
+// how many of the first diagonal elements of the merge of [first1, first1 +
+// n1) and [first2, first2 + n2) come from the first range, equal elements
+// taken from the first range first
+template<class It1, class It2, class Compare>
+inline size_t merge_path_split(It1 first1, size_t n1, It2 first2, size_t n2, size_t diagonal, Compare& comp)
+{
+	size_t lo = diagonal > n2 ? diagonal - n2 : 0;
+	size_t hi = (std::min)(diagonal, n1);
+	while (lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (comp(first2[diagonal - mid - 1], first1[mid]))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+template<class It1, class It2, class OutIt, class Compare>
+inline OutIt merge_copy(It1 first1, It1 last1, It2 first2, It2 last2, OutIt out, Compare& comp)
+{
+	while (first1 != last1 && first2 != last2)
+	{
+		if (comp(*first2, *first1))
+			*out = *first2++;
+		else
+			*out = *first1++;
+		++out;
+	}
+	out = std::copy(first1, last1, out);
+	return std::copy(first2, last2, out);
+}
+
+}	// namespace detail
+
+constexpr size_t parallel_sort_grain = size_t(1) << 14;
+
+// parallel_sort ---------------------------------------------------------------
+// A sample of the input picks up to 127 splitters. Every worker then sorts a
+// chunk of the input into the buckets between and on the splitters,
+// remembering the bucket of each element in a byte, the chunks are moved to
+// their place in a buffer of n elements and back, and the buckets are sorted
+// by toy::sort, a bucket per job. Elements equal to a splitter need no more
+// sorting, so a run of duplicates does not make one bucket much larger than
+// the others.
+//
+// It reads and writes the input about three times besides the bucket sorts,
+// and the buckets are a few times the grain or more, so past the last level
+// cache it scales up to the memory bandwidth. The elements must be copyable
+// (the splitters are copies), without memory for the buffer the sort is
+// done by toy::sort on the calling thread.
+
+template<class RandomIt, class Compare = std::less<>>
+void parallel_sort(thread_pool& pool, RandomIt first, RandomIt last, Compare comp = Compare(), size_t grain = parallel_sort_grain)
+{
+	using T = typename std::iterator_traits<RandomIt>::value_type;
+
+	size_t n = static_cast<size_t>(last - first);
+	grain = (std::max)(grain, size_t(2));
+	if (n <= 2 * grain || pool.size() < 2)
+	{
+		toy::sort(first, last, comp);
+		return;
+	}
+
+	detail::sort_buffer<T> buffer(n);
+	detail::sort_buffer<uint8_t> oracle(n);
+	if (!buffer.data || !oracle.data)
+	{
+		toy::sort(first, last, comp);
+		return;
+	}
+
+	// splitters, every oversample-th of a sorted sample taken at pseudo random
+	// positions, without the repeated ones
+	size_t wanted = (std::min)(detail::parallel_sort_splitters, n / grain);
+	vector<T> splitters;
+	{
+		size_t samples = (wanted + 1) * detail::parallel_sort_oversample;
+		vector<T> sample;
+		sample.reserve(samples);
+		uint64_t state = 0x9e3779b97f4a7c15ull ^ n;
+		for (size_t i = 0; i < samples; ++i)
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			sample.push_back(first[static_cast<ptrdiff_t>(state % n)]);
+		}
+		toy::sort(sample.begin(), sample.end(), comp);
+
+		splitters.reserve(wanted);
+		for (size_t i = 1; i <= wanted; ++i)
+		{
+			const T& candidate = sample[i * detail::parallel_sort_oversample - 1];
+			if (splitters.empty() || comp(splitters.back(), candidate))
+				splitters.push_back(candidate);
+		}
+	}
+	const T* splitter_data = splitters.data();
+	size_t splitter_count = splitters.size();
+	size_t buckets = 2 * splitter_count + 1;
+
+	// classify: the bucket of every element and the size of every bucket in
+	// every chunk, counts[chunk * buckets + bucket]
+	size_t chunk_size = (std::max)(grain, (n + 4 * pool.size() - 1) / (4 * pool.size()));
+	size_t chunks = (n + chunk_size - 1) / chunk_size;
+	vector<size_t> counts(chunks * buckets, 0);
+	uint8_t* bucket_of = oracle.data;
+
+	pool.parallel_for(0, chunks, [&](size_t chunk)
+	{
+		size_t begin = chunk * chunk_size;
+		size_t end = (std::min)(begin + chunk_size, n);
+		size_t* count = counts.data() + chunk * buckets;
+		RandomIt it = first + static_cast<ptrdiff_t>(begin);
+		for (size_t i = begin; i < end; ++i, ++it)
+		{
+			size_t b = detail::sample_sort_bucket(*it, splitter_data, splitter_count, comp);
+			bucket_of[i] = static_cast<uint8_t>(b);
+			++count[b];
+		}
+	}, 1);
+
+	// where every chunk puts its part of every bucket, the bucket bounds
+	vector<size_t> bounds(buckets + 1);
+	{
+		size_t sum = 0;
+		for (size_t b = 0; b < buckets; ++b)
+		{
+			bounds[b] = sum;
+			for (size_t c = 0; c < chunks; ++c)
+			{
+				size_t count = counts[c * buckets + b];
+				counts[c * buckets + b] = sum;
+				sum += count;
+			}
+		}
+		bounds[buckets] = sum;
+	}
+
+	// distribute into the buffer, then back into the range in bucket order.
+	// The comparison is not called from here to the end of the moves, if it
+	// throws while the buckets are sorted every element is in the range
+	T* out = buffer.data;
+	pool.parallel_for(0, chunks, [&](size_t chunk)
+	{
+		size_t begin = chunk * chunk_size;
+		size_t end = (std::min)(begin + chunk_size, n);
+		size_t* offset = counts.data() + chunk * buckets;
+		RandomIt it = first + static_cast<ptrdiff_t>(begin);
+		for (size_t i = begin; i < end; ++i, ++it)
+			::new (static_cast<void*>(out + offset[bucket_of[i]]++)) T(toy::move(*it));
+	}, 1);
+
+	pool.parallel_for_range(0, n, [&](size_t begin, size_t end)
+	{
+		std::move(out + begin, out + end, first + static_cast<ptrdiff_t>(begin));
+		if constexpr (!std::is_trivially_destructible<T>::value)
+			std::destroy(out + begin, out + end);
+	}, chunk_size);
+
+	pool.parallel_for(0, splitter_count + 1, [&](size_t i)
+	{
+		size_t b = 2 * i;	// the buckets of equal elements are sorted already
+		toy::sort(first + static_cast<ptrdiff_t>(bounds[b]), first + static_cast<ptrdiff_t>(bounds[b + 1]), comp);
+	}, 1);
+}
+
+template<class RandomIt, class Compare = std::less<>>
+void parallel_sort(RandomIt first, RandomIt last, Compare comp = Compare(), size_t grain = parallel_sort_grain)
+{
+	parallel_sort(thread_pool::global(), first, last, comp, grain);
+}
+
+// parallel_merge --------------------------------------------------------------
+// Copies the merge of two sorted ranges to out, stable like std::merge. The
+// output is cut into pieces of about grain elements, and a binary search
+// along each cut (the merge path) finds how much of it comes from either
+// range, so the pieces are merged independently.
+
+template<class RandomIt1, class RandomIt2, class OutIt, class Compare = std::less<>>
+OutIt parallel_merge(thread_pool& pool, RandomIt1 first1, RandomIt1 last1, RandomIt2 first2, RandomIt2 last2,
+	OutIt out, Compare comp = Compare(), size_t grain = parallel_sort_grain)
+{
+	size_t n1 = static_cast<size_t>(last1 - first1);
+	size_t n2 = static_cast<size_t>(last2 - first2);
+	size_t n = n1 + n2;
+	grain = (std::max)(grain, size_t(1));
+	if (n <= 2 * grain || pool.size() < 2)
+		return detail::merge_copy(first1, last1, first2, last2, out, comp);
+
+	size_t pieces = (n + grain - 1) / grain;
+	pool.parallel_for(0, pieces, [&](size_t piece)
+	{
+		size_t begin = piece * grain;
+		size_t end = (std::min)(begin + grain, n);
+		size_t i = detail::merge_path_split(first1, n1, first2, n2, begin, comp);
+		size_t i_end = detail::merge_path_split(first1, n1, first2, n2, end, comp);
+		detail::merge_copy(first1 + static_cast<ptrdiff_t>(i), first1 + static_cast<ptrdiff_t>(i_end),
+			first2 + static_cast<ptrdiff_t>(begin - i), first2 + static_cast<ptrdiff_t>(end - i_end),
+			out + static_cast<ptrdiff_t>(begin), comp);
+	}, 1);
+	return out + static_cast<ptrdiff_t>(n);
+}
+
+template<class RandomIt1, class RandomIt2, class OutIt, class Compare = std::less<>>
+OutIt parallel_merge(RandomIt1 first1, RandomIt1 last1, RandomIt2 first2, RandomIt2 last2,
+	OutIt out, Compare comp = Compare(), size_t grain = parallel_sort_grain)
+{
+	return parallel_merge(thread_pool::global(), first1, last1, first2, last2, out, comp, grain);
+}
+
+}	// namespace toy
+
+#endif	// TOY_ALGORITHM_PARALLEL_SORT_H
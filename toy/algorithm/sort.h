@@ -0,0 +1,1276 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_ALGORITHM_SORT_H
+#define TOY_ALGORITHM_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "toy/algorithm/heap.h"
+#include "toy/core/type_traits.h"
+#include "toy/core/utility.h"
+#include "toy/utility/byte.h"
+
+namespace toy
+{
+
+// sorting ---------------------------------------------------------------------
+//
+//	sort         pattern-defeating quicksort, not stable, O(n log n) worst case
+//	stable_sort  merge sort on a buffer of n / 2 elements, in place without one
+//	radix_sort   LSD radix sort a byte per pass, for integer and floating point
+//	             keys, stable, O(n) per byte of the key
+//	sort_network sorting network for up to 64 elements, or keys and values
+//	             side by side, SIMD for 4 and 8 byte keys
+//
+// All of them take a "less" as std::sort does. radix_sort orders by the key
+// itself, ascending, and takes a function that gives the key of an element
+// for records.
+
+constexpr size_t sort_network_max = 64;
+
+namespace detail
+{
+
+constexpr ptrdiff_t sort_insertion_threshold = 24;		// below this, insertion sort
+constexpr ptrdiff_t sort_ninther_threshold   = 128;		// above this, the pivot is a median of 3 medians
+constexpr size_t    sort_partial_limit       = 8;		// moves a partial insertion sort may make
+constexpr size_t    sort_block_size          = 64;		// elements per block of the branchless partition
+constexpr ptrdiff_t stable_sort_threshold    = 32;
+constexpr size_t    radix_sort_threshold     = 256;		// below this, sort by the key
+
+// raw storage for n elements, nullptr if it can't be had
+template<class T>
+struct sort_buffer
+{
+	explicit sort_buffer(size_t n) noexcept
+		: data(static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T)), std::nothrow)))
+	{
+	}
+
+	~sort_buffer()
+	{
+		::operator delete(data, std::align_val_t(alignof(T)));
+	}
+
+	sort_buffer(const sort_buffer&) = delete;
+	sort_buffer& operator=(const sort_buffer&) = delete;
+
+	T* data;
+};
+
+// insertion sorts -------------------------------------------------------------
+
+template<class RandomIt, class Compare>
+inline void insertion_sort(RandomIt first, RandomIt last, Compare& comp)
+{
+	if (first == last)
+		return;
+	for (RandomIt cur = first + 1; cur != last; ++cur)
+	{
+		RandomIt sift = cur;
+		RandomIt sift_1 = cur - 1;
+		if (comp(*sift, *sift_1))
+		{
+			auto tmp = toy::move(*sift);
+			do
+			{
+				*sift-- = toy::move(*sift_1);
+			} while (sift != first && comp(tmp, *--sift_1));
+			*sift = toy::move(tmp);
+		}
+	}
+}
+
+// *(first - 1) is not greater than any element of the range, it ends the sifts
+template<class RandomIt, class Compare>
+inline void unguarded_insertion_sort(RandomIt first, RandomIt last, Compare& comp)
+{
+	if (first == last)
+		return;
+	for (RandomIt cur = first + 1; cur != last; ++cur)
+	{
+		RandomIt sift = cur;
+		RandomIt sift_1 = cur - 1;
+		if (comp(*sift, *sift_1))
+		{
+			auto tmp = toy::move(*sift);
+			do
+			{
+				*sift-- = toy::move(*sift_1);
+			} while (comp(tmp, *--sift_1));
+			*sift = toy::move(tmp);
+		}
+	}
+}
+
+// sorts a range that is nearly sorted, or gives up after a few moves and
+// returns false
+template<class RandomIt, class Compare>
+inline bool partial_insertion_sort(RandomIt first, RandomIt last, Compare& comp)
+{
+	if (first == last)
+		return true;
+	size_t moves = 0;
+	for (RandomIt cur = first + 1; cur != last; ++cur)
+	{
+		RandomIt sift = cur;
+		RandomIt sift_1 = cur - 1;
+		if (comp(*sift, *sift_1))
+		{
+			auto tmp = toy::move(*sift);
+			do
+			{
+				*sift-- = toy::move(*sift_1);
+			} while (sift != first && comp(tmp, *--sift_1));
+			*sift = toy::move(tmp);
+			moves += static_cast<size_t>(cur - sift);
+		}
+		if (moves > sort_partial_limit)
+			return false;
+	}
+	return true;
+}
+
+// pdqsort ---------------------------------------------------------------------
+// Orson Peters, "Pattern-defeating Quicksort". Introsort, and:
+//	- the pivot is a median of 3, or of 3 medians of 3
+//	- a pivot equal to the element before the range (which ended the left
+//	  part of the partition above) puts the equal elements left and skips
+//	  them, so many equal keys take O(n)
+//	- a partition that swapped nothing is followed by an insertion sort that
+//	  gives up after 8 moves, sorted and reversed input take O(n)
+//	- a bad partition shuffles a few elements; after log n of them, heapsort
+// For arithmetic keys under std::less and std::greater the partition is the
+// block partition of Edelkamp and Weiss ("BlockQuicksort"): the compares of
+// a block of 64 elements fill a buffer of offsets without a branch, then the
+// misplaced pairs are swapped, so random keys cost no mispredictions.
+
+template<class T, class Compare>
+struct sort_is_branchless
+	: bool_constant<std::is_arithmetic<T>::value &&
+		(std::is_same<Compare, std::less<>>::value || std::is_same<Compare, std::less<T>>::value ||
+		 std::is_same<Compare, std::greater<>>::value || std::is_same<Compare, std::greater<T>>::value)>
+{
+};
+
+template<class RandomIt, class Compare>
+inline void sort3(RandomIt a, RandomIt b, RandomIt c, Compare& comp)
+{
+	if (comp(*b, *a))
+		std::iter_swap(a, b);
+	if (comp(*c, *b))
+		std::iter_swap(b, c);
+	if (comp(*b, *a))
+		std::iter_swap(a, b);
+}
+
+// the partition with the elements equal to the pivot *first on the right.
+// Returns where the pivot ends up, and whether nothing had to move
+template<class RandomIt, class Compare>
+inline pair<RandomIt, bool> partition_right(RandomIt begin, RandomIt end, Compare& comp)
+{
+	auto pivot = toy::move(*begin);
+	RandomIt first = begin;
+	RandomIt last = end;
+
+	// the median of 3 guarantees an element not less than the pivot
+	while (comp(*++first, pivot))
+	{
+	}
+	if (first - 1 == begin)
+	{
+		while (first < last && !comp(*--last, pivot))
+		{
+		}
+	}
+	else
+	{
+		while (!comp(*--last, pivot))
+		{
+		}
+	}
+
+	bool already_partitioned = first >= last;
+	while (first < last)
+	{	// the pairs swapped before guard the searches
+		std::iter_swap(first, last);
+		while (comp(*++first, pivot))
+		{
+		}
+		while (!comp(*--last, pivot))
+		{
+		}
+	}
+
+	RandomIt pivot_pos = first - 1;
+	*begin = toy::move(*pivot_pos);
+	*pivot_pos = toy::move(pivot);
+	return pair<RandomIt, bool>(pivot_pos, already_partitioned);
+}
+
+// the swaps of the misplaced pairs the offsets name. With as many on each
+// side they are plain swaps, else a cycle through both sides saves moves
+template<class RandomIt>
+inline void swap_offsets(RandomIt first, RandomIt last, const unsigned char* offsets_l,
+	const unsigned char* offsets_r, size_t n, bool use_swaps)
+{
+	if (use_swaps)
+	{	// the reversed input needs these to stay O(n)
+		for (size_t i = 0; i < n; ++i)
+			std::iter_swap(first + offsets_l[i], last - offsets_r[i]);
+	}
+	else if (n > 0)
+	{
+		RandomIt l = first + offsets_l[0];
+		RandomIt r = last - offsets_r[0];
+		auto tmp = toy::move(*l);
+		*l = toy::move(*r);
+		for (size_t i = 1; i < n; ++i)
+		{
+			l = first + offsets_l[i];
+			*r = toy::move(*l);
+			r = last - offsets_r[i];
+			*l = toy::move(*r);
+		}
+		*r = toy::move(tmp);
+	}
+}
+
+template<class RandomIt, class Compare>
+inline pair<RandomIt, bool> partition_right_branchless(RandomIt begin, RandomIt end, Compare& comp)
+{
+	auto pivot = toy::move(*begin);
+	RandomIt first = begin;
+	RandomIt last = end;
+
+	while (comp(*++first, pivot))
+	{
+	}
+	if (first - 1 == begin)
+	{
+		while (first < last && !comp(*--last, pivot))
+		{
+		}
+	}
+	else
+	{
+		while (!comp(*--last, pivot))
+		{
+		}
+	}
+
+	bool already_partitioned = first >= last;
+	if (!already_partitioned)
+	{
+		std::iter_swap(first, last);
+		++first;
+
+		alignas(64) unsigned char offsets_l[sort_block_size];
+		alignas(64) unsigned char offsets_r[sort_block_size];
+		RandomIt base_l = first;
+		RandomIt base_r = last;
+		size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+
+		while (first < last)
+		{
+			// how many of the unknown elements each side takes: all of them to
+			// the side whose buffer is empty, half to each if both are
+			size_t unknown = static_cast<size_t>(last - first);
+			size_t split_l = num_l == 0 ? (num_r == 0 ? unknown / 2 : unknown) : 0;
+			size_t split_r = num_r == 0 ? unknown - split_l : 0;
+
+			if (split_l >= sort_block_size)
+			{
+				for (size_t i = 0; i < sort_block_size;)
+				{	// unrolled by 8, the store is unconditional, the count is not
+					offsets_l[num_l] = static_cast<unsigned char>(i++); num_l += !comp(*first, pivot); ++first;
+					offsets_l[num_l] = static_cast<unsigned char>(i++); num_l += !comp(*first, pivot); ++first;
+					offsets_l[num_l] = static_cast<unsigned char>(i++); num_l += !comp(*first, pivot); ++first;
+					offsets_l[num_l] = static_cast<unsigned char>(i++); num_l += !comp(*first, pivot); ++first;
+					offsets_l[num_l] = static_cast<unsigned char>(i++); num_l += !comp(*first, pivot); ++first;
+					offsets_l[num_l] = static_cast<unsigned char>(i++); num_l += !comp(*first, pivot); ++first;
+					offsets_l[num_l] = static_cast<unsigned char>(i++); num_l += !comp(*first, pivot); ++first;
+					offsets_l[num_l] = static_cast<unsigned char>(i++); num_l += !comp(*first, pivot); ++first;
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < split_l;)
+				{
+					offsets_l[num_l] = static_cast<unsigned char>(i++);
+					num_l += !comp(*first, pivot);
+					++first;
+				}
+			}
+
+			if (split_r >= sort_block_size)
+			{
+				for (size_t i = 0; i < sort_block_size;)
+				{
+					offsets_r[num_r] = static_cast<unsigned char>(++i); num_r += comp(*--last, pivot);
+					offsets_r[num_r] = static_cast<unsigned char>(++i); num_r += comp(*--last, pivot);
+					offsets_r[num_r] = static_cast<unsigned char>(++i); num_r += comp(*--last, pivot);
+					offsets_r[num_r] = static_cast<unsigned char>(++i); num_r += comp(*--last, pivot);
+					offsets_r[num_r] = static_cast<unsigned char>(++i); num_r += comp(*--last, pivot);
+					offsets_r[num_r] = static_cast<unsigned char>(++i); num_r += comp(*--last, pivot);
+					offsets_r[num_r] = static_cast<unsigned char>(++i); num_r += comp(*--last, pivot);
+					offsets_r[num_r] = static_cast<unsigned char>(++i); num_r += comp(*--last, pivot);
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < split_r;)
+				{
+					offsets_r[num_r] = static_cast<unsigned char>(++i);
+					num_r += comp(*--last, pivot);
+				}
+			}
+
+			size_t n = std::min(num_l, num_r);
+			swap_offsets(base_l, base_r, offsets_l + start_l, offsets_r + start_r, n, num_l == num_r);
+			num_l -= n;
+			num_r -= n;
+			start_l += n;
+			start_r += n;
+			if (num_l == 0)
+			{
+				start_l = 0;
+				base_l = first;
+			}
+			if (num_r == 0)
+			{
+				start_r = 0;
+				base_r = last;
+			}
+		}
+
+		// the misplaced elements left on one side go to the far end of the middle
+		if (num_l)
+		{
+			while (num_l--)
+				std::iter_swap(base_l + offsets_l[start_l + num_l], --last);
+			first = last;
+		}
+		if (num_r)
+		{
+			while (num_r--)
+			{
+				std::iter_swap(base_r - offsets_r[start_r + num_r], first);
+				++first;
+			}
+			last = first;
+		}
+	}
+
+	RandomIt pivot_pos = first - 1;
+	*begin = toy::move(*pivot_pos);
+	*pivot_pos = toy::move(pivot);
+	return pair<RandomIt, bool>(pivot_pos, already_partitioned);
+}
+
+// the partition with the elements equal to the pivot on the left, for a pivot
+// equal to *(begin - 1): nothing in the range is less than it, so the left
+// part is all equal and sorted. Returns where the pivot ends up
+template<class RandomIt, class Compare>
+inline RandomIt partition_left(RandomIt begin, RandomIt end, Compare& comp)
+{
+	auto pivot = toy::move(*begin);
+	RandomIt first = begin;
+	RandomIt last = end;
+
+	while (comp(pivot, *--last))
+	{
+	}
+	if (last + 1 == end)
+	{
+		while (first < last && !comp(pivot, *++first))
+		{
+		}
+	}
+	else
+	{
+		while (!comp(pivot, *++first))
+		{
+		}
+	}
+
+	while (first < last)
+	{
+		std::iter_swap(first, last);
+		while (comp(pivot, *--last))
+		{
+		}
+		while (!comp(pivot, *++first))
+		{
+		}
+	}
+
+	RandomIt pivot_pos = last;
+	*begin = toy::move(*pivot_pos);
+	*pivot_pos = toy::move(pivot);
+	return pivot_pos;
+}
+
+// sorting networks ------------------------------------------------------------
+// A network is a sequence of compare-exchanges fixed by the number of
+// elements alone, so sorting a handful of keys by one costs no mispredicted
+// branch. Keys of 4 or 8 bytes under std::less and std::greater go through a
+// bitonic network on AVX-512 or AVX2 registers: the keys are padded with the
+// last key in the order to a power of two, an exchange between registers is
+// a compare and two blends, within a register a permute pairs the lanes.
+// Anything else goes through Batcher's merge exchange network, which sorts
+// any n in place.
+//
+// references
+// Batcher, "Sorting networks and their applications", AFIPS 1968
+// Knuth, "The Art of Computer Programming", vol. 3, 5.2.2, algorithm M
+
+constexpr ptrdiff_t sort_network_threshold = 32;	// below this, the base case of sort for the keys of the SIMD network
+
+template<class T, class Compare>
+struct sort_is_descending
+	: bool_constant<std::is_same<Compare, std::greater<>>::value || std::is_same<Compare, std::greater<T>>::value>
+{
+};
+
+template<class CompareExchange>
+inline void merge_exchange_network(size_t n, CompareExchange&& compare_exchange)
+{
+	if (n < 2)
+		return;
+	size_t top = size_t(1) << (bit_width(n - 1) - 1);
+	for (size_t p = top; p > 0; p >>= 1)
+	{
+		size_t q = top;
+		size_t r = 0;
+		size_t d = p;
+		for (;;)
+		{
+			for (size_t i = 0; i + d < n; ++i)
+			{
+				if ((i & p) == r)
+					compare_exchange(i, i + d);
+			}
+			if (q == p)
+				break;
+			d = q - p;
+			q >>= 1;
+			r = p;
+		}
+	}
+}
+
+// Values is false for keys alone
+template<bool Values, class KeyIt, class ValueIt, class Compare>
+inline void scalar_network_sort(KeyIt keys, ValueIt values, size_t n, Compare& comp)
+{
+	using K = typename std::iterator_traits<KeyIt>::value_type;
+	merge_exchange_network(n, [&](size_t i, size_t j)
+	{
+		if constexpr (std::is_arithmetic<K>::value && !Values)
+		{	// conditional moves
+			K a = keys[i];
+			K b = keys[j];
+			bool swap = comp(b, a);
+			keys[i] = swap ? b : a;
+			keys[j] = swap ? a : b;
+		}
+		else if (comp(keys[j], keys[i]))
+		{
+			std::iter_swap(keys + i, keys + j);
+			if constexpr (Values)
+				std::iter_swap(values + i, values + j);
+		}
+	});
+}
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+
+// the lanes l of a register of 16 at most where l & j
+constexpr unsigned network_lane_bits(size_t j) noexcept
+{
+	unsigned bits = 0;
+	for (unsigned l = 0; l < 16; ++l)
+		bits |= (l & j) ? 1u << l : 0u;
+	return bits;
+}
+
+// the registers of the bitonic network for keys of type T:
+//	greater(a, b)              the lanes where a > b
+//	blend(a, b, m)             b in the lanes of m, else a
+//	exchange(v, j)             lane l gets lane l ^ j
+//	lanes(bits)                a mask of the lanes in bits
+//	select(m, if_set, if_not)  the lanes of if_set in m, of if_not elsewhere
+template<class T, size_t Size = sizeof(T)>
+struct network_ops;
+
+#if defined(__AVX512F__)
+
+template<class T>
+struct network_ops<T, 4>
+{
+	using reg = __m512i;
+	using mask = __mmask16;
+	static constexpr size_t count = 16;
+
+	static reg load(const T* p) noexcept { return _mm512_load_si512(p); }
+	static void store(T* p, reg v) noexcept { _mm512_store_si512(p, v); }
+
+	static mask greater(reg a, reg b) noexcept
+	{
+		if constexpr (std::is_floating_point<T>::value)
+			return _mm512_cmp_ps_mask(_mm512_castsi512_ps(a), _mm512_castsi512_ps(b), _CMP_GT_OQ);
+		else if constexpr (std::is_signed<T>::value)
+			return _mm512_cmpgt_epi32_mask(a, b);
+		else
+			return _mm512_cmpgt_epu32_mask(a, b);
+	}
+
+	static reg blend(reg a, reg b, mask m) noexcept { return _mm512_mask_blend_epi32(m, a, b); }
+
+	static reg exchange(reg v, size_t j) noexcept
+	{
+		__m512i index = _mm512_xor_si512(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+			_mm512_set1_epi32(static_cast<int>(j)));
+		return _mm512_maskz_permutexvar_epi32(0xffff, index, v);	// the unmasked form trips -Wmaybe-uninitialized in GCC 12
+	}
+
+	static mask lanes(unsigned bits) noexcept { return static_cast<mask>(bits); }
+	static mask select(mask m, mask if_set, mask if_not) noexcept { return static_cast<mask>((if_set & m) | (if_not & ~m)); }
+};
+
+template<class T>
+struct network_ops<T, 8>
+{
+	using reg = __m512i;
+	using mask = __mmask8;
+	static constexpr size_t count = 8;
+
+	static reg load(const T* p) noexcept { return _mm512_load_si512(p); }
+	static void store(T* p, reg v) noexcept { _mm512_store_si512(p, v); }
+
+	static mask greater(reg a, reg b) noexcept
+	{
+		if constexpr (std::is_floating_point<T>::value)
+			return _mm512_cmp_pd_mask(_mm512_castsi512_pd(a), _mm512_castsi512_pd(b), _CMP_GT_OQ);
+		else if constexpr (std::is_signed<T>::value)
+			return _mm512_cmpgt_epi64_mask(a, b);
+		else
+			return _mm512_cmpgt_epu64_mask(a, b);
+	}
+
+	static reg blend(reg a, reg b, mask m) noexcept { return _mm512_mask_blend_epi64(m, a, b); }
+
+	static reg exchange(reg v, size_t j) noexcept
+	{
+		__m512i index = _mm512_xor_si512(_mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7),
+			_mm512_set1_epi64(static_cast<long long>(j)));
+		return _mm512_maskz_permutexvar_epi64(0xff, index, v);
+	}
+
+	static mask lanes(unsigned bits) noexcept { return static_cast<mask>(bits); }
+	static mask select(mask m, mask if_set, mask if_not) noexcept { return static_cast<mask>((if_set & m) | (if_not & ~m)); }
+};
+
+#else
+
+template<class T>
+struct network_ops<T, 4>
+{
+	using reg = __m256i;
+	using mask = __m256i;
+	static constexpr size_t count = 8;
+
+	static reg load(const T* p) noexcept { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+	static void store(T* p, reg v) noexcept { _mm256_store_si256(reinterpret_cast<__m256i*>(p), v); }
+
+	static mask greater(reg a, reg b) noexcept
+	{
+		if constexpr (std::is_floating_point<T>::value)
+			return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _CMP_GT_OQ));
+		else if constexpr (std::is_signed<T>::value)
+			return _mm256_cmpgt_epi32(a, b);
+		else
+		{	// flipping the sign bits orders unsigned as signed
+			__m256i sign = _mm256_set1_epi32(INT32_MIN);
+			return _mm256_cmpgt_epi32(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+		}
+	}
+
+	static reg blend(reg a, reg b, mask m) noexcept { return _mm256_blendv_epi8(a, b, m); }
+
+	static reg exchange(reg v, size_t j) noexcept
+	{
+		__m256i index = _mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(j)));
+		return _mm256_permutevar8x32_epi32(v, index);
+	}
+
+	static mask lanes(unsigned bits) noexcept
+	{
+		__m256i bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(bits)), bit), bit);
+	}
+
+	static mask select(mask m, mask if_set, mask if_not) noexcept { return _mm256_blendv_epi8(if_not, if_set, m); }
+};
+
+template<class T>
+struct network_ops<T, 8>
+{
+	using reg = __m256i;
+	using mask = __m256i;
+	static constexpr size_t count = 4;
+
+	static reg load(const T* p) noexcept { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+	static void store(T* p, reg v) noexcept { _mm256_store_si256(reinterpret_cast<__m256i*>(p), v); }
+
+	static mask greater(reg a, reg b) noexcept
+	{
+		if constexpr (std::is_floating_point<T>::value)
+			return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b), _CMP_GT_OQ));
+		else if constexpr (std::is_signed<T>::value)
+			return _mm256_cmpgt_epi64(a, b);
+		else
+		{
+			__m256i sign = _mm256_set1_epi64x(INT64_MIN);
+			return _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+		}
+	}
+
+	static reg blend(reg a, reg b, mask m) noexcept { return _mm256_blendv_epi8(a, b, m); }
+
+	static reg exchange(reg v, size_t j) noexcept
+	{	// as pairs of 32 bit lanes
+		__m256i index = _mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(2 * j)));
+		return _mm256_permutevar8x32_epi32(v, index);
+	}
+
+	static mask lanes(unsigned bits) noexcept
+	{
+		__m256i bit = _mm256_setr_epi64x(1, 2, 4, 8);
+		return _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(bits), bit), bit);
+	}
+
+	static mask select(mask m, mask if_set, mask if_not) noexcept { return _mm256_blendv_epi8(if_not, if_set, m); }
+};
+
+#endif
+
+template<class T, class Compare>
+struct sort_network_simd
+	: bool_constant<sort_is_branchless<T, Compare>::value && !std::is_same<T, bool>::value &&
+		(sizeof(T) == 4 || sizeof(T) == 8)>
+{
+};
+
+// one step of the bitonic network on registers: in the merges of runs of
+// Merge keys, the compare-exchanges at distance J. The steps follow each other
+// by recursion, so every loop has a fixed count and unrolls
+template<class T, bool Descending, bool Values, size_t Size, size_t Merge, size_t J>
+inline void bitonic_step(typename network_ops<T>::reg* k, typename network_ops<T>::reg* v) noexcept
+{
+	using ops = network_ops<T>;
+	using reg = typename ops::reg;
+	using mask = typename ops::mask;
+	constexpr size_t count = ops::count;
+	constexpr size_t regs = Size / count;
+	constexpr unsigned all = (1u << count) - 1;
+
+	if constexpr (J >= count)
+	{	// between registers r and r + J / count
+		constexpr size_t jr = J / count;
+		for (size_t r = 0; r < regs; ++r)
+		{
+			if (r & jr)
+				continue;
+			reg a = k[r];
+			reg b = k[r + jr];
+			bool up = ((r * count & Merge) == 0) != Descending;
+			mask swap = up ? ops::greater(a, b) : ops::greater(b, a);
+			k[r] = ops::blend(a, b, swap);
+			k[r + jr] = ops::blend(b, a, swap);
+			if constexpr (Values)
+			{
+				reg va = v[r];
+				v[r] = ops::blend(va, v[r + jr], swap);
+				v[r + jr] = ops::blend(v[r + jr], va, swap);
+			}
+		}
+	}
+	else
+	{	// within a register, the lanes that keep the smaller key have bit J of the index equal to bit Merge
+		constexpr unsigned j_bits = network_lane_bits(J) & all;
+		for (size_t r = 0; r < regs; ++r)
+		{
+			unsigned merge_bits = Merge < count ? network_lane_bits(Merge) & all : (r * count & Merge ? all : 0u);
+			unsigned min_bits = Descending ? j_bits ^ merge_bits : ~(j_bits ^ merge_bits) & all;
+			reg b = ops::exchange(k[r], J);
+			mask swap = ops::select(ops::lanes(min_bits), ops::greater(k[r], b), ops::greater(b, k[r]));
+			k[r] = ops::blend(k[r], b, swap);
+			if constexpr (Values)
+				v[r] = ops::blend(v[r], ops::exchange(v[r], J), swap);
+		}
+	}
+
+	if constexpr (J > 1)
+		bitonic_step<T, Descending, Values, Size, Merge, J / 2>(k, v);
+	else if constexpr (Merge < Size)
+		bitonic_step<T, Descending, Values, Size, 2 * Merge, Merge>(k, v);
+}
+
+// the bitonic network on Size keys, Size a power of two and at least a
+// register, the values in step with the keys when Values
+template<class T, bool Descending, bool Values, size_t Size>
+inline void bitonic_network(T* keys, T* values) noexcept
+{
+	using ops = network_ops<T>;
+	using reg = typename ops::reg;
+	constexpr size_t count = ops::count;
+	constexpr size_t regs = Size / count;
+
+	reg k[regs];
+	reg v[Values ? regs : 1];
+	for (size_t r = 0; r < regs; ++r)
+	{
+		k[r] = ops::load(keys + r * count);
+		if constexpr (Values)
+			v[r] = ops::load(values + r * count);
+	}
+	bitonic_step<T, Descending, Values, Size, 2, 1>(k, v);
+	for (size_t r = 0; r < regs; ++r)
+	{
+		ops::store(keys + r * count, k[r]);
+		if constexpr (Values)
+			ops::store(values + r * count, v[r]);
+	}
+}
+
+// the network of the first power of two from a register up that holds size
+template<class T, bool Descending, bool Values, size_t Size = network_ops<T>::count>
+inline void bitonic_network(T* keys, T* values, size_t size) noexcept
+{
+	if constexpr (Size < sort_network_max)
+	{
+		if (size > Size)
+		{
+			bitonic_network<T, Descending, Values, 2 * Size>(keys, values, size);
+			return;
+		}
+	}
+	bitonic_network<T, Descending, Values, Size>(keys, values);
+}
+
+// n <= sort_network_max keys through a padded copy. With values, keys equal to
+// the padding would mix with it: they are the last in the order, so they are
+// kept out of the network and put at the end
+template<bool Values, class KeyIt, class ValueIt, class Compare>
+inline void simd_network_sort(KeyIt keys, ValueIt values, size_t n, Compare&)
+{
+	using T = typename std::iterator_traits<KeyIt>::value_type;
+	constexpr bool descending = sort_is_descending<T, Compare>::value;
+	constexpr size_t count = network_ops<T>::count;
+	using limits = std::numeric_limits<T>;
+	const T pad = limits::has_infinity
+		? (descending ? -limits::infinity() : limits::infinity())
+		: (descending ? limits::lowest() : (limits::max)());
+
+	alignas(64) T key_buffer[sort_network_max];
+	alignas(64) T value_buffer[Values ? sort_network_max : 1];
+	T tail_values[Values ? sort_network_max : 1];
+	size_t m = 0;
+	size_t tail = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		T key = keys[i];
+		if constexpr (Values)
+		{
+			if (key == pad)
+			{
+				std::memcpy(&tail_values[tail++], &values[i], sizeof(T));
+				continue;
+			}
+			std::memcpy(&value_buffer[m], &values[i], sizeof(T));
+		}
+		key_buffer[m++] = key;
+	}
+
+	size_t size = (std::max)(count, bit_ceil(m));
+	for (size_t i = m; i < size; ++i)
+	{
+		key_buffer[i] = pad;
+		if constexpr (Values)
+			value_buffer[i] = T();
+	}
+	bitonic_network<T, descending, Values>(key_buffer, value_buffer, size);
+
+	for (size_t i = 0; i < m; ++i)
+	{
+		keys[i] = key_buffer[i];
+		if constexpr (Values)
+			std::memcpy(&values[i], &value_buffer[i], sizeof(T));
+	}
+	for (size_t i = 0; i < tail; ++i)
+	{
+		keys[m + i] = pad;
+		std::memcpy(&values[m + i], &tail_values[i], sizeof(T));
+	}
+}
+
+#else
+
+template<class T, class Compare>
+struct sort_network_simd : std::false_type
+{
+};
+
+template<bool Values, class KeyIt, class ValueIt, class Compare>
+void simd_network_sort(KeyIt keys, ValueIt values, size_t n, Compare& comp);	// not called without SIMD
+
+#endif	// __AVX512F__ || __AVX2__
+
+// the base case of sort, for a range of fewer than sort_small_threshold
+template<class RandomIt, class Compare>
+inline void sort_small(RandomIt first, RandomIt last, Compare& comp, bool leftmost)
+{
+	using T = typename std::iterator_traits<RandomIt>::value_type;
+	if constexpr (sort_network_simd<T, Compare>::value)
+		simd_network_sort<false>(first, first, static_cast<size_t>(last - first), comp);
+	else if (leftmost)
+		insertion_sort(first, last, comp);
+	else
+		unguarded_insertion_sort(first, last, comp);
+}
+
+template<bool Branchless, class RandomIt, class Compare>
+inline void pdqsort_loop(RandomIt begin, RandomIt end, Compare& comp, int bad_allowed, bool leftmost)
+{
+	using T = typename std::iterator_traits<RandomIt>::value_type;
+	constexpr ptrdiff_t sort_small_threshold = sort_network_simd<T, Compare>::value
+		? sort_network_threshold
+		: sort_insertion_threshold;
+	for (;;)
+	{
+		ptrdiff_t size = end - begin;
+		if (size < sort_small_threshold)
+		{
+			sort_small(begin, end, comp, leftmost);
+			return;
+		}
+
+		// the pivot to *begin
+		ptrdiff_t half = size / 2;
+		if (size > sort_ninther_threshold)
+		{
+			sort3(begin, begin + half, end - 1, comp);
+			sort3(begin + 1, begin + (half - 1), end - 2, comp);
+			sort3(begin + 2, begin + (half + 1), end - 3, comp);
+			sort3(begin + (half - 1), begin + half, begin + (half + 1), comp);
+			std::iter_swap(begin, begin + half);
+		}
+		else
+		{
+			sort3(begin + half, begin, end - 1, comp);
+		}
+
+		if (!leftmost && !comp(*(begin - 1), *begin))
+		{	// the pivot equals the element before: the equal ones are done
+			begin = partition_left(begin, end, comp) + 1;
+			continue;
+		}
+
+		pair<RandomIt, bool> part = Branchless
+			? partition_right_branchless(begin, end, comp)
+			: partition_right(begin, end, comp);
+		RandomIt pivot_pos = part.first;
+
+		ptrdiff_t size_l = pivot_pos - begin;
+		ptrdiff_t size_r = end - (pivot_pos + 1);
+		if (size_l < size / 8 || size_r < size / 8)
+		{	// a bad split: past the allowance heapsort, else shuffle the pivots of the next round
+			if (--bad_allowed == 0)
+			{
+				make_dary_heap(begin, end, comp);
+				sort_dary_heap(begin, end, comp);
+				return;
+			}
+			if (size_l >= sort_insertion_threshold)
+			{
+				std::iter_swap(begin, begin + size_l / 4);
+				std::iter_swap(pivot_pos - 1, pivot_pos - size_l / 4);
+				if (size_l > sort_ninther_threshold)
+				{
+					std::iter_swap(begin + 1, begin + (size_l / 4 + 1));
+					std::iter_swap(begin + 2, begin + (size_l / 4 + 2));
+					std::iter_swap(pivot_pos - 2, pivot_pos - (size_l / 4 + 1));
+					std::iter_swap(pivot_pos - 3, pivot_pos - (size_l / 4 + 2));
+				}
+			}
+			if (size_r >= sort_insertion_threshold)
+			{
+				std::iter_swap(pivot_pos + 1, pivot_pos + (1 + size_r / 4));
+				std::iter_swap(end - 1, end - size_r / 4);
+				if (size_r > sort_ninther_threshold)
+				{
+					std::iter_swap(pivot_pos + 2, pivot_pos + (2 + size_r / 4));
+					std::iter_swap(pivot_pos + 3, pivot_pos + (3 + size_r / 4));
+					std::iter_swap(end - 2, end - (1 + size_r / 4));
+					std::iter_swap(end - 3, end - (2 + size_r / 4));
+				}
+			}
+		}
+		else if (part.second && partial_insertion_sort(begin, pivot_pos, comp) &&
+			partial_insertion_sort(pivot_pos + 1, end, comp))
+		{	// a good split of a range that needed no swaps, likely sorted
+			return;
+		}
+
+		// the left part by recursion, the right one by the loop
+		pdqsort_loop<Branchless>(begin, pivot_pos, comp, bad_allowed, leftmost);
+		begin = pivot_pos + 1;
+		leftmost = false;
+	}
+}
+
+// stable sort -----------------------------------------------------------------
+
+// merge [first, middle) and [middle, last), moving the left run through buffer
+template<class RandomIt, class T, class Compare>
+inline void merge_with_buffer(RandomIt first, RandomIt middle, RandomIt last, T* buffer, Compare& comp)
+{
+	T* b = buffer;
+	T* b_end = std::uninitialized_move(first, middle, buffer);
+	RandomIt out = first;
+	RandomIt r = middle;
+	while (b != b_end && r != last)
+	{	// the left one on ties, for stability
+		if (comp(*r, *b))
+			*out++ = toy::move(*r++);
+		else
+			*out++ = toy::move(*b++);
+	}
+	std::move(b, b_end, out);
+	std::destroy(buffer, b_end);
+}
+
+template<class RandomIt, class T, class Compare>
+inline void stable_sort_buffered(RandomIt first, RandomIt last, T* buffer, Compare& comp)
+{
+	ptrdiff_t n = last - first;
+	if (n <= stable_sort_threshold)
+	{
+		insertion_sort(first, last, comp);
+		return;
+	}
+	RandomIt middle = first + n / 2;
+	stable_sort_buffered(first, middle, buffer, comp);
+	stable_sort_buffered(middle, last, buffer, comp);
+	if (comp(*middle, *(middle - 1)))
+		merge_with_buffer(first, middle, last, buffer, comp);
+}
+
+// merge by rotations, O(n log n) for a merge, when there is no buffer
+template<class RandomIt, class Compare>
+inline void merge_in_place(RandomIt first, RandomIt middle, RandomIt last, ptrdiff_t len1, ptrdiff_t len2, Compare& comp)
+{
+	if (len1 == 0 || len2 == 0)
+		return;
+	if (len1 + len2 == 2)
+	{
+		if (comp(*middle, *first))
+			std::iter_swap(first, middle);
+		return;
+	}
+
+	RandomIt cut1, cut2;
+	ptrdiff_t len11, len22;
+	if (len1 > len2)
+	{
+		len11 = len1 / 2;
+		cut1 = first + len11;
+		cut2 = std::lower_bound(middle, last, *cut1, comp);
+		len22 = cut2 - middle;
+	}
+	else
+	{
+		len22 = len2 / 2;
+		cut2 = middle + len22;
+		cut1 = std::upper_bound(first, middle, *cut2, comp);
+		len11 = cut1 - first;
+	}
+	RandomIt new_middle = std::rotate(cut1, middle, cut2);
+	merge_in_place(first, cut1, new_middle, len11, len22, comp);
+	merge_in_place(new_middle, cut2, last, len1 - len11, len2 - len22, comp);
+}
+
+template<class RandomIt, class Compare>
+inline void stable_sort_in_place(RandomIt first, RandomIt last, Compare& comp)
+{
+	ptrdiff_t n = last - first;
+	if (n <= stable_sort_threshold)
+	{
+		insertion_sort(first, last, comp);
+		return;
+	}
+	RandomIt middle = first + n / 2;
+	stable_sort_in_place(first, middle, comp);
+	stable_sort_in_place(middle, last, comp);
+	merge_in_place(first, middle, last, middle - first, last - middle, comp);
+}
+
+// radix sort ------------------------------------------------------------------
+
+// the key as an unsigned integer of its size that sorts as the key does:
+// signed integers with the sign bit flipped, floating point with the sign
+// bit flipped if clear and every bit flipped if set. -0.0 sorts before 0.0,
+// NaNs with the sign bit set first and the others last
+template<class K>
+inline auto radix_bits(K key) noexcept
+{
+	static_assert(std::is_arithmetic<K>::value, "radix_sort keys are integers or floating point");
+	if constexpr (std::is_floating_point<K>::value)
+	{
+		static_assert(sizeof(K) == 4 || sizeof(K) == 8, "radix_sort floating point keys are float or double");
+		using U = conditional_t<sizeof(K) == 4, uint32_t, uint64_t>;
+		U u;
+		std::memcpy(&u, &key, sizeof(u));
+		U sign = U(1) << (sizeof(U) * 8 - 1);
+		return (u & sign) ? U(~u) : U(u | sign);
+	}
+	else
+	{
+		using U = std::make_unsigned_t<conditional_t<std::is_same<K, bool>::value, unsigned char, K>>;
+		U u = static_cast<U>(key);
+		if constexpr (std::is_signed<K>::value)
+			u ^= U(1) << (sizeof(U) * 8 - 1);
+		return u;
+	}
+}
+
+// one pass: every element of src to dst by the byte at shift of its key
+template<class SrcIt, class DstIt, class Key>
+inline void radix_scatter(SrcIt src, size_t n, DstIt dst, size_t* offsets, unsigned shift, Key& key)
+{
+	for (size_t i = 0; i < n; ++i, ++src)
+	{
+		size_t byte = static_cast<size_t>(radix_bits(key(*src)) >> shift) & 0xff;
+		dst[offsets[byte]++] = toy::move(*src);
+	}
+}
+
+// the same, with the elements for each byte gathered into a cache line first
+// and written a line at a time: 256 destinations written one element at a
+// time miss the TLB and the cache on most writes once n is large
+template<class T, class SrcIt, class DstIt, class Key>
+inline void radix_scatter_staged(SrcIt src, size_t n, DstIt dst, size_t* offsets, unsigned shift, Key& key)
+{
+	constexpr size_t line = 64 / sizeof(T);
+	alignas(64) T stage[256][line];
+	unsigned char fill[256] = {};
+	for (size_t i = 0; i < n; ++i, ++src)
+	{
+		size_t byte = static_cast<size_t>(radix_bits(key(*src)) >> shift) & 0xff;
+		stage[byte][fill[byte]] = *src;
+		if (++fill[byte] == line)
+		{
+			DstIt out = dst + static_cast<ptrdiff_t>(offsets[byte]);
+			for (size_t k = 0; k < line; ++k)
+				out[k] = stage[byte][k];
+			offsets[byte] += line;
+			fill[byte] = 0;
+		}
+	}
+	for (size_t byte = 0; byte < 256; ++byte)
+	{
+		DstIt out = dst + static_cast<ptrdiff_t>(offsets[byte]);
+		for (size_t k = 0; k < fill[byte]; ++k)
+			out[k] = stage[byte][k];
+	}
+}
+
+template<class T>
+struct radix_can_stage
+	: bool_constant<std::is_trivially_copyable<T>::value && std::is_trivially_default_constructible<T>::value &&
+		sizeof(T) <= 16 && 64 % sizeof(T) == 0>
+{
+};
+
+struct radix_identity
+{
+	template<class T>
+	const T& operator()(const T& value) const noexcept { return value; }
+};
+
+}	// namespace detail
+
+// sort ------------------------------------------------------------------------
+
+template<class RandomIt, class Compare = std::less<>>
+inline void sort(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+	using T = typename std::iterator_traits<RandomIt>::value_type;
+	ptrdiff_t n = last - first;
+	if (n < 2)
+		return;
+	int bad_allowed = bit_width(static_cast<size_t>(n));	// log2(n) bad partitions before heapsort
+	detail::pdqsort_loop<detail::sort_is_branchless<T, Compare>::value>(first, last, comp, bad_allowed, true);
+}
+
+// equal elements keep their order. With no memory for a buffer of n / 2
+// elements the merges are done in place, in O(n log^2 n)
+template<class RandomIt, class Compare = std::less<>>
+inline void stable_sort(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+	using T = typename std::iterator_traits<RandomIt>::value_type;
+	ptrdiff_t n = last - first;
+	if (n <= detail::stable_sort_threshold)
+	{
+		detail::insertion_sort(first, last, comp);
+		return;
+	}
+	detail::sort_buffer<T> buffer(static_cast<size_t>(n - n / 2));
+	if (buffer.data)
+		detail::stable_sort_buffered(first, last, buffer.data, comp);
+	else
+		detail::stable_sort_in_place(first, last, comp);
+}
+
+// sort_network ----------------------------------------------------------------
+// For the sorts of a few elements (the k nearest, a small bucket) where a
+// call of sort costs more than the sorting. Not stable. The keys of the
+// second form are sorted with the value at the same place in values moving
+// along, the values must be as large as the keys and trivially copyable for
+// the SIMD network.
+
+template<class RandomIt, class Compare = std::less<>>
+inline void sort_network(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+	using T = typename std::iterator_traits<RandomIt>::value_type;
+	size_t n = static_cast<size_t>(last - first);
+	if (n > sort_network_max)
+		throw std::length_error("sort_network -- more than sort_network_max elements");
+	if constexpr (detail::sort_network_simd<T, Compare>::value)
+		detail::simd_network_sort<false>(first, first, n, comp);
+	else
+		detail::scalar_network_sort<false>(first, first, n, comp);
+}
+
+template<class KeyIt, class ValueIt, class Compare = std::less<>>
+inline void sort_network_by_key(KeyIt first, KeyIt last, ValueIt values, Compare comp = Compare())
+{
+	using K = typename std::iterator_traits<KeyIt>::value_type;
+	using V = typename std::iterator_traits<ValueIt>::value_type;
+	size_t n = static_cast<size_t>(last - first);
+	if (n > sort_network_max)
+		throw std::length_error("sort_network_by_key -- more than sort_network_max elements");
+	if constexpr (detail::sort_network_simd<K, Compare>::value && sizeof(V) == sizeof(K) &&
+		std::is_trivially_copyable<V>::value)
+		detail::simd_network_sort<true>(first, values, n, comp);
+	else
+		detail::scalar_network_sort<true>(first, values, n, comp);
+}
+
+// radix_sort ------------------------------------------------------------------
+// One pass over the input counts every byte of every key, then a pass per
+// byte moves the elements by it between the range and a buffer of n
+// elements. A byte that is the same in every key (the high bytes of small
+// integers, the exponent of values in a narrow range) is skipped. Stable,
+// so records with equal keys keep their order.
+//
+//	radix_sort(keys.begin(), keys.end());
+//	radix_sort(rows.begin(), rows.end(), [](const row& r) { return r.timestamp; });
+
+template<class RandomIt, class Key>
+inline void radix_sort(RandomIt first, RandomIt last, Key key)
+{
+	using T = typename std::iterator_traits<RandomIt>::value_type;
+	using U = decltype(detail::radix_bits(key(*first)));
+	constexpr size_t passes = sizeof(U);
+
+	size_t n = static_cast<size_t>(last - first);
+	if (n < detail::radix_sort_threshold)
+	{
+		toy::stable_sort(first, last, [&key](const T& a, const T& b)
+		{
+			return detail::radix_bits(key(a)) < detail::radix_bits(key(b));
+		});
+		return;
+	}
+
+	size_t counts[passes][256] = {};
+	for (RandomIt it = first; it != last; ++it)
+	{
+		U bits = detail::radix_bits(key(*it));
+		for (size_t p = 0; p < passes; ++p)
+			++counts[p][static_cast<size_t>(bits >> (8 * p)) & 0xff];
+	}
+
+	detail::sort_buffer<T> buffer(n);
+	if (!buffer.data)
+		throw std::bad_alloc();
+	U any_bits = detail::radix_bits(key(*first));
+	bool in_buffer = false;
+	if constexpr (!std::is_trivially_copyable<T>::value)
+	{	// the elements are constructed in the buffer once, the passes move by assignment
+		std::uninitialized_move(first, last, buffer.data);
+		in_buffer = true;
+	}
+	for (size_t p = 0; p < passes; ++p)
+	{
+		if (counts[p][static_cast<size_t>(any_bits >> (8 * p)) & 0xff] == n)
+			continue;	// the same byte in every key
+
+		size_t offsets[256];
+		size_t sum = 0;
+		for (size_t b = 0; b < 256; ++b)
+		{
+			offsets[b] = sum;
+			sum += counts[p][b];
+		}
+		unsigned shift = static_cast<unsigned>(8 * p);
+		if constexpr (detail::radix_can_stage<T>::value)
+		{
+			if (in_buffer)
+				detail::radix_scatter_staged<T>(buffer.data, n, first, offsets, shift, key);
+			else
+				detail::radix_scatter_staged<T>(first, n, buffer.data, offsets, shift, key);
+		}
+		else
+		{
+			if (in_buffer)
+				detail::radix_scatter(buffer.data, n, first, offsets, shift, key);
+			else
+				detail::radix_scatter(first, n, buffer.data, offsets, shift, key);
+		}
+		in_buffer = !in_buffer;
+	}
+	if (in_buffer)
+		std::move(buffer.data, buffer.data + n, first);
+	if constexpr (!std::is_trivially_copyable<T>::value)
+		std::destroy(buffer.data, buffer.data + n);
+}
+
+template<class RandomIt>
+inline void radix_sort(RandomIt first, RandomIt last)
+{
+	radix_sort(first, last, detail::radix_identity());
+}
+
+}	// namespace toy
+
+#endif // TOY_ALGORITHM_SORT_H
@@ -0,0 +1,411 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_ALLOC_STATS_H
+#define TOY_CORE_ALLOC_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// TOY_ALLOC_STATS -------------------------------------------------------------
+// 1 to count the allocations of toy::allocator and of the global operator new
+// (when TOY_GLOBAL_NEW_IMPLEMENTATION replaces it), 0 compiles every hook to
+// nothing. Must have the same value in every file of a program, so it is set
+// in the project rather than in a source file: the AllocStats configuration
+// of toy_test and toy_test_new builds the tests with it on.
+
+#ifndef TOY_ALLOC_STATS
+#define TOY_ALLOC_STATS 0
+#endif
+
+namespace toy
+{
+
+// alloc stats -----------------------------------------------------------------
+
+// Allocations are charged to the tag of the innermost alloc_scope of the
+// calling thread, tag 0 when there is none. Tags are registered once and live
+// for the whole program; TOY_ALLOC_SITE() makes a tag of the call site.
+//
+// Every thread counts in a record of its own with plain relaxed stores, no
+// lock and no read-modify-write on the allocation path. A tracked block keeps
+// its tag and size in a 16 byte header, so a free is charged to the tag of the
+// allocation whichever thread or scope it happens in.
+//
+// alloc_stats_snapshot() sums the records of all threads. Live bytes are
+// exact, peak bytes come from global counters that every thread updates once
+// its unreported change passes 64K, so a peak may be missed by that much per
+// thread.
+
+constexpr size_t alloc_tag_capacity     = 64;
+constexpr size_t alloc_histogram_size   = 32;	// bucket i counts sizes in [2^i, 2^(i+1))
+
+using alloc_tag_id = uint32_t;
+
+struct alloc_tag_stats
+{
+	const char* name;
+
+	uint64_t allocations;
+	uint64_t deallocations;
+	uint64_t bytes_allocated;
+	uint64_t bytes_freed;
+	int64_t  live_bytes;
+	int64_t  peak_bytes;
+
+	uint64_t histogram[alloc_histogram_size];
+};
+
+struct alloc_snapshot
+{
+	std::vector<alloc_tag_stats> tags;	// indexed by alloc_tag_id
+	int64_t live_bytes{ 0 };
+	int64_t peak_bytes{ 0 };
+};
+
+#if TOY_ALLOC_STATS
+
+namespace detail
+{
+
+struct alloc_header
+{	// in front of every tracked block
+	uint32_t tag;
+	uint32_t offset;	// from the start of the block to the user pointer
+	uint64_t size;
+};
+
+static_assert(sizeof(alloc_header) == 16, "the header keeps 16 byte alignment");
+
+struct alloc_thread_record
+{
+	struct counters
+	{
+		std::atomic<uint64_t> allocations;
+		std::atomic<uint64_t> deallocations;
+		std::atomic<uint64_t> bytes_allocated;
+		std::atomic<uint64_t> bytes_freed;
+		std::atomic<uint64_t> histogram[alloc_histogram_size];
+	};
+
+	counters tags[alloc_tag_capacity];
+	int64_t  unreported[alloc_tag_capacity];	// live bytes not in the global counters yet
+
+	std::atomic<bool>    in_use;
+	alloc_thread_record* next;
+};
+
+struct alloc_global_state
+{
+	std::atomic<alloc_thread_record*> records{ nullptr };
+	std::atomic<alloc_tag_id>         tag_count{ 1 };
+	std::atomic<const char*>          names[alloc_tag_capacity]{};
+	std::atomic<int64_t>              live[alloc_tag_capacity]{};
+	std::atomic<int64_t>              peak[alloc_tag_capacity]{};
+	std::atomic<int64_t>              total_live{ 0 };
+	std::atomic<int64_t>              total_peak{ 0 };
+};
+
+// constant initialized, usable before main
+inline alloc_global_state alloc_state;
+
+struct alloc_thread_state
+{
+	alloc_thread_record* record;
+	alloc_tag_id         tag;
+	int                  state;		// 0 before the first use, 1 alive, 2 destroyed
+	int                  untracked;	// > 0 while tracked_allocate calls operator new
+};
+
+inline thread_local alloc_thread_state alloc_thread;
+
+constexpr int64_t alloc_report_threshold = 64 * 1024;
+
+inline void alloc_update_peak(std::atomic<int64_t>& peak, int64_t value) noexcept
+{
+	int64_t old = peak.load(std::memory_order_relaxed);
+	while (value > old && !peak.compare_exchange_weak(old, value, std::memory_order_relaxed))
+		;
+}
+
+inline void alloc_report(alloc_tag_id tag, int64_t bytes) noexcept
+{	// move unreported live bytes to the global counters
+	alloc_update_peak(alloc_state.peak[tag], alloc_state.live[tag].fetch_add(bytes, std::memory_order_relaxed) + bytes);
+	alloc_update_peak(alloc_state.total_peak, alloc_state.total_live.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+inline alloc_thread_record* alloc_acquire_record() noexcept
+{	// reuse the record of an exited thread, the counters keep adding up
+	for (alloc_thread_record* r = alloc_state.records.load(std::memory_order_acquire); r; r = r->next)
+	{
+		bool expected = false;
+		if (!r->in_use.load(std::memory_order_relaxed) && r->in_use.compare_exchange_strong(expected, true))
+			return r;
+	}
+
+	// calloc, not operator new, which may be the one being counted
+	alloc_thread_record* r = static_cast<alloc_thread_record*>(std::calloc(1, sizeof(alloc_thread_record)));
+	if (!r)
+		return nullptr;
+	r->in_use.store(true, std::memory_order_relaxed);
+	r->next = alloc_state.records.load(std::memory_order_relaxed);
+	while (!alloc_state.records.compare_exchange_weak(r->next, r, std::memory_order_release))
+		;
+	return r;
+}
+
+struct alloc_thread_exit
+{
+	~alloc_thread_exit()
+	{
+		alloc_thread_record* r = alloc_thread.record;
+		for (alloc_tag_id tag = 0; tag < alloc_tag_capacity; ++tag)
+		{
+			if (r->unreported[tag])
+				alloc_report(tag, r->unreported[tag]);
+			r->unreported[tag] = 0;
+		}
+		alloc_thread.record = nullptr;
+		alloc_thread.state = 2;
+		r->in_use.store(false, std::memory_order_release);
+	}
+};
+
+inline alloc_thread_record* alloc_local_record() noexcept
+{	// null once the thread is exiting, its allocations are no longer counted
+	alloc_thread_state& t = alloc_thread;
+	if (t.state == 1 || t.state == 2)
+		return t.record;
+
+	t.record = alloc_acquire_record();
+	if (!t.record)
+		return nullptr;
+	t.state = 1;
+	static thread_local alloc_thread_exit on_exit;
+	(void)on_exit;
+	return t.record;
+}
+
+inline size_t alloc_bucket(size_t size) noexcept
+{
+	size_t bucket = 0;
+	while (size >>= 1)
+		++bucket;
+	return bucket < alloc_histogram_size ? bucket : alloc_histogram_size - 1;
+}
+
+template<class T>
+inline void alloc_increment(std::atomic<T>& counter, T n) noexcept
+{	// single writer, a plain load and store is enough
+	counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void alloc_record(alloc_tag_id tag, size_t size) noexcept
+{
+	alloc_thread_record* r = alloc_local_record();
+	if (!r)
+		return;
+
+	alloc_thread_record::counters& c = r->tags[tag];
+	alloc_increment(c.allocations, uint64_t(1));
+	alloc_increment(c.bytes_allocated, uint64_t(size));
+	alloc_increment(c.histogram[alloc_bucket(size)], uint64_t(1));
+
+	if ((r->unreported[tag] += static_cast<int64_t>(size)) >= alloc_report_threshold)
+	{
+		alloc_report(tag, r->unreported[tag]);
+		r->unreported[tag] = 0;
+	}
+}
+
+inline void alloc_record_free(alloc_tag_id tag, size_t size) noexcept
+{
+	alloc_thread_record* r = alloc_local_record();
+	if (!r)
+		return;
+
+	alloc_thread_record::counters& c = r->tags[tag];
+	alloc_increment(c.deallocations, uint64_t(1));
+	alloc_increment(c.bytes_freed, uint64_t(size));
+
+	if ((r->unreported[tag] -= static_cast<int64_t>(size)) <= -alloc_report_threshold)
+	{
+		alloc_report(tag, r->unreported[tag]);
+		r->unreported[tag] = 0;
+	}
+}
+
+// header_size is 16 or the alignment when that is larger
+inline void* alloc_track(void* block, size_t size, size_t header_size) noexcept
+{
+	char* p = static_cast<char*>(block) + header_size;
+	alloc_header* h = reinterpret_cast<alloc_header*>(p) - 1;
+	h->tag    = alloc_thread.tag;
+	h->offset = static_cast<uint32_t>(header_size);
+	h->size   = size;
+	alloc_record(h->tag, size);
+	return p;
+}
+
+inline void* alloc_untrack(void* p) noexcept
+{	// the start of the block of a tracked pointer
+	alloc_header* h = static_cast<alloc_header*>(p) - 1;
+	alloc_record_free(h->tag, static_cast<size_t>(h->size));
+	return static_cast<char*>(p) - h->offset;
+}
+
+inline bool alloc_tracking() noexcept
+{	// false inside tracked_allocate, whose block is already counted
+	return alloc_thread.untracked == 0;
+}
+
+}	// namespace detail
+
+inline alloc_tag_id alloc_register_tag(const char* name) noexcept
+{	// name must outlive the program, tag 0 once the tags are used up
+	alloc_tag_id tag = detail::alloc_state.tag_count.fetch_add(1, std::memory_order_relaxed);
+	if (tag >= alloc_tag_capacity)
+		return 0;
+	detail::alloc_state.names[tag].store(name, std::memory_order_release);
+	return tag;
+}
+
+class alloc_scope
+{
+public:
+	explicit alloc_scope(alloc_tag_id tag) noexcept : previous(detail::alloc_thread.tag)
+	{
+		detail::alloc_thread.tag = tag;
+	}
+
+	~alloc_scope() { detail::alloc_thread.tag = previous; }
+
+	alloc_scope(const alloc_scope&) = delete;
+	alloc_scope& operator=(const alloc_scope&) = delete;
+
+private:
+	alloc_tag_id previous;
+};
+
+inline void* tracked_allocate(size_t size)
+{
+	constexpr size_t header_size = sizeof(detail::alloc_header);
+
+	++detail::alloc_thread.untracked;
+	void* block;
+	try
+	{
+		block = ::operator new(size + header_size);
+	}
+	catch (...)
+	{
+		--detail::alloc_thread.untracked;
+		throw;
+	}
+	--detail::alloc_thread.untracked;
+	return detail::alloc_track(block, size, header_size);
+}
+
+inline void tracked_deallocate(void* p) noexcept
+{
+	if (!p)
+		return;
+	void* block = detail::alloc_untrack(p);
+	++detail::alloc_thread.untracked;
+	::operator delete(block);
+	--detail::alloc_thread.untracked;
+}
+
+inline alloc_snapshot alloc_stats_snapshot()
+{
+	using namespace detail;
+
+	alloc_tag_id count = alloc_state.tag_count.load(std::memory_order_relaxed);
+	if (count > alloc_tag_capacity)
+		count = alloc_tag_capacity;
+
+	alloc_snapshot snapshot;
+	snapshot.tags.resize(count, alloc_tag_stats{});
+
+	for (alloc_thread_record* r = alloc_state.records.load(std::memory_order_acquire); r; r = r->next)
+	{
+		for (alloc_tag_id tag = 0; tag < count; ++tag)
+		{
+			const alloc_thread_record::counters& c = r->tags[tag];
+			alloc_tag_stats& s = snapshot.tags[tag];
+
+			s.allocations     += c.allocations.load(std::memory_order_relaxed);
+			s.deallocations   += c.deallocations.load(std::memory_order_relaxed);
+			s.bytes_allocated += c.bytes_allocated.load(std::memory_order_relaxed);
+			s.bytes_freed     += c.bytes_freed.load(std::memory_order_relaxed);
+			for (size_t i = 0; i < alloc_histogram_size; ++i)
+				s.histogram[i] += c.histogram[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	for (alloc_tag_id tag = 0; tag < count; ++tag)
+	{
+		alloc_tag_stats& s = snapshot.tags[tag];
+		const char* name = alloc_state.names[tag].load(std::memory_order_acquire);
+
+		s.name       = tag == 0 ? "untagged" : (name ? name : "");
+		s.live_bytes = static_cast<int64_t>(s.bytes_allocated - s.bytes_freed);
+		s.peak_bytes = alloc_state.peak[tag].load(std::memory_order_relaxed);
+		if (s.peak_bytes < s.live_bytes)
+			s.peak_bytes = s.live_bytes;
+
+		snapshot.live_bytes += s.live_bytes;
+	}
+
+	snapshot.peak_bytes = alloc_state.total_peak.load(std::memory_order_relaxed);
+	if (snapshot.peak_bytes < snapshot.live_bytes)
+		snapshot.peak_bytes = snapshot.live_bytes;
+	return snapshot;
+}
+
+inline void alloc_stats_reset_peak() noexcept
+{	// start a new peak from the reported live bytes
+	for (size_t tag = 0; tag < alloc_tag_capacity; ++tag)
+		detail::alloc_state.peak[tag].store(detail::alloc_state.live[tag].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	detail::alloc_state.total_peak.store(detail::alloc_state.total_live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+#else	// TOY_ALLOC_STATS
+
+inline alloc_tag_id alloc_register_tag(const char*) noexcept { return 0; }
+
+class alloc_scope
+{
+public:
+	explicit alloc_scope(alloc_tag_id) noexcept {}
+};
+
+inline void* tracked_allocate(size_t size) { return ::operator new(size); }
+inline void tracked_deallocate(void* p) noexcept { ::operator delete(p); }
+
+inline alloc_snapshot alloc_stats_snapshot() { return alloc_snapshot(); }
+inline void alloc_stats_reset_peak() noexcept {}
+
+#endif	// TOY_ALLOC_STATS
+
+}	// namespace toy
+
+// charge the allocations of the enclosing block to a tag named name, or to
+// the call site
+#define TOY_ALLOC_CONCAT_(a, b) a##b
+#define TOY_ALLOC_CONCAT(a, b) TOY_ALLOC_CONCAT_(a, b)
+#define TOY_ALLOC_STRING_(x) #x
+#define TOY_ALLOC_STRING(x) TOY_ALLOC_STRING_(x)
+
+#define TOY_ALLOC_SCOPE(name) \
+	static const ::toy::alloc_tag_id TOY_ALLOC_CONCAT(toy_alloc_tag_, __LINE__) = ::toy::alloc_register_tag(name); \
+	::toy::alloc_scope TOY_ALLOC_CONCAT(toy_alloc_scope_, __LINE__)(TOY_ALLOC_CONCAT(toy_alloc_tag_, __LINE__))
+
+#define TOY_ALLOC_SITE() TOY_ALLOC_SCOPE(__FILE__ "(" TOY_ALLOC_STRING(__LINE__) ")")
+
+#endif	// TOY_CORE_ALLOC_STATS_H
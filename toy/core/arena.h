@@ -0,0 +1,290 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_ARENA_H
+#define TOY_CORE_ARENA_H
+
+#include <cstddef>	// for size_t, max_align_t
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+#include "toy/core/utility.h"
+
+namespace toy
+{
+
+// arena -----------------------------------------------------------------------
+
+// Monotonic (bump pointer) allocator. Allocation moves a cursor forward,
+// deallocation does nothing, and everything is freed at once by reset().
+//
+// Memory comes from an optional initial buffer (e.g. on the stack), then from
+// a chain of blocks of growing size taken from ::operator new. reset() only
+// rewinds the cursor to the start and keeps the blocks for the next round,
+// so an arena reused per request stops touching the heap after warming up;
+// release() gives the blocks back.
+
+class arena
+{
+public:
+	static constexpr size_t default_block_size = 4096;
+	static constexpr size_t max_block_size     = 1024 * 1024;
+
+public:
+	arena() noexcept {}
+
+	explicit arena(size_t block_size) noexcept
+		: next_size(block_size < sizeof(block) * 2 ? sizeof(block) * 2 : block_size) {}
+
+	arena(void* buffer, size_t size) noexcept
+		: initial(static_cast<char*>(buffer)), initial_size(size),
+		  cursor(static_cast<char*>(buffer)), end(static_cast<char*>(buffer) + size) {}
+
+	~arena() { release(); }
+
+	arena(const arena&) = delete;
+	arena& operator=(const arena&) = delete;
+
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+	{
+		if (alignment == 0 || (alignment & (alignment - 1)))
+			throw std::invalid_argument("arena::allocate: alignment is not a power of two");
+
+		char* p = align_up(cursor, alignment);
+		if (p && p <= end && size <= static_cast<size_t>(end - p))
+		{
+			cursor = p + size;
+			return p;
+		}
+		return allocate_slow(size, alignment);
+	}
+
+	void reset() noexcept
+	{	// O(1): the blocks stay in the chain for reuse
+		if (initial)
+		{
+			current = nullptr;
+			cursor  = initial;
+			end     = initial + initial_size;
+		}
+		else if (head)
+		{
+			current = head;
+			cursor  = head->data();
+			end     = head->data() + head->size;
+		}
+	}
+
+	void release() noexcept
+	{	// give every block back and start over
+		while (head)
+		{
+			block* next = head->next;
+			::operator delete(head);
+			head = next;
+		}
+		current = nullptr;
+		cursor  = initial;
+		end     = initial ? initial + initial_size : nullptr;
+	}
+
+	bool owns(const void* p) const noexcept
+	{
+		const char* c = static_cast<const char*>(p);
+		if (initial && initial <= c && c < initial + initial_size)
+			return true;
+		for (block* b = head; b; b = b->next)
+			if (b->data() <= c && c < b->data() + b->size)
+				return true;
+		return false;
+	}
+
+	size_t block_count() const noexcept
+	{
+		size_t n = 0;
+		for (block* b = head; b; b = b->next)
+			++n;
+		return n;
+	}
+
+private:
+	struct block
+	{
+		block* next;
+		size_t size;	// bytes after the header
+
+		char* data() noexcept { return reinterpret_cast<char*>(this) + header_size(); }
+	};
+
+	static constexpr size_t header_size() noexcept
+	{
+		return (sizeof(block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+	}
+
+	static char* align_up(char* p, size_t alignment) noexcept
+	{
+		uintptr_t u = reinterpret_cast<uintptr_t>(p);
+		return reinterpret_cast<char*>((u + alignment - 1) & ~uintptr_t(alignment - 1));
+	}
+
+	void* allocate_slow(size_t size, size_t alignment)
+	{	// alignment is a power of two
+		// a block kept by reset() may be next in the chain
+		block* next = current ? current->next : head;
+		if (next)
+		{
+			char* p = align_up(next->data(), alignment);
+			char* last = next->data() + next->size;
+			if (p <= last && size <= static_cast<size_t>(last - p))
+			{
+				current = next;
+				cursor  = p + size;
+				end     = next->data() + next->size;
+				return p;
+			}
+		}
+
+		// a new block, big enough for the request, linked after the current one
+		if (size > SIZE_MAX - alignment - header_size())
+			throw std::bad_alloc();
+		size_t need = size + alignment;
+		size_t capacity = next_size > need ? next_size : need;
+		if (next_size < max_block_size)
+			next_size *= 2;
+
+		block* b = static_cast<block*>(::operator new(header_size() + capacity));
+		b->size = capacity;
+		if (current)
+		{
+			b->next = current->next;
+			current->next = b;
+		}
+		else
+		{
+			b->next = head;
+			head = b;
+		}
+
+		current = b;
+		char* p = align_up(b->data(), alignment);
+		cursor = p + size;
+		end    = b->data() + b->size;
+		return p;
+	}
+
+private:
+	char*  initial{ nullptr };	// the caller's buffer, not owned
+	size_t initial_size{ 0 };
+
+	block* head{ nullptr };		// chain of owned blocks
+	block* current{ nullptr };	// block of the cursor, null while in the initial buffer
+	char*  cursor{ nullptr };
+	char*  end{ nullptr };
+
+	size_t next_size{ default_block_size };
+};
+
+// inline_arena ----------------------------------------------------------------
+// arena whose initial buffer is a member, e.g. on the stack of a request handler
+
+template<size_t N>
+class inline_arena : public arena
+{
+public:
+	inline_arena() noexcept : arena(buffer, N) {}
+
+private:
+	alignas(std::max_align_t) char buffer[N];
+};
+
+// arena_allocator -------------------------------------------------------------
+
+// allocator with the interface of toy::allocator that takes its memory from an
+// arena, deallocate is a no-op: the memory comes back with arena::reset()
+
+template<class T>
+class arena_allocator
+{
+public:
+	using value_type	  = T;
+	using pointer		  = T*;
+	using const_pointer   = const T*;
+	using reference		  = T&;
+	using const_reference = const T&;
+
+	using size_type		  = size_t;
+	using difference_type = ptrdiff_t;
+
+	using propagate_on_container_copy_assignment = true_type;
+	using propagate_on_container_move_assignment = true_type;
+	using propagate_on_container_swap            = true_type;
+
+public:
+	template<class U> struct rebind { using other = arena_allocator<U>; };
+
+	// constructors
+	arena_allocator(arena& a) noexcept : source{ &a } {}
+	arena_allocator(const arena_allocator&) noexcept = default;
+	template <typename U> arena_allocator(const arena_allocator<U>& right) noexcept
+		: source{ right.get_arena() } {}
+
+	//
+	pointer address(reference ref) const noexcept { return std::addressof(ref); }
+	const_pointer address(const_reference ref) const noexcept { return std::addressof(ref); }
+
+	// allocate & deallocate
+	pointer allocate(size_t count)
+	{
+		if (count > max_size())
+			throw std::length_error("arena_allocator<T>::allocate(size_t n)"
+				" 'n' exceeds maximum supported size");
+		return static_cast<pointer>(source->allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(pointer, size_t) noexcept
+	{
+	}
+
+	// construct & destroy
+	template<class U, class... Args>
+	void construct(U* ptr, Args&&... args)
+	{
+		::new(const_cast<void*>(static_cast<const volatile void*>(ptr)))
+			U(toy::forward<Args>(args)...);
+	}
+
+	template<class U>
+	void destroy(U* ptr)
+	{
+		ptr->~U();
+	}
+
+	size_t max_size() const noexcept
+	{
+		return (static_cast<size_t>(-1) / sizeof(T));
+	}
+
+	arena* get_arena() const noexcept { return source; }
+
+private:
+	arena* source;
+};
+
+template <class T1, class T2>
+inline bool operator==(const arena_allocator<T1>& left, const arena_allocator<T2>& right) noexcept
+{
+	return left.get_arena() == right.get_arena();
+}
+
+template <class T1, class T2>
+inline bool operator!=(const arena_allocator<T1>& left, const arena_allocator<T2>& right) noexcept
+{
+	return !(left == right);
+}
+
+}	// namespace toy
+
+#endif	// TOY_CORE_ARENA_H
@@ -0,0 +1,726 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_BITSET_H
+#define TOY_CORE_BITSET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "toy/core/vector.h"
+#include "toy/utility/byte.h"
+
+namespace toy
+{
+
+// bit words -------------------------------------------------------------------
+// the loops of bitset and dynamic_bitset on arrays of 64 bit words. With
+// AVX2 the bulk operations take 8 words per step, without it the plain word
+// loops are left to the auto vectorizer
+
+namespace detail
+{
+
+using bit_word = uint64_t;
+
+constexpr size_t bits_per_word = 64;
+
+constexpr size_t words_for_bits(size_t n) noexcept
+{
+	return (n + bits_per_word - 1) / bits_per_word;
+}
+
+enum class bit_op { and_, or_, xor_, and_not };
+
+template<bit_op Op>
+inline bit_word apply_bit_op(bit_word a, bit_word b) noexcept
+{
+	if constexpr (Op == bit_op::and_)
+		return a & b;
+	else if constexpr (Op == bit_op::or_)
+		return a | b;
+	else if constexpr (Op == bit_op::xor_)
+		return a ^ b;
+	else
+		return a & ~b;
+}
+
+#if defined(__AVX2__)
+template<bit_op Op>
+inline __m256i apply_bit_op(__m256i a, __m256i b) noexcept
+{
+	if constexpr (Op == bit_op::and_)
+		return _mm256_and_si256(a, b);
+	else if constexpr (Op == bit_op::or_)
+		return _mm256_or_si256(a, b);
+	else if constexpr (Op == bit_op::xor_)
+		return _mm256_xor_si256(a, b);
+	else
+		return _mm256_andnot_si256(b, a);	// ~b & a
+}
+#endif
+
+template<bit_op Op>
+inline void bit_words_apply(bit_word* dest, const bit_word* a, const bit_word* b, size_t n) noexcept
+{	// dest[i] = a[i] op b[i], dest may be a
+	size_t i = 0;
+#if defined(__AVX2__)
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 4));
+		__m256i y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		__m256i y1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 4));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), apply_bit_op<Op>(x0, y0));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 4), apply_bit_op<Op>(x1, y1));
+	}
+#endif
+	for (; i < n; ++i)
+		dest[i] = apply_bit_op<Op>(a[i], b[i]);
+}
+
+inline size_t bit_words_count(const bit_word* w, size_t n) noexcept
+{	// four counters, so the popcnt instructions do not wait on each other
+	size_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		c0 += popcount(w[i]);
+		c1 += popcount(w[i + 1]);
+		c2 += popcount(w[i + 2]);
+		c3 += popcount(w[i + 3]);
+	}
+	for (; i < n; ++i)
+		c0 += popcount(w[i]);
+	return c0 + c1 + c2 + c3;
+}
+
+inline bool bit_words_intersect(const bit_word* a, const bit_word* b, size_t n) noexcept
+{
+	size_t i = 0;
+#if defined(__AVX2__)
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		if (!_mm256_testz_si256(x, y))
+			return true;
+	}
+#endif
+	for (; i < n; ++i)
+		if (a[i] & b[i])
+			return true;
+	return false;
+}
+
+inline bool bit_words_equal(const bit_word* a, const bit_word* b, size_t n) noexcept
+{
+	for (size_t i = 0; i < n; ++i)
+		if (a[i] != b[i])
+			return false;
+	return true;
+}
+
+inline size_t bit_words_find_next(const bit_word* w, size_t n, size_t pos) noexcept
+{	// the first 1 bit at or after pos, size_t(-1) if none
+	size_t i = pos / bits_per_word;
+	if (i >= n)
+		return size_t(-1);
+
+	bit_word x = w[i] & (~bit_word(0) << (pos % bits_per_word));
+	while (x == 0)
+	{
+		if (++i == n)
+			return size_t(-1);
+#if defined(__AVX2__)
+		for (; i + 4 <= n; i += 4)
+		{	// skip the zero words 4 at a time
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+			if (!_mm256_testz_si256(v, v))
+				break;
+		}
+		if (i == n)
+			return size_t(-1);
+#endif
+		x = w[i];
+	}
+	return i * bits_per_word + static_cast<size_t>(countr_zero(x));
+}
+
+inline void bit_words_fill(bit_word* w, size_t first, size_t last, bool value) noexcept
+{	// set the bits [first, last) to value
+	if (first >= last)
+		return;
+
+	size_t i = first / bits_per_word, j = (last - 1) / bits_per_word;
+	bit_word head = ~bit_word(0) << (first % bits_per_word);
+	bit_word tail = ~bit_word(0) >> (bits_per_word - 1 - (last - 1) % bits_per_word);
+	if (i == j)
+		head &= tail;
+
+	w[i] = value ? (w[i] | head) : (w[i] & ~head);
+	if (i == j)
+		return;
+	for (size_t k = i + 1; k < j; ++k)
+		w[k] = value ? ~bit_word(0) : 0;
+	w[j] = value ? (w[j] | tail) : (w[j] & ~tail);
+}
+
+class bit_reference
+{	// what operator[] of a bitset returns
+public:
+	bit_reference(bit_word* word, size_t bit) noexcept
+		: word(word), mask(bit_word(1) << bit)
+	{
+	}
+
+	bit_reference(const bit_reference&) = default;
+
+	bit_reference& operator=(bool value) noexcept
+	{
+		if (value)
+			*word |= mask;
+		else
+			*word &= ~mask;
+		return *this;
+	}
+
+	bit_reference& operator=(const bit_reference& right) noexcept { return *this = bool(right); }
+
+	operator bool() const noexcept { return (*word & mask) != 0; }
+	bool operator~() const noexcept { return (*word & mask) == 0; }
+
+	bit_reference& flip() noexcept
+	{
+		*word ^= mask;
+		return *this;
+	}
+
+private:
+	bit_word* word;
+	bit_word  mask;
+};
+
+}	// namespace detail
+
+// bitset ----------------------------------------------------------------------
+
+// std::bitset with the bulk operations on words, find_first/find_next and
+// and_not. The bits past N in the last word are always 0.
+
+template<size_t N>
+class bitset
+{
+	using word = detail::bit_word;
+
+public:
+	using reference = detail::bit_reference;
+
+	static constexpr size_t npos      = size_t(-1);
+	static constexpr size_t num_words = detail::words_for_bits(N) > 0 ? detail::words_for_bits(N) : 1;
+
+	constexpr bitset() noexcept : words{} {}
+
+	bitset(unsigned long long value) noexcept
+		: words{}
+	{
+		words[0] = static_cast<word>(value);
+		trim();
+	}
+
+	// element access
+
+	bool operator[](size_t pos) const noexcept { return (words[pos / 64] >> (pos % 64)) & 1; }
+	reference operator[](size_t pos) noexcept  { return reference(&words[pos / 64], pos % 64); }
+
+	bool test(size_t pos) const
+	{
+		if (pos >= N)
+			throw std::out_of_range("bitset::test -- invalid position");
+		return (*this)[pos];
+	}
+
+	// capacity and queries
+
+	static constexpr size_t size() noexcept { return N; }
+
+	size_t count() const noexcept { return detail::bit_words_count(words, num_words); }
+	bool   any() const noexcept   { return find_first() != npos; }
+	bool   none() const noexcept  { return !any(); }
+	bool   all() const noexcept   { return count() == N; }
+
+	size_t find_first() const noexcept { return detail::bit_words_find_next(words, num_words, 0); }
+
+	size_t find_next(size_t pos) const noexcept
+	{	// the first 1 bit after pos
+		return pos + 1 >= N ? npos : detail::bit_words_find_next(words, num_words, pos + 1);
+	}
+
+	bool intersects(const bitset& right) const noexcept { return detail::bit_words_intersect(words, right.words, num_words); }
+
+	// modifiers
+
+	bitset& set() noexcept
+	{
+		for (word& w : words)
+			w = ~word(0);
+		trim();
+		return *this;
+	}
+
+	bitset& set(size_t pos, bool value = true)
+	{
+		check_position(pos, "bitset::set -- invalid position");
+		(*this)[pos] = value;
+		return *this;
+	}
+
+	bitset& reset() noexcept
+	{
+		for (word& w : words)
+			w = 0;
+		return *this;
+	}
+
+	bitset& reset(size_t pos) { return set(pos, false); }
+
+	bitset& flip() noexcept
+	{
+		for (word& w : words)
+			w = ~w;
+		trim();
+		return *this;
+	}
+
+	bitset& flip(size_t pos)
+	{
+		check_position(pos, "bitset::flip -- invalid position");
+		(*this)[pos].flip();
+		return *this;
+	}
+
+	bitset& operator&=(const bitset& right) noexcept { return apply<detail::bit_op::and_>(right); }
+	bitset& operator|=(const bitset& right) noexcept { return apply<detail::bit_op::or_>(right); }
+	bitset& operator^=(const bitset& right) noexcept { return apply<detail::bit_op::xor_>(right); }
+	bitset& and_not(const bitset& right) noexcept    { return apply<detail::bit_op::and_not>(right); }
+
+	bitset operator~() const noexcept { return bitset(*this).flip(); }
+
+	bitset& operator<<=(size_t n) noexcept
+	{
+		if (n >= N)
+			return reset();
+		size_t shift = n / 64, bits = n % 64;
+		for (size_t i = num_words; i-- > 0; )
+		{
+			word w = i >= shift ? words[i - shift] << bits : 0;
+			if (bits != 0 && i > shift)
+				w |= words[i - shift - 1] >> (64 - bits);
+			words[i] = w;
+		}
+		trim();
+		return *this;
+	}
+
+	bitset& operator>>=(size_t n) noexcept
+	{
+		if (n >= N)
+			return reset();
+		size_t shift = n / 64, bits = n % 64;
+		for (size_t i = 0; i < num_words; ++i)
+		{
+			word w = i + shift < num_words ? words[i + shift] >> bits : 0;
+			if (bits != 0 && i + shift + 1 < num_words)
+				w |= words[i + shift + 1] << (64 - bits);
+			words[i] = w;
+		}
+		return *this;
+	}
+
+	bitset operator<<(size_t n) const noexcept { return bitset(*this) <<= n; }
+	bitset operator>>(size_t n) const noexcept { return bitset(*this) >>= n; }
+
+	bool operator==(const bitset& right) const noexcept { return detail::bit_words_equal(words, right.words, num_words); }
+	bool operator!=(const bitset& right) const noexcept { return !(*this == right); }
+
+	// the words, bit i is bit i % 64 of word i / 64
+	word*       data() noexcept       { return words; }
+	const word* data() const noexcept { return words; }
+
+private:
+	template<detail::bit_op Op>
+	bitset& apply(const bitset& right) noexcept
+	{
+		detail::bit_words_apply<Op>(words, words, right.words, num_words);
+		return *this;
+	}
+
+	void trim() noexcept
+	{	// clear the bits past N
+		if constexpr (N % 64 != 0)
+			words[num_words - 1] &= ~word(0) >> (64 - N % 64);
+		else if constexpr (N == 0)
+			words[0] = 0;
+	}
+
+	void check_position(size_t pos, const char* message) const
+	{
+		if (pos >= N)
+			throw std::out_of_range(message);
+	}
+
+private:
+	word words[num_words];
+};
+
+template<size_t N>
+inline bitset<N> operator&(const bitset<N>& a, const bitset<N>& b) noexcept { return bitset<N>(a) &= b; }
+
+template<size_t N>
+inline bitset<N> operator|(const bitset<N>& a, const bitset<N>& b) noexcept { return bitset<N>(a) |= b; }
+
+template<size_t N>
+inline bitset<N> operator^(const bitset<N>& a, const bitset<N>& b) noexcept { return bitset<N>(a) ^= b; }
+
+// dynamic_bitset --------------------------------------------------------------
+
+// a bitset whose size is set at run time, the words live in a toy::vector.
+// The binary operations need two bitsets of the same size.
+
+class dynamic_bitset
+{
+	using word = detail::bit_word;
+
+public:
+	using reference = detail::bit_reference;
+
+	static constexpr size_t npos = size_t(-1);
+
+	dynamic_bitset() noexcept {}
+
+	explicit dynamic_bitset(size_t n, bool value = false)
+		: words(detail::words_for_bits(n), value ? ~word(0) : word(0)), bits(n)
+	{
+		trim();
+	}
+
+	// element access
+
+	bool operator[](size_t pos) const noexcept { return (words[pos / 64] >> (pos % 64)) & 1; }
+	reference operator[](size_t pos) noexcept  { return reference(&words[pos / 64], pos % 64); }
+
+	bool test(size_t pos) const
+	{
+		check_position(pos, "dynamic_bitset::test -- invalid position");
+		return (*this)[pos];
+	}
+
+	// capacity and queries
+
+	size_t size() const noexcept      { return bits; }
+	bool   empty() const noexcept     { return bits == 0; }
+	size_t num_words() const noexcept { return words.size(); }
+
+	size_t count() const noexcept { return detail::bit_words_count(words.data(), words.size()); }
+	bool   any() const noexcept   { return find_first() != npos; }
+	bool   none() const noexcept  { return !any(); }
+	bool   all() const noexcept   { return count() == bits; }
+
+	size_t find_first() const noexcept { return detail::bit_words_find_next(words.data(), words.size(), 0); }
+
+	size_t find_next(size_t pos) const noexcept
+	{	// the first 1 bit after pos
+		return pos + 1 >= bits ? npos : detail::bit_words_find_next(words.data(), words.size(), pos + 1);
+	}
+
+	bool intersects(const dynamic_bitset& right) const
+	{
+		check_size(right);
+		return detail::bit_words_intersect(words.data(), right.words.data(), words.size());
+	}
+
+	bool is_subset_of(const dynamic_bitset& right) const
+	{
+		check_size(right);
+		for (size_t i = 0; i < words.size(); ++i)
+			if (words[i] & ~right.words[i])
+				return false;
+		return true;
+	}
+
+	// modifiers
+
+	void resize(size_t n, bool value = false)
+	{
+		size_t old = bits;
+		words.resize(detail::words_for_bits(n), value ? ~word(0) : word(0));
+		bits = n;
+		if (value && n > old)
+			detail::bit_words_fill(words.data(), old, n, true);	// the tail of the old last word
+		trim();
+	}
+
+	void clear() noexcept
+	{
+		words.clear();
+		bits = 0;
+	}
+
+	void reserve(size_t n) { words.reserve(detail::words_for_bits(n)); }
+
+	void push_back(bool value)
+	{
+		if (bits % 64 == 0)
+			words.push_back(0);
+		if (value)
+			words[bits / 64] |= word(1) << (bits % 64);
+		++bits;
+	}
+
+	dynamic_bitset& set() noexcept
+	{
+		for (word& w : words)
+			w = ~word(0);
+		trim();
+		return *this;
+	}
+
+	dynamic_bitset& set(size_t pos, bool value = true)
+	{
+		check_position(pos, "dynamic_bitset::set -- invalid position");
+		(*this)[pos] = value;
+		return *this;
+	}
+
+	dynamic_bitset& set(size_t pos, size_t count, bool value)
+	{	// the bits [pos, pos + count)
+		if (pos > bits || count > bits - pos)
+			throw std::out_of_range("dynamic_bitset::set -- invalid range");
+		detail::bit_words_fill(words.data(), pos, pos + count, value);
+		return *this;
+	}
+
+	dynamic_bitset& reset() noexcept
+	{
+		for (word& w : words)
+			w = 0;
+		return *this;
+	}
+
+	dynamic_bitset& reset(size_t pos) { return set(pos, false); }
+
+	dynamic_bitset& flip() noexcept
+	{
+		for (word& w : words)
+			w = ~w;
+		trim();
+		return *this;
+	}
+
+	dynamic_bitset& flip(size_t pos)
+	{
+		check_position(pos, "dynamic_bitset::flip -- invalid position");
+		(*this)[pos].flip();
+		return *this;
+	}
+
+	dynamic_bitset& operator&=(const dynamic_bitset& right) { return apply<detail::bit_op::and_>(right); }
+	dynamic_bitset& operator|=(const dynamic_bitset& right) { return apply<detail::bit_op::or_>(right); }
+	dynamic_bitset& operator^=(const dynamic_bitset& right) { return apply<detail::bit_op::xor_>(right); }
+	dynamic_bitset& and_not(const dynamic_bitset& right)    { return apply<detail::bit_op::and_not>(right); }
+
+	dynamic_bitset operator~() const
+	{
+		dynamic_bitset result(*this);
+		result.flip();
+		return result;
+	}
+
+	bool operator==(const dynamic_bitset& right) const noexcept
+	{
+		return bits == right.bits && detail::bit_words_equal(words.data(), right.words.data(), words.size());
+	}
+
+	bool operator!=(const dynamic_bitset& right) const noexcept { return !(*this == right); }
+
+	// the words, bit i is bit i % 64 of word i / 64
+	word*       data() noexcept       { return words.data(); }
+	const word* data() const noexcept { return words.data(); }
+
+private:
+	template<detail::bit_op Op>
+	dynamic_bitset& apply(const dynamic_bitset& right)
+	{
+		check_size(right);
+		detail::bit_words_apply<Op>(words.data(), words.data(), right.words.data(), words.size());
+		return *this;
+	}
+
+	void trim() noexcept
+	{	// clear the bits past size()
+		if (bits % 64 != 0)
+			words.back() &= ~word(0) >> (64 - bits % 64);
+	}
+
+	void check_position(size_t pos, const char* message) const
+	{
+		if (pos >= bits)
+			throw std::out_of_range(message);
+	}
+
+	void check_size(const dynamic_bitset& right) const
+	{
+		if (bits != right.bits)
+			throw std::invalid_argument("dynamic_bitset -- the sizes differ");
+	}
+
+private:
+	vector<word> words;
+	size_t       bits{ 0 };
+};
+
+inline dynamic_bitset operator&(const dynamic_bitset& a, const dynamic_bitset& b) { return dynamic_bitset(a) &= b; }
+inline dynamic_bitset operator|(const dynamic_bitset& a, const dynamic_bitset& b) { return dynamic_bitset(a) |= b; }
+inline dynamic_bitset operator^(const dynamic_bitset& a, const dynamic_bitset& b) { return dynamic_bitset(a) ^= b; }
+
+template<>
+struct is_trivially_relocatable<dynamic_bitset> : true_type {};
+
+// rank_select_index -----------------------------------------------------------
+
+// Constant time rank (the number of 1 bits before a position) and
+// logarithmic select (the position of the k-th 1 bit) over the words of a
+// bitset, for about 5% of its size: an absolute count per superblock of
+// 4096 bits and a 16 bit count per block of 512 bits relative to it, plus
+// the superblock of every 4096-th 1 bit to start the search of select.
+// It points into the bitset and must be built again after the bitset
+// changes.
+
+class rank_select_index
+{
+	using word = detail::bit_word;
+
+public:
+	static constexpr size_t npos            = size_t(-1);
+	static constexpr size_t block_words     = 8;
+	static constexpr size_t super_words     = 64;
+	static constexpr size_t select_sampling = 4096;
+
+	rank_select_index() noexcept {}
+
+	explicit rank_select_index(const dynamic_bitset& bits)
+	{
+		build(bits.data(), bits.num_words(), bits.size());
+	}
+
+	template<size_t N>
+	explicit rank_select_index(const bitset<N>& bits)
+	{
+		build(bits.data(), bitset<N>::num_words, N);
+	}
+
+	size_t size() const noexcept  { return bits; }
+	size_t count() const noexcept { return ones; }
+
+	size_t rank(size_t pos) const noexcept
+	{	// the 1 bits in [0, pos), pos <= size()
+		size_t w = pos / 64;
+		size_t result = supers[w / super_words] + blocks[w / block_words];
+		for (size_t i = w / block_words * block_words; i < w; ++i)
+			result += popcount(words[i]);
+		if (pos % 64 != 0)
+			result += popcount(words[w] & ~(~word(0) << (pos % 64)));
+		return result;
+	}
+
+	size_t select(size_t k) const noexcept
+	{	// the position of the k-th (from 0) 1 bit, npos if k >= count()
+		if (k >= ones)
+			return npos;
+
+		// the last superblock that starts at or before the k-th 1
+		size_t sample = k / select_sampling;
+		size_t lo = samples[sample];
+		size_t hi = sample + 1 < samples.size() ? samples[sample + 1] + 1 : supers.size() - 1;
+		while (hi - lo > 1)
+		{
+			size_t mid = lo + (hi - lo) / 2;
+			if (supers[mid] <= k)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		k -= supers[lo];
+
+		// then the block, and the word
+		size_t first_block = lo * (super_words / block_words);
+		size_t last_block = first_block + super_words / block_words;
+		if (last_block > blocks.size())
+			last_block = blocks.size();
+		size_t b = first_block;
+		while (b + 1 < last_block && blocks[b + 1] <= k)
+			++b;
+		k -= blocks[b];
+
+		for (size_t i = b * block_words; ; ++i)
+		{
+			size_t n = static_cast<size_t>(popcount(words[i]));
+			if (k < n)
+				return i * 64 + static_cast<size_t>(select_bit(words[i], static_cast<int>(k)));
+			k -= n;
+		}
+	}
+
+private:
+	void build(const word* w, size_t n, size_t size_in_bits)
+	{
+		words = w;
+		bits = size_in_bits;
+		size_t num_blocks = n / block_words + 1;
+		supers.assign(n / super_words + 2, 0);
+		blocks.assign(num_blocks, 0);
+		samples.clear();
+
+		size_t total = 0, in_super = 0;
+		for (size_t i = 0; i < num_blocks * block_words; ++i)
+		{
+			if (i % super_words == 0)
+			{
+				supers[i / super_words] = total;
+				in_super = 0;
+			}
+			if (i % block_words == 0)
+				blocks[i / block_words] = static_cast<uint16_t>(in_super);
+			if (i >= n)
+				continue;
+
+			size_t c = static_cast<size_t>(popcount(w[i]));
+			while (samples.size() * select_sampling < total + c)
+			{	// the superblock holding this sampled 1 bit
+				samples.push_back(i / super_words);
+			}
+			total += c;
+			in_super += c;
+		}
+		supers.back() = total;
+		ones = total;
+	}
+
+private:
+	const word*      words{ nullptr };
+	size_t           bits{ 0 };
+	size_t           ones{ 0 };
+	vector<size_t>   supers;	// the 1 bits before each superblock, and the total
+	vector<uint16_t> blocks;	// the 1 bits before each block, in its superblock
+	vector<size_t>   samples;	// the superblock of the 1 bits 0, 4096, 8192, ...
+};
+
+}	// namespace toy
+
+#endif	// TOY_CORE_BITSET_H
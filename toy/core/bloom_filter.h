@@ -0,0 +1,903 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_BLOOM_FILTER_H
+#define TOY_CORE_BLOOM_FILTER_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
+#include "toy/core/functional.h"
+#include "toy/core/span.h"
+#include "toy/core/utility.h"
+
+namespace toy
+{
+
+// membership filters ----------------------------------------------------------
+// Approximate sets for a cheap "certainly not there" before a disk or
+// network lookup: contains() never misses an inserted key and answers yes
+// for a key never inserted with a small probability (the false positive
+// rate), in a few bits per key.
+//
+// The filters hold hashes, not keys. insert(key) and contains(key) hash with
+// toy::hash<T>, the *_hash functions take a hash computed elsewhere, and
+// both mix it with the seed of the filter. A filter that is saved must be
+// queried with the same hash function: std::hash, under toy::hash, is not
+// the same across standard libraries, hash_bytes is.
+//
+// A filter serializes to a flat layout, a 64 byte header and then its
+// table, in the byte order of the machine. The *_view classes query such a
+// buffer in place, e.g. a file mapped at startup, without copying it.
+//
+//	bloom_filter filter(1000000, 0.01);
+//	filter.insert(record_id);
+//	if (!filter.contains(record_id)) ... skip the read
+//
+// contains_batch() hashes a group of keys and prefetches their blocks or
+// buckets before testing the first, so the cache misses of a group overlap
+// instead of being paid one after another.
+
+namespace detail
+{
+
+inline void filter_prefetch(const void* p) noexcept
+{
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	_mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#elif defined(__GNUC__)
+	__builtin_prefetch(p);
+#endif
+}
+
+constexpr size_t   filter_batch       = 16;		// keys hashed and prefetched ahead
+constexpr uint32_t filter_version     = 1;
+constexpr uint32_t filter_byte_order  = 0x01020304;
+constexpr size_t   filter_table_align = 64;
+
+struct filter_header
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t byte_order;	// filter_byte_order as written, reads back swapped on another endianness
+	uint64_t seed;
+	uint64_t size;			// blocks or buckets in the table
+	uint64_t count;			// keys inserted
+	uint64_t extra[3];		// the cuckoo filter keeps its victim here
+};
+
+static_assert(sizeof(filter_header) == 64, "the table follows the header on a cache line boundary");
+
+inline void write_filter_header(void* out, const char (&magic)[9], uint64_t seed, uint64_t size,
+	uint64_t count, uint64_t extra0 = 0, uint64_t extra1 = 0, uint64_t extra2 = 0) noexcept
+{
+	filter_header header;
+	std::memcpy(header.magic, magic, 8);
+	header.version = filter_version;
+	header.byte_order = filter_byte_order;
+	header.seed = seed;
+	header.size = size;
+	header.count = count;
+	header.extra[0] = extra0;
+	header.extra[1] = extra1;
+	header.extra[2] = extra2;
+	std::memcpy(out, &header, sizeof(header));
+}
+
+// the header of a serialized filter, checked against its magic and length
+inline filter_header read_filter_header(const void* data, size_t length, const char (&magic)[9],
+	size_t entry_size, const char* message)
+{
+	filter_header header;
+	if (length < sizeof(header))
+		throw std::invalid_argument(message);
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, magic, 8) != 0 || header.version != filter_version ||
+		header.byte_order != filter_byte_order || header.size == 0 ||
+		header.size > (length - sizeof(header)) / entry_size)
+		throw std::invalid_argument(message);
+	return header;
+}
+
+// the table of a filter, on cache line boundaries
+struct filter_table_delete
+{
+	void operator()(void* p) const noexcept
+	{
+		::operator delete(p, std::align_val_t(filter_table_align));
+	}
+};
+
+template<class T>
+using filter_table = std::unique_ptr<T[], filter_table_delete>;
+
+template<class T>
+inline filter_table<T> make_filter_table(size_t n)
+{	// zeroed
+	void* p = ::operator new(n * sizeof(T), std::align_val_t(filter_table_align));
+	std::memset(p, 0, n * sizeof(T));
+	return filter_table<T>(static_cast<T*>(p));
+}
+
+inline uint64_t filter_key(uint64_t hash, uint64_t seed) noexcept
+{
+	return hash_mix(hash ^ seed);
+}
+
+// blocked bloom filter --------------------------------------------------------
+// A key sets 8 bits in one 256 bit block, one bit in each 32 bit word of it,
+// picked by multiplying the low half of the hash with 8 odd constants (the
+// split block filter of Impala and Parquet). A lookup is one cache line,
+// with AVX2 the 8 bits are made, set and tested in a few instructions.
+
+struct bloom_block
+{
+	alignas(32) uint32_t words[8];
+};
+
+alignas(32) constexpr uint32_t bloom_salt[8] = {
+	0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+	0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+};
+
+inline size_t bloom_block_index(uint64_t key, size_t blocks) noexcept
+{	// the high half of the key scaled to [0, blocks), no division
+	return static_cast<size_t>(((key >> 32) * uint64_t(blocks)) >> 32);
+}
+
+#if defined(__AVX2__)
+inline __m256i bloom_mask(uint32_t key) noexcept
+{
+	__m256i salt = _mm256_load_si256(reinterpret_cast<const __m256i*>(bloom_salt));
+	__m256i shift = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(key)), salt), 27);
+	return _mm256_sllv_epi32(_mm256_set1_epi32(1), shift);
+}
+
+inline void bloom_block_insert(bloom_block& block, uint32_t key) noexcept
+{
+	__m256i* p = reinterpret_cast<__m256i*>(block.words);
+	_mm256_store_si256(p, _mm256_or_si256(_mm256_load_si256(p), bloom_mask(key)));
+}
+
+inline bool bloom_block_test(const bloom_block& block, uint32_t key) noexcept
+{	// testc: all bits of the mask are set in the block
+	return _mm256_testc_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(block.words)), bloom_mask(key)) != 0;
+}
+#else
+inline void bloom_block_insert(bloom_block& block, uint32_t key) noexcept
+{
+	for (size_t i = 0; i < 8; ++i)
+		block.words[i] |= uint32_t(1) << ((key * bloom_salt[i]) >> 27);
+}
+
+inline bool bloom_block_test(const bloom_block& block, uint32_t key) noexcept
+{
+	uint32_t missing = 0;
+	for (size_t i = 0; i < 8; ++i)
+	{
+		uint32_t bit = uint32_t(1) << ((key * bloom_salt[i]) >> 27);
+		missing |= ~block.words[i] & bit;
+	}
+	return missing == 0;
+}
+#endif
+
+// the queries of bloom_filter and bloom_filter_view
+inline bool bloom_contains(const bloom_block* blocks, size_t n, uint64_t seed, uint64_t hash) noexcept
+{
+	uint64_t key = filter_key(hash, seed);
+	return bloom_block_test(blocks[bloom_block_index(key, n)], static_cast<uint32_t>(key));
+}
+
+inline size_t bloom_contains_batch(const bloom_block* blocks, size_t n, uint64_t seed,
+	const uint64_t* hashes, size_t count, bool* results) noexcept
+{
+	size_t found = 0;
+	for (size_t first = 0; first < count; first += filter_batch)
+	{
+		size_t group = count - first < filter_batch ? count - first : filter_batch;
+		uint64_t keys[filter_batch];
+		const bloom_block* block[filter_batch];
+		for (size_t i = 0; i < group; ++i)
+		{
+			keys[i] = filter_key(hashes[first + i], seed);
+			block[i] = blocks + bloom_block_index(keys[i], n);
+			filter_prefetch(block[i]);
+		}
+		for (size_t i = 0; i < group; ++i)
+		{
+			bool hit = bloom_block_test(*block[i], static_cast<uint32_t>(keys[i]));
+			results[first + i] = hit;
+			found += hit;
+		}
+	}
+	return found;
+}
+
+template<class T, class Query>
+inline size_t filter_contains_keys(const T* keys, size_t count, bool* results, Query query)
+{	// hash a group of keys, then query the group in one batch
+	size_t found = 0;
+	uint64_t hashes[filter_batch];
+	for (size_t first = 0; first < count; first += filter_batch)
+	{
+		size_t group = count - first < filter_batch ? count - first : filter_batch;
+		for (size_t i = 0; i < group; ++i)
+			hashes[i] = toy::hash<T>{}(keys[first + i]);
+		found += query(hashes, group, results + first);
+	}
+	return found;
+}
+
+}	// namespace detail
+
+// bloom_filter ----------------------------------------------------------------
+
+class bloom_filter
+{
+public:
+	using block_type = detail::bloom_block;
+
+	bloom_filter() = default;
+
+	// sized for 'expected' keys at a false positive rate of 'fpp'
+	explicit bloom_filter(size_t expected, double fpp = 0.01, uint64_t seed = 0)
+		: bloom_filter(block_count_for(expected, fpp), seed, nullptr)
+	{
+	}
+
+	bloom_filter(const bloom_filter& right)
+		: bloom_filter(right.blocks, right.seed, nullptr)
+	{
+		if (blocks)
+			std::memcpy(table.get(), right.table.get(), blocks * sizeof(block_type));
+		inserted = right.inserted;
+	}
+
+	bloom_filter(bloom_filter&& right) noexcept
+		: table(toy::move(right.table)), blocks(right.blocks), seed(right.seed), inserted(right.inserted)
+	{
+		right.blocks = 0;
+		right.inserted = 0;
+	}
+
+	bloom_filter& operator=(const bloom_filter& right)
+	{
+		if (this != &right)
+			bloom_filter(right).swap(*this);
+		return *this;
+	}
+
+	bloom_filter& operator=(bloom_filter&& right) noexcept
+	{
+		bloom_filter(toy::move(right)).swap(*this);
+		return *this;
+	}
+
+	// the blocks needed for 'expected' keys at a false positive rate of 'fpp'
+	static size_t block_count_for(size_t expected, double fpp)
+	{
+		if (!(fpp > 0.0 && fpp < 1.0))
+			throw std::invalid_argument("bloom_filter -- fpp must be in (0, 1)");
+		// the estimate of a classic filter with 8 hashes, then grow it until
+		// the rate of the blocked layout, whose blocks fill unevenly, is met
+		double keys = double(expected ? expected : 1);
+		double bits = -8.0 * keys / std::log(1.0 - std::pow(fpp, 1.0 / 8.0));
+		size_t n = static_cast<size_t>(std::ceil(bits / 256.0));
+		n = n ? n : 1;
+		while (false_positive_rate(keys, n) > fpp)
+			n += n / 32 + 1;
+		return n;
+	}
+
+	// of 'keys' keys in 'blocks' blocks: the keys of a block are Poisson
+	// distributed, k of them leave a bit of a word clear with (31 / 32)^k
+	static double false_positive_rate(double keys, size_t blocks) noexcept
+	{
+		double load = keys / double(blocks);
+		double p = std::exp(-load);
+		double rate = 0.0;
+		size_t last = static_cast<size_t>(load + 10.0 * std::sqrt(load) + 10.0);
+		for (size_t k = 0; k <= last; ++k)
+		{
+			rate += p * std::pow(1.0 - std::pow(31.0 / 32.0, double(k)), 8.0);
+			p *= load / double(k + 1);
+		}
+		return rate;
+	}
+
+	// insert & lookup
+
+	template<class T>
+	void insert(const T& key) { insert_hash(toy::hash<T>{}(key)); }
+
+	void insert_hash(uint64_t hash)
+	{
+		if (blocks == 0)	// default constructed or moved from, one block to hold the key
+			bloom_filter(1, seed, nullptr).swap(*this);
+
+		uint64_t key = detail::filter_key(hash, seed);
+		detail::bloom_block_insert(table[detail::bloom_block_index(key, blocks)], static_cast<uint32_t>(key));
+		++inserted;
+	}
+
+	template<class T>
+	bool contains(const T& key) const { return contains_hash(toy::hash<T>{}(key)); }
+
+	bool contains_hash(uint64_t hash) const noexcept
+	{
+		return blocks && detail::bloom_contains(table.get(), blocks, seed, hash);
+	}
+
+	// results[i] = contains(keys[i]), the number of keys found
+	template<class T>
+	size_t contains_batch(const T* keys, size_t count, bool* results) const
+	{
+		return detail::filter_contains_keys(keys, count, results,
+			[this](const uint64_t* hashes, size_t n, bool* out) { return contains_hash_batch(hashes, n, out); });
+	}
+
+	size_t contains_hash_batch(const uint64_t* hashes, size_t count, bool* results) const noexcept
+	{
+		if (blocks == 0)
+		{
+			std::memset(results, 0, count);
+			return 0;
+		}
+		return detail::bloom_contains_batch(table.get(), blocks, seed, hashes, count, results);
+	}
+
+	// the union with a filter of the same size and seed
+	void merge(const bloom_filter& right)
+	{
+		if (blocks != right.blocks || seed != right.seed)
+			throw std::invalid_argument("bloom_filter::merge -- the filters differ in size or seed");
+		if (blocks == 0)
+			return;
+		uint32_t* a = table[0].words;
+		const uint32_t* b = right.table[0].words;
+		for (size_t i = 0, n = blocks * 8; i < n; ++i)
+			a[i] |= b[i];
+		inserted += right.inserted;
+	}
+
+	void clear() noexcept
+	{
+		if (blocks)
+			std::memset(table.get(), 0, blocks * sizeof(block_type));
+		inserted = 0;
+	}
+
+	// observers
+
+	size_t   block_count() const noexcept { return blocks; }
+	size_t   size_in_bytes() const noexcept { return blocks * sizeof(block_type); }
+	size_t   insert_count() const noexcept { return inserted; }
+	uint64_t hash_seed() const noexcept { return seed; }
+
+	// serialization, see membership filters above
+
+	size_t serialized_size() const noexcept { return sizeof(detail::filter_header) + size_in_bytes(); }
+
+	void serialize(span<unsigned char> out) const
+	{
+		if (out.size() < sizeof(detail::filter_header) || out.size() - sizeof(detail::filter_header) < size_in_bytes())
+			throw std::length_error("bloom_filter::serialize -- buffer too small");
+		detail::write_filter_header(out.data(), magic, seed, blocks, inserted);
+		if (blocks)
+			std::memcpy(out.data() + sizeof(detail::filter_header), table.get(), size_in_bytes());
+	}
+
+	static bloom_filter deserialize(span<const unsigned char> data)
+	{
+		detail::filter_header header = detail::read_filter_header(data.data(), data.size(), magic,
+			sizeof(block_type), "bloom_filter::deserialize -- not a serialized bloom_filter");
+		bloom_filter filter(static_cast<size_t>(header.size), header.seed, nullptr);
+		std::memcpy(filter.table.get(), data.data() + sizeof(detail::filter_header), filter.size_in_bytes());
+		filter.inserted = static_cast<size_t>(header.count);
+		return filter;
+	}
+
+	void swap(bloom_filter& right) noexcept
+	{
+		toy::swap(table, right.table);
+		toy::swap(blocks, right.blocks);
+		toy::swap(seed, right.seed);
+		toy::swap(inserted, right.inserted);
+	}
+
+private:
+	friend class bloom_filter_view;
+
+	static constexpr const char magic[9] = "TOYBLOOM";
+
+	bloom_filter(size_t blocks, uint64_t seed, std::nullptr_t)
+		: table(blocks ? detail::make_filter_table<block_type>(blocks) : nullptr), blocks(blocks), seed(seed)
+	{
+	}
+
+private:
+	detail::filter_table<block_type> table;
+	size_t                           blocks{ 0 };
+	uint64_t                         seed{ 0 };
+	size_t                           inserted{ 0 };
+};
+
+inline void swap(bloom_filter& a, bloom_filter& b) noexcept
+{
+	a.swap(b);
+}
+
+// the queries of a bloom_filter over its serialized bytes, which must stay
+// alive and be 32 byte aligned, as a mapped file is
+class bloom_filter_view
+{
+public:
+	using block_type = detail::bloom_block;
+
+	explicit bloom_filter_view(span<const unsigned char> data)
+	{
+		detail::filter_header header = detail::read_filter_header(data.data(), data.size(), bloom_filter::magic,
+			sizeof(block_type), "bloom_filter_view -- not a serialized bloom_filter");
+		if (reinterpret_cast<uintptr_t>(data.data()) % alignof(block_type) != 0)
+			throw std::invalid_argument("bloom_filter_view -- the data is not 32 byte aligned");
+		blocks = reinterpret_cast<const block_type*>(data.data() + sizeof(detail::filter_header));
+		count = static_cast<size_t>(header.size);
+		seed = header.seed;
+	}
+
+	template<class T>
+	bool contains(const T& key) const { return contains_hash(toy::hash<T>{}(key)); }
+
+	bool contains_hash(uint64_t hash) const noexcept
+	{
+		return detail::bloom_contains(blocks, count, seed, hash);
+	}
+
+	template<class T>
+	size_t contains_batch(const T* keys, size_t count, bool* results) const
+	{
+		return detail::filter_contains_keys(keys, count, results,
+			[this](const uint64_t* hashes, size_t n, bool* out) { return contains_hash_batch(hashes, n, out); });
+	}
+
+	size_t contains_hash_batch(const uint64_t* hashes, size_t n, bool* results) const noexcept
+	{
+		return detail::bloom_contains_batch(blocks, count, seed, hashes, n, results);
+	}
+
+	size_t   block_count() const noexcept { return count; }
+	uint64_t hash_seed() const noexcept { return seed; }
+
+private:
+	const block_type* blocks;
+	size_t            count;
+	uint64_t          seed;
+};
+
+// cuckoo filter ---------------------------------------------------------------
+// Fan et al., "Cuckoo Filter: Practically Better Than Bloom". A key is a 16
+// bit fingerprint stored in one of two buckets of 4, the second bucket is
+// the first xor the hash of the fingerprint, so an entry can be moved
+// without its key. Unlike a Bloom filter it erases keys, and at about
+// 0.01% false positives it takes fewer bits per key. It fills up: at a load
+// of about 95% an insert can't place every fingerprint, the one left over
+// waits in a victim slot and further inserts fail until an erase. A bucket is
+// one 64 bit word, a lookup compares the fingerprint with all 4 lanes of
+// it at once.
+
+namespace detail
+{
+
+constexpr uint64_t cuckoo_lanes = 0x0001000100010001ull;
+constexpr size_t   cuckoo_max_kicks = 500;
+
+inline uint16_t cuckoo_fingerprint(uint64_t key) noexcept
+{	// 0 marks an empty lane
+	uint16_t fp = static_cast<uint16_t>(key >> 48);
+	return fp ? fp : 1;
+}
+
+inline size_t cuckoo_alternate(size_t index, uint16_t fp, size_t mask) noexcept
+{
+	return (index ^ static_cast<size_t>(hash_mix(fp))) & mask;
+}
+
+inline bool cuckoo_bucket_has(uint64_t bucket, uint16_t fp) noexcept
+{	// a lane of bucket ^ fp is zero
+	uint64_t x = bucket ^ (uint64_t(fp) * cuckoo_lanes);
+	return ((x - cuckoo_lanes) & ~x & (cuckoo_lanes << 15)) != 0;
+}
+
+struct cuckoo_victim
+{	// the fingerprint the last failed insert could not place
+	uint16_t fp;
+	bool     used;
+	size_t   index;
+};
+
+inline bool cuckoo_contains(const uint64_t* buckets, size_t mask, uint64_t seed,
+	const cuckoo_victim& victim, uint64_t hash) noexcept
+{
+	uint64_t key = filter_key(hash, seed);
+	uint16_t fp = cuckoo_fingerprint(key);
+	size_t i1 = static_cast<size_t>(key) & mask;
+	size_t i2 = cuckoo_alternate(i1, fp, mask);
+	return cuckoo_bucket_has(buckets[i1], fp) || cuckoo_bucket_has(buckets[i2], fp) ||
+		(victim.used && victim.fp == fp && (victim.index == i1 || victim.index == i2));
+}
+
+inline size_t cuckoo_contains_batch(const uint64_t* buckets, size_t mask, uint64_t seed,
+	const cuckoo_victim& victim, const uint64_t* hashes, size_t count, bool* results) noexcept
+{
+	size_t found = 0;
+	for (size_t first = 0; first < count; first += filter_batch)
+	{
+		size_t group = count - first < filter_batch ? count - first : filter_batch;
+		uint16_t fps[filter_batch];
+		size_t   i1[filter_batch];
+		size_t   i2[filter_batch];
+		for (size_t i = 0; i < group; ++i)
+		{
+			uint64_t key = filter_key(hashes[first + i], seed);
+			fps[i] = cuckoo_fingerprint(key);
+			i1[i] = static_cast<size_t>(key) & mask;
+			i2[i] = cuckoo_alternate(i1[i], fps[i], mask);
+			filter_prefetch(buckets + i1[i]);
+			filter_prefetch(buckets + i2[i]);
+		}
+		for (size_t i = 0; i < group; ++i)
+		{
+			bool hit = cuckoo_bucket_has(buckets[i1[i]], fps[i]) || cuckoo_bucket_has(buckets[i2[i]], fps[i]) ||
+				(victim.used && victim.fp == fps[i] && (victim.index == i1[i] || victim.index == i2[i]));
+			results[first + i] = hit;
+			found += hit;
+		}
+	}
+	return found;
+}
+
+}	// namespace detail
+
+class cuckoo_filter
+{
+public:
+	cuckoo_filter() = default;
+
+	// room for 'capacity' keys, the table is a power of two of buckets
+	explicit cuckoo_filter(size_t capacity, uint64_t seed = 0)
+		: cuckoo_filter(bucket_count_for(capacity), seed, nullptr)
+	{
+	}
+
+	cuckoo_filter(const cuckoo_filter& right)
+		: cuckoo_filter(right.bucket_count(), right.seed, nullptr)
+	{
+		if (table)
+			std::memcpy(table.get(), right.table.get(), size_in_bytes());
+		inserted = right.inserted;
+		victim = right.victim;
+		random = right.random;
+	}
+
+	cuckoo_filter(cuckoo_filter&& right) noexcept
+		: table(toy::move(right.table)), mask(right.mask), seed(right.seed), inserted(right.inserted),
+		victim(right.victim), random(right.random)
+	{
+		right.mask = 0;
+		right.inserted = 0;
+		right.victim.used = false;
+	}
+
+	cuckoo_filter& operator=(const cuckoo_filter& right)
+	{
+		if (this != &right)
+			cuckoo_filter(right).swap(*this);
+		return *this;
+	}
+
+	cuckoo_filter& operator=(cuckoo_filter&& right) noexcept
+	{
+		cuckoo_filter(toy::move(right)).swap(*this);
+		return *this;
+	}
+
+	static size_t bucket_count_for(size_t capacity)
+	{	// 4 per bucket at a load of 95%
+		size_t buckets = 1;
+		while (buckets * 4 * 95 / 100 < capacity)
+		{
+			if (buckets > SIZE_MAX / sizeof(uint64_t) / 2 / (4 * 95))
+				throw std::length_error("cuckoo_filter -- capacity too large");
+			buckets *= 2;
+		}
+		return buckets;
+	}
+
+	// insert & lookup
+
+	template<class T>
+	bool insert(const T& key) { return insert_hash(toy::hash<T>{}(key)); }
+
+	bool insert_hash(uint64_t hash) noexcept
+	{	// false if the filter is full
+		if (!table || victim.used)
+			return false;
+
+		uint64_t key = detail::filter_key(hash, seed);
+		insert_fingerprint(static_cast<size_t>(key) & mask, detail::cuckoo_fingerprint(key));
+		return true;
+	}
+
+	template<class T>
+	bool contains(const T& key) const { return contains_hash(toy::hash<T>{}(key)); }
+
+	bool contains_hash(uint64_t hash) const noexcept
+	{
+		return table && detail::cuckoo_contains(table.get(), mask, seed, victim, hash);
+	}
+
+	template<class T>
+	size_t contains_batch(const T* keys, size_t count, bool* results) const
+	{
+		return detail::filter_contains_keys(keys, count, results,
+			[this](const uint64_t* hashes, size_t n, bool* out) { return contains_hash_batch(hashes, n, out); });
+	}
+
+	size_t contains_hash_batch(const uint64_t* hashes, size_t count, bool* results) const noexcept
+	{
+		if (!table)
+		{
+			std::memset(results, 0, count);
+			return 0;
+		}
+		return detail::cuckoo_contains_batch(table.get(), mask, seed, victim, hashes, count, results);
+	}
+
+	// erase one copy of a key that was inserted, erasing a key that wasn't
+	// can drop another key with the same fingerprint
+	template<class T>
+	bool erase(const T& key) { return erase_hash(toy::hash<T>{}(key)); }
+
+	bool erase_hash(uint64_t hash) noexcept
+	{
+		if (!table)
+			return false;
+		uint64_t key = detail::filter_key(hash, seed);
+		uint16_t fp = detail::cuckoo_fingerprint(key);
+		size_t i1 = static_cast<size_t>(key) & mask;
+		size_t i2 = detail::cuckoo_alternate(i1, fp, mask);
+
+		if (victim.used && victim.fp == fp && (victim.index == i1 || victim.index == i2))
+		{
+			victim.used = false;
+			--inserted;
+			return true;
+		}
+		if (!remove(i1, fp) && !remove(i2, fp))
+			return false;
+		--inserted;
+
+		if (victim.used)
+		{	// there is room now, try the victim again
+			victim.used = false;
+			--inserted;
+			insert_fingerprint(victim.index, victim.fp);
+		}
+		return true;
+	}
+
+	void clear() noexcept
+	{
+		if (table)
+			std::memset(table.get(), 0, size_in_bytes());
+		inserted = 0;
+		victim.used = false;
+	}
+
+	// observers
+
+	size_t   size() const noexcept { return inserted; }
+	size_t   bucket_count() const noexcept { return table ? mask + 1 : 0; }
+	size_t   size_in_bytes() const noexcept { return bucket_count() * sizeof(uint64_t); }
+	double   load_factor() const noexcept { return table ? double(inserted) / double(4 * bucket_count()) : 0.0; }
+	uint64_t hash_seed() const noexcept { return seed; }
+
+	// serialization, see membership filters above
+
+	size_t serialized_size() const noexcept { return sizeof(detail::filter_header) + size_in_bytes(); }
+
+	void serialize(span<unsigned char> out) const
+	{
+		if (out.size() < sizeof(detail::filter_header) || out.size() - sizeof(detail::filter_header) < size_in_bytes())
+			throw std::length_error("cuckoo_filter::serialize -- buffer too small");
+		detail::write_filter_header(out.data(), magic, seed, bucket_count(), inserted,
+			victim.fp, victim.used, victim.index);
+		if (table)
+			std::memcpy(out.data() + sizeof(detail::filter_header), table.get(), size_in_bytes());
+	}
+
+	static cuckoo_filter deserialize(span<const unsigned char> data)
+	{
+		detail::filter_header header = read_header(data, "cuckoo_filter::deserialize -- not a serialized cuckoo_filter");
+		cuckoo_filter filter(static_cast<size_t>(header.size), header.seed, nullptr);
+		std::memcpy(filter.table.get(), data.data() + sizeof(detail::filter_header), filter.size_in_bytes());
+		filter.inserted = static_cast<size_t>(header.count);
+		filter.victim = victim_of(header);
+		return filter;
+	}
+
+	void swap(cuckoo_filter& right) noexcept
+	{
+		toy::swap(table, right.table);
+		toy::swap(mask, right.mask);
+		toy::swap(seed, right.seed);
+		toy::swap(inserted, right.inserted);
+		toy::swap(victim, right.victim);
+		toy::swap(random, right.random);
+	}
+
+private:
+	friend class cuckoo_filter_view;
+
+	static constexpr const char magic[9] = "TOYCUCKO";
+
+	cuckoo_filter(size_t buckets, uint64_t seed, std::nullptr_t)
+		: table(buckets ? detail::make_filter_table<uint64_t>(buckets) : nullptr),
+		mask(buckets ? buckets - 1 : 0), seed(seed), random(hash_mix(seed) | 1)
+	{
+	}
+
+	static detail::filter_header read_header(span<const unsigned char> data, const char* message)
+	{
+		detail::filter_header header = detail::read_filter_header(data.data(), data.size(), magic, sizeof(uint64_t), message);
+		if ((header.size & (header.size - 1)) != 0 || (header.extra[1] && header.extra[2] >= header.size))
+			throw std::invalid_argument(message);
+		return header;
+	}
+
+	static detail::cuckoo_victim victim_of(const detail::filter_header& header) noexcept
+	{
+		return detail::cuckoo_victim{ static_cast<uint16_t>(header.extra[0]), header.extra[1] != 0,
+			static_cast<size_t>(header.extra[2]) };
+	}
+
+	bool put(size_t i, uint16_t fp) noexcept
+	{	// into an empty lane of bucket i
+		uint64_t bucket = table[i];
+		for (unsigned shift = 0; shift < 64; shift += 16)
+		{
+			if (((bucket >> shift) & 0xffff) == 0)
+			{
+				table[i] = bucket | (uint64_t(fp) << shift);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool remove(size_t i, uint16_t fp) noexcept
+	{
+		uint64_t bucket = table[i];
+		for (unsigned shift = 0; shift < 64; shift += 16)
+		{
+			if (((bucket >> shift) & 0xffff) == fp)
+			{
+				table[i] = bucket & ~(uint64_t(0xffff) << shift);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void insert_fingerprint(size_t i, uint16_t fp) noexcept
+	{	// into bucket i or its alternate, else kick a random entry to its other
+		// bucket, and so on, the last one that finds no room waits in the victim
+		if (put(i, fp) || put(detail::cuckoo_alternate(i, fp, mask), fp))
+		{
+			++inserted;
+			return;
+		}
+		for (size_t kick = 0; kick < detail::cuckoo_max_kicks; ++kick)
+		{
+			unsigned shift = unsigned(next_random() & 3) * 16;
+			uint16_t evicted = static_cast<uint16_t>(table[i] >> shift);
+			table[i] = (table[i] & ~(uint64_t(0xffff) << shift)) | (uint64_t(fp) << shift);
+			fp = evicted;
+			i = detail::cuckoo_alternate(i, fp, mask);
+			if (put(i, fp))
+			{
+				++inserted;
+				return;
+			}
+		}
+		victim = detail::cuckoo_victim{ fp, true, i };
+		++inserted;
+	}
+
+	uint64_t next_random() noexcept
+	{	// xorshift64, the kicks only need to not repeat a cycle
+		random ^= random << 13;
+		random ^= random >> 7;
+		random ^= random << 17;
+		return random;
+	}
+
+private:
+	detail::filter_table<uint64_t> table;
+	size_t                         mask{ 0 };
+	uint64_t                       seed{ 0 };
+	size_t                         inserted{ 0 };
+	detail::cuckoo_victim          victim{ 0, false, 0 };
+	uint64_t                       random{ 1 };
+};
+
+inline void swap(cuckoo_filter& a, cuckoo_filter& b) noexcept
+{
+	a.swap(b);
+}
+
+// the queries of a cuckoo_filter over its serialized bytes, which must stay
+// alive and be 8 byte aligned
+class cuckoo_filter_view
+{
+public:
+	explicit cuckoo_filter_view(span<const unsigned char> data)
+	{
+		detail::filter_header header = cuckoo_filter::read_header(data, "cuckoo_filter_view -- not a serialized cuckoo_filter");
+		if (reinterpret_cast<uintptr_t>(data.data()) % alignof(uint64_t) != 0)
+			throw std::invalid_argument("cuckoo_filter_view -- the data is not 8 byte aligned");
+		buckets = reinterpret_cast<const uint64_t*>(data.data() + sizeof(detail::filter_header));
+		mask = static_cast<size_t>(header.size) - 1;
+		seed = header.seed;
+		victim = cuckoo_filter::victim_of(header);
+		count = static_cast<size_t>(header.count);
+	}
+
+	template<class T>
+	bool contains(const T& key) const { return contains_hash(toy::hash<T>{}(key)); }
+
+	bool contains_hash(uint64_t hash) const noexcept
+	{
+		return detail::cuckoo_contains(buckets, mask, seed, victim, hash);
+	}
+
+	template<class T>
+	size_t contains_batch(const T* keys, size_t count, bool* results) const
+	{
+		return detail::filter_contains_keys(keys, count, results,
+			[this](const uint64_t* hashes, size_t n, bool* out) { return contains_hash_batch(hashes, n, out); });
+	}
+
+	size_t contains_hash_batch(const uint64_t* hashes, size_t n, bool* results) const noexcept
+	{
+		return detail::cuckoo_contains_batch(buckets, mask, seed, victim, hashes, n, results);
+	}
+
+	size_t   size() const noexcept { return count; }
+	size_t   bucket_count() const noexcept { return mask + 1; }
+	uint64_t hash_seed() const noexcept { return seed; }
+
+private:
+	const uint64_t*       buckets;
+	size_t                mask;
+	uint64_t              seed;
+	detail::cuckoo_victim victim;
+	size_t                count;
+};
+
+}	// namespace toy
+
+#endif // TOY_CORE_BLOOM_FILTER_H
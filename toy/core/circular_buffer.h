@@ -0,0 +1,433 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_CIRCULAR_BUFFER_H
+#define TOY_CORE_CIRCULAR_BUFFER_H
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include "toy/core/memory.h"
+#include "toy/core/span.h"
+#include "toy/core/type_traits.h"
+#include "toy/core/utility.h"
+#include "toy/utility/byte.h"
+
+namespace toy
+{
+
+// circular_buffer -------------------------------------------------------------
+
+// A fixed capacity ring, allocated once. The capacity is rounded up to a
+// power of two, so a position wraps with a mask instead of a division.
+// push_back on a full buffer overwrites the oldest element, which keeps a
+// sliding window of the last N values; try_push_back fails instead.
+//
+// The elements are at most two contiguous runs, as_spans() hands them out so
+// a consumer can write or memcpy them in two calls:
+//
+//	auto spans = window.as_spans();
+//	file.write(spans.first.data(), spans.first.size_bytes());
+//	file.write(spans.second.data(), spans.second.size_bytes());
+template<typename T, typename Allocator = allocator<T>>
+class circular_buffer
+{
+	using alloc_traits = std::allocator_traits<Allocator>;
+
+public:
+	using value_type             = T;
+	using allocator_type         = Allocator;
+	using pointer                = T*;
+	using const_pointer          = const T*;
+	using reference              = T&;
+	using const_reference        = const T&;
+	using size_type              = size_t;
+	using difference_type        = ptrdiff_t;
+
+	template<bool Const> class ring_iterator;
+
+	using iterator               = ring_iterator<false>;
+	using const_iterator         = ring_iterator<true>;
+	using reverse_iterator       = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	// room for at least 'capacity' elements, at least one
+	explicit circular_buffer(size_type capacity, const allocator_type& a = allocator_type())
+		: storage(a)
+	{
+		if (capacity > max_size())
+			throw std::length_error("circular_buffer -- capacity too large");
+		size_type n = bit_ceil(capacity);
+		storage.buffer = alloc_traits::allocate(storage, n);
+		storage.mask   = n - 1;
+	}
+
+	circular_buffer(const circular_buffer& right)
+		: circular_buffer(right.capacity(), alloc_traits::select_on_container_copy_construction(right.storage))
+	{
+		for (const T& value : right)
+			emplace_back(value);
+	}
+
+	circular_buffer(circular_buffer&& right) noexcept
+		: storage(toy::move(static_cast<allocator_type&>(right.storage)))
+	{
+		steal(right);
+	}
+
+	~circular_buffer()
+	{
+		release();
+	}
+
+	circular_buffer& operator=(const circular_buffer& right)
+	{
+		if (this != &right)
+			circular_buffer(right).swap(*this);
+		return *this;
+	}
+
+	circular_buffer& operator=(circular_buffer&& right)
+		noexcept(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value)
+	{
+		if (this == &right)
+			return *this;
+		if constexpr (alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value)
+		{
+			release();
+			if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+				static_cast<allocator_type&>(storage) = toy::move(static_cast<allocator_type&>(right.storage));
+			steal(right);
+		}
+		else if (static_cast<allocator_type&>(storage) == static_cast<allocator_type&>(right.storage))
+		{
+			release();
+			steal(right);
+		}
+		else
+		{	// the memory of 'right' can't be freed by our allocator, move the elements
+			circular_buffer moved(right.capacity(), storage);
+			for (T& value : right)
+				moved.emplace_back(toy::move(value));
+			release();
+			steal(moved);
+		}
+		return *this;
+	}
+
+	allocator_type get_allocator() const noexcept { return storage; }
+
+	// iterators, from the oldest to the newest
+
+	iterator       begin() noexcept        { return iterator(this, 0); }
+	const_iterator begin() const noexcept  { return const_iterator(this, 0); }
+	const_iterator cbegin() const noexcept { return const_iterator(this, 0); }
+	iterator       end() noexcept          { return iterator(this, storage.count); }
+	const_iterator end() const noexcept    { return const_iterator(this, storage.count); }
+	const_iterator cend() const noexcept   { return const_iterator(this, storage.count); }
+
+	reverse_iterator       rbegin() noexcept       { return reverse_iterator(end()); }
+	const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+	reverse_iterator       rend() noexcept         { return reverse_iterator(begin()); }
+	const_reverse_iterator rend() const noexcept   { return const_reverse_iterator(begin()); }
+
+	// capacity
+
+	bool      empty() const noexcept    { return storage.count == 0; }
+	bool      full() const noexcept     { return storage.count == capacity(); }
+	size_type size() const noexcept     { return storage.count; }
+	size_type capacity() const noexcept { return storage.buffer ? storage.mask + 1 : 0; }
+
+	size_type max_size() const noexcept
+	{
+		size_type n = alloc_traits::max_size(storage);
+		size_type limit = (size_type(1) << (std::numeric_limits<size_type>::digits - 1)) / sizeof(T);
+		return n < limit ? n : limit;
+	}
+
+	// element access, 0 is the oldest
+
+	reference       operator[](size_type i) noexcept       { return storage.buffer[slot(i)]; }
+	const_reference operator[](size_type i) const noexcept { return storage.buffer[slot(i)]; }
+
+	reference at(size_type i)
+	{
+		if (i >= storage.count)
+			throw std::out_of_range("circular_buffer::at -- invalid position");
+		return (*this)[i];
+	}
+
+	const_reference at(size_type i) const
+	{
+		if (i >= storage.count)
+			throw std::out_of_range("circular_buffer::at -- invalid position");
+		return (*this)[i];
+	}
+
+	reference       front() noexcept       { return storage.buffer[storage.head]; }
+	const_reference front() const noexcept { return storage.buffer[storage.head]; }
+	reference       back() noexcept        { return (*this)[storage.count - 1]; }
+	const_reference back() const noexcept  { return (*this)[storage.count - 1]; }
+
+	// the elements as the run from the oldest to the end of the buffer and
+	// the run that wrapped around to its start, the second may be empty
+	pair<span<T>, span<T>> as_spans() noexcept
+	{
+		size_type first = first_run();
+		return pair<span<T>, span<T>>(span<T>(storage.buffer + storage.head, first),
+			span<T>(storage.buffer, storage.count - first));
+	}
+
+	pair<span<const T>, span<const T>> as_spans() const noexcept
+	{
+		size_type first = first_run();
+		return pair<span<const T>, span<const T>>(span<const T>(storage.buffer + storage.head, first),
+			span<const T>(storage.buffer, storage.count - first));
+	}
+
+	// modifiers
+
+	template<class... Args>
+	reference emplace_back(Args&&... args)
+	{	// overwrites the oldest element when full
+		if (full())
+		{	// the arguments may refer to the oldest element, the new one is made before it goes
+			if (capacity() == 0)
+				throw std::length_error("circular_buffer::emplace_back -- no storage");
+			value_type value(toy::forward<Args>(args)...);
+			pointer p = storage.buffer + storage.head;
+			*p = toy::move(value);
+			storage.head = (storage.head + 1) & storage.mask;
+			return *p;
+		}
+		pointer p = storage.buffer + slot(storage.count);
+		alloc_traits::construct(storage, p, toy::forward<Args>(args)...);
+		++storage.count;
+		return *p;
+	}
+
+	void push_back(const value_type& value) { emplace_back(value); }
+	void push_back(value_type&& value)      { emplace_back(toy::move(value)); }
+
+	template<class... Args>
+	bool try_emplace_back(Args&&... args)
+	{	// false, and nothing constructed, when full
+		if (full())
+			return false;
+		alloc_traits::construct(storage, storage.buffer + slot(storage.count), toy::forward<Args>(args)...);
+		++storage.count;
+		return true;
+	}
+
+	bool try_push_back(const value_type& value) { return try_emplace_back(value); }
+	bool try_push_back(value_type&& value)      { return try_emplace_back(toy::move(value)); }
+
+	void append(const T* first, size_type n)
+	{	// push_back of every element of [first, first + n), only the last capacity() stay
+		if (n != 0 && !(first + n <= storage.buffer || storage.buffer + capacity() <= first))
+		{	// a run of our own elements, dropping or overwriting some would lose them: append a copy
+			circular_buffer copy(n, static_cast<const allocator_type&>(storage));
+			copy.append(first, n);
+			append(copy.storage.buffer, n);
+			return;
+		}
+
+		if (n >= capacity())
+		{
+			clear();
+			first += n - capacity();
+			n = capacity();
+		}
+		else if (storage.count + n > capacity())
+		{
+			size_type drop = storage.count + n - capacity();
+			destroy_front(drop);
+		}
+
+		if constexpr (std::is_trivially_copyable<T>::value)
+		{	// at most two copies, the elements need no construction
+			size_type at = slot(storage.count);
+			size_type run = capacity() - at < n ? capacity() - at : n;
+			if (run != 0)
+				std::memcpy(static_cast<void*>(storage.buffer + at), first, run * sizeof(T));
+			if (n - run != 0)
+				std::memcpy(static_cast<void*>(storage.buffer), first + run, (n - run) * sizeof(T));
+			storage.count += n;
+		}
+		else
+		{
+			for (size_type i = 0; i < n; ++i)
+				emplace_back(first[i]);
+		}
+	}
+
+	void pop_front() noexcept
+	{
+		alloc_traits::destroy(storage, storage.buffer + storage.head);
+		storage.head = (storage.head + 1) & storage.mask;
+		--storage.count;
+	}
+
+	void pop_back() noexcept
+	{
+		alloc_traits::destroy(storage, storage.buffer + slot(storage.count - 1));
+		--storage.count;
+	}
+
+	void clear() noexcept
+	{
+		destroy_front(storage.count);
+		storage.head = 0;
+	}
+
+	void swap(circular_buffer& right) noexcept
+	{
+		if constexpr (alloc_traits::propagate_on_container_swap::value)
+		{
+			using std::swap;
+			swap(static_cast<allocator_type&>(storage), static_cast<allocator_type&>(right.storage));
+		}
+		std::swap(storage.buffer, right.storage.buffer);
+		std::swap(storage.mask, right.storage.mask);
+		std::swap(storage.head, right.storage.head);
+		std::swap(storage.count, right.storage.count);
+	}
+
+	// ring_iterator, a random access iterator that wraps with the mask
+	template<bool Const>
+	class ring_iterator
+	{
+		using owner_type = conditional_t<Const, const circular_buffer, circular_buffer>;
+
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type        = T;
+		using difference_type   = ptrdiff_t;
+		using pointer           = conditional_t<Const, const T*, T*>;
+		using reference         = conditional_t<Const, const T&, T&>;
+
+		ring_iterator() noexcept = default;
+
+		template<bool C = Const, class = enable_if_t<C>>
+		ring_iterator(const ring_iterator<false>& right) noexcept
+			: owner(right.owner), index(right.index)
+		{
+		}
+
+		reference operator*() const noexcept                   { return (*owner)[index]; }
+		pointer   operator->() const noexcept                  { return &(*owner)[index]; }
+		reference operator[](difference_type n) const noexcept { return (*owner)[index + n]; }
+
+		ring_iterator& operator++() noexcept { ++index; return *this; }
+		ring_iterator& operator--() noexcept { --index; return *this; }
+		ring_iterator  operator++(int) noexcept { ring_iterator tmp = *this; ++index; return tmp; }
+		ring_iterator  operator--(int) noexcept { ring_iterator tmp = *this; --index; return tmp; }
+
+		ring_iterator& operator+=(difference_type n) noexcept { index += n; return *this; }
+		ring_iterator& operator-=(difference_type n) noexcept { index -= n; return *this; }
+
+		friend ring_iterator operator+(ring_iterator it, difference_type n) noexcept { return it += n; }
+		friend ring_iterator operator+(difference_type n, ring_iterator it) noexcept { return it += n; }
+		friend ring_iterator operator-(ring_iterator it, difference_type n) noexcept { return it -= n; }
+
+		friend difference_type operator-(const ring_iterator& a, const ring_iterator& b) noexcept
+		{
+			return static_cast<difference_type>(a.index) - static_cast<difference_type>(b.index);
+		}
+
+		friend bool operator==(const ring_iterator& a, const ring_iterator& b) noexcept { return a.index == b.index; }
+		friend bool operator!=(const ring_iterator& a, const ring_iterator& b) noexcept { return a.index != b.index; }
+		friend bool operator<(const ring_iterator& a, const ring_iterator& b) noexcept  { return a.index < b.index; }
+		friend bool operator>(const ring_iterator& a, const ring_iterator& b) noexcept  { return a.index > b.index; }
+		friend bool operator<=(const ring_iterator& a, const ring_iterator& b) noexcept { return a.index <= b.index; }
+		friend bool operator>=(const ring_iterator& a, const ring_iterator& b) noexcept { return a.index >= b.index; }
+
+	private:
+		friend class circular_buffer;
+		template<bool> friend class ring_iterator;
+
+		ring_iterator(owner_type* owner, size_type index) noexcept
+			: owner(owner), index(index)
+		{
+		}
+
+	private:
+		owner_type* owner{ nullptr };
+		size_type   index{ 0 };		// from the oldest, not wrapped
+	};
+
+private:
+	size_type slot(size_type i) const noexcept { return (storage.head + i) & storage.mask; }
+
+	size_type first_run() const noexcept
+	{	// the elements before the wrap
+		size_type to_end = storage.mask + 1 - storage.head;
+		return storage.count < to_end ? storage.count : to_end;
+	}
+
+	void destroy_front(size_type n) noexcept
+	{
+		if constexpr (std::is_trivially_destructible<T>::value)
+		{
+			storage.head = (storage.head + n) & storage.mask;
+			storage.count -= n;
+		}
+		else
+		{
+			while (n-- != 0)
+				pop_front();
+		}
+	}
+
+	void steal(circular_buffer& right) noexcept
+	{
+		storage.buffer = right.storage.buffer;
+		storage.mask   = right.storage.mask;
+		storage.head   = right.storage.head;
+		storage.count  = right.storage.count;
+		right.storage.buffer = nullptr;
+		right.storage.mask = right.storage.head = right.storage.count = 0;
+	}
+
+	void release() noexcept
+	{
+		if (storage.buffer == nullptr)
+			return;
+		clear();
+		alloc_traits::deallocate(storage, storage.buffer, storage.mask + 1);
+		storage.buffer = nullptr;
+	}
+
+private:
+	struct impl : allocator_type
+	{	// the allocator is a base, an empty one takes no room
+		impl(const allocator_type& a) noexcept : allocator_type(a) {}
+		impl(allocator_type&& a) noexcept : allocator_type(toy::move(a)) {}
+
+		T*        buffer{ nullptr };
+		size_type mask{ 0 };		// capacity - 1
+		size_type head{ 0 };		// the slot of the oldest element
+		size_type count{ 0 };
+	};
+
+	impl storage;
+};
+
+template<typename T, typename A>
+inline void swap(circular_buffer<T, A>& a, circular_buffer<T, A>& b) noexcept
+{
+	a.swap(b);
+}
+
+template<typename T, typename A>
+struct is_trivially_relocatable<circular_buffer<T, A>> : is_trivially_relocatable<A> {};
+
+}	// namespace toy
+
+#endif // TOY_CORE_CIRCULAR_BUFFER_H
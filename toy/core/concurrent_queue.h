@@ -0,0 +1,466 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_CONCURRENT_QUEUE_H
+#define TOY_CORE_CONCURRENT_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#include "toy/core/new.h"
+#include "toy/core/utility.h"
+
+namespace toy
+{
+
+namespace detail
+{
+
+inline size_t ring_capacity(size_t capacity)
+{	// round up to a power of two, so an index wraps with a mask
+	if (capacity < 2)
+		capacity = 2;
+	if (capacity > (static_cast<size_t>(-1) >> 2))
+		throw std::length_error("ring capacity is too large");
+
+	size_t n = 1;
+	while (n < capacity)
+		n <<= 1;
+	return n;
+}
+
+template<class T>
+struct ring_storage
+{	// uninitialized array of T
+	explicit ring_storage(size_t n)
+		: data(static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))))) {}
+
+	~ring_storage() { ::operator delete(data, std::align_val_t(alignof(T))); }
+
+	ring_storage(const ring_storage&) = delete;
+	ring_storage& operator=(const ring_storage&) = delete;
+
+	T* data;
+};
+
+}	// namespace detail
+
+// spsc_queue ------------------------------------------------------------------
+
+// Bounded single-producer/single-consumer ring buffer, wait-free on both
+// sides. The producer owns tail and the consumer owns head, each sits on its
+// own cache line together with a cached copy of the other side's index, so
+// the shared lines are only touched when the cached copy says full or empty.
+
+template<class T>
+class spsc_queue
+{
+public:
+	using value_type = T;
+	using size_type  = size_t;
+
+public:
+	explicit spsc_queue(size_type capacity)
+		: mask(detail::ring_capacity(capacity) - 1), storage(mask + 1) {}
+
+	~spsc_queue()
+	{
+		size_type head = consumer.index.load(std::memory_order_relaxed);
+		size_type tail = producer.index.load(std::memory_order_relaxed);
+		for (; head != tail; ++head)
+			storage.data[head & mask].~T();
+	}
+
+	spsc_queue(const spsc_queue&) = delete;
+	spsc_queue& operator=(const spsc_queue&) = delete;
+
+	size_type capacity() const noexcept { return mask + 1; }
+
+	size_type size() const noexcept
+	{	// approximate unless called from the producer or the consumer
+		return producer.index.load(std::memory_order_acquire)
+			- consumer.index.load(std::memory_order_acquire);
+	}
+
+	bool empty() const noexcept { return size() == 0; }
+
+	// producer side
+
+	template<class... Args>
+	bool try_emplace(Args&&... args)
+	{
+		size_type tail = producer.index.load(std::memory_order_relaxed);
+		if (tail - producer.cached >= capacity())
+		{
+			producer.cached = consumer.index.load(std::memory_order_acquire);
+			if (tail - producer.cached >= capacity())
+				return false;
+		}
+
+		::new (static_cast<void*>(storage.data + (tail & mask))) T(toy::forward<Args>(args)...);
+		producer.index.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool try_push(const T& value) { return try_emplace(value); }
+	bool try_push(T&& value) { return try_emplace(toy::move(value)); }
+
+	template<class InputIt>
+	size_type try_push_n(InputIt first, size_type count)
+	{	// push up to count elements with one publication, return the number pushed,
+		// none if a copy throws
+		size_type tail = producer.index.load(std::memory_order_relaxed);
+		size_type room = capacity() - (tail - producer.cached);
+		if (room < count)
+		{
+			producer.cached = consumer.index.load(std::memory_order_acquire);
+			room = capacity() - (tail - producer.cached);
+		}
+
+		size_type n = count < room ? count : room;
+		size_type i = 0;
+		try
+		{
+			for (; i < n; ++i, ++first)
+				::new (static_cast<void*>(storage.data + ((tail + i) & mask))) T(*first);
+		}
+		catch (...)
+		{	// the copies made so far were never published
+			while (i-- > 0)
+				storage.data[(tail + i) & mask].~T();
+			throw;
+		}
+
+		if (n != 0)
+			producer.index.store(tail + n, std::memory_order_release);
+		return n;
+	}
+
+	// consumer side
+
+	bool try_pop(T& value)
+	{
+		size_type head = consumer.index.load(std::memory_order_relaxed);
+		if (head == consumer.cached)
+		{
+			consumer.cached = producer.index.load(std::memory_order_acquire);
+			if (head == consumer.cached)
+				return false;
+		}
+
+		T* p = storage.data + (head & mask);
+		value = toy::move(*p);
+		p->~T();
+		consumer.index.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	template<class OutputIt>
+	size_type try_pop_n(OutputIt first, size_type count)
+	{	// pop up to count elements with one publication, return the number popped,
+		// if an assignment throws the elements before it are popped and the rest stay
+		size_type head = consumer.index.load(std::memory_order_relaxed);
+		size_type ready = consumer.cached - head;
+		if (ready < count)
+		{
+			consumer.cached = producer.index.load(std::memory_order_acquire);
+			ready = consumer.cached - head;
+		}
+
+		size_type n = count < ready ? count : ready;
+		size_type i = 0;
+		try
+		{
+			for (; i < n; ++i, ++first)
+			{
+				T* p = storage.data + ((head + i) & mask);
+				*first = toy::move(*p);
+				p->~T();
+			}
+		}
+		catch (...)
+		{	// the ones destroyed must not be popped again
+			if (i != 0)
+				consumer.index.store(head + i, std::memory_order_release);
+			throw;
+		}
+
+		if (n != 0)
+			consumer.index.store(head + n, std::memory_order_release);
+		return n;
+	}
+
+private:
+	struct alignas(hardware_destructive_interference_size) side
+	{
+		std::atomic<size_type> index{ 0 };	// written by the owner
+		size_type cached{ 0 };				// owner's copy of the other index
+	};
+
+	const size_type mask;
+	detail::ring_storage<T> storage;
+
+	side producer;
+	side consumer;
+};
+
+// mpmc_queue ------------------------------------------------------------------
+
+// Bounded multi-producer/multi-consumer queue of Dmitry Vyukov. Every cell
+// carries a sequence number that tells which lap of the ring it is ready for:
+// a producer may fill cell i of position pos when seq == pos, a consumer may
+// empty it when seq == pos + 1. Producers and consumers only contend on their
+// own index with a single CAS, and never on each other.
+//
+// A claimed cell must be published, or the queue stops at it for good, so
+// nothing that can throw runs between the CAS and the store of seq: T must be
+// nothrow move constructible, a push builds its element before the claim and
+// a pop moves it out of the cell before handing it over. If the assignment of
+// a popped element throws, that element is lost and the queue stays usable.
+//
+// references
+// http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+
+template<class T>
+class mpmc_queue
+{
+	static_assert(std::is_nothrow_move_constructible<T>::value, "mpmc_queue -- T must be nothrow move constructible");
+
+public:
+	using value_type = T;
+	using size_type  = size_t;
+
+public:
+	explicit mpmc_queue(size_type capacity)
+		: mask(detail::ring_capacity(capacity) - 1), cells(new cell[mask + 1])
+	{
+		for (size_type i = 0; i <= mask; ++i)
+			cells[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	~mpmc_queue()
+	{
+		size_type head = dequeue_pos.value.load(std::memory_order_relaxed);
+		size_type tail = enqueue_pos.value.load(std::memory_order_relaxed);
+		for (; head != tail; ++head)
+			cells[head & mask].value().~T();
+	}
+
+	mpmc_queue(const mpmc_queue&) = delete;
+	mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+	size_type capacity() const noexcept { return mask + 1; }
+
+	size_type size() const noexcept
+	{	// approximate while other threads are running
+		size_type tail = enqueue_pos.value.load(std::memory_order_relaxed);
+		size_type head = dequeue_pos.value.load(std::memory_order_relaxed);
+		return tail > head ? tail - head : 0;
+	}
+
+	bool empty() const noexcept { return size() == 0; }
+
+	template<class... Args>
+	bool try_emplace(Args&&... args)
+	{
+		if constexpr (std::is_nothrow_constructible<T, Args&&...>::value)
+			return emplace_claimed(toy::forward<Args>(args)...);
+		else
+			return emplace_claimed(T(toy::forward<Args>(args)...));
+	}
+
+	bool try_push(const T& value) { return try_emplace(value); }
+	bool try_push(T&& value) { return try_emplace(toy::move(value)); }
+
+	bool try_pop(T& value)
+	{
+		size_type pos = dequeue_pos.value.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell& c = cells[pos & mask];
+			size_type seq = c.seq.load(std::memory_order_acquire);
+			auto diff = static_cast<std::make_signed_t<size_type>>(seq - (pos + 1));
+
+			if (diff == 0)
+			{
+				if (dequeue_pos.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					T popped(toy::move(c.value()));
+					c.value().~T();
+					c.seq.store(pos + mask + 1, std::memory_order_release);
+					value = toy::move(popped);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;	// empty
+			}
+			else
+			{
+				pos = dequeue_pos.value.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	template<class InputIt>
+	size_type try_push_n(InputIt first, size_type count)
+	{	// claim the longest run of ready cells (at most count) with a single CAS,
+		// return the number pushed
+		if constexpr (!std::is_nothrow_constructible<T, decltype(*first)>::value)
+		{	// the copies could throw after the claim, one at a time instead: the
+			// elements before a copy that throws stay pushed
+			size_type n = 0;
+			for (; n < count && try_emplace(*first); ++n, ++first)
+			{
+			}
+			return n;
+		}
+		else
+		{
+			size_type pos = enqueue_pos.value.load(std::memory_order_relaxed);
+			size_type n = 0;
+			for (;;)
+			{
+				n = 0;
+				while (n < count && n <= mask
+					&& cells[(pos + n) & mask].seq.load(std::memory_order_acquire) == pos + n)
+					++n;
+
+				if (n == 0)
+				{
+					cell& c = cells[pos & mask];
+					auto diff = static_cast<std::make_signed_t<size_type>>(
+						c.seq.load(std::memory_order_acquire) - pos);
+					if (diff < 0 || count == 0)
+						return 0;
+					pos = enqueue_pos.value.load(std::memory_order_relaxed);
+					continue;
+				}
+
+				if (enqueue_pos.value.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+					break;
+			}
+
+			for (size_type i = 0; i < n; ++i, ++first)
+			{
+				cell& c = cells[(pos + i) & mask];
+				::new (static_cast<void*>(c.storage)) T(*first);
+				c.seq.store(pos + i + 1, std::memory_order_release);
+			}
+			return n;
+		}
+	}
+
+	template<class OutputIt>
+	size_type try_pop_n(OutputIt first, size_type count)
+	{	// claim the longest run of filled cells (at most count) with a single CAS,
+		// return the number popped
+		size_type pos = dequeue_pos.value.load(std::memory_order_relaxed);
+		size_type n = 0;
+		for (;;)
+		{
+			n = 0;
+			while (n < count && n <= mask
+				&& cells[(pos + n) & mask].seq.load(std::memory_order_acquire) == pos + n + 1)
+				++n;
+
+			if (n == 0)
+			{
+				cell& c = cells[pos & mask];
+				auto diff = static_cast<std::make_signed_t<size_type>>(
+					c.seq.load(std::memory_order_acquire) - (pos + 1));
+				if (diff < 0 || count == 0)
+					return 0;
+				pos = dequeue_pos.value.load(std::memory_order_relaxed);
+				continue;
+			}
+
+			if (dequeue_pos.value.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+				break;
+		}
+
+		size_type i = 0;
+		try
+		{
+			for (; i < n; ++i, ++first)
+			{
+				cell& c = cells[(pos + i) & mask];
+				T popped(toy::move(c.value()));
+				c.value().~T();
+				c.seq.store(pos + i + mask + 1, std::memory_order_release);
+				*first = toy::move(popped);
+			}
+		}
+		catch (...)
+		{	// the rest of the claimed cells are dropped, not left unpublished
+			for (++i; i < n; ++i)
+			{
+				cell& c = cells[(pos + i) & mask];
+				c.value().~T();
+				c.seq.store(pos + i + mask + 1, std::memory_order_release);
+			}
+			throw;
+		}
+		return n;
+	}
+
+private:
+	template<class... Args>
+	bool emplace_claimed(Args&&... args) noexcept
+	{	// constructing T from args does not throw
+		size_type pos = enqueue_pos.value.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell& c = cells[pos & mask];
+			size_type seq = c.seq.load(std::memory_order_acquire);
+			auto diff = static_cast<std::make_signed_t<size_type>>(seq - pos);
+
+			if (diff == 0)
+			{
+				if (enqueue_pos.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					::new (static_cast<void*>(c.storage)) T(toy::forward<Args>(args)...);
+					c.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;	// the cell still holds last lap's element, full
+			}
+			else
+			{
+				pos = enqueue_pos.value.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	struct cell
+	{
+		std::atomic<size_type> seq;
+		alignas(T) unsigned char storage[sizeof(T)];
+
+		T& value() noexcept { return *std::launder(reinterpret_cast<T*>(storage)); }
+	};
+
+	struct alignas(hardware_destructive_interference_size) padded_index
+	{
+		std::atomic<size_type> value{ 0 };
+	};
+
+	const size_type mask;
+	std::unique_ptr<cell[]> cells;
+
+	padded_index enqueue_pos;
+	padded_index dequeue_pos;
+};
+
+}	// namespace toy
+
+#endif	// TOY_CORE_CONCURRENT_QUEUE_H
@@ -0,0 +1,655 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_CONCURRENT_UNORDERED_MAP_H
+#define TOY_CORE_CONCURRENT_UNORDERED_MAP_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "toy/core/functional.h"
+#include "toy/core/memory.h"
+#include "toy/core/new.h"
+#include "toy/core/thread.h"
+#include "toy/core/utility.h"
+
+namespace toy
+{
+
+// concurrent_unordered_map ----------------------------------------------------
+
+// The keys are striped over a power-of-two number of shards by the high bits
+// of their hash. Each shard is an open addressing table (linear probing)
+// guarded by its own write lock, so writers on different shards never meet.
+//
+// Readers never take the lock when both K and V are trivially copyable:
+// they copy the slot out and validate the copy against the sequence counter
+// of the shard (seqlock), retrying if a writer got in between. Other types
+// are read under the shard lock.
+//
+// A shard grows on its own, under its own lock: a resize only stalls the
+// threads that hash into the same shard. When tombstones rather than live keys
+// fill a table, they are purged in place instead. With optimistic readers, a
+// table a shard grew out of is kept while a reader may still be walking it:
+// readers count themselves in the shard, and a writer frees the retired tables
+// once it sees no reader inside.
+//
+// K and V must be nothrow move constructible (or trivially relocatable), the
+// elements are moved around inside a table that has already been rewritten.
+
+template<class K, class V, class Hash = toy::hash<K>, class KeyEqual = std::equal_to<K>>
+class concurrent_unordered_map
+{
+	static_assert(is_trivially_relocatable<K>::value || std::is_nothrow_move_constructible<K>::value,
+		"concurrent_unordered_map -- K must be nothrow move constructible");
+	static_assert(is_trivially_relocatable<V>::value || std::is_nothrow_move_constructible<V>::value,
+		"concurrent_unordered_map -- V must be nothrow move constructible");
+
+public:
+	using key_type    = K;
+	using mapped_type = V;
+	using hasher      = Hash;
+	using key_equal   = KeyEqual;
+	using size_type   = size_t;
+
+	// readers copy slots without the lock only if it can't observe a torn object
+	static constexpr bool optimistic_read =
+		std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value;
+
+public:
+	explicit concurrent_unordered_map(size_type concurrency = 0,
+		const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual())
+		: hash_fn(hash), equal_fn(equal)
+	{
+		if (concurrency == 0)
+			concurrency = 4 * (std::max)(1u, std::thread::hardware_concurrency());
+
+		while ((size_type(1) << shard_bits) < concurrency && shard_bits < max_shard_bits)
+			++shard_bits;
+		shards.reset(new shard[size_type(1) << shard_bits]);
+	}
+
+	~concurrent_unordered_map()
+	{
+		for (size_type i = 0; i < shard_count(); ++i)
+		{
+			table* t = shards[i].current.load(std::memory_order_relaxed);
+			if (t)
+				t->destroy_all();
+		}
+	}
+
+	concurrent_unordered_map(const concurrent_unordered_map&) = delete;
+	concurrent_unordered_map& operator=(const concurrent_unordered_map&) = delete;
+
+	// capacity
+
+	size_type size() const noexcept
+	{	// a racy sum, exact only when no writer is running
+		size_type n = 0;
+		for (size_type i = 0; i < shard_count(); ++i)
+			n += shards[i].count.load(std::memory_order_relaxed);
+		return n;
+	}
+
+	bool empty() const noexcept { return size() == 0; }
+
+	size_type shard_count() const noexcept { return size_type(1) << shard_bits; }
+
+	size_type size_in_bytes() const
+	{	// the memory of the tables, the retired ones still kept for readers included
+		size_type bytes = 0;
+		for (size_type i = 0; i < shard_count(); ++i)
+		{
+			const shard& s = shards[i];
+			std::lock_guard<std::mutex> lock(s.mutex);
+			for (const auto& t : s.tables)
+				bytes += sizeof(table) + t->capacity() * sizeof(slot);
+		}
+		return bytes;
+	}
+
+	void reserve(size_type n)
+	{	// spread the reservation evenly, keys are uniform over the shards
+		size_type per_shard = n / shard_count() + 1;
+		for (size_type i = 0; i < shard_count(); ++i)
+		{
+			shard& s = shards[i];
+			std::lock_guard<std::mutex> lock(s.mutex);
+			size_type capacity = table_capacity_for(per_shard);
+			table* t = s.current.load(std::memory_order_relaxed);
+			if (!t || t->capacity() < capacity)
+			{
+				write_guard guard(s);
+				rehash(s, capacity);
+			}
+		}
+	}
+
+	// lookup
+
+	bool find(const K& key, V& value) const
+	{	// copy the mapped value of key into value, return false if absent
+		size_t h = hash_fn(key);
+		const shard& s = shard_for(h);
+
+		if constexpr (optimistic_read)
+		{
+			return read_optimistic(s, h, key, std::addressof(value));
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(s.mutex);
+			const slot* p = probe(s.current.load(std::memory_order_relaxed), h, key);
+			if (!p)
+				return false;
+			value = p->value();
+			return true;
+		}
+	}
+
+	bool contains(const K& key) const
+	{
+		size_t h = hash_fn(key);
+		const shard& s = shard_for(h);
+
+		if constexpr (optimistic_read)
+		{
+			return read_optimistic(s, h, key, nullptr);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(s.mutex);
+			return probe(s.current.load(std::memory_order_relaxed), h, key) != nullptr;
+		}
+	}
+
+	template<class F>
+	bool visit(const K& key, F&& f) const
+	{	// call f(const V&) under the shard lock, return false if key is absent
+		size_t h = hash_fn(key);
+		const shard& s = shard_for(h);
+		std::lock_guard<std::mutex> lock(s.mutex);
+		const slot* p = probe(s.current.load(std::memory_order_relaxed), h, key);
+		if (!p)
+			return false;
+		f(static_cast<const V&>(p->value()));
+		return true;
+	}
+
+	// modifiers
+
+	template<class... Args>
+	bool emplace(const K& key, Args&&... args)
+	{	// insert V(args...) if key is absent, return true if inserted
+		return upsert(key, [](V&) {},
+			[&]() { return V(toy::forward<Args>(args)...); });
+	}
+
+	bool insert(const K& key, const V& value)
+	{
+		return emplace(key, value);
+	}
+
+	bool insert_or_assign(const K& key, const V& value)
+	{	// return true if inserted, false if assigned
+		return upsert(key, [&](V& old) { old = value; },
+			[&]() { return value; });
+	}
+
+	template<class Make>
+	V find_or_insert(const K& key, Make&& make)
+	{	// return the mapped value of key, inserting make() first if it is absent,
+		// make runs under the shard lock, so it runs once per missing key
+		size_t h = hash_fn(key);
+		shard& s = shard_for(h);
+		std::lock_guard<std::mutex> lock(s.mutex);
+
+		slot* p = probe(s.current.load(std::memory_order_relaxed), h, key);
+		if (p)
+			return p->value();
+
+		write_guard guard(s);
+		p = insert_slot(s, h, key, make());
+		return p->value();
+	}
+
+	template<class Update, class Make>
+	bool upsert(const K& key, Update&& update, Make&& make)
+	{	// update(V&) the mapped value of key if present, else insert make(),
+		// both run under the shard lock, return true if inserted
+		size_t h = hash_fn(key);
+		shard& s = shard_for(h);
+		std::lock_guard<std::mutex> lock(s.mutex);
+
+		slot* p = probe(s.current.load(std::memory_order_relaxed), h, key);
+
+		write_guard guard(s);
+		if (p)
+		{
+			update(p->value());
+			return false;
+		}
+		insert_slot(s, h, key, make());
+		return true;
+	}
+
+	bool erase(const K& key)
+	{	// return true if key was erased
+		size_t h = hash_fn(key);
+		shard& s = shard_for(h);
+		std::lock_guard<std::mutex> lock(s.mutex);
+
+		slot* p = probe(s.current.load(std::memory_order_relaxed), h, key);
+		if (!p)
+			return false;
+
+		write_guard guard(s);
+		p->destroy();
+		p->state.store(slot_deleted, std::memory_order_relaxed);
+		s.count.store(s.count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+		reclaim(s);
+		return true;
+	}
+
+	void clear()
+	{	// not linearizable with respect to the other shards
+		for (size_type i = 0; i < shard_count(); ++i)
+		{
+			shard& s = shards[i];
+			std::lock_guard<std::mutex> lock(s.mutex);
+			write_guard guard(s);
+
+			table* t = s.current.load(std::memory_order_relaxed);
+			if (t)
+				t->destroy_all();
+
+			if (optimistic_read)
+			{	// an optimistic reader may be in the table, keep the memory
+				if (t)
+					for (size_type j = 0; j <= t->mask; ++j)
+						t->slots[j].state.store(slot_empty, std::memory_order_relaxed);
+				reclaim(s);
+			}
+			else
+			{
+				s.current.store(nullptr, std::memory_order_relaxed);
+				s.tables.clear();
+			}
+			s.count.store(0, std::memory_order_relaxed);
+			s.used = 0;
+		}
+	}
+
+	template<class F>
+	void for_each(F&& f) const
+	{	// call f(const K&, const V&) for every element, locks one shard at a time
+		for (size_type i = 0; i < shard_count(); ++i)
+		{
+			const shard& s = shards[i];
+			std::lock_guard<std::mutex> lock(s.mutex);
+			const table* t = s.current.load(std::memory_order_relaxed);
+			if (!t)
+				continue;
+			for (size_type j = 0; j <= t->mask; ++j)
+				if (is_full(t->slots[j].state.load(std::memory_order_relaxed)))
+					f(static_cast<const K&>(t->slots[j].key()),
+					  static_cast<const V&>(t->slots[j].value()));
+		}
+	}
+
+private:
+	// a slot's state is empty, deleted, or full with the low 7 bits of the hash
+	// as a tag, the probe starts at the bits above them
+	static constexpr uint8_t slot_empty   = 0;
+	static constexpr uint8_t slot_deleted = 1;
+	static constexpr uint8_t slot_moving  = 2;	// full, not yet put back by purge()
+
+	static constexpr bool is_full(uint8_t state) noexcept { return (state & 0x80) != 0; }
+	static constexpr uint8_t tag_of(size_t h) noexcept { return uint8_t(0x80 | (h & 0x7f)); }
+
+	static constexpr size_type min_capacity   = 16;
+	static constexpr unsigned  max_shard_bits = 16;
+
+	struct slot
+	{
+		std::atomic<uint8_t> state{ slot_empty };
+		alignas(K) unsigned char key_storage[sizeof(K)];
+		alignas(V) unsigned char value_storage[sizeof(V)];
+
+		K& key() noexcept { return *std::launder(reinterpret_cast<K*>(key_storage)); }
+		const K& key() const noexcept { return *std::launder(reinterpret_cast<const K*>(key_storage)); }
+		V& value() noexcept { return *std::launder(reinterpret_cast<V*>(value_storage)); }
+		const V& value() const noexcept { return *std::launder(reinterpret_cast<const V*>(value_storage)); }
+
+		void destroy() noexcept
+		{
+			key().~K();
+			value().~V();
+		}
+	};
+
+	struct table
+	{
+		explicit table(size_type capacity)
+			: mask(capacity - 1), slots(new slot[capacity]) {}
+
+		size_type capacity() const noexcept { return mask + 1; }
+
+		void destroy_all() noexcept
+		{
+			if (std::is_trivially_destructible<K>::value && std::is_trivially_destructible<V>::value)
+				return;
+			for (size_type i = 0; i <= mask; ++i)
+				if (is_full(slots[i].state.load(std::memory_order_relaxed)))
+					slots[i].destroy();
+		}
+
+		const size_type mask;
+		std::unique_ptr<slot[]> slots;
+	};
+
+	struct alignas(hardware_destructive_interference_size) shard
+	{
+		std::atomic<size_t>  seq{ 0 };	// odd while a writer is inside
+		mutable std::mutex   mutex;
+		std::atomic<table*>  current{ nullptr };
+		std::atomic<size_type> count{ 0 };	// full slots
+		size_type            used{ 0 };	// full and deleted slots
+
+		// current is tables.back(), the older ones are kept while an optimistic
+		// reader may be inside them
+		std::vector<std::unique_ptr<table>> tables;
+		alignas(hardware_destructive_interference_size) mutable std::atomic<size_t> readers{ 0 };
+	};
+
+	class read_guard
+	{	// an optimistic reader in the shard, from before it loads current
+	public:
+		explicit read_guard(const shard& s) noexcept : s(s)
+		{
+			s.readers.fetch_add(1, std::memory_order_seq_cst);
+		}
+
+		~read_guard()
+		{
+			s.readers.fetch_sub(1, std::memory_order_release);
+		}
+
+	private:
+		const shard& s;
+	};
+
+	class write_guard
+	{	// the writer side of the seqlock, the shard mutex must be held
+	public:
+		explicit write_guard(shard& s) : s(s)
+		{
+			s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+
+		~write_guard()
+		{
+			s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+	private:
+		shard& s;
+	};
+
+private:
+	shard& shard_for(size_t h) noexcept
+	{
+		return shards[shard_bits == 0 ? 0 : h >> (sizeof(size_t) * 8 - shard_bits)];
+	}
+
+	const shard& shard_for(size_t h) const noexcept
+	{
+		return shards[shard_bits == 0 ? 0 : h >> (sizeof(size_t) * 8 - shard_bits)];
+	}
+
+	static size_type table_capacity_for(size_type n) noexcept
+	{	// keep the load factor under 3/4
+		size_type capacity = min_capacity;
+		while (capacity * 3 < n * 4)
+			capacity *= 2;
+		return capacity;
+	}
+
+	slot* probe(table* t, size_t h, const K& key) const
+	{	// caller holds the shard lock
+		if (!t)
+			return nullptr;
+
+		uint8_t tag = tag_of(h);
+		for (size_type i = (h >> 7) & t->mask, n = 0; n <= t->mask; i = (i + 1) & t->mask, ++n)
+		{
+			uint8_t state = t->slots[i].state.load(std::memory_order_relaxed);
+			if (state == slot_empty)
+				return nullptr;
+			if (state == tag && equal_fn(t->slots[i].key(), key))
+				return &t->slots[i];
+		}
+		return nullptr;
+	}
+
+	const slot* probe(const table* t, size_t h, const K& key) const
+	{
+		return probe(const_cast<table*>(t), h, key);
+	}
+
+	bool read_optimistic(const shard& s, size_t h, const K& key, V* value) const
+	{	// lock-free lookup, copy the mapped value to value if it isn't null
+		alignas(V) unsigned char buffer[sizeof(V)];
+		read_guard reading(s);
+		for (backoff bo;; bo.pause())
+		{
+			size_t begin = s.seq.load(std::memory_order_acquire);
+			if (begin & 1)
+				continue;	// a writer is in the shard
+
+			bool found = false;
+			const table* t = s.current.load(std::memory_order_seq_cst);
+			if (t)
+			{
+				const slot* p = probe_optimistic(t, h, key);
+				if (p)
+				{
+					if (value)
+						std::memcpy(buffer, p->value_storage, sizeof(V));
+					found = true;
+				}
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (s.seq.load(std::memory_order_relaxed) == begin)
+			{
+				if (found && value)
+					std::memcpy(static_cast<void*>(value), buffer, sizeof(V));
+				return found;
+			}
+		}
+	}
+
+	const slot* probe_optimistic(const table* t, size_t h, const K& key) const
+	{	// the slots may be rewritten under our feet, only touch copies of the key,
+		// the caller validates the result against the sequence counter
+		alignas(K) unsigned char buffer[sizeof(K)];
+
+		uint8_t tag = tag_of(h);
+		for (size_type i = (h >> 7) & t->mask, n = 0; n <= t->mask; i = (i + 1) & t->mask, ++n)
+		{
+			uint8_t state = t->slots[i].state.load(std::memory_order_relaxed);
+			if (state == slot_empty)
+				return nullptr;
+			if (state == tag)
+			{
+				std::memcpy(buffer, t->slots[i].key_storage, sizeof(K));
+				if (equal_fn(*reinterpret_cast<const K*>(buffer), key))
+					return &t->slots[i];
+			}
+		}
+		return nullptr;
+	}
+
+	slot* insert_slot(shard& s, size_t h, const K& key, V&& value)
+	{	// key is known to be absent, caller holds the lock and the write guard
+		table* t = s.current.load(std::memory_order_relaxed);
+		if (!t || (s.used + 1) * 4 > t->capacity() * 3)
+		{	// grow, or just drop the tombstones if most of the load is deleted slots
+			size_type capacity = table_capacity_for(2 * (s.count.load(std::memory_order_relaxed) + 1));
+			if (t && capacity <= t->capacity())
+				purge(s, *t);
+			else
+				rehash(s, capacity);
+			t = s.current.load(std::memory_order_relaxed);
+		}
+		reclaim(s);
+
+		slot* p = nullptr;
+		for (size_type i = (h >> 7) & t->mask;; i = (i + 1) & t->mask)
+		{
+			uint8_t state = t->slots[i].state.load(std::memory_order_relaxed);
+			if (!is_full(state))
+			{
+				p = &t->slots[i];
+				if (state == slot_empty)
+					++s.used;
+				break;
+			}
+		}
+
+		::new (static_cast<void*>(p->key_storage)) K(key);
+		::new (static_cast<void*>(p->value_storage)) V(toy::move(value));
+		p->state.store(tag_of(h), std::memory_order_relaxed);
+		s.count.store(s.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return p;
+	}
+
+	void rehash(shard& s, size_type capacity)
+	{	// caller holds the lock and the write guard, move every element into a fresh table
+		std::unique_ptr<table> fresh(new table(capacity));
+		table* old = s.current.load(std::memory_order_relaxed);
+		if (old)
+		{
+			for (size_type i = 0; i <= old->mask; ++i)
+			{
+				slot& from = old->slots[i];
+				uint8_t state = from.state.load(std::memory_order_relaxed);
+				if (!is_full(state))
+					continue;
+
+				size_type j = (hash_fn(from.key()) >> 7) & fresh->mask;
+				while (fresh->slots[j].state.load(std::memory_order_relaxed) != slot_empty)
+					j = (j + 1) & fresh->mask;
+
+				slot& to = fresh->slots[j];
+				if (optimistic_read)
+				{	// trivially copyable slots stay readable
+					::new (static_cast<void*>(to.key_storage)) K(from.key());
+					::new (static_cast<void*>(to.value_storage)) V(from.value());
+				}
+				else
+				{	// a memcpy for trivially relocatable keys and values
+					relocate_at(&from.key(), reinterpret_cast<K*>(to.key_storage));
+					relocate_at(&from.value(), reinterpret_cast<V*>(to.value_storage));
+				}
+				to.state.store(state, std::memory_order_relaxed);
+			}
+		}
+
+		s.tables.reserve(s.tables.size() + 1);
+		s.current.store(fresh.get(), std::memory_order_seq_cst);
+		s.used = s.count.load(std::memory_order_relaxed);
+		if (!optimistic_read)
+			s.tables.clear();	// nobody reads without the lock
+		s.tables.push_back(toy::move(fresh));
+	}
+
+	void purge(shard& s, table& t) noexcept
+	{	// caller holds the lock and the write guard, drop the tombstones of t in
+		// place: every element is put back at the first slot of its probe that
+		// is not already taken by one put back before it
+		for (size_type i = 0; i <= t.mask; ++i)
+		{
+			uint8_t state = t.slots[i].state.load(std::memory_order_relaxed);
+			if (state == slot_deleted)
+				t.slots[i].state.store(slot_empty, std::memory_order_relaxed);
+			else if (is_full(state))
+				t.slots[i].state.store(slot_moving, std::memory_order_relaxed);
+		}
+
+		for (size_type i = 0; i <= t.mask; ++i)
+		{
+			slot& from = t.slots[i];
+			while (from.state.load(std::memory_order_relaxed) == slot_moving)
+			{
+				size_t h = hash_fn(from.key());
+				size_type j = (h >> 7) & t.mask;
+				while (is_full(t.slots[j].state.load(std::memory_order_relaxed)))
+					j = (j + 1) & t.mask;
+
+				slot& to = t.slots[j];
+				if (j == i)
+				{
+					from.state.store(tag_of(h), std::memory_order_relaxed);
+				}
+				else if (to.state.load(std::memory_order_relaxed) == slot_empty)
+				{
+					relocate_at(&from.key(), reinterpret_cast<K*>(to.key_storage));
+					relocate_at(&from.value(), reinterpret_cast<V*>(to.value_storage));
+					to.state.store(tag_of(h), std::memory_order_relaxed);
+					from.state.store(slot_empty, std::memory_order_relaxed);
+				}
+				else
+				{	// to is waiting too, swap and go on with the element of to
+					swap_slots(from, to);
+					to.state.store(tag_of(h), std::memory_order_relaxed);
+				}
+			}
+		}
+		s.used = s.count.load(std::memory_order_relaxed);
+	}
+
+	static void swap_slots(slot& a, slot& b) noexcept
+	{
+		alignas(K) unsigned char key[sizeof(K)];
+		alignas(V) unsigned char value[sizeof(V)];
+		relocate_at(&a.key(), reinterpret_cast<K*>(key));
+		relocate_at(&a.value(), reinterpret_cast<V*>(value));
+		relocate_at(&b.key(), reinterpret_cast<K*>(a.key_storage));
+		relocate_at(&b.value(), reinterpret_cast<V*>(a.value_storage));
+		relocate_at(std::launder(reinterpret_cast<K*>(key)), reinterpret_cast<K*>(b.key_storage));
+		relocate_at(std::launder(reinterpret_cast<V*>(value)), reinterpret_cast<V*>(b.value_storage));
+	}
+
+	static void reclaim(shard& s) noexcept
+	{	// caller holds the lock, free the retired tables when no reader can be
+		// in them: a reader counted after this load sees the current table
+		if (optimistic_read && s.tables.size() > 1 && s.readers.load(std::memory_order_seq_cst) == 0)
+			s.tables.erase(s.tables.begin(), s.tables.end() - 1);
+	}
+
+private:
+	std::unique_ptr<shard[]> shards;
+	unsigned shard_bits{};
+
+	Hash     hash_fn;
+	KeyEqual equal_fn;
+};
+
+}	// namespace toy
+
+#endif	// TOY_CORE_CONCURRENT_UNORDERED_MAP_H
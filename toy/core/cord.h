@@ -0,0 +1,521 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_CORD_H
+#define TOY_CORE_CORD_H
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+
+#include "toy/core/memory.h"
+#include "toy/core/string.h"
+#include "toy/core/string_view.h"
+
+namespace toy
+{
+
+// cord ------------------------------------------------------------------------
+
+// A rope: the text is the in-order sequence of the leaves of a height
+// balanced (AVL) binary tree. The nodes are immutable and shared through
+// intrusive_ptr, so copying a cord or taking a part of it copies no text,
+// and the cords made from one another share their common subtrees.
+//
+//	flat       the chars, stored right after the node
+//	substring  a range of a flat, so cutting a large flat copies nothing
+//	concat     two subtrees, 'length' is the sum of theirs
+//
+// Concatenation joins two trees in O(|height difference|) with the rotations
+// of an AVL tree, substring and insert are O(log n) joins. Small pieces are
+// merged into one flat, appending many short fragments does not build a tree
+// of tiny leaves.
+
+namespace detail
+{
+
+struct cord_node : intrusive_ref_counter<cord_node>
+{
+	using pointer = intrusive_ptr<const cord_node>;
+
+	enum kind_type : uint8_t { flat, substring, concat };
+
+	kind_type kind;
+	uint8_t   height;		// 0 for the leaves
+	size_t    length;
+	size_t    offset{ 0 };	// substring: the start in 'left', a flat
+	pointer   left;			// concat: the subtrees, substring: the flat
+	pointer   right;
+
+	cord_node(kind_type kind, uint8_t height, size_t length) noexcept
+		: kind(kind), height(height), length(length)
+	{
+	}
+
+	// a flat is allocated with its chars, the class operator delete is the
+	// unsized one so delete does not pass sizeof(cord_node)
+	static void operator delete(void* p) noexcept { ::operator delete(p); }
+
+	bool is_leaf() const noexcept { return kind != concat; }
+
+	const char* chars() const noexcept { return reinterpret_cast<const char*>(this + 1); }
+
+	string_view leaf() const noexcept
+	{	// the text of a flat or a substring
+		if (kind == flat)
+			return string_view(chars(), length);
+		return string_view(left->chars() + offset, length);
+	}
+
+	static pointer make_flat(string_view a, string_view b = string_view())
+	{	// a flat of the chars of 'a' followed by those of 'b'
+		void* p = ::operator new(sizeof(cord_node) + a.size() + b.size());
+		cord_node* node = ::new(p) cord_node(flat, 0, a.size() + b.size());
+		char* chars = reinterpret_cast<char*>(node + 1);
+		if (!a.empty())
+			std::memcpy(chars, a.data(), a.size());
+		if (!b.empty())
+			std::memcpy(chars + a.size(), b.data(), b.size());
+		return pointer(node);
+	}
+
+	static pointer make_substring(const pointer& flat_node, size_t offset, size_t length)
+	{
+		cord_node* node = ::new(::operator new(sizeof(cord_node))) cord_node(substring, 0, length);
+		node->offset = offset;
+		node->left = flat_node;
+		return pointer(node);
+	}
+
+	static pointer make_concat(pointer l, pointer r)
+	{
+		uint8_t h = static_cast<uint8_t>((l->height > r->height ? l->height : r->height) + 1);
+		cord_node* node = ::new(::operator new(sizeof(cord_node))) cord_node(concat, h, l->length + r->length);
+		node->left = toy::move(l);
+		node->right = toy::move(r);
+		return pointer(node);
+	}
+};
+
+}	// namespace detail
+
+class cord
+{
+	using node         = detail::cord_node;
+	using node_pointer = detail::cord_node::pointer;
+
+public:
+	using size_type = size_t;
+
+	static constexpr size_type npos = size_type(-1);
+
+	// leaves up to this size are merged by concatenation
+	static constexpr size_type max_merged_flat = 256;
+
+	// a part of a flat shorter than this is copied instead of shared
+	static constexpr size_type min_substring = 64;
+
+	// no AVL tree of less than 2^44 leaves is higher
+	static constexpr size_type max_height = 64;
+
+	// chunk_iterator ------------------------------------------------------
+	// visits the leaves in order, each chunk is a view into the cord
+
+	class chunk_iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type        = string_view;
+		using difference_type   = ptrdiff_t;
+		using pointer           = const string_view*;
+		using reference         = const string_view&;
+
+		chunk_iterator() noexcept = default;
+
+		explicit chunk_iterator(const node* root) noexcept
+		{
+			if (root != nullptr)
+				descend(root);
+		}
+
+		reference operator*() const noexcept  { return chunk; }
+		pointer   operator->() const noexcept { return &chunk; }
+
+		chunk_iterator& operator++() noexcept
+		{
+			if (depth == 0)
+				chunk = string_view();
+			else
+				descend(stack[--depth]);
+			return *this;
+		}
+
+		chunk_iterator operator++(int) noexcept
+		{
+			chunk_iterator tmp = *this;
+			++*this;
+			return tmp;
+		}
+
+		bool operator==(const chunk_iterator& right) const noexcept
+		{	// a leaf may appear twice in a cord, the pending subtrees tell apart
+			if (chunk.data() != right.chunk.data() || chunk.size() != right.chunk.size() || depth != right.depth)
+				return false;
+			for (size_type i = 0; i < depth; ++i)
+				if (stack[i] != right.stack[i])
+					return false;
+			return true;
+		}
+
+		bool operator!=(const chunk_iterator& right) const noexcept { return !(*this == right); }
+
+	private:
+		void descend(const node* n) noexcept
+		{	// to the leftmost leaf of 'n', the right subtrees wait on the stack
+			while (!n->is_leaf())
+			{
+				stack[depth++] = n->right.get();
+				n = n->left.get();
+			}
+			chunk = n->leaf();
+		}
+
+	private:
+		string_view chunk;
+		const node* stack[max_height];
+		size_type   depth{ 0 };
+	};
+
+	class chunk_range
+	{
+	public:
+		explicit chunk_range(const node* root) noexcept : root(root) {}
+
+		chunk_iterator begin() const noexcept { return chunk_iterator(root); }
+		chunk_iterator end() const noexcept   { return chunk_iterator(); }
+
+	private:
+		const node* root;
+	};
+
+	// construct
+
+	cord() noexcept = default;
+
+	cord(string_view s)
+		: root(s.empty() ? node_pointer() : node::make_flat(s))
+	{
+	}
+
+	cord(const char* s)
+		: cord(string_view(s))
+	{
+	}
+
+	// capacity
+
+	size_type size() const noexcept  { return root ? root->length : 0; }
+	size_type length() const noexcept { return size(); }
+	bool      empty() const noexcept { return !root; }
+	size_type height() const noexcept { return root ? root->height : 0; }
+
+	// element access, O(log n)
+
+	char operator[](size_type pos) const noexcept
+	{
+		const node* n = root.get();
+		while (!n->is_leaf())
+		{
+			if (pos < n->left->length)
+			{
+				n = n->left.get();
+			}
+			else
+			{
+				pos -= n->left->length;
+				n = n->right.get();
+			}
+		}
+		return n->leaf()[pos];
+	}
+
+	char at(size_type pos) const
+	{
+		if (pos >= size())
+			throw std::out_of_range("cord::at -- invalid position");
+		return (*this)[pos];
+	}
+
+	// modifiers
+
+	void clear() noexcept { root.reset(); }
+
+	void swap(cord& right) noexcept { root.swap(right.root); }
+
+	cord& append(string_view s)
+	{
+		if (s.empty())
+			return *this;
+		if (root)
+		{	// the rightmost leaf may take the chars
+			if (node_pointer merged = append_to_last_flat(root, s))
+			{
+				root = toy::move(merged);
+				return *this;
+			}
+		}
+		root = join(toy::move(root), node::make_flat(s));
+		return *this;
+	}
+
+	cord& append(const char* s) { return append(string_view(s)); }
+
+	cord& append(const cord& c)
+	{
+		root = join(toy::move(root), c.root);
+		return *this;
+	}
+
+	cord& prepend(string_view s)
+	{
+		if (!s.empty())
+			root = join(node::make_flat(s), toy::move(root));
+		return *this;
+	}
+
+	cord& prepend(const char* s) { return prepend(string_view(s)); }
+
+	cord& prepend(const cord& c)
+	{
+		root = join(c.root, toy::move(root));
+		return *this;
+	}
+
+	cord& operator+=(string_view s) { return append(s); }
+	cord& operator+=(const cord& c) { return append(c); }
+	cord& operator+=(const char* s) { return append(string_view(s)); }
+
+	cord& insert(size_type pos, const cord& c)
+	{
+		check_position(pos, "cord::insert -- invalid position");
+		size_type n = size();
+		root = join(join(sub(root, 0, pos), c.root), sub(root, pos, n - pos));
+		return *this;
+	}
+
+	cord& insert(size_type pos, string_view s) { return insert(pos, cord(s)); }
+	cord& insert(size_type pos, const char* s) { return insert(pos, cord(s)); }
+
+	cord& erase(size_type pos, size_type count = npos)
+	{
+		check_position(pos, "cord::erase -- invalid position");
+		size_type n = size();
+		if (count >= n - pos)
+			root = sub(root, 0, pos);
+		else
+			root = join(sub(root, 0, pos), sub(root, pos + count, n - pos - count));
+		return *this;
+	}
+
+	// operations
+
+	cord substr(size_type pos = 0, size_type count = npos) const
+	{
+		check_position(pos, "cord::substr -- invalid position");
+		size_type n = size() - pos;
+		cord result;
+		result.root = sub(root, pos, count < n ? count : n);
+		return result;
+	}
+
+	chunk_range chunks() const noexcept { return chunk_range(root.get()); }
+
+	template<class F>
+	void for_each_chunk(F&& f) const
+	{
+		for (string_view chunk : chunks())
+			f(chunk);
+	}
+
+	size_type copy(char* dest) const noexcept
+	{	// all the chars, no terminator
+		char* p = dest;
+		for (string_view chunk : chunks())
+		{
+			std::memcpy(p, chunk.data(), chunk.size());
+			p += chunk.size();
+		}
+		return static_cast<size_type>(p - dest);
+	}
+
+	string flatten() const
+	{
+		string result;
+		result.reserve(size());
+		for (string_view chunk : chunks())
+			result.append(chunk);
+		return result;
+	}
+
+	int compare(const cord& right) const noexcept
+	{
+		chunk_iterator a(root.get()), b(right.root.get()), last;
+		string_view x = a != last ? *a : string_view();
+		string_view y = b != last ? *b : string_view();
+		for (;;)
+		{	// the chunks of both sides need not line up
+			if (x.empty() && a != last && ++a != last)
+				x = *a;
+			if (y.empty() && b != last && ++b != last)
+				y = *b;
+			if (x.empty() || y.empty())
+				return x.empty() ? (y.empty() ? 0 : -1) : 1;
+
+			size_type n = x.size() < y.size() ? x.size() : y.size();
+			if (int result = std::memcmp(x.data(), y.data(), n))
+				return result;
+			x.remove_prefix(n);
+			y.remove_prefix(n);
+		}
+	}
+
+	int compare(string_view right) const noexcept
+	{
+		for (string_view chunk : chunks())
+		{
+			size_type n = chunk.size() < right.size() ? chunk.size() : right.size();
+			if (int result = n == 0 ? 0 : std::memcmp(chunk.data(), right.data(), n))
+				return result;
+			if (n < chunk.size())
+				return 1;
+			right.remove_prefix(n);
+		}
+		return right.empty() ? 0 : -1;
+	}
+
+private:
+	static node_pointer join(node_pointer l, node_pointer r)
+	{	// AVL join, l and r are balanced, so is the result
+		if (!l)
+			return r;
+		if (!r)
+			return l;
+
+		if (l->is_leaf() && r->is_leaf() && l->length + r->length <= max_merged_flat)
+			return node::make_flat(l->leaf(), r->leaf());
+
+		if (l->height > r->height + 1)
+		{	// down the right spine of l
+			node_pointer t = join(l->right, toy::move(r));
+			if (t->height <= l->left->height + 1)
+				return node::make_concat(l->left, toy::move(t));
+			if (t->left->height <= t->right->height)		// rotate left
+				return node::make_concat(node::make_concat(l->left, t->left), t->right);
+			const node_pointer& m = t->left;				// rotate right, then left
+			return node::make_concat(node::make_concat(l->left, m->left), node::make_concat(m->right, t->right));
+		}
+
+		if (r->height > l->height + 1)
+		{	// down the left spine of r
+			node_pointer t = join(toy::move(l), r->left);
+			if (t->height <= r->right->height + 1)
+				return node::make_concat(toy::move(t), r->right);
+			if (t->right->height <= t->left->height)		// rotate right
+				return node::make_concat(t->left, node::make_concat(t->right, r->right));
+			const node_pointer& m = t->right;				// rotate left, then right
+			return node::make_concat(node::make_concat(t->left, m->left), node::make_concat(m->right, r->right));
+		}
+
+		return node::make_concat(toy::move(l), toy::move(r));
+	}
+
+	static node_pointer sub(const node_pointer& n, size_type pos, size_type count)
+	{	// [pos, pos + count) of n
+		if (count == 0)
+			return node_pointer();
+		if (pos == 0 && count == n->length)
+			return n;
+
+		switch (n->kind)
+		{
+		case node::flat:
+			if (count < min_substring)
+				return node::make_flat(string_view(n->chars() + pos, count));
+			return node::make_substring(n, pos, count);
+
+		case node::substring:
+			if (count < min_substring)
+				return node::make_flat(n->leaf().substr(pos, count));
+			return node::make_substring(n->left, n->offset + pos, count);
+
+		default:
+			{
+				size_type left_length = n->left->length;
+				if (pos + count <= left_length)
+					return sub(n->left, pos, count);
+				if (pos >= left_length)
+					return sub(n->right, pos - left_length, count);
+				return join(sub(n->left, pos, left_length - pos), sub(n->right, 0, pos + count - left_length));
+			}
+		}
+	}
+
+	static node_pointer append_to_last_flat(const node_pointer& n, string_view s)
+	{	// a copy of the right spine of n whose last flat also holds s,
+		// nullptr if that leaf is not a flat or would grow too large
+		if (n->kind == node::flat)
+		{
+			if (n->length + s.size() > max_merged_flat)
+				return node_pointer();
+			return node::make_flat(n->leaf(), s);
+		}
+		if (n->kind == node::substring)
+			return node_pointer();
+
+		node_pointer r = append_to_last_flat(n->right, s);
+		if (!r)
+			return r;
+		return node::make_concat(n->left, toy::move(r));
+	}
+
+	void check_position(size_type pos, const char* message) const
+	{
+		if (pos > size())
+			throw std::out_of_range(message);
+	}
+
+private:
+	node_pointer root;
+};
+
+template<>
+struct is_trivially_relocatable<cord> : true_type {};
+
+inline cord operator+(cord a, const cord& b)
+{
+	return toy::move(a.append(b));
+}
+
+inline bool operator==(const cord& a, const cord& b) noexcept { return a.size() == b.size() && a.compare(b) == 0; }
+inline bool operator!=(const cord& a, const cord& b) noexcept { return !(a == b); }
+inline bool operator<(const cord& a, const cord& b) noexcept  { return a.compare(b) < 0; }
+
+inline bool operator==(const cord& a, string_view b) noexcept { return a.size() == b.size() && a.compare(b) == 0; }
+inline bool operator!=(const cord& a, string_view b) noexcept { return !(a == b); }
+inline bool operator==(const cord& a, const char* b) noexcept { return a == string_view(b); }
+inline bool operator!=(const cord& a, const char* b) noexcept { return !(a == string_view(b)); }
+
+inline std::ostream& operator<<(std::ostream& os, const cord& c)
+{	// chunk by chunk, the cord is not flattened
+	for (string_view chunk : c.chunks())
+		os.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+	return os;
+}
+
+}	// namespace toy
+
+#endif	// TOY_CORE_CORD_H
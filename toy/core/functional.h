@@ -1 +1,91 @@
+#if defined(_MSC_VER)
 #pragma once
+#endif
+
+#ifndef TOY_CORE_FUNCTIONAL_H
+#define TOY_CORE_FUNCTIONAL_H
+
+#include <cstddef>	// for size_t
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+namespace toy
+{
+
+// C++17 Standard, section 23.14.
+
+// hash_mix --------------------------------------------------------------------
+// finalizer of MurmurHash3, spreads every input bit over the whole output,
+// so the low bits can be used directly as an index of a power-of-two table
+
+constexpr uint64_t hash_mix(uint64_t h) noexcept
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+// hash_bytes ------------------------------------------------------------------
+// MurmurHash64A, reads the message 8 bytes at a time
+
+inline uint64_t hash_bytes(const void* data, size_t length, uint64_t seed = 0) noexcept
+{
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	uint64_t h = seed ^ (length * m);
+
+	for (size_t blocks = length / 8; blocks != 0; --blocks, p += 8)
+	{
+		uint64_t k;
+		std::memcpy(&k, p, 8);	// unaligned load
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+	}
+
+	switch (length & 7)
+	{
+	case 7: h ^= uint64_t(p[6]) << 48;	// fall through
+	case 6: h ^= uint64_t(p[5]) << 40;	// fall through
+	case 5: h ^= uint64_t(p[4]) << 32;	// fall through
+	case 4: h ^= uint64_t(p[3]) << 24;	// fall through
+	case 3: h ^= uint64_t(p[2]) << 16;	// fall through
+	case 2: h ^= uint64_t(p[1]) << 8;	// fall through
+	case 1: h ^= uint64_t(p[0]);
+		h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
+}
+
+// hash ------------------------------------------------------------------------
+// std::hash of integers is the identity on most implementations, which is
+// fine for prime bucket counts but terrible for power-of-two tables,
+// toy::hash mixes the result of std::hash
+
+template<class T>
+struct hash
+{
+	size_t operator()(const T& value) const
+		noexcept(noexcept(std::hash<T>{}(value)))
+	{
+		return static_cast<size_t>(hash_mix(std::hash<T>{}(value)));
+	}
+};
+
+}	// namespace toy
+
+#endif	// TOY_CORE_FUNCTIONAL_H
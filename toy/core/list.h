@@ -0,0 +1,318 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_LIST_H
+#define TOY_CORE_LIST_H
+
+#include <cstddef>
+#include <iterator>
+
+#include "toy/core/type_traits.h"
+
+namespace toy
+{
+
+// intrusive_list --------------------------------------------------------------
+
+// A doubly linked list of objects that carry their own links: T derives from
+// intrusive_list_hook<Tag>, and the list never allocates or owns anything.
+// An object unlinks itself in O(1) from its hook alone, without a search,
+// which is what an LRU list needs. One object can be in several lists at
+// once through hooks with different tags.
+//
+//	struct entry : intrusive_list_hook<> { int key; };
+//	intrusive_list<entry> lru;
+//	lru.push_front(e);
+//	lru.move_to_front(e);
+//	entry& oldest = lru.back();
+//
+// The list is circular around a sentinel hook, so linking and unlinking have
+// no branches for the ends.
+
+struct default_list_tag;
+
+template<class Tag = default_list_tag>
+struct intrusive_list_hook
+{
+	intrusive_list_hook() noexcept = default;
+
+	// copying an object doesn't copy its place in a list
+	intrusive_list_hook(const intrusive_list_hook&) noexcept {}
+	intrusive_list_hook& operator=(const intrusive_list_hook&) noexcept { return *this; }
+
+	bool is_linked() const noexcept { return next != nullptr; }
+
+	void unlink() noexcept
+	{	// from whatever list holds it
+		prev->next = next;
+		next->prev = prev;
+		prev = next = nullptr;
+	}
+
+	intrusive_list_hook* prev{ nullptr };
+	intrusive_list_hook* next{ nullptr };
+};
+
+template<class T, class Tag = default_list_tag>
+class intrusive_list
+{
+	using hook = intrusive_list_hook<Tag>;
+
+	static_assert(std::is_base_of<hook, T>::value, "T must derive from intrusive_list_hook<Tag>");
+
+public:
+	using value_type      = T;
+	using size_type       = size_t;
+	using difference_type = ptrdiff_t;
+	using reference       = T&;
+	using const_reference = const T&;
+	using pointer         = T*;
+	using const_pointer   = const T*;
+
+	template<bool Const>
+	class list_iterator
+	{
+		using hook_pointer = conditional_t<Const, const hook*, hook*>;
+
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type        = T;
+		using difference_type   = ptrdiff_t;
+		using pointer           = conditional_t<Const, const T*, T*>;
+		using reference         = conditional_t<Const, const T&, T&>;
+
+		list_iterator() noexcept = default;
+
+		explicit list_iterator(hook_pointer node) noexcept
+			: node(node)
+		{
+		}
+
+		template<bool C = Const, class = enable_if_t<C>>
+		list_iterator(const list_iterator<false>& right) noexcept
+			: node(right.node)
+		{
+		}
+
+		reference operator*() const noexcept  { return static_cast<reference>(*node); }
+		pointer   operator->() const noexcept { return static_cast<pointer>(node); }
+
+		list_iterator& operator++() noexcept { node = node->next; return *this; }
+		list_iterator& operator--() noexcept { node = node->prev; return *this; }
+		list_iterator  operator++(int) noexcept { list_iterator tmp = *this; node = node->next; return tmp; }
+		list_iterator  operator--(int) noexcept { list_iterator tmp = *this; node = node->prev; return tmp; }
+
+		friend bool operator==(const list_iterator& a, const list_iterator& b) noexcept { return a.node == b.node; }
+		friend bool operator!=(const list_iterator& a, const list_iterator& b) noexcept { return a.node != b.node; }
+
+	private:
+		template<bool> friend class list_iterator;
+		friend class intrusive_list;
+
+		hook_pointer node{ nullptr };
+	};
+
+	using iterator               = list_iterator<false>;
+	using const_iterator         = list_iterator<true>;
+	using reverse_iterator       = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	intrusive_list() noexcept
+	{
+		head.prev = head.next = &head;
+	}
+
+	intrusive_list(const intrusive_list&) = delete;
+	intrusive_list& operator=(const intrusive_list&) = delete;
+
+	intrusive_list(intrusive_list&& right) noexcept
+		: intrusive_list()
+	{
+		swap(right);
+	}
+
+	intrusive_list& operator=(intrusive_list&& right) noexcept
+	{
+		clear();
+		swap(right);
+		return *this;
+	}
+
+	~intrusive_list()
+	{
+		clear();
+	}
+
+	// iterators
+
+	iterator       begin() noexcept        { return iterator(head.next); }
+	const_iterator begin() const noexcept  { return const_iterator(head.next); }
+	iterator       end() noexcept          { return iterator(&head); }
+	const_iterator end() const noexcept    { return const_iterator(&head); }
+
+	reverse_iterator       rbegin() noexcept       { return reverse_iterator(end()); }
+	const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+	reverse_iterator       rend() noexcept         { return reverse_iterator(begin()); }
+	const_reverse_iterator rend() const noexcept   { return const_reverse_iterator(begin()); }
+
+	// the iterator of an object in this list
+	iterator       iterator_to(T& value) noexcept             { return iterator(static_cast<hook*>(&value)); }
+	const_iterator iterator_to(const T& value) const noexcept { return const_iterator(static_cast<const hook*>(&value)); }
+
+	// capacity & access
+
+	bool      empty() const noexcept { return head.next == &head; }
+	size_type size() const noexcept  { return count; }
+
+	T&       front() noexcept       { return static_cast<T&>(*head.next); }
+	const T& front() const noexcept { return static_cast<const T&>(*head.next); }
+	T&       back() noexcept        { return static_cast<T&>(*head.prev); }
+	const T& back() const noexcept  { return static_cast<const T&>(*head.prev); }
+
+	// modifiers, the object must not be in a list with the same tag
+
+	void push_front(T& value) noexcept { link_before(head.next, &value); }
+	void push_back(T& value) noexcept  { link_before(&head, &value); }
+
+	iterator insert(const_iterator pos, T& value) noexcept
+	{
+		link_before(const_cast<hook*>(pos.node), &value);
+		return iterator_to(value);
+	}
+
+	void pop_front() noexcept { erase(front()); }
+	void pop_back() noexcept  { erase(back()); }
+
+	void erase(T& value) noexcept
+	{	// value must be in this list
+		static_cast<hook&>(value).unlink();
+		--count;
+	}
+
+	iterator erase(const_iterator pos) noexcept
+	{
+		hook* node = const_cast<hook*>(pos.node);
+		hook* next = node->next;
+		node->unlink();
+		--count;
+		return iterator(next);
+	}
+
+	void move_to_front(T& value) noexcept
+	{	// value must be in this list
+		hook* node = &value;
+		if (head.next == node)
+			return;
+		node->prev->next = node->next;
+		node->next->prev = node->prev;
+		node->prev = &head;
+		node->next = head.next;
+		head.next->prev = node;
+		head.next = node;
+	}
+
+	void move_to_back(T& value) noexcept
+	{
+		hook* node = &value;
+		if (head.prev == node)
+			return;
+		node->prev->next = node->next;
+		node->next->prev = node->prev;
+		node->next = &head;
+		node->prev = head.prev;
+		head.prev->next = node;
+		head.prev = node;
+	}
+
+	void splice(const_iterator pos, intrusive_list& right) noexcept
+	{	// move every element of right before pos
+		if (right.empty())
+			return;
+		hook* at = const_cast<hook*>(pos.node);
+		hook* first = right.head.next;
+		hook* last = right.head.prev;
+		first->prev = at->prev;
+		last->next = at;
+		at->prev->next = first;
+		at->prev = last;
+		count += right.count;
+		right.head.prev = right.head.next = &right.head;
+		right.count = 0;
+	}
+
+	void clear() noexcept
+	{	// unlink every object, nothing is destroyed
+		for (hook* node = head.next; node != &head;)
+		{
+			hook* next = node->next;
+			node->prev = node->next = nullptr;
+			node = next;
+		}
+		head.prev = head.next = &head;
+		count = 0;
+	}
+
+	template<class Dispose>
+	void clear_and_dispose(Dispose dispose)
+	{	// unlink every object and call dispose(T*) on it, to free it
+		for (hook* node = head.next; node != &head;)
+		{
+			hook* next = node->next;
+			node->prev = node->next = nullptr;
+			dispose(static_cast<T*>(node));
+			node = next;
+		}
+		head.prev = head.next = &head;
+		count = 0;
+	}
+
+	void swap(intrusive_list& right) noexcept
+	{	// the sentinels stay in place, the elements are relinked to them
+		hook* a_first = head.next;
+		hook* a_last = head.prev;
+		hook* b_first = right.head.next;
+		hook* b_last = right.head.prev;
+		bool a_empty = empty(), b_empty = right.empty();
+
+		if (b_empty)
+		{
+			head.prev = head.next = &head;
+		}
+		else
+		{
+			head.next = b_first; b_first->prev = &head;
+			head.prev = b_last;  b_last->next = &head;
+		}
+		if (a_empty)
+		{
+			right.head.prev = right.head.next = &right.head;
+		}
+		else
+		{
+			right.head.next = a_first; a_first->prev = &right.head;
+			right.head.prev = a_last;  a_last->next = &right.head;
+		}
+		size_type n = count;
+		count = right.count;
+		right.count = n;
+	}
+
+private:
+	void link_before(hook* pos, hook* node) noexcept
+	{
+		node->prev = pos->prev;
+		node->next = pos;
+		pos->prev->next = node;
+		pos->prev = node;
+		++count;
+	}
+
+private:
+	hook      head;		// the sentinel, head.next is the front
+	size_type count{ 0 };
+};
+
+}	// namespace toy
+
+#endif // TOY_CORE_LIST_H
@@ -0,0 +1,649 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_LRU_CACHE_H
+#define TOY_CORE_LRU_CACHE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "toy/core/functional.h"
+#include "toy/core/list.h"
+#include "toy/core/new.h"
+#include "toy/core/unorder_map.h"
+#include "toy/core/utility.h"
+#include "toy/utility/byte.h"
+
+namespace toy
+{
+
+// caches ----------------------------------------------------------------------
+
+// Thread-safe key/value caches bounded by a total weight: the number of
+// entries by default, or any size a Weigher gives each (key, value), e.g.
+// bytes. The keys are striped over shards by the high bits of their hash as
+// in concurrent_unordered_map, each shard has its own lock, map and eviction
+// order, and a capacity / shard_count share of the weight.
+//
+//	lru_cache<std::string, std::string, toy::hash<std::string>,
+//		std::equal_to<std::string>, string_weigher> pages(64 << 20);
+//	pages.put(url, body);
+//	std::string hit;
+//	if (pages.get(url, hit)) ...
+//
+// lru_cache evicts the least recently used entry. tinylfu_cache (W-TinyLFU)
+// keeps a small LRU window in front of a segmented LRU and lets a candidate
+// out of the window in only if it was seen more often than the entry it
+// would evict, by a count-min sketch of recent accesses: a scan of keys that
+// are never read again passes through the window without flushing the
+// frequently used ones, where a plain LRU loses all of them.
+
+struct unit_weight
+{
+	template<class K, class V>
+	size_t operator()(const K&, const V&) const noexcept { return 1; }
+};
+
+struct cache_stats
+{
+	size_t hits{ 0 };
+	size_t misses{ 0 };
+	size_t evictions{ 0 };
+
+	double hit_rate() const noexcept
+	{
+		size_t n = hits + misses;
+		return n ? double(hits) / double(n) : 0.0;
+	}
+};
+
+namespace detail
+{
+
+template<class K, class V>
+struct cache_entry : intrusive_list_hook<>
+{
+	template<class KeyArg, class ValueArg>
+	cache_entry(KeyArg&& key, ValueArg&& value, size_t hash, size_t weight)
+		: key(toy::forward<KeyArg>(key)), value(toy::forward<ValueArg>(value)), hash(hash), weight(weight)
+	{
+	}
+
+	K       key;
+	V       value;
+	size_t  hash;
+	size_t  weight;
+	uint8_t queue{ 0 };		// the list of the policy the entry is in
+};
+
+// The policies keep the eviction order of one shard, the shard owns the
+// entries. evict(f) unlinks the entries to drop until the weight fits the
+// capacity and hands each to f, which frees it.
+
+template<class Entry>
+class lru_policy
+{
+public:
+	explicit lru_policy(size_t capacity) noexcept
+		: capacity(capacity)
+	{
+	}
+
+	void on_miss(size_t) noexcept {}
+	void on_hit(Entry& e) noexcept { order.move_to_front(e); }
+
+	void on_insert(Entry& e) noexcept
+	{
+		order.push_front(e);
+		total += e.weight;
+	}
+
+	void on_erase(Entry& e) noexcept
+	{
+		order.erase(e);
+		total -= e.weight;
+	}
+
+	void on_reweigh(Entry&, size_t old_weight, size_t new_weight) noexcept
+	{
+		total = total - old_weight + new_weight;
+	}
+
+	template<class Evict>
+	void evict(Evict&& evict)
+	{
+		while (total > capacity && !order.empty())
+		{
+			Entry& victim = order.back();
+			on_erase(victim);
+			evict(victim);
+		}
+	}
+
+	size_t weight() const noexcept { return total; }
+
+	void clear() noexcept
+	{
+		order.clear();
+		total = 0;
+	}
+
+	template<class Dispose>
+	void clear_and_dispose(Dispose dispose)
+	{
+		order.clear_and_dispose(dispose);
+		total = 0;
+	}
+
+private:
+	intrusive_list<Entry> order;	// most recent first
+	size_t                capacity;
+	size_t                total{ 0 };
+};
+
+// A count-min sketch of 4 bit counters, 16 to a word. An item increments one
+// counter in each of 4 words, its estimate is the least of them. There is a
+// word per entry of the cache, up to a bound for caches weighted in bytes,
+// and every 10 increments per word all counters are halved, so old
+// popularity fades
+class frequency_sketch
+{
+public:
+	explicit frequency_sketch(size_t entries)
+	{
+		size_t words = bit_ceil((std::min)((std::max)(entries, size_t(16)), max_words));
+		table.reset(new uint64_t[words]());
+		mask = words - 1;
+		sample = 10 * words;
+	}
+
+	void increment(size_t h) noexcept
+	{
+		bool added = false;
+		for (unsigned i = 0; i < 4; ++i)
+		{
+			uint64_t& word = table[index_of(h, i)];
+			unsigned shift = counter_of(h, i) * 4;
+			if (((word >> shift) & 0xf) != 0xf)
+			{
+				word += uint64_t(1) << shift;
+				added = true;
+			}
+		}
+		if (added && ++additions == sample)
+			halve();
+	}
+
+	unsigned frequency(size_t h) const noexcept
+	{
+		unsigned f = 0xf;
+		for (unsigned i = 0; i < 4; ++i)
+		{
+			unsigned c = unsigned(table[index_of(h, i)] >> (counter_of(h, i) * 4)) & 0xf;
+			f = c < f ? c : f;
+		}
+		return f;
+	}
+
+private:
+	static constexpr size_t max_words = size_t(1) << 16;
+
+	size_t index_of(size_t h, unsigned i) const noexcept
+	{	// h is already mixed, each row takes another slice of it
+		return static_cast<size_t>(hash_mix(uint64_t(h) + uint64_t(i) * 0x9e3779b97f4a7c15ull)) & mask;
+	}
+
+	static unsigned counter_of(size_t h, unsigned i) noexcept
+	{	// a counter out of 4 per row, the rows use disjoint ones in a word
+		return i * 4 + unsigned((uint64_t(h) >> (32 + 2 * i)) & 3);
+	}
+
+	void halve() noexcept
+	{
+		for (size_t i = 0; i <= mask; ++i)
+			table[i] = (table[i] >> 1) & 0x7777777777777777ull;
+		additions /= 2;
+	}
+
+private:
+	std::unique_ptr<uint64_t[]> table;
+	size_t                      mask;
+	size_t                      sample;
+	size_t                      additions{ 0 };
+};
+
+template<class Entry>
+class tinylfu_policy
+{
+	enum : uint8_t { window, probation, protect };
+
+public:
+	explicit tinylfu_policy(size_t capacity)
+		: sketch(capacity)
+	{	// a 1% window, the main area is 20% probation and 80% protected
+		window_capacity = (std::max)(capacity / 100, size_t(1));
+		main_capacity = capacity > window_capacity ? capacity - window_capacity : 0;
+		protected_capacity = main_capacity - main_capacity / 5;
+	}
+
+	void on_miss(size_t h) noexcept { sketch.increment(h); }
+
+	void on_hit(Entry& e) noexcept
+	{
+		sketch.increment(e.hash);
+		switch (e.queue)
+		{
+		case window:
+			window_list.move_to_front(e);
+			break;
+		case probation:
+			// a second access promotes, the protected tail goes back to probation
+			probation_list.erase(e);
+			protected_list.push_front(e);
+			e.queue = protect;
+			protected_weight += e.weight;
+			while (protected_weight > protected_capacity && protected_list.size() > 1)
+			{
+				Entry& demoted = protected_list.back();
+				protected_list.erase(demoted);
+				protected_weight -= demoted.weight;
+				probation_list.push_front(demoted);
+				demoted.queue = probation;
+			}
+			break;
+		default:
+			protected_list.move_to_front(e);
+			break;
+		}
+	}
+
+	void on_insert(Entry& e) noexcept
+	{	// a write counts as an access, as a read does
+		sketch.increment(e.hash);
+		window_list.push_front(e);
+		e.queue = window;
+		window_weight += e.weight;
+	}
+
+	void on_erase(Entry& e) noexcept
+	{
+		switch (e.queue)
+		{
+		case window:
+			window_list.erase(e);
+			window_weight -= e.weight;
+			break;
+		case probation:
+			probation_list.erase(e);
+			main_weight -= e.weight;
+			break;
+		default:
+			protected_list.erase(e);
+			protected_weight -= e.weight;
+			main_weight -= e.weight;
+			break;
+		}
+	}
+
+	void on_reweigh(Entry& e, size_t old_weight, size_t new_weight) noexcept
+	{
+		if (e.queue == window)
+		{
+			window_weight = window_weight - old_weight + new_weight;
+			return;
+		}
+		main_weight = main_weight - old_weight + new_weight;
+		if (e.queue == protect)
+			protected_weight = protected_weight - old_weight + new_weight;
+	}
+
+	template<class Evict>
+	void evict(Evict&& evict)
+	{
+		// the window overflows into the main area, where a candidate has to
+		// beat the probation tail on frequency once the area is full
+		while (window_weight > window_capacity && !window_list.empty())
+		{
+			Entry& candidate = window_list.back();
+			window_list.erase(candidate);
+			window_weight -= candidate.weight;
+
+			if (main_weight + candidate.weight > main_capacity)
+			{
+				Entry* victim = main_victim();
+				if (!victim || candidate.weight > main_capacity ||
+					sketch.frequency(candidate.hash) <= sketch.frequency(victim->hash))
+				{
+					evict(candidate);
+					continue;
+				}
+				while (main_weight + candidate.weight > main_capacity && (victim = main_victim()) != nullptr)
+				{
+					on_erase(*victim);
+					evict(*victim);
+				}
+			}
+			probation_list.push_front(candidate);
+			candidate.queue = probation;
+			main_weight += candidate.weight;
+		}
+
+		// a reweighed entry can leave the main area over its share
+		while (main_weight > main_capacity)
+		{
+			Entry* victim = main_victim();
+			on_erase(*victim);
+			evict(*victim);
+		}
+	}
+
+	size_t weight() const noexcept { return window_weight + main_weight; }
+
+	void clear() noexcept
+	{
+		window_list.clear();
+		probation_list.clear();
+		protected_list.clear();
+		window_weight = main_weight = protected_weight = 0;
+	}
+
+	template<class Dispose>
+	void clear_and_dispose(Dispose dispose)
+	{
+		window_list.clear_and_dispose(dispose);
+		probation_list.clear_and_dispose(dispose);
+		protected_list.clear_and_dispose(dispose);
+		window_weight = main_weight = protected_weight = 0;
+	}
+
+private:
+	Entry* main_victim() noexcept
+	{
+		if (!probation_list.empty())
+			return &probation_list.back();
+		if (!protected_list.empty())
+			return &protected_list.back();
+		return nullptr;
+	}
+
+private:
+	intrusive_list<Entry> window_list;
+	intrusive_list<Entry> probation_list;
+	intrusive_list<Entry> protected_list;
+	frequency_sketch      sketch;
+	size_t                window_capacity;
+	size_t                main_capacity;
+	size_t                protected_capacity;
+	size_t                window_weight{ 0 };
+	size_t                main_weight{ 0 };		// probation and protected
+	size_t                protected_weight{ 0 };
+};
+
+}	// namespace detail
+
+// sharded_cache ---------------------------------------------------------------
+
+template<class K, class V, template<class> class Policy, class Hash = toy::hash<K>,
+	class KeyEqual = std::equal_to<K>, class Weigher = unit_weight>
+class sharded_cache
+{
+	using entry = detail::cache_entry<K, V>;
+
+public:
+	using key_type    = K;
+	using mapped_type = V;
+	using hasher      = Hash;
+	using key_equal   = KeyEqual;
+	using size_type   = size_t;
+
+	// the total weight is split evenly, a small cache gets fewer shards so
+	// that every shard can still hold a useful number of entries
+	explicit sharded_cache(size_type capacity, size_type concurrency = 0, const Weigher& weigher = Weigher(),
+		const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual())
+		: hash_fn(hash), weigher(weigher), total_capacity(capacity)
+	{
+		if (concurrency == 0)
+			concurrency = 4 * (std::max)(1u, std::thread::hardware_concurrency());
+
+		while ((size_type(1) << shard_bits) < concurrency && shard_bits < max_shard_bits &&
+			(capacity >> (shard_bits + 1)) >= min_shard_capacity)
+			++shard_bits;
+
+		size_type n = size_type(1) << shard_bits;
+		shards.reset(static_cast<shard*>(::operator new(n * sizeof(shard), std::align_val_t(alignof(shard)))));
+		size_type i = 0;
+		try
+		{
+			for (; i < n; ++i)
+				new (&shards[i]) shard(capacity / n + (i < capacity % n ? 1 : 0), hash, equal);
+		}
+		catch (...)
+		{
+			while (i > 0)
+				shards[--i].~shard();
+			throw;
+		}
+	}
+
+	sharded_cache(const sharded_cache&) = delete;
+	sharded_cache& operator=(const sharded_cache&) = delete;
+
+	~sharded_cache()
+	{
+		for (size_type i = 0, n = shard_count(); i < n; ++i)
+			shards[i].~shard();
+	}
+
+	// lookup, a hit counts as a use
+
+	bool get(const K& key, V& value)
+	{
+		return visit(key, [&value](const V& v) { value = v; });
+	}
+
+	template<class F>
+	bool visit(const K& key, F&& f)
+	{	// f(const V&) under the shard lock
+		size_t h = hash_of(key);
+		shard& s = shard_of(h);
+		std::lock_guard<std::mutex> lock(s.mutex);
+		auto it = s.map.find(key);
+		if (it == s.map.end())
+		{
+			++s.stats.misses;
+			s.policy.on_miss(h);
+			return false;
+		}
+		++s.stats.hits;
+		s.policy.on_hit(*it->second);
+		f(static_cast<const V&>(it->second->value));
+		return true;
+	}
+
+	bool contains(const K& key) const
+	{	// doesn't count as a use
+		size_t h = hash_of(key);
+		shard& s = shard_of(h);
+		std::lock_guard<std::mutex> lock(s.mutex);
+		return s.map.contains(key);
+	}
+
+	template<class Load>
+	V get_or_load(const K& key, Load&& load)
+	{	// load(key) runs without the lock, two threads may both load a missing key
+		V value;
+		if (get(key, value))
+			return value;
+		value = load(key);
+		put(key, value);
+		return value;
+	}
+
+	// modifiers
+
+	template<class M>
+	void put(const K& key, M&& value)
+	{	// insert or assign, then evict down to the capacity
+		size_t h = hash_of(key);
+		shard& s = shard_of(h);
+		size_t weight = weigher(key, static_cast<const V&>(value));
+		std::lock_guard<std::mutex> lock(s.mutex);
+		auto it = s.map.find(key);
+		if (it != s.map.end())
+		{
+			entry& e = *it->second;
+			e.value = toy::forward<M>(value);
+			s.policy.on_reweigh(e, e.weight, weight);
+			e.weight = weight;
+			s.policy.on_hit(e);
+		}
+		else
+		{
+			std::unique_ptr<entry> e(new entry(key, toy::forward<M>(value), h, weight));
+			s.map.try_emplace(key, e.get());
+			s.policy.on_insert(*e);
+			e.release();
+		}
+		s.evict();
+	}
+
+	bool erase(const K& key)
+	{
+		size_t h = hash_of(key);
+		shard& s = shard_of(h);
+		std::lock_guard<std::mutex> lock(s.mutex);
+		auto it = s.map.find(key);
+		if (it == s.map.end())
+			return false;
+		entry* e = it->second;
+		s.map.erase(it);
+		s.policy.on_erase(*e);
+		delete e;
+		return true;
+	}
+
+	void clear()
+	{
+		for (size_type i = 0, n = shard_count(); i < n; ++i)
+		{
+			std::lock_guard<std::mutex> lock(shards[i].mutex);
+			shards[i].release();
+		}
+	}
+
+	// observers, each shard is read under its lock but not all at once
+
+	size_type size() const
+	{
+		size_type n = 0;
+		for (size_type i = 0; i < shard_count(); ++i)
+		{
+			std::lock_guard<std::mutex> lock(shards[i].mutex);
+			n += shards[i].map.size();
+		}
+		return n;
+	}
+
+	size_type weight() const
+	{
+		size_type w = 0;
+		for (size_type i = 0; i < shard_count(); ++i)
+		{
+			std::lock_guard<std::mutex> lock(shards[i].mutex);
+			w += shards[i].policy.weight();
+		}
+		return w;
+	}
+
+	cache_stats stats() const
+	{
+		cache_stats total;
+		for (size_type i = 0; i < shard_count(); ++i)
+		{
+			std::lock_guard<std::mutex> lock(shards[i].mutex);
+			total.hits += shards[i].stats.hits;
+			total.misses += shards[i].stats.misses;
+			total.evictions += shards[i].stats.evictions;
+		}
+		return total;
+	}
+
+	size_type capacity() const noexcept    { return total_capacity; }
+	size_type shard_count() const noexcept { return size_type(1) << shard_bits; }
+
+private:
+	static constexpr size_type max_shard_bits     = 10;
+	static constexpr size_type min_shard_capacity = 64;
+
+	struct alignas(hardware_destructive_interference_size) shard
+	{
+		shard(size_type capacity, const Hash& hash, const KeyEqual& equal)
+			: map(0, hash, equal), policy(capacity)
+		{
+		}
+
+		~shard()
+		{
+			release();
+		}
+
+		void evict()
+		{
+			policy.evict([this](entry& victim)
+			{
+				map.erase(victim.key);
+				++stats.evictions;
+				delete &victim;
+			});
+		}
+
+		void release() noexcept
+		{
+			map.clear();
+			policy.clear_and_dispose([](entry* e) { delete e; });
+		}
+
+		mutable std::mutex                        mutex;
+		unordered_map<K, entry*, Hash, KeyEqual> map;
+		Policy<entry>                             policy;
+		cache_stats                               stats;
+	};
+
+	struct shard_delete
+	{
+		void operator()(shard* p) const noexcept
+		{
+			::operator delete(p, std::align_val_t(alignof(shard)));
+		}
+	};
+
+	size_t hash_of(const K& key) const { return static_cast<size_t>(hash_fn(key)); }
+
+	shard& shard_of(size_t h) const noexcept
+	{	// the high bits, the map in the shard uses the low ones
+		return shard_bits ? shards[h >> (sizeof(size_t) * 8 - shard_bits)] : shards[0];
+	}
+
+private:
+	std::unique_ptr<shard[], shard_delete> shards;
+	size_type                              shard_bits{ 0 };
+	Hash                                   hash_fn;
+	Weigher                                weigher;
+	size_type                              total_capacity;
+};
+
+template<class K, class V, class Hash = toy::hash<K>, class KeyEqual = std::equal_to<K>, class Weigher = unit_weight>
+using lru_cache = sharded_cache<K, V, detail::lru_policy, Hash, KeyEqual, Weigher>;
+
+template<class K, class V, class Hash = toy::hash<K>, class KeyEqual = std::equal_to<K>, class Weigher = unit_weight>
+using tinylfu_cache = sharded_cache<K, V, detail::tinylfu_policy, Hash, KeyEqual, Weigher>;
+
+}	// namespace toy
+
+#endif // TOY_CORE_LRU_CACHE_H
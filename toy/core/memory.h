@@ -5,10 +5,16 @@
 #ifndef TOY_CORE_MEMORY_H
 #define TOY_CORE_MEMORY_H
 
+#include <atomic>
 #include <cstddef>    // for size_t
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
 #include <type_traits>
 #include <utility>
 
+#include "toy/core/alloc_stats.h"
 #include "toy/core/utility.h"
 
 namespace toy
@@ -53,20 +59,23 @@ public:
 		if (count > max_size())
 			throw std::length_error("allocator<T>::allocate(size_t n)"
 				" 'n' exceeds maximum supported size");
-		return static_cast<pointer>(::operator new(count * sizeof(T)));
+		return static_cast<pointer>(toy::tracked_allocate(count * sizeof(T)));
 	}
 
 	void deallocate(pointer ptr, size_t count)
-	{
-		::operator delete(ptr);
+	{	// counted in the allocation stats when TOY_ALLOC_STATS is on
+		toy::tracked_deallocate(ptr);
 	}
 
 	// construct & destroy
 	template<class U, class... Args>
 	void construct(const U* ptr, Args&&... args)
-	{	// new((void*)U) U{args}, construct U(Args...) at ptr
-		::new(const_cast<void*>(static_cast<const volatile void*>(ptr)))
-			U{std::forward<Args>(args)...};
+	{	// new((void*)U) U(args), U{args} for an aggregate, construct U(Args...) at ptr
+		void* p = const_cast<void*>(static_cast<const volatile void*>(ptr));
+		if constexpr (std::is_constructible<U, Args...>::value)
+			::new(p) U(std::forward<Args>(args)...);
+		else
+			::new(p) U{std::forward<Args>(args)...};
 	}
 
 	template<class U>
@@ -109,6 +118,9 @@ inline bool operator!=(const allocator<T1>&, const allocator<T2>&) noexcept
 	return false;
 }
 
+template<class T>
+struct is_trivially_relocatable<allocator<T>> : true_type {};
+
 // unique_ptr ------------------------------------------------------------------
 
 template<typename T>
@@ -198,11 +210,10 @@ public:
 
 	void reset(pointer p = {}) noexcept
 	{
-		if (p != ptr)
-		{
-			get_deleter()(ptr);
-			ptr = p;
-		}
+		pointer old = ptr;
+		ptr = p;
+		if (old != pointer())
+			get_deleter()(old);
 	}
 
 	void swap(unique_ptr& u) noexcept
@@ -216,7 +227,7 @@ public:
 	unique_ptr& operator=(const unique_ptr&) = delete;
 
 private:
-	pointer ptr;
+	pointer ptr{};
 	deleter_type deleter;
 };
 
@@ -242,6 +253,9 @@ bool operator<(const unique_ptr<T1, D1>& left, const unique_ptr<T2, D2>& right)
 	return std::less<common>()(left.get(), right.get());
 }
 
+template<class T, class D>
+struct is_trivially_relocatable<unique_ptr<T, D>> : is_trivially_relocatable<D> {};
+
 // make_unique -----------------------------------------------------------------
 
 template<class T, class... Types, class = enable_if_t<!std::is_array<T>::value>>
@@ -253,19 +267,969 @@ inline unique_ptr<T> make_unique(Types&&... args)
 template<class T, class... Types, class = enable_if_t<std::extent<T>::value != 0>>
 void make_unique(Types&&...) = delete;
 
+// pool_delete -----------------------------------------------------------------
+// deleter of unique_ptr for objects that came from a pool with a destroy(T*)
+// member, e.g. toy::object_pool, the pool must outlive the pointer
+
+template<class T, class Pool>
+struct pool_delete
+{
+	constexpr pool_delete() noexcept = default;
+	explicit pool_delete(Pool* pool) noexcept : pool{ pool } {}
+
+	void operator()(T* ptr) const
+	{
+		pool->destroy(ptr);
+	}
+
+	Pool* pool = nullptr;
+};
+
+// relocate --------------------------------------------------------------------
+// move objects to uninitialized storage and end the lifetime of the sources,
+// one memmove for the trivially relocatable types
+
+template<class T, class D>
+struct is_trivially_relocatable<std::unique_ptr<T, D>> : is_trivially_relocatable<D> {};
+
+template<class T>
+struct is_trivially_relocatable<std::shared_ptr<T>> : true_type {};
+
+template<class T>
+struct is_trivially_relocatable<std::weak_ptr<T>> : true_type {};
+
+template<class T>
+inline T* relocate_at(T* source, T* dest)
+	noexcept(is_trivially_relocatable<T>::value || std::is_nothrow_move_constructible<T>::value)
+{	// *source to the uninitialized dest
+	if constexpr (is_trivially_relocatable<T>::value)
+	{
+		std::memcpy(static_cast<void*>(dest), static_cast<const void*>(source), sizeof(T));
+		return std::launder(dest);
+	}
+	else
+	{
+		::new(static_cast<void*>(dest)) T(toy::move(*source));
+		source->~T();
+		return dest;
+	}
+}
+
+// [first, last) to the uninitialized range at dest, the ranges may overlap when
+// dest <= first. If a move constructor throws, the objects already moved are
+// destroyed at dest and every source is still alive.
+template<class T>
+inline T* uninitialized_relocate(T* first, T* last, T* dest)
+	noexcept(is_trivially_relocatable<T>::value || std::is_nothrow_move_constructible<T>::value)
+{
+	if constexpr (is_trivially_relocatable<T>::value)
+	{
+		size_t n = static_cast<size_t>(last - first);
+		if (n)
+			std::memmove(static_cast<void*>(dest), static_cast<const void*>(first), n * sizeof(T));
+		return dest + n;
+	}
+	else if constexpr (std::is_nothrow_move_constructible<T>::value)
+	{
+		for (; first != last; ++first, ++dest)
+			relocate_at(first, dest);
+		return dest;
+	}
+	else
+	{	// move everything first, the sources die once nothing can throw
+		T* out = dest;
+		try
+		{
+			for (T* p = first; p != last; ++p, ++out)
+				::new(static_cast<void*>(out)) T(toy::move(*p));
+		}
+		catch (...)
+		{
+			for (T* p = dest; p != out; ++p)
+				p->~T();
+			throw;
+		}
+		for (T* p = first; p != last; ++p)
+			p->~T();
+		return out;
+	}
+}
+
+template<class T>
+inline T* uninitialized_relocate_n(T* first, size_t n, T* dest)
+	noexcept(noexcept(uninitialized_relocate(first, first + n, dest)))
+{
+	return uninitialized_relocate(first, first + n, dest);
+}
+
+// as uninitialized_relocate, from the back: the ranges may overlap when
+// dest_last >= last, return the start of the destination
+template<class T>
+inline T* uninitialized_relocate_backward(T* first, T* last, T* dest_last)
+	noexcept(is_trivially_relocatable<T>::value || std::is_nothrow_move_constructible<T>::value)
+{
+	size_t n = static_cast<size_t>(last - first);
+	if constexpr (is_trivially_relocatable<T>::value)
+	{
+		if (n)
+			std::memmove(static_cast<void*>(dest_last - n), static_cast<const void*>(first), n * sizeof(T));
+		return dest_last - n;
+	}
+	else
+	{
+		static_assert(std::is_nothrow_move_constructible<T>::value,
+			"uninitialized_relocate_backward needs a nothrow move constructor");
+		while (last != first)
+			relocate_at(--last, --dest_last);
+		return dest_last;
+	}
+}
+
+// ref counts ------------------------------------------------------------------
+// count policies of shared_ptr and intrusive_ref_counter: atomic_ref_count may
+// be shared between threads, local_ref_count is a plain integer for objects
+// that never leave their thread
+
+class atomic_ref_count
+{
+public:
+	explicit atomic_ref_count(long n = 0) noexcept : count{ n } {}
+
+	void increment() noexcept { count.fetch_add(1, std::memory_order_relaxed); }
+
+	bool decrement() noexcept
+	{	// true when the count drops to zero, the last owner sees every write
+		if (count.fetch_sub(1, std::memory_order_release) != 1)
+			return false;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return true;
+	}
+
+	bool increment_if_nonzero() noexcept
+	{
+		long n = count.load(std::memory_order_relaxed);
+		while (n != 0)
+			if (count.compare_exchange_weak(n, n + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+				return true;
+		return false;
+	}
+
+	long load() const noexcept { return count.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<long> count;
+};
+
+class local_ref_count
+{
+public:
+	explicit local_ref_count(long n = 0) noexcept : count{ n } {}
+
+	void increment() noexcept { ++count; }
+	bool decrement() noexcept { return --count == 0; }
+
+	bool increment_if_nonzero() noexcept
+	{
+		if (count == 0)
+			return false;
+		++count;
+		return true;
+	}
+
+	long load() const noexcept { return count; }
+
+private:
+	long count;
+};
+
 // shared_ptr ------------------------------------------------------------------
 
+// basic_shared_ptr<T, Count> is shared ownership with Count as the policy of
+// its reference counts:
+//   shared_ptr<T>       atomic counts, may be copied across threads
+//   local_shared_ptr<T> plain counts, no atomic traffic on copy, single thread
+//
+// The control block holds the use count, the weak count (plus one while any
+// shared owner is alive) and either the pointer and deleter, or the object
+// itself when it comes from make_shared/allocate_shared, which then take a
+// single allocation for both.
+
+template<class T, class Count> class basic_shared_ptr;
+template<class T, class Count> class basic_weak_ptr;
+template<class T> class enable_shared_from_this;
+
+namespace detail
+{
+
+template<class Count>
+class shared_control
+{
+public:
+	shared_control() noexcept : uses{ 1 }, weaks{ 1 } {}
+	virtual ~shared_control() {}
+
+	void add_ref() noexcept { uses.increment(); }
+	bool add_ref_if_alive() noexcept { return uses.increment_if_nonzero(); }
+
+	void release() noexcept
+	{
+		if (uses.decrement())
+		{
+			dispose();
+			weak_release();
+		}
+	}
+
+	void weak_add_ref() noexcept { weaks.increment(); }
+
+	void weak_release() noexcept
+	{
+		if (weaks.decrement())
+			destroy();
+	}
+
+	long use_count() const noexcept { return uses.load(); }
+
+private:
+	virtual void dispose() noexcept = 0;	// destroy the object
+	virtual void destroy() noexcept = 0;	// free the control block
+
+private:
+	Count uses;
+	Count weaks;
+};
+
+template<class Count, class P, class D, class A>
+class shared_control_pointer final : public shared_control<Count>
+{	// owns a pointer and its deleter
+public:
+	shared_control_pointer(P p, D d, const A& a) noexcept
+		: ptr{ p }, deleter{ toy::move(d) }, alloc{ a } {}
+
+private:
+	void dispose() noexcept override
+	{
+		deleter(ptr);
+	}
+
+	void destroy() noexcept override
+	{
+		using block_alloc = typename std::allocator_traits<A>::template rebind_alloc<shared_control_pointer>;
+		block_alloc a(alloc);
+		this->~shared_control_pointer();
+		a.deallocate(this, 1);
+	}
+
+private:
+	P ptr;
+	D deleter;
+	A alloc;
+};
+
+template<class Count, class T, class A>
+class shared_control_inplace final : public shared_control<Count>
+{	// the object lives in the control block
+public:
+	template<bool UseAllocator, class... Args>
+	shared_control_inplace(std::bool_constant<UseAllocator>, const A& a, Args&&... args)
+		: alloc{ a }
+	{
+		if constexpr (UseAllocator)
+		{	// allocate_shared constructs through the allocator
+			value_alloc va(alloc);
+			std::allocator_traits<value_alloc>::construct(va, get(), toy::forward<Args>(args)...);
+		}
+		else
+		{
+			::new (static_cast<void*>(get())) T(toy::forward<Args>(args)...);
+		}
+	}
+
+	T* get() noexcept { return reinterpret_cast<T*>(&storage); }
+
+private:
+	using value_alloc = typename std::allocator_traits<A>::template rebind_alloc<T>;
+
+	void dispose() noexcept override
+	{
+		get()->~T();
+	}
+
+	void destroy() noexcept override
+	{
+		using block_alloc = typename std::allocator_traits<A>::template rebind_alloc<shared_control_inplace>;
+		block_alloc a(alloc);
+		this->~shared_control_inplace();
+		a.deallocate(this, 1);
+	}
+
+private:
+	A alloc;
+	std::aligned_storage_t<sizeof(T), alignof(T)> storage;
+};
+
+template<class Block, class A, class... Args>
+inline Block* new_control_block(const A& alloc, Args&&... args)
+{
+	using block_alloc = typename std::allocator_traits<A>::template rebind_alloc<Block>;
+	block_alloc a(alloc);
+	Block* block = a.allocate(1);
+	try
+	{
+		::new (static_cast<void*>(block)) Block(toy::forward<Args>(args)...);
+	}
+	catch (...)
+	{
+		a.deallocate(block, 1);
+		throw;
+	}
+	return block;
+}
+
+struct shared_make_tag {};
+
+}	// namespace detail
+
+template<class T, class Count>
+class basic_shared_ptr
+{
+public:
+	using element_type = T;
+	using weak_type    = basic_weak_ptr<T, Count>;
+
+public:
+	// constructors
+	constexpr basic_shared_ptr() noexcept {}
+	constexpr basic_shared_ptr(nullptr_t) noexcept {}
+
+	template<class Y>
+	explicit basic_shared_ptr(Y* p)
+		: basic_shared_ptr(p, default_delete<Y>()) {}
+
+	template<class Y, class D>
+	basic_shared_ptr(Y* p, D d)
+		: basic_shared_ptr(p, toy::move(d), allocator<Y>()) {}
+
+	template<class Y, class D, class A>
+	basic_shared_ptr(Y* p, D d, A a)
+		: ptr{ p }
+	{
+		try
+		{
+			ctrl = detail::new_control_block<detail::shared_control_pointer<Count, Y*, D, A>>(a, p, d, a);
+		}
+		catch (...)
+		{	// the pointer is deleted when the control block can't be made
+			d(p);
+			throw;
+		}
+		enable_shared_from(p);
+	}
+
+	template<class Y>
+	basic_shared_ptr(const basic_shared_ptr<Y, Count>& r, element_type* p) noexcept
+		: ptr{ p }, ctrl{ r.ctrl }
+	{	// aliasing: shares the ownership of r, points to p
+		if (ctrl)
+			ctrl->add_ref();
+	}
+
+	basic_shared_ptr(const basic_shared_ptr& r) noexcept
+		: ptr{ r.ptr }, ctrl{ r.ctrl }
+	{
+		if (ctrl)
+			ctrl->add_ref();
+	}
+
+	template<class Y, class = enable_if_t<std::is_convertible<Y*, T*>::value>>
+	basic_shared_ptr(const basic_shared_ptr<Y, Count>& r) noexcept
+		: ptr{ r.ptr }, ctrl{ r.ctrl }
+	{
+		if (ctrl)
+			ctrl->add_ref();
+	}
+
+	basic_shared_ptr(basic_shared_ptr&& r) noexcept
+		: ptr{ r.ptr }, ctrl{ r.ctrl }
+	{
+		r.ptr  = nullptr;
+		r.ctrl = nullptr;
+	}
+
+	template<class Y, class = enable_if_t<std::is_convertible<Y*, T*>::value>>
+	basic_shared_ptr(basic_shared_ptr<Y, Count>&& r) noexcept
+		: ptr{ r.ptr }, ctrl{ r.ctrl }
+	{
+		r.ptr  = nullptr;
+		r.ctrl = nullptr;
+	}
+
+	template<class Y, class = enable_if_t<std::is_convertible<Y*, T*>::value>>
+	explicit basic_shared_ptr(const basic_weak_ptr<Y, Count>& r)
+	{
+		if (!r.ctrl || !r.ctrl->add_ref_if_alive())
+			throw std::bad_weak_ptr();
+		ptr  = r.ptr;
+		ctrl = r.ctrl;
+	}
+
+	template<class Y, class D, class = enable_if_t<std::is_convertible<Y*, T*>::value>>
+	basic_shared_ptr(unique_ptr<Y, D>&& r)
+	{
+		if (r)
+		{
+			using deleter = conditional_t<is_reference<D>::value, std::reference_wrapper<remove_reference_t<D>>, D>;
+			ctrl = detail::new_control_block<detail::shared_control_pointer<Count, Y*, deleter, allocator<Y>>>(
+				allocator<Y>(), r.get(), deleter(r.get_deleter()), allocator<Y>());
+			ptr = r.release();
+			enable_shared_from(ptr);
+		}
+	}
+
+	// destructor
+	~basic_shared_ptr()
+	{
+		if (ctrl)
+			ctrl->release();
+	}
+
+	// assignment
+	basic_shared_ptr& operator=(const basic_shared_ptr& r) noexcept
+	{
+		return assign(r);
+	}
+
+	template<class Y>
+	basic_shared_ptr& operator=(const basic_shared_ptr<Y, Count>& r) noexcept
+	{
+		return assign(r);
+	}
+
+	basic_shared_ptr& operator=(basic_shared_ptr&& r) noexcept
+	{
+		basic_shared_ptr(toy::move(r)).swap(*this);
+		return *this;
+	}
+
+	template<class Y>
+	basic_shared_ptr& operator=(basic_shared_ptr<Y, Count>&& r) noexcept
+	{
+		basic_shared_ptr(toy::move(r)).swap(*this);
+		return *this;
+	}
+
+	template<class Y, class D>
+	basic_shared_ptr& operator=(unique_ptr<Y, D>&& r)
+	{
+		basic_shared_ptr(toy::move(r)).swap(*this);
+		return *this;
+	}
+
+	// modifiers
+	void reset() noexcept { basic_shared_ptr().swap(*this); }
+
+	template<class Y>
+	void reset(Y* p) { basic_shared_ptr(p).swap(*this); }
+
+	template<class Y, class D>
+	void reset(Y* p, D d) { basic_shared_ptr(p, toy::move(d)).swap(*this); }
+
+	template<class Y, class D, class A>
+	void reset(Y* p, D d, A a) { basic_shared_ptr(p, toy::move(d), toy::move(a)).swap(*this); }
+
+	void swap(basic_shared_ptr& r) noexcept
+	{
+		std::swap(ptr, r.ptr);
+		std::swap(ctrl, r.ctrl);
+	}
+
+	// observers
+	element_type* get() const noexcept { return ptr; }
+	std::add_lvalue_reference_t<T> operator*() const noexcept { return *get(); }
+	element_type* operator->() const noexcept { return get(); }
+
+	long use_count() const noexcept { return ctrl ? ctrl->use_count() : 0; }
+	explicit operator bool() const noexcept { return get() != nullptr; }
+
+	template<class Y, class C>
+	bool owner_before(const basic_shared_ptr<Y, C>& r) const noexcept
+	{
+		return std::less<const void*>()(ctrl, r.ctrl);
+	}
+
+	template<class Y, class C>
+	bool owner_before(const basic_weak_ptr<Y, C>& r) const noexcept
+	{
+		return std::less<const void*>()(ctrl, r.ctrl);
+	}
+
+	// used by make_shared, c holds the object p
+	basic_shared_ptr(detail::shared_make_tag, element_type* p, detail::shared_control<Count>* c) noexcept
+		: ptr{ p }, ctrl{ c }
+	{
+		enable_shared_from(p);
+	}
+
+private:
+	template<class Y, class C> friend class basic_shared_ptr;
+	template<class Y, class C> friend class basic_weak_ptr;
+
+	template<class Y>
+	basic_shared_ptr& assign(const basic_shared_ptr<Y, Count>& r) noexcept
+	{	// same owner: no count traffic
+		if (ctrl == r.ctrl)
+			ptr = r.ptr;
+		else
+			basic_shared_ptr(r).swap(*this);
+		return *this;
+	}
+
+	template<class Y>
+	void enable_shared_from(Y* p) noexcept
+	{	// only shared_ptr, enable_shared_from_this is made of atomic weak_ptr
+		if constexpr (std::is_same<Count, atomic_ref_count>::value)
+			enable_shared_from_(p, p);
+		else
+			(void)p;
+	}
+
+	template<class Y, class U>
+	void enable_shared_from_(const enable_shared_from_this<U>* e, Y* p) noexcept;
+
+	void enable_shared_from_(...) noexcept {}
+
+private:
+	element_type* ptr{ nullptr };
+	detail::shared_control<Count>* ctrl{ nullptr };
+};
+
+template<class T1, class C1, class T2, class C2>
+inline bool operator==(const basic_shared_ptr<T1, C1>& left, const basic_shared_ptr<T2, C2>& right) noexcept
+{
+	return left.get() == right.get();
+}
+
+template<class T1, class C1, class T2, class C2>
+inline bool operator!=(const basic_shared_ptr<T1, C1>& left, const basic_shared_ptr<T2, C2>& right) noexcept
+{
+	return left.get() != right.get();
+}
+
+template<class T1, class C1, class T2, class C2>
+inline bool operator<(const basic_shared_ptr<T1, C1>& left, const basic_shared_ptr<T2, C2>& right) noexcept
+{
+	using common = std::common_type_t<T1*, T2*>;
+	return std::less<common>()(left.get(), right.get());
+}
+
+template<class T, class C>
+inline bool operator==(const basic_shared_ptr<T, C>& left, nullptr_t) noexcept { return !left; }
+template<class T, class C>
+inline bool operator==(nullptr_t, const basic_shared_ptr<T, C>& right) noexcept { return !right; }
+template<class T, class C>
+inline bool operator!=(const basic_shared_ptr<T, C>& left, nullptr_t) noexcept { return bool(left); }
+template<class T, class C>
+inline bool operator!=(nullptr_t, const basic_shared_ptr<T, C>& right) noexcept { return bool(right); }
+
+template<class T, class C>
+inline void swap(basic_shared_ptr<T, C>& left, basic_shared_ptr<T, C>& right) noexcept
+{
+	left.swap(right);
+}
+
+template<class T, class C>
+struct is_trivially_relocatable<basic_shared_ptr<T, C>> : true_type {};
 
+template<class T> using shared_ptr       = basic_shared_ptr<T, atomic_ref_count>;
+template<class T> using local_shared_ptr = basic_shared_ptr<T, local_ref_count>;
 
+// pointer casts, the result shares the ownership of r
 
+template<class T, class U, class C>
+inline basic_shared_ptr<T, C> static_pointer_cast(const basic_shared_ptr<U, C>& r) noexcept
+{
+	return basic_shared_ptr<T, C>(r, static_cast<T*>(r.get()));
+}
+
+template<class T, class U, class C>
+inline basic_shared_ptr<T, C> dynamic_pointer_cast(const basic_shared_ptr<U, C>& r) noexcept
+{
+	if (T* p = dynamic_cast<T*>(r.get()))
+		return basic_shared_ptr<T, C>(r, p);
+	return basic_shared_ptr<T, C>();
+}
 
+template<class T, class U, class C>
+inline basic_shared_ptr<T, C> const_pointer_cast(const basic_shared_ptr<U, C>& r) noexcept
+{
+	return basic_shared_ptr<T, C>(r, const_cast<T*>(r.get()));
+}
 
+// make_shared -----------------------------------------------------------------
+// the object and the control block in one allocation
 
+namespace detail
+{
 
+template<class T, class Count, bool UseAllocator, class A, class... Args>
+inline basic_shared_ptr<T, Count> allocate_shared(std::bool_constant<UseAllocator> use_allocator, const A& alloc, Args&&... args)
+{
+	using block = shared_control_inplace<Count, T, A>;
+	block* b = new_control_block<block>(alloc, use_allocator, alloc, toy::forward<Args>(args)...);
+	return basic_shared_ptr<T, Count>(shared_make_tag(), b->get(), b);
+}
 
+}	// namespace detail
+
+template<class T, class... Args, class = enable_if_t<!std::is_array<T>::value>>
+inline shared_ptr<T> make_shared(Args&&... args)
+{
+	return detail::allocate_shared<T, atomic_ref_count>(std::false_type(), allocator<T>(), toy::forward<Args>(args)...);
+}
+
+template<class T, class A, class... Args, class = enable_if_t<!std::is_array<T>::value>>
+inline shared_ptr<T> allocate_shared(const A& alloc, Args&&... args)
+{
+	return detail::allocate_shared<T, atomic_ref_count>(std::true_type(), alloc, toy::forward<Args>(args)...);
+}
+
+template<class T, class... Args, class = enable_if_t<!std::is_array<T>::value>>
+inline local_shared_ptr<T> make_local_shared(Args&&... args)
+{
+	return detail::allocate_shared<T, local_ref_count>(std::false_type(), allocator<T>(), toy::forward<Args>(args)...);
+}
+
+template<class T, class A, class... Args, class = enable_if_t<!std::is_array<T>::value>>
+inline local_shared_ptr<T> allocate_local_shared(const A& alloc, Args&&... args)
+{
+	return detail::allocate_shared<T, local_ref_count>(std::true_type(), alloc, toy::forward<Args>(args)...);
+}
 
 // weak_ptr --------------------------------------------------------------------
 
+template<class T, class Count>
+class basic_weak_ptr
+{
+public:
+	using element_type = T;
+
+public:
+	// constructors
+	constexpr basic_weak_ptr() noexcept {}
+
+	basic_weak_ptr(const basic_weak_ptr& r) noexcept
+		: ptr{ r.ptr }, ctrl{ r.ctrl }
+	{
+		if (ctrl)
+			ctrl->weak_add_ref();
+	}
+
+	template<class Y, class = enable_if_t<std::is_convertible<Y*, T*>::value>>
+	basic_weak_ptr(const basic_weak_ptr<Y, Count>& r) noexcept
+		: ctrl{ r.ctrl }
+	{	// r may expire meanwhile, take the pointer from a locked copy
+		if (ctrl)
+		{
+			ctrl->weak_add_ref();
+			ptr = r.lock().get();
+		}
+	}
+
+	template<class Y, class = enable_if_t<std::is_convertible<Y*, T*>::value>>
+	basic_weak_ptr(const basic_shared_ptr<Y, Count>& r) noexcept
+		: ptr{ r.ptr }, ctrl{ r.ctrl }
+	{
+		if (ctrl)
+			ctrl->weak_add_ref();
+	}
+
+	basic_weak_ptr(basic_weak_ptr&& r) noexcept
+		: ptr{ r.ptr }, ctrl{ r.ctrl }
+	{
+		r.ptr  = nullptr;
+		r.ctrl = nullptr;
+	}
+
+	template<class Y, class = enable_if_t<std::is_convertible<Y*, T*>::value>>
+	basic_weak_ptr(basic_weak_ptr<Y, Count>&& r) noexcept
+		: ctrl{ r.ctrl }
+	{	// takes over the weak reference of r, the pointer as in the copy
+		if (ctrl)
+			ptr = r.lock().get();
+		r.ptr  = nullptr;
+		r.ctrl = nullptr;
+	}
+
+	// destructor
+	~basic_weak_ptr()
+	{
+		if (ctrl)
+			ctrl->weak_release();
+	}
+
+	// assignment
+	basic_weak_ptr& operator=(const basic_weak_ptr& r) noexcept
+	{
+		basic_weak_ptr(r).swap(*this);
+		return *this;
+	}
+
+	template<class Y>
+	basic_weak_ptr& operator=(const basic_shared_ptr<Y, Count>& r) noexcept
+	{
+		basic_weak_ptr(r).swap(*this);
+		return *this;
+	}
+
+	basic_weak_ptr& operator=(basic_weak_ptr&& r) noexcept
+	{
+		basic_weak_ptr(toy::move(r)).swap(*this);
+		return *this;
+	}
+
+	template<class Y, class = enable_if_t<std::is_convertible<Y*, T*>::value>>
+	basic_weak_ptr& operator=(const basic_weak_ptr<Y, Count>& r) noexcept
+	{
+		basic_weak_ptr(r).swap(*this);
+		return *this;
+	}
+
+	template<class Y, class = enable_if_t<std::is_convertible<Y*, T*>::value>>
+	basic_weak_ptr& operator=(basic_weak_ptr<Y, Count>&& r) noexcept
+	{
+		basic_weak_ptr(toy::move(r)).swap(*this);
+		return *this;
+	}
+
+	// modifiers
+	void reset() noexcept { basic_weak_ptr().swap(*this); }
+
+	void swap(basic_weak_ptr& r) noexcept
+	{
+		std::swap(ptr, r.ptr);
+		std::swap(ctrl, r.ctrl);
+	}
+
+	// observers
+	long use_count() const noexcept { return ctrl ? ctrl->use_count() : 0; }
+	bool expired() const noexcept { return use_count() == 0; }
+
+	basic_shared_ptr<T, Count> lock() const noexcept
+	{
+		basic_shared_ptr<T, Count> p;
+		if (ctrl && ctrl->add_ref_if_alive())
+		{
+			p.ptr  = ptr;
+			p.ctrl = ctrl;
+		}
+		return p;
+	}
+
+	template<class Y, class C>
+	bool owner_before(const basic_shared_ptr<Y, C>& r) const noexcept
+	{
+		return std::less<const void*>()(ctrl, r.ctrl);
+	}
+
+	template<class Y, class C>
+	bool owner_before(const basic_weak_ptr<Y, C>& r) const noexcept
+	{
+		return std::less<const void*>()(ctrl, r.ctrl);
+	}
+
+private:
+	template<class Y, class C> friend class basic_shared_ptr;
+	template<class Y, class C> friend class basic_weak_ptr;
+
+	element_type* ptr{ nullptr };
+	detail::shared_control<Count>* ctrl{ nullptr };
+};
+
+template<class T, class C>
+inline void swap(basic_weak_ptr<T, C>& left, basic_weak_ptr<T, C>& right) noexcept
+{
+	left.swap(right);
+}
+
+template<class T, class C>
+struct is_trivially_relocatable<basic_weak_ptr<T, C>> : true_type {};
+
+template<class T> using weak_ptr       = basic_weak_ptr<T, atomic_ref_count>;
+template<class T> using local_weak_ptr = basic_weak_ptr<T, local_ref_count>;
+
+// enable_shared_from_this -----------------------------------------------------
+
+template<class T>
+class enable_shared_from_this
+{
+public:
+	shared_ptr<T> shared_from_this() { return shared_ptr<T>(weak_this); }
+	shared_ptr<const T> shared_from_this() const { return shared_ptr<const T>(weak_this); }
+
+	weak_ptr<T> weak_from_this() noexcept { return weak_this; }
+	weak_ptr<const T> weak_from_this() const noexcept { return weak_this; }
+
+protected:
+	constexpr enable_shared_from_this() noexcept {}
+	enable_shared_from_this(const enable_shared_from_this&) noexcept {}
+	enable_shared_from_this& operator=(const enable_shared_from_this&) noexcept { return *this; }
+	~enable_shared_from_this() {}
+
+private:
+	template<class Y, class C> friend class basic_shared_ptr;
+
+	mutable weak_ptr<T> weak_this;
+};
+
+template<class T, class Count>
+template<class Y, class U>
+inline void basic_shared_ptr<T, Count>::enable_shared_from_(const enable_shared_from_this<U>* e, Y* p) noexcept
+{	// the first shared_ptr of the object sets its weak_this
+	if (e && e->weak_this.expired())
+		e->weak_this = shared_ptr<U>(*this, const_cast<U*>(static_cast<const U*>(p)));
+}
+
+// intrusive_ptr ---------------------------------------------------------------
+
+// Pointer to an object that carries its own reference count. The count is
+// reached through intrusive_ptr_add_ref(T*) and intrusive_ptr_release(T*),
+// found by argument dependent lookup, intrusive_ref_counter provides both.
+// No control block: the pointer is one word and an object can be adopted
+// again from a raw pointer.
+
+template<class T>
+class intrusive_ptr
+{
+public:
+	using element_type = T;
+
+public:
+	// constructors
+	constexpr intrusive_ptr() noexcept {}
+
+	intrusive_ptr(T* p, bool add_ref = true) : ptr{ p }
+	{
+		if (ptr && add_ref)
+			intrusive_ptr_add_ref(ptr);
+	}
+
+	intrusive_ptr(const intrusive_ptr& r) : ptr{ r.ptr }
+	{
+		if (ptr)
+			intrusive_ptr_add_ref(ptr);
+	}
+
+	template<class Y, class = enable_if_t<std::is_convertible<Y*, T*>::value>>
+	intrusive_ptr(const intrusive_ptr<Y>& r) : ptr{ r.get() }
+	{
+		if (ptr)
+			intrusive_ptr_add_ref(ptr);
+	}
+
+	intrusive_ptr(intrusive_ptr&& r) noexcept : ptr{ r.ptr }
+	{
+		r.ptr = nullptr;
+	}
+
+	// destructor
+	~intrusive_ptr()
+	{
+		if (ptr)
+			intrusive_ptr_release(ptr);
+	}
+
+	// assignment
+	intrusive_ptr& operator=(const intrusive_ptr& r)
+	{
+		intrusive_ptr(r).swap(*this);
+		return *this;
+	}
+
+	intrusive_ptr& operator=(intrusive_ptr&& r) noexcept
+	{
+		intrusive_ptr(toy::move(r)).swap(*this);
+		return *this;
+	}
+
+	intrusive_ptr& operator=(T* p)
+	{
+		intrusive_ptr(p).swap(*this);
+		return *this;
+	}
+
+	// modifiers
+	void reset() noexcept { intrusive_ptr().swap(*this); }
+	void reset(T* p, bool add_ref = true) { intrusive_ptr(p, add_ref).swap(*this); }
+
+	T* detach() noexcept
+	{	// give up the pointer without releasing it
+		T* p = ptr;
+		ptr = nullptr;
+		return p;
+	}
+
+	void swap(intrusive_ptr& r) noexcept { std::swap(ptr, r.ptr); }
+
+	// observers
+	T* get() const noexcept { return ptr; }
+	T& operator*() const noexcept { return *ptr; }
+	T* operator->() const noexcept { return ptr; }
+	explicit operator bool() const noexcept { return ptr != nullptr; }
+
+private:
+	T* ptr{ nullptr };
+};
+
+template<class T, class U>
+inline bool operator==(const intrusive_ptr<T>& left, const intrusive_ptr<U>& right) noexcept
+{
+	return left.get() == right.get();
+}
+
+template<class T, class U>
+inline bool operator!=(const intrusive_ptr<T>& left, const intrusive_ptr<U>& right) noexcept
+{
+	return left.get() != right.get();
+}
+
+template<class T>
+inline void swap(intrusive_ptr<T>& left, intrusive_ptr<T>& right) noexcept
+{
+	left.swap(right);
+}
+
+template<class T>
+struct is_trivially_relocatable<intrusive_ptr<T>> : true_type {};
+
+// base of the objects counted by intrusive_ptr, the last release deletes the
+// object as a Derived, Count is atomic_ref_count or local_ref_count
+template<class Derived, class Count = atomic_ref_count>
+class intrusive_ref_counter
+{
+public:
+	long use_count() const noexcept { return refs.load(); }
+
+	friend void intrusive_ptr_add_ref(const Derived* p) noexcept
+	{
+		static_cast<const intrusive_ref_counter*>(p)->refs.increment();
+	}
+
+	friend void intrusive_ptr_release(const Derived* p) noexcept
+	{
+		if (static_cast<const intrusive_ref_counter*>(p)->refs.decrement())
+			delete p;
+	}
+
+protected:
+	intrusive_ref_counter() noexcept {}
+	intrusive_ref_counter(const intrusive_ref_counter&) noexcept {}	// a copy is a new object with no owner
+	intrusive_ref_counter& operator=(const intrusive_ref_counter&) noexcept { return *this; }
+	~intrusive_ref_counter() {}
+
+private:
+	mutable Count refs{ 0 };
+};
+
 }	// namespace toy	
 
 #endif	// TOY_CORE_MEMORY_H
@@ -0,0 +1,698 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_MEMORY_RESOURCE_H
+#define TOY_CORE_MEMORY_RESOURCE_H
+
+#include <atomic>
+#include <cstddef>	// for size_t, max_align_t
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "toy/core/arena.h"
+#include "toy/core/utility.h"
+
+namespace toy
+{
+
+// C++17 Standard, section 23.12, with a statistics wrapper on top.
+
+// memory_resource -------------------------------------------------------------
+
+// Abstract source of memory. Containers that use polymorphic_allocator<T> keep
+// a memory_resource*, so the same container type runs on the heap, an arena or
+// a pool chosen at runtime.
+
+class memory_resource
+{
+public:
+	static constexpr size_t max_align = alignof(std::max_align_t);
+
+public:
+	virtual ~memory_resource() {}
+
+	void* allocate(size_t bytes, size_t alignment = max_align)
+	{
+		return do_allocate(bytes, alignment);
+	}
+
+	void deallocate(void* p, size_t bytes, size_t alignment = max_align)
+	{
+		do_deallocate(p, bytes, alignment);
+	}
+
+	bool is_equal(const memory_resource& other) const noexcept
+	{
+		return do_is_equal(other);
+	}
+
+private:
+	virtual void* do_allocate(size_t bytes, size_t alignment) = 0;
+	virtual void do_deallocate(void* p, size_t bytes, size_t alignment) = 0;
+	virtual bool do_is_equal(const memory_resource& other) const noexcept = 0;
+};
+
+inline bool operator==(const memory_resource& left, const memory_resource& right) noexcept
+{
+	return &left == &right || left.is_equal(right);
+}
+
+inline bool operator!=(const memory_resource& left, const memory_resource& right) noexcept
+{
+	return !(left == right);
+}
+
+// new_delete_resource & null_memory_resource ----------------------------------
+
+namespace detail
+{
+
+class new_delete_resource final : public memory_resource
+{
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			return ::operator new(bytes, std::align_val_t(alignment));
+		return ::operator new(bytes);
+	}
+
+	void do_deallocate(void* p, size_t, size_t alignment) override
+	{
+		if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			::operator delete(p, std::align_val_t(alignment));
+		else
+			::operator delete(p);
+	}
+
+	bool do_is_equal(const memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+class null_memory_resource final : public memory_resource
+{
+	void* do_allocate(size_t, size_t) override
+	{
+		throw std::bad_alloc();
+	}
+
+	void do_deallocate(void*, size_t, size_t) override
+	{
+	}
+
+	bool do_is_equal(const memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+inline std::atomic<memory_resource*>& default_resource() noexcept
+{
+	static std::atomic<memory_resource*> resource{ nullptr };
+	return resource;
+}
+
+}	// namespace detail
+
+inline memory_resource* new_delete_resource() noexcept
+{	// never destroyed, containers with static storage may still use it at exit
+	alignas(detail::new_delete_resource) static unsigned char storage[sizeof(detail::new_delete_resource)];
+	static memory_resource* resource = ::new (storage) detail::new_delete_resource;
+	return resource;
+}
+
+inline memory_resource* null_memory_resource() noexcept
+{	// every allocation throws bad_alloc
+	alignas(detail::null_memory_resource) static unsigned char storage[sizeof(detail::null_memory_resource)];
+	static memory_resource* resource = ::new (storage) detail::null_memory_resource;
+	return resource;
+}
+
+inline memory_resource* get_default_resource() noexcept
+{
+	memory_resource* resource = detail::default_resource().load(std::memory_order_acquire);
+	return resource ? resource : new_delete_resource();
+}
+
+inline memory_resource* set_default_resource(memory_resource* resource) noexcept
+{	// null restores new_delete_resource(), return the previous one
+	memory_resource* previous = detail::default_resource().exchange(resource, std::memory_order_acq_rel);
+	return previous ? previous : new_delete_resource();
+}
+
+// monotonic_buffer_resource ---------------------------------------------------
+
+// memory_resource over a toy::arena: allocation bumps a pointer, deallocate is
+// a no-op and release() frees everything at once. Meant for per-request or
+// per-frame data that dies together.
+
+class monotonic_buffer_resource : public memory_resource
+{
+public:
+	monotonic_buffer_resource() noexcept {}
+	explicit monotonic_buffer_resource(size_t block_size) noexcept : source(block_size) {}
+	monotonic_buffer_resource(void* buffer, size_t size) noexcept : source(buffer, size) {}
+
+	monotonic_buffer_resource(const monotonic_buffer_resource&) = delete;
+	monotonic_buffer_resource& operator=(const monotonic_buffer_resource&) = delete;
+
+	void release() noexcept { source.release(); }	// the blocks go back to the heap
+	void reset() noexcept { source.reset(); }		// the blocks are kept for reuse
+
+	arena& get_arena() noexcept { return source; }
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		return source.allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void*, size_t, size_t) override
+	{
+	}
+
+	bool do_is_equal(const memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+private:
+	arena source;
+};
+
+// pool_resource ---------------------------------------------------------------
+
+struct pool_options
+{
+	size_t max_blocks_per_chunk{ 0 };			// 0: implementation default
+	size_t largest_required_pool_block{ 0 };	// 0: implementation default
+};
+
+// Pools of fixed-size blocks, one per power of two from 8 bytes up to
+// largest_required_pool_block. A pool carves its blocks out of chunks taken
+// from the upstream resource, the chunks double in size up to
+// max_blocks_per_chunk blocks. Freed blocks go to the free list of their pool,
+// requests above the largest pool go straight upstream, with a header that
+// links them into a list so release() can free them too.
+//
+// unsynchronized_pool_resource is for a single thread, e.g. a per-thread pool,
+// synchronized_pool_resource puts a mutex in front of it.
+
+class unsynchronized_pool_resource : public memory_resource
+{
+public:
+	static constexpr size_t min_block_size      = 8;
+	static constexpr size_t default_largest     = 4096;
+	static constexpr size_t default_max_blocks  = 1024;
+
+public:
+	unsynchronized_pool_resource() : unsynchronized_pool_resource(pool_options(), get_default_resource()) {}
+	explicit unsynchronized_pool_resource(memory_resource* upstream) : unsynchronized_pool_resource(pool_options(), upstream) {}
+	explicit unsynchronized_pool_resource(const pool_options& opts) : unsynchronized_pool_resource(opts, get_default_resource()) {}
+
+	unsynchronized_pool_resource(const pool_options& options, memory_resource* upstream)
+		: upstream(upstream)
+	{
+		size_t largest = options.largest_required_pool_block ? options.largest_required_pool_block : default_largest;
+		size_t max_blocks = options.max_blocks_per_chunk ? options.max_blocks_per_chunk : default_max_blocks;
+
+		size_t size = min_block_size;
+		while (size < largest)
+			size *= 2;
+		opts.largest_required_pool_block = size;
+		opts.max_blocks_per_chunk = max_blocks;
+
+		for (size_t s = min_block_size; s <= size; s *= 2)
+			pools.push_back(pool{ s, nullptr, 1 });
+	}
+
+	~unsynchronized_pool_resource() { release(); }
+
+	unsynchronized_pool_resource(const unsynchronized_pool_resource&) = delete;
+	unsynchronized_pool_resource& operator=(const unsynchronized_pool_resource&) = delete;
+
+	void release()
+	{	// give every chunk and large block back upstream, even the blocks still in use
+		for (const chunk& c : chunks)
+			upstream->deallocate(c.p, c.size, c.alignment);
+		chunks.clear();
+		while (large)
+		{
+			large_block* b = large;
+			large = b->next;
+			upstream->deallocate(b, b->size, b->alignment);
+		}
+		for (pool& p : pools)
+		{
+			p.free = nullptr;
+			p.next_blocks = 1;
+		}
+	}
+
+	memory_resource* upstream_resource() const noexcept { return upstream; }
+	pool_options options() const noexcept { return opts; }
+
+private:
+	struct node
+	{
+		node* next;
+	};
+
+	struct pool
+	{
+		size_t block_size;
+		node*  free;
+		size_t next_blocks;	// blocks in the next chunk
+	};
+
+	struct chunk
+	{
+		void*  p;
+		size_t size;
+		size_t alignment;
+	};
+
+	struct large_block
+	{	// in front of a block above the largest pool, the block starts at
+		// large_offset(alignment) from it
+		large_block* prev;
+		large_block* next;
+		size_t       size;	// with the header
+		size_t       alignment;
+	};
+
+	static size_t large_offset(size_t alignment) noexcept
+	{
+		return sizeof(large_block) > alignment
+			? (sizeof(large_block) + alignment - 1) & ~(alignment - 1)
+			: alignment;
+	}
+
+	pool* pool_for(size_t bytes, size_t alignment) noexcept
+	{
+		size_t need = bytes > alignment ? bytes : alignment;
+		if (need > opts.largest_required_pool_block)
+			return nullptr;
+
+		size_t index = 0;
+		for (size_t size = min_block_size; size < need; size *= 2)
+			++index;
+		return &pools[index];
+	}
+
+	void refill(pool& p)
+	{
+		size_t blocks = p.next_blocks;
+		size_t size = blocks * p.block_size;
+		size_t alignment = p.block_size < max_align ? max_align : p.block_size;
+
+		chunks.reserve(chunks.size() + 1);
+		void* memory = upstream->allocate(size, alignment);
+		chunks.push_back(chunk{ memory, size, alignment });
+
+		unsigned char* base = static_cast<unsigned char*>(memory);
+		for (size_t i = blocks; i-- > 0;)
+			p.free = ::new (base + i * p.block_size) node{ p.free };
+
+		if (p.next_blocks * 2 <= opts.max_blocks_per_chunk)
+			p.next_blocks *= 2;
+	}
+
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		pool* p = pool_for(bytes, alignment);
+		if (!p)
+		{
+			size_t align = alignment < alignof(large_block) ? alignof(large_block) : alignment;
+			size_t offset = large_offset(align);
+			if (bytes > SIZE_MAX - offset)
+				throw std::bad_alloc();
+
+			large_block* b = static_cast<large_block*>(upstream->allocate(bytes + offset, align));
+			::new (b) large_block{ nullptr, large, bytes + offset, align };
+			if (large)
+				large->prev = b;
+			large = b;
+			return reinterpret_cast<unsigned char*>(b) + offset;
+		}
+
+		if (!p->free)
+			refill(*p);
+		node* n = p->free;
+		p->free = n->next;
+		return n;
+	}
+
+	void do_deallocate(void* ptr, size_t bytes, size_t alignment) override
+	{
+		pool* p = pool_for(bytes, alignment);
+		if (!p)
+		{
+			size_t align = alignment < alignof(large_block) ? alignof(large_block) : alignment;
+			large_block* b = reinterpret_cast<large_block*>(static_cast<unsigned char*>(ptr) - large_offset(align));
+			if (b->prev)
+				b->prev->next = b->next;
+			else
+				large = b->next;
+			if (b->next)
+				b->next->prev = b->prev;
+			return upstream->deallocate(b, b->size, b->alignment);
+		}
+
+		p->free = ::new (ptr) node{ p->free };
+	}
+
+	bool do_is_equal(const memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+private:
+	memory_resource*   upstream;
+	pool_options       opts;
+	std::vector<pool>  pools;
+	std::vector<chunk> chunks;
+	large_block*       large{ nullptr };
+};
+
+class synchronized_pool_resource : public memory_resource
+{
+public:
+	synchronized_pool_resource() {}
+	explicit synchronized_pool_resource(memory_resource* upstream) : pools(upstream) {}
+	explicit synchronized_pool_resource(const pool_options& opts) : pools(opts) {}
+	synchronized_pool_resource(const pool_options& opts, memory_resource* upstream) : pools(opts, upstream) {}
+
+	void release()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pools.release();
+	}
+
+	memory_resource* upstream_resource() const noexcept { return pools.upstream_resource(); }
+	pool_options options() const noexcept { return pools.options(); }
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return pools.allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pools.deallocate(p, bytes, alignment);
+	}
+
+	bool do_is_equal(const memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+private:
+	std::mutex mutex;
+	unsynchronized_pool_resource pools;
+};
+
+// statistics_resource ---------------------------------------------------------
+// forwards to an upstream resource and counts what goes through it, safe to
+// share between threads when the upstream is
+
+class statistics_resource : public memory_resource
+{
+public:
+	explicit statistics_resource(memory_resource* upstream = get_default_resource()) noexcept
+		: upstream(upstream) {}
+
+	size_t allocations() const noexcept   { return allocate_count.load(std::memory_order_relaxed); }
+	size_t deallocations() const noexcept { return deallocate_count.load(std::memory_order_relaxed); }
+	size_t bytes_allocated() const noexcept { return total_bytes.load(std::memory_order_relaxed); }
+	size_t bytes_in_use() const noexcept  { return in_use.load(std::memory_order_relaxed); }
+	size_t peak_bytes() const noexcept    { return peak.load(std::memory_order_relaxed); }
+
+	void reset_peak() noexcept { peak.store(in_use.load(std::memory_order_relaxed), std::memory_order_relaxed); }
+
+	memory_resource* upstream_resource() const noexcept { return upstream; }
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		void* p = upstream->allocate(bytes, alignment);
+
+		allocate_count.fetch_add(1, std::memory_order_relaxed);
+		total_bytes.fetch_add(bytes, std::memory_order_relaxed);
+		size_t now = in_use.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		size_t old = peak.load(std::memory_order_relaxed);
+		while (now > old && !peak.compare_exchange_weak(old, now, std::memory_order_relaxed))
+			;
+		return p;
+	}
+
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override
+	{
+		upstream->deallocate(p, bytes, alignment);
+
+		deallocate_count.fetch_add(1, std::memory_order_relaxed);
+		in_use.fetch_sub(bytes, std::memory_order_relaxed);
+	}
+
+	bool do_is_equal(const memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+private:
+	memory_resource* upstream;
+
+	std::atomic<size_t> allocate_count{ 0 };
+	std::atomic<size_t> deallocate_count{ 0 };
+	std::atomic<size_t> total_bytes{ 0 };
+	std::atomic<size_t> in_use{ 0 };
+	std::atomic<size_t> peak{ 0 };
+};
+
+// polymorphic_allocator -------------------------------------------------------
+
+// Allocator that holds a memory_resource*. construct() passes the allocator on
+// to the elements that take one (uses-allocator construction), so a map of
+// vectors of strings keeps every level on the same resource.
+//
+// Copying a container does not copy its resource: the copy goes back to the
+// default resource, as the standard does.
+
+template<class T>
+class polymorphic_allocator
+{
+public:
+	using value_type	  = T;
+	using pointer		  = T*;
+	using const_pointer   = const T*;
+	using reference		  = T&;
+	using const_reference = const T&;
+
+	using size_type		  = size_t;
+	using difference_type = ptrdiff_t;
+
+public:
+	template<class U> struct rebind { using other = polymorphic_allocator<U>; };
+
+	// constructors
+	polymorphic_allocator() noexcept : resource{ get_default_resource() } {}
+	polymorphic_allocator(memory_resource* r) noexcept : resource{ r } {}
+	polymorphic_allocator(const polymorphic_allocator&) noexcept = default;
+	template <typename U> polymorphic_allocator(const polymorphic_allocator<U>& right) noexcept
+		: resource{ right.get_resource() } {}
+
+	polymorphic_allocator& operator=(const polymorphic_allocator&) = delete;
+
+	// allocate & deallocate
+	pointer allocate(size_t count)
+	{
+		if (count > max_size())
+			throw std::length_error("polymorphic_allocator<T>::allocate(size_t n)"
+				" 'n' exceeds maximum supported size");
+		return static_cast<pointer>(resource->allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(pointer ptr, size_t count)
+	{
+		resource->deallocate(ptr, count * sizeof(T), alignof(T));
+	}
+
+	// objects of any type on the same resource
+	template<class U, class... Args>
+	U* new_object(Args&&... args)
+	{
+		polymorphic_allocator<U> alloc(resource);
+		U* p = alloc.allocate(1);
+		try
+		{
+			alloc.construct(p, toy::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			alloc.deallocate(p, 1);
+			throw;
+		}
+		return p;
+	}
+
+	template<class U>
+	void delete_object(U* p)
+	{
+		p->~U();
+		polymorphic_allocator<U>(resource).deallocate(p, 1);
+	}
+
+	// construct & destroy
+	template<class U, class... Args>
+	void construct(U* ptr, Args&&... args)
+	{
+		construct_with_allocator(ptr, toy::forward<Args>(args)...);
+	}
+
+	template<class U1, class U2, class... Args1, class... Args2>
+	void construct(std::pair<U1, U2>* ptr, std::piecewise_construct_t,
+		std::tuple<Args1...> a, std::tuple<Args2...> b)
+	{	// both members of the pair get the allocator
+		::new(static_cast<void*>(ptr)) std::pair<U1, U2>(std::piecewise_construct,
+			add_allocator<U1>(toy::move(a)), add_allocator<U2>(toy::move(b)));
+	}
+
+	template<class U1, class U2>
+	void construct(std::pair<U1, U2>* ptr)
+	{
+		construct(ptr, std::piecewise_construct, std::tuple<>(), std::tuple<>());
+	}
+
+	template<class U1, class U2, class V1, class V2>
+	void construct(std::pair<U1, U2>* ptr, V1&& x, V2&& y)
+	{
+		construct(ptr, std::piecewise_construct,
+			std::forward_as_tuple(toy::forward<V1>(x)), std::forward_as_tuple(toy::forward<V2>(y)));
+	}
+
+	template<class U1, class U2, class V1, class V2>
+	void construct(std::pair<U1, U2>* ptr, const std::pair<V1, V2>& pr)
+	{
+		construct(ptr, std::piecewise_construct,
+			std::forward_as_tuple(pr.first), std::forward_as_tuple(pr.second));
+	}
+
+	template<class U1, class U2, class V1, class V2>
+	void construct(std::pair<U1, U2>* ptr, std::pair<V1, V2>&& pr)
+	{
+		construct(ptr, std::piecewise_construct,
+			std::forward_as_tuple(toy::forward<V1>(pr.first)), std::forward_as_tuple(toy::forward<V2>(pr.second)));
+	}
+
+	// toy::pair the same way
+	template<class U1, class U2, class... Args1, class... Args2>
+	void construct(pair<U1, U2>* ptr, std::piecewise_construct_t,
+		std::tuple<Args1...> a, std::tuple<Args2...> b)
+	{
+		::new(static_cast<void*>(ptr)) pair<U1, U2>(std::piecewise_construct,
+			add_allocator<U1>(toy::move(a)), add_allocator<U2>(toy::move(b)));
+	}
+
+	template<class U1, class U2>
+	void construct(pair<U1, U2>* ptr)
+	{
+		construct(ptr, std::piecewise_construct, std::tuple<>(), std::tuple<>());
+	}
+
+	template<class U1, class U2, class V1, class V2>
+	void construct(pair<U1, U2>* ptr, V1&& x, V2&& y)
+	{
+		construct(ptr, std::piecewise_construct,
+			std::forward_as_tuple(toy::forward<V1>(x)), std::forward_as_tuple(toy::forward<V2>(y)));
+	}
+
+	template<class U1, class U2, class V1, class V2>
+	void construct(pair<U1, U2>* ptr, const pair<V1, V2>& pr)
+	{
+		construct(ptr, std::piecewise_construct,
+			std::forward_as_tuple(pr.first), std::forward_as_tuple(pr.second));
+	}
+
+	template<class U1, class U2, class V1, class V2>
+	void construct(pair<U1, U2>* ptr, pair<V1, V2>&& pr)
+	{
+		construct(ptr, std::piecewise_construct,
+			std::forward_as_tuple(toy::forward<V1>(pr.first)), std::forward_as_tuple(toy::forward<V2>(pr.second)));
+	}
+
+	template<class U>
+	void destroy(U* ptr)
+	{
+		ptr->~U();
+	}
+
+	size_t max_size() const noexcept
+	{
+		return (static_cast<size_t>(-1) / sizeof(T));
+	}
+
+	polymorphic_allocator select_on_container_copy_construction() const noexcept
+	{
+		return polymorphic_allocator();
+	}
+
+	memory_resource* get_resource() const noexcept { return resource; }
+
+private:
+	template<class U, class... Args>
+	void construct_with_allocator(U* ptr, Args&&... args)
+	{
+		void* p = const_cast<void*>(static_cast<const volatile void*>(ptr));
+
+		if constexpr (!std::uses_allocator<U, polymorphic_allocator>::value)
+			::new(p) U(toy::forward<Args>(args)...);
+		else if constexpr (std::is_constructible<U, std::allocator_arg_t, const polymorphic_allocator&, Args...>::value)
+			::new(p) U(std::allocator_arg, *this, toy::forward<Args>(args)...);
+		else
+			::new(p) U(toy::forward<Args>(args)..., *this);
+	}
+
+	template<class U, class... Args>
+	auto add_allocator(std::tuple<Args...>&& args) const
+	{	// the arguments of a pair member, with the allocator added when it takes one
+		if constexpr (!std::uses_allocator<U, polymorphic_allocator>::value)
+			return std::tuple<Args&&...>(toy::move(args));
+		else if constexpr (std::is_constructible<U, std::allocator_arg_t, const polymorphic_allocator&, Args...>::value)
+			return std::tuple_cat(std::tuple<std::allocator_arg_t, const polymorphic_allocator&>(std::allocator_arg, *this),
+				std::tuple<Args&&...>(toy::move(args)));
+		else
+			return std::tuple_cat(std::tuple<Args&&...>(toy::move(args)),
+				std::tuple<const polymorphic_allocator&>(*this));
+	}
+
+private:
+	memory_resource* resource;
+};
+
+template <class T1, class T2>
+inline bool operator==(const polymorphic_allocator<T1>& left, const polymorphic_allocator<T2>& right) noexcept
+{
+	return *left.get_resource() == *right.get_resource();
+}
+
+template <class T1, class T2>
+inline bool operator!=(const polymorphic_allocator<T1>& left, const polymorphic_allocator<T2>& right) noexcept
+{
+	return !(left == right);
+}
+
+}	// namespace toy
+
+#endif	// TOY_CORE_MEMORY_RESOURCE_H
@@ -5,14 +5,807 @@
 #ifndef TOY_CORE_NEW_H
 #define TOY_CORE_NEW_H
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
+#include <new>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "toy/core/alloc_stats.h"
+#include "toy/core/thread.h"
 
 namespace toy
 {
 
+// hardware interference size --------------------------------------------------
+// C++17 std::hardware_destructive_interference_size is not provided by every
+// standard library yet, 64 bytes is the cache line of x86 and most ARM cores
+
+constexpr size_t hardware_destructive_interference_size  = 64;
+constexpr size_t hardware_constructive_interference_size = 64;
+
+// os pages --------------------------------------------------------------------
+// memory straight from the kernel, released memory goes back to the OS
+// instead of staying in the free lists of malloc
+
+inline size_t os_page_size() noexcept
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return static_cast<size_t>(info.dwPageSize);
+#else
+	return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// size is a multiple of the page size and alignment a power of two, the
+// pages are zeroed, throw bad_alloc when the OS is out of memory
+inline void* os_allocate_pages(size_t size, size_t alignment)
+{
+#if defined(_WIN32)
+	// VirtualAlloc is 64K aligned, for more reserve a larger range, release
+	// it and map again at the aligned address inside it
+	for (;;)
+	{
+		void* p = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (!p)
+			throw std::bad_alloc();
+		if ((reinterpret_cast<uintptr_t>(p) & (alignment - 1)) == 0)
+			return p;
+		VirtualFree(p, 0, MEM_RELEASE);
+
+		p = VirtualAlloc(nullptr, size + alignment, MEM_RESERVE, PAGE_NOACCESS);
+		if (!p)
+			throw std::bad_alloc();
+		uintptr_t aligned = (reinterpret_cast<uintptr_t>(p) + alignment - 1) & ~(alignment - 1);
+		VirtualFree(p, 0, MEM_RELEASE);
+
+		p = VirtualAlloc(reinterpret_cast<void*>(aligned), size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (p)
+			return p;
+		// somebody else took the range in between, try again
+	}
+#else
+	// map alignment more than asked and unmap the misaligned head and tail
+	size_t page = os_page_size();
+	size_t extra = alignment > page ? alignment : 0;
+
+	void* p = mmap(nullptr, size + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		throw std::bad_alloc();
+	if (extra == 0)
+		return p;
+
+	uintptr_t begin   = reinterpret_cast<uintptr_t>(p);
+	uintptr_t aligned = (begin + alignment - 1) & ~(alignment - 1);
+	if (aligned != begin)
+		munmap(p, aligned - begin);
+	if (extra != aligned - begin)
+		munmap(reinterpret_cast<void*>(aligned + size), extra - (aligned - begin));
+	return reinterpret_cast<void*>(aligned);
+#endif
+}
+
+inline void os_release_pages(void* p, size_t size) noexcept
+{	// p and size are the ones of os_allocate_pages
+#if defined(_WIN32)
+	(void)size;
+	VirtualFree(p, 0, MEM_RELEASE);
+#else
+	munmap(p, size);
+#endif
+}
+
+// heap ------------------------------------------------------------------------
+
+// Size-class allocator meant to replace the global operator new/delete.
+//
+// Small requests (up to 32K) are rounded up to one of 44 size classes, 16 byte
+// steps up to 256 and then four classes per power of two. Every class carves
+// its blocks out of spans, runs of 64K pages straight from the OS, and every
+// thread keeps a free list per class: allocation and deallocation pop and push
+// that list without any lock or atomic. A thread cache that runs dry takes a
+// batch of blocks from the central list of the class, one that grows past two
+// batches gives one back, so blocks freed by another thread flow back in
+// batches too.
+//
+// The span of a pointer is found through a two-level page map indexed by the
+// 64K chunk of the address, the span headers live outside the spans so blocks
+// are packed from the first byte and a power-of-two class is naturally aligned
+// to its size. A span whose blocks are all back in the central list is
+// returned to the OS, except one per class kept against thrashing, which
+// heap_trim() releases too. Large requests get spans of their own. The spin
+// locks of the classes are never held across mmap or munmap.
+//
+// heap_allocate/heap_deallocate can be called directly. To route every new and
+// delete of the program through them, define TOY_GLOBAL_NEW_IMPLEMENTATION in
+// exactly one .cpp file before including this header.
+
+namespace detail
+{
+
+constexpr size_t heap_chunk_shift = 16;
+constexpr size_t heap_chunk_size  = size_t(1) << heap_chunk_shift;	// granularity of the page map
+constexpr size_t heap_max_small   = 32 * 1024;
+constexpr size_t heap_class_count = 45;	// class 0 is a large span
+
+constexpr size_t heap_class_size(size_t index) noexcept
+{
+	if (index <= 16)
+		return index * 16;
+	size_t k = (index - 17) / 4 + 8;	// the class lies in (2^k, 2^(k+1)]
+	size_t j = (index - 17) % 4;
+	return (size_t(1) << k) + (j + 1) * (size_t(1) << (k - 2));
+}
+
+inline size_t heap_class_index(size_t size) noexcept
+{	// 0 < size <= heap_max_small
+	if (size <= 256)
+		return (size + 15) / 16;
+
+	size_t k = 0;
+	for (size_t n = size - 1; n >>= 1;)
+		++k;
+	return 17 + (k - 8) * 4 + ((size - 1 - (size_t(1) << k)) >> (k - 2));
+}
+
+constexpr size_t heap_span_size(size_t index) noexcept
+{	// at least 8 blocks per span
+	size_t size = heap_class_size(index) * 8;
+	return size <= heap_chunk_size ? heap_chunk_size : (size + heap_chunk_size - 1) & ~(heap_chunk_size - 1);
+}
+
+constexpr size_t heap_batch_size(size_t index) noexcept
+{	// blocks moved between a thread cache and the central list at once
+	size_t n = 8192 / heap_class_size(index);
+	return n < 2 ? 2 : (n > 64 ? 64 : n);
+}
+
+class spin_lock
+{
+public:
+	void lock() noexcept
+	{
+		backoff wait;
+		while (flag.exchange(true, std::memory_order_acquire))
+			while (flag.load(std::memory_order_relaxed))
+				wait.pause();
+	}
+
+	void unlock() noexcept { flag.store(false, std::memory_order_release); }
+
+private:
+	std::atomic<bool> flag{ false };
+};
+
+class spin_guard
+{
+public:
+	explicit spin_guard(spin_lock& lock) noexcept : lock(lock) { lock.lock(); }
+	~spin_guard() { lock.unlock(); }
+
+	spin_guard(const spin_guard&) = delete;
+	spin_guard& operator=(const spin_guard&) = delete;
+
+private:
+	spin_lock& lock;
+};
+
+struct heap_node
+{
+	heap_node* next;
+};
+
+struct heap_span
+{
+	char*      start;
+	size_t     size;
+	size_t     index;	// size class, 0 for a large span
+	size_t     carved;	// blocks handed out of the span so far
+	size_t     used;	// blocks outside the central list
+	heap_node* free;
+	heap_span* prev;	// in the central list of the class
+	heap_span* next;
+};
+
+// page map --------------------------------------------------------------------
+
+class heap_page_map
+{
+public:
+	heap_span* find(const void* p) const noexcept
+	{
+		uintptr_t chunk = reinterpret_cast<uintptr_t>(p) >> heap_chunk_shift;
+		if ((chunk >> (2 * leaf_bits)) != 0)
+			return nullptr;
+		leaf* l = root[chunk >> leaf_bits].load(std::memory_order_acquire);
+		return l ? l->spans[chunk & (leaf_size - 1)].load(std::memory_order_acquire) : nullptr;
+	}
+
+	void assign(heap_span* s, heap_span* value)
+	{	// every chunk of the span, value is s or null
+		uintptr_t first = reinterpret_cast<uintptr_t>(s->start) >> heap_chunk_shift;
+		uintptr_t last  = first + (s->size >> heap_chunk_shift);
+		for (uintptr_t chunk = first; chunk < last; ++chunk)
+		{
+			if ((chunk >> (2 * leaf_bits)) != 0)
+				throw std::bad_alloc();
+			leaf_of(chunk).spans[chunk & (leaf_size - 1)].store(value, std::memory_order_release);
+		}
+	}
+
+private:
+	// 2 * 16 bits of chunk index and 16 bits of offset cover a 48 bit space
+	static constexpr size_t leaf_bits = sizeof(void*) == 8 ? 16 : 8;
+	static constexpr size_t leaf_size = size_t(1) << leaf_bits;
+
+	struct leaf
+	{
+		std::atomic<heap_span*> spans[leaf_size];
+	};
+
+	leaf& leaf_of(uintptr_t chunk)
+	{
+		std::atomic<leaf*>& slot = root[chunk >> leaf_bits];
+		leaf* l = slot.load(std::memory_order_acquire);
+		if (l)
+			return *l;
+
+		// zeroed pages are a leaf of null pointers
+		size_t size = (sizeof(leaf) + os_page_size() - 1) & ~(os_page_size() - 1);
+		leaf* fresh = static_cast<leaf*>(os_allocate_pages(size, os_page_size()));
+		if (slot.compare_exchange_strong(l, fresh, std::memory_order_acq_rel))
+			return *fresh;
+		os_release_pages(fresh, size);
+		return *l;
+	}
+
+private:
+	std::atomic<leaf*> root[leaf_size]{};
+};
+
+// heap ------------------------------------------------------------------------
+
+class heap
+{
+public:
+	struct central_list
+	{
+		spin_lock  lock;
+		heap_span* spans{ nullptr };	// spans with free blocks, the empty ones last
+		size_t     empty{ 0 };			// spans with every block free
+	};
+
+public:
+	void* allocate_large(size_t size, size_t alignment)
+	{
+		size = (size + heap_chunk_size - 1) & ~(heap_chunk_size - 1);
+		if (size == 0)
+			throw std::bad_alloc();	// overflow
+
+		heap_span* s = new_span(0, size, alignment > heap_chunk_size ? alignment : heap_chunk_size);
+		s->used = 1;
+		return s->start;
+	}
+
+	void deallocate_large(heap_span* s) noexcept
+	{
+		release_span(s);
+	}
+
+	heap_node* take(size_t index, size_t count, size_t& taken)
+	{	// between one and count blocks of the class from the central list
+		central_list& c = central[index];
+		heap_node* head = nullptr;
+		taken = 0;
+
+		c.lock.lock();
+		while (taken < count)
+		{
+			heap_span* s = c.spans;
+			if (!s)
+			{
+				if (taken > 0)
+					break;	// a short batch rather than a new span
+
+				// the pages are mapped without the lock, the other threads keep
+				// taking and giving blocks of the class during the system call
+				c.lock.unlock();
+				s = new_span(index, heap_span_size(index), heap_chunk_size);
+				c.lock.lock();
+				link_front(c, s);
+			}
+			if (s->used == 0 && s->carved > 0)
+				--c.empty;	// an empty span back in use
+
+			size_t capacity = s->size / heap_class_size(index);
+			while (taken < count && (s->free || s->carved < capacity))
+			{
+				heap_node* n = s->free;
+				if (n)
+					s->free = n->next;
+				else
+					n = reinterpret_cast<heap_node*>(s->start + s->carved++ * heap_class_size(index));
+
+				n->next = head;
+				head = n;
+				++s->used;
+				++taken;
+			}
+
+			if (!s->free && s->carved == capacity)
+				unlink(c, s);
+		}
+		c.lock.unlock();
+		return head;
+	}
+
+	void give(size_t index, heap_node* head) noexcept
+	{	// a list of blocks of the class back to the central list
+		central_list& c = central[index];
+		heap_span* released = nullptr;	// unmapped once the lock is dropped
+
+		c.lock.lock();
+		size_t capacity = heap_span_size(index) / heap_class_size(index);
+		while (head)
+		{
+			heap_node* n = head;
+			head = head->next;
+
+			heap_span* s = page_map.find(n);
+			bool full = !s->free && s->carved == capacity;
+			n->next = s->free;
+			s->free = n;
+
+			if (full)
+				link_front(c, s);
+			if (--s->used == 0)
+			{
+				if (c.empty > 0)
+				{	// keep a single empty span per class
+					unlink(c, s);
+					s->next = released;
+					released = s;
+				}
+				else
+				{
+					unlink(c, s);
+					link_back(c, s);
+					++c.empty;
+				}
+			}
+		}
+		c.lock.unlock();
+		release_spans(released);
+	}
+
+	size_t trim() noexcept
+	{	// return the empty spans kept by the classes, return the bytes released
+		size_t released = 0;
+		for (size_t index = 1; index < heap_class_count; ++index)
+		{
+			central_list& c = central[index];
+			heap_span* empty = nullptr;
+			{
+				spin_guard guard(c.lock);
+				for (heap_span* s = c.spans; s && c.empty > 0;)
+				{
+					heap_span* next = s->next;
+					if (s->used == 0)
+					{
+						unlink(c, s);
+						released += s->size;
+						s->next = empty;
+						empty = s;
+						--c.empty;
+					}
+					s = next;
+				}
+			}
+			release_spans(empty);
+		}
+		return released;
+	}
+
+	heap_span* find(const void* p) const noexcept { return page_map.find(p); }
+
+	size_t mapped_bytes() const noexcept { return mapped.load(std::memory_order_relaxed); }
+
+private:
+	static void link_front(central_list& c, heap_span* s) noexcept
+	{
+		s->prev = nullptr;
+		s->next = c.spans;
+		if (c.spans)
+			c.spans->prev = s;
+		c.spans = s;
+	}
+
+	static void link_back(central_list& c, heap_span* s) noexcept
+	{
+		heap_span* last = c.spans;
+		while (last && last->next)
+			last = last->next;
+
+		s->next = nullptr;
+		s->prev = last;
+		if (last)
+			last->next = s;
+		else
+			c.spans = s;
+	}
+
+	static void unlink(central_list& c, heap_span* s) noexcept
+	{
+		if (s->prev)
+			s->prev->next = s->next;
+		else if (c.spans == s)
+			c.spans = s->next;
+		if (s->next)
+			s->next->prev = s->prev;
+		s->prev = s->next = nullptr;
+	}
+
+	heap_span* new_span(size_t index, size_t size, size_t alignment)
+	{
+		heap_span* s = new_header();
+		try
+		{
+			s->start = static_cast<char*>(os_allocate_pages(size, alignment));
+		}
+		catch (...)
+		{
+			delete_header(s);
+			throw;
+		}
+		s->size   = size;
+		s->index  = index;
+		s->carved = 0;
+		s->used   = 0;
+		s->free   = nullptr;
+		s->prev   = s->next = nullptr;
+
+		try
+		{
+			page_map.assign(s, s);
+		}
+		catch (...)
+		{
+			os_release_pages(s->start, size);
+			delete_header(s);
+			throw;
+		}
+		mapped.fetch_add(size, std::memory_order_relaxed);
+		return s;
+	}
+
+	void release_span(heap_span* s) noexcept
+	{
+		page_map.assign(s, nullptr);	// the leaves exist, cannot throw
+		os_release_pages(s->start, s->size);
+		mapped.fetch_sub(s->size, std::memory_order_relaxed);
+		delete_header(s);
+	}
+
+	void release_spans(heap_span* s) noexcept
+	{	// a list linked through next
+		while (s)
+		{
+			heap_span* next = s->next;
+			release_span(s);
+			s = next;
+		}
+	}
+
+	heap_span* new_header()
+	{	// span headers are carved out of their own pages and recycled
+		{
+			spin_guard guard(header_lock);
+			if (heap_span* s = free_headers)
+			{
+				free_headers = s->next;
+				return s;
+			}
+		}
+
+		// more pages, mapped without the lock
+		size_t size = os_page_size() * 16;
+		char* p = static_cast<char*>(os_allocate_pages(size, os_page_size()));
+
+		spin_guard guard(header_lock);
+		for (size_t i = size / sizeof(heap_span); i-- > 1;)
+		{
+			heap_span* s = reinterpret_cast<heap_span*>(p + i * sizeof(heap_span));
+			s->next = free_headers;
+			free_headers = s;
+		}
+		return reinterpret_cast<heap_span*>(p);
+	}
+
+	void delete_header(heap_span* s) noexcept
+	{
+		spin_guard guard(header_lock);
+		s->next = free_headers;
+		free_headers = s;
+	}
+
+private:
+	heap_page_map page_map;
+	central_list  central[heap_class_count];
+
+	spin_lock  header_lock;
+	heap_span* free_headers{ nullptr };
+
+	std::atomic<size_t> mapped{ 0 };
+};
+
+// constant initialized, usable by operator new before any constructor runs
+inline heap global_heap;
+
+// thread cache ----------------------------------------------------------------
+
+struct heap_thread_cache
+{
+	struct list
+	{
+		heap_node* head;
+		size_t     count;
+	};
+
+	list lists[heap_class_count];
+	int  state;	// 0 before the first use, 1 alive, 2 destroyed
+
+	void flush(size_t index, size_t count) noexcept
+	{	// the first count blocks of the list back to the central list
+		list& l = lists[index];
+		heap_node* head = l.head;
+		heap_node* tail = head;
+		for (size_t i = 1; i < count; ++i)
+			tail = tail->next;
+
+		l.head = tail->next;
+		l.count -= count;
+		tail->next = nullptr;
+		global_heap.give(index, head);
+	}
+
+	void flush_all() noexcept
+	{
+		for (size_t index = 1; index < heap_class_count; ++index)
+			if (lists[index].count)
+				flush(index, lists[index].count);
+	}
+};
+
+// trivial, so no guard and no destructor on the fast path
+inline thread_local heap_thread_cache thread_cache;
+
+struct heap_thread_exit
+{
+	~heap_thread_exit()
+	{	// later frees of the thread go straight to the central lists
+		thread_cache.flush_all();
+		thread_cache.state = 2;
+	}
+};
+
+inline heap_thread_cache* local_heap_cache() noexcept
+{
+	heap_thread_cache* cache = &thread_cache;
+	if (cache->state == 1)
+		return cache;
+	if (cache->state == 2)
+		return nullptr;
+
+	cache->state = 1;
+	static thread_local heap_thread_exit on_exit;	// registers the flush at thread exit
+	(void)on_exit;
+	return cache;
+}
+
+inline void* heap_allocate_small(size_t index)
+{
+	heap_thread_cache* cache = local_heap_cache();
+	if (!cache)
+	{
+		size_t taken;
+		return global_heap.take(index, 1, taken);
+	}
+
+	heap_thread_cache::list& l = cache->lists[index];
+	heap_node* n = l.head;
+	if (!n)
+	{
+		n = global_heap.take(index, heap_batch_size(index), l.count);
+		l.head = n;
+	}
+	l.head = n->next;
+	--l.count;
+	return n;
+}
+
+inline void heap_deallocate_small(void* p, size_t index) noexcept
+{
+	heap_thread_cache* cache = local_heap_cache();
+	if (!cache)
+	{
+		global_heap.give(index, ::new (p) heap_node{ nullptr });
+		return;
+	}
+
+	heap_thread_cache::list& l = cache->lists[index];
+	l.head = ::new (p) heap_node{ l.head };
+	if (++l.count >= 2 * heap_batch_size(index))
+		cache->flush(index, heap_batch_size(index));
+}
+
+}	// namespace detail
+
+// throw bad_alloc when out of memory, alignment is a power of two
+inline void* heap_allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+{
+	if (alignment > 16)
+	{	// a power-of-two class is aligned to its size
+		size_t n = size > alignment ? size : alignment;
+		size = 16;
+		while (size < n && size != 0)
+			size *= 2;
+		if (size == 0)
+			throw std::bad_alloc();
+	}
+
+	if (size <= detail::heap_max_small && alignment <= detail::heap_chunk_size)
+		return detail::heap_allocate_small(detail::heap_class_index(size ? size : 1));
+	return detail::global_heap.allocate_large(size, alignment);
+}
+
+inline void heap_deallocate(void* p) noexcept
+{	// p is null or comes from heap_allocate
+	if (!p)
+		return;
+
+	detail::heap_span* s = detail::global_heap.find(p);
+	if (!s)
+		return;	// not from this heap, a foreign pointer is left alone rather than followed
+	if (s->index)
+		detail::heap_deallocate_small(p, s->index);
+	else
+		detail::global_heap.deallocate_large(s);
+}
+
+inline size_t heap_usable_size(const void* p) noexcept
+{
+	detail::heap_span* s = detail::global_heap.find(p);
+	if (!s)
+		return 0;
+	if (s->index)
+		return detail::heap_class_size(s->index);
+	return s->size - (static_cast<const char*>(p) - s->start);
+}
+
+inline void heap_flush_thread_cache() noexcept
+{	// give the blocks cached by the calling thread back to the central lists
+	if (detail::heap_thread_cache* cache = detail::local_heap_cache())
+		cache->flush_all();
+}
+
+inline size_t heap_trim() noexcept
+{	// return the empty spans to the OS, return the bytes released
+	return detail::global_heap.trim();
+}
+
+inline size_t heap_mapped_bytes() noexcept
+{	// bytes taken from the OS and not returned yet, span headers excluded
+	return detail::global_heap.mapped_bytes();
+}
+
+namespace detail
+{
+
+// the global operators, with a header for the allocation stats when they are on
+
+inline void* global_allocate(size_t size, size_t alignment)
+{
+#if TOY_ALLOC_STATS
+	if (alloc_tracking())
+	{
+		size_t header = alignment > sizeof(alloc_header) ? alignment : sizeof(alloc_header);
+		if (size + header < size)
+			throw std::bad_alloc();
+		return alloc_track(heap_allocate(size + header, alignment), size, header);
+	}
+#endif
+	return heap_allocate(size, alignment);
+}
+
+inline void* global_new(size_t size, size_t alignment)
+{	// like the standard operator new, the new handler gets to free memory before bad_alloc goes out
+	for (;;)
+	{
+		try
+		{
+			return global_allocate(size, alignment);
+		}
+		catch (const std::bad_alloc&)
+		{
+			std::new_handler handler = std::get_new_handler();
+			if (!handler)
+				throw;
+			handler();
+		}
+	}
+}
+
+inline void global_delete(void* p) noexcept
+{
+#if TOY_ALLOC_STATS
+	if (p && alloc_tracking())
+		p = alloc_untrack(p);
+#endif
+	heap_deallocate(p);
+}
+
+}	// namespace detail
+
+}	// namespace toy
+
+// global operator new & delete ------------------------------------------------
+
+#if defined(TOY_GLOBAL_NEW_IMPLEMENTATION)
+
+void* operator new(size_t size) { return toy::detail::global_new(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size) { return toy::detail::global_new(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t alignment) { return toy::detail::global_new(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return toy::detail::global_new(size, static_cast<size_t>(alignment)); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	try { return toy::detail::global_new(size, alignof(std::max_align_t)); } catch (...) { return nullptr; }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	try { return toy::detail::global_new(size, alignof(std::max_align_t)); } catch (...) { return nullptr; }
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try { return toy::detail::global_new(size, static_cast<size_t>(alignment)); } catch (...) { return nullptr; }
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try { return toy::detail::global_new(size, static_cast<size_t>(alignment)); } catch (...) { return nullptr; }
+}
 
+// the span knows the size class, the size and alignment arguments are not needed
+void operator delete(void* p) noexcept { toy::detail::global_delete(p); }
+void operator delete[](void* p) noexcept { toy::detail::global_delete(p); }
+void operator delete(void* p, size_t) noexcept { toy::detail::global_delete(p); }
+void operator delete[](void* p, size_t) noexcept { toy::detail::global_delete(p); }
+void operator delete(void* p, std::align_val_t) noexcept { toy::detail::global_delete(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { toy::detail::global_delete(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { toy::detail::global_delete(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { toy::detail::global_delete(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { toy::detail::global_delete(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { toy::detail::global_delete(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { toy::detail::global_delete(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { toy::detail::global_delete(p); }
 
-}	// namespace toy	
+#endif	// TOY_GLOBAL_NEW_IMPLEMENTATION
 
 #endif	// TOY_CORE_NEW_H
@@ -0,0 +1,359 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_PRIORITY_QUEUE_H
+#define TOY_CORE_PRIORITY_QUEUE_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+#include "toy/algorithm/heap.h"
+#include "toy/core/type_traits.h"
+#include "toy/core/utility.h"
+#include "toy/core/vector.h"
+
+namespace toy
+{
+
+// priority_queue --------------------------------------------------------------
+
+// std::priority_queue on a d-ary heap, 4 children per node by default. As
+// with std, Compare is a "less" and top() is the largest element, use
+// std::greater for a min queue. Building from a range, and push_range with
+// many elements, heapify in O(n) instead of sifting one element at a time.
+template<class T, class Compare = std::less<T>, size_t Arity = 4, class Container = vector<T>>
+class priority_queue
+{
+public:
+	using container_type  = Container;
+	using value_compare   = Compare;
+	using value_type      = typename Container::value_type;
+	using size_type       = typename Container::size_type;
+	using reference       = typename Container::reference;
+	using const_reference = typename Container::const_reference;
+
+	static constexpr size_t arity = Arity;
+
+	priority_queue() = default;
+
+	explicit priority_queue(const Compare& comp)
+		: comp(comp)
+	{
+	}
+
+	template<class InputIt>
+	priority_queue(InputIt first, InputIt last, const Compare& comp = Compare())
+		: c(first, last), comp(comp)
+	{
+		make_dary_heap<Arity>(c.begin(), c.end(), this->comp);
+	}
+
+	priority_queue(const Compare& comp, Container&& cont)
+		: c(toy::move(cont)), comp(comp)
+	{
+		make_dary_heap<Arity>(c.begin(), c.end(), this->comp);
+	}
+
+	bool            empty() const noexcept { return c.empty(); }
+	size_type       size() const noexcept  { return c.size(); }
+	const_reference top() const noexcept   { return c.front(); }
+
+	void reserve(size_type n) { c.reserve(n); }
+
+	void push(const value_type& value)
+	{
+		c.push_back(value);
+		push_dary_heap<Arity>(c.begin(), c.end(), comp);
+	}
+
+	void push(value_type&& value)
+	{
+		c.push_back(toy::move(value));
+		push_dary_heap<Arity>(c.begin(), c.end(), comp);
+	}
+
+	template<class... Args>
+	void emplace(Args&&... args)
+	{
+		c.emplace_back(toy::forward<Args>(args)...);
+		push_dary_heap<Arity>(c.begin(), c.end(), comp);
+	}
+
+	template<class InputIt>
+	void push_range(InputIt first, InputIt last)
+	{	// sift the new elements up one by one, or heapify everything when that is cheaper
+		size_type old = c.size();
+		for (; first != last; ++first)
+			c.push_back(*first);
+		size_type added = c.size() - old;
+
+		size_type depth = 1;
+		for (size_type n = c.size(); n > Arity; n /= Arity)
+			++depth;
+		if (added * depth > c.size())
+		{
+			make_dary_heap<Arity>(c.begin(), c.end(), comp);
+		}
+		else
+		{
+			for (size_type i = old + 1; i <= c.size(); ++i)
+				push_dary_heap<Arity>(c.begin(), c.begin() + i, comp);
+		}
+	}
+
+	void pop()
+	{
+		pop_dary_heap<Arity>(c.begin(), c.end(), comp);
+		c.pop_back();
+	}
+
+	value_type take_top()
+	{	// pop, and return the element instead of destroying it
+		pop_dary_heap<Arity>(c.begin(), c.end(), comp);
+		value_type result = toy::move(c.back());
+		c.pop_back();
+		return result;
+	}
+
+	void clear() noexcept { c.clear(); }
+
+	void swap(priority_queue& right) noexcept
+	{
+		using std::swap;
+		swap(c, right.c);
+		swap(comp, right.comp);
+	}
+
+	// the heap, top first
+	const container_type& container() const noexcept { return c; }
+
+private:
+	Container c;
+	Compare   comp;
+};
+
+template<class T, class C, size_t A, class S>
+inline void swap(priority_queue<T, C, A, S>& a, priority_queue<T, C, A, S>& b) noexcept
+{
+	a.swap(b);
+}
+
+// indexed_priority_queue ------------------------------------------------------
+
+// A d-ary heap whose elements are reached by a handle as well as from the
+// top, so a value can be changed or erased in place in O(log n) instead of
+// pushed again and skipped when stale (lazy deletion). The handle of an
+// element is returned by push and stays valid until it is popped or erased,
+// then it may be handed out again.
+//
+//	indexed_priority_queue<double, std::greater<double>> open;	// min queue
+//	handle[v] = open.push(distance[v]);
+//	...
+//	open.decrease_key(handle[v], shorter);
+template<class T, class Compare = std::less<T>, size_t Arity = 4>
+class indexed_priority_queue
+{
+public:
+	using value_type    = T;
+	using value_compare = Compare;
+	using size_type     = size_t;
+	using handle_type   = size_t;
+
+	static constexpr size_t    arity = Arity;
+	static constexpr size_type npos  = ~size_type(0);
+
+	indexed_priority_queue() = default;
+
+	explicit indexed_priority_queue(const Compare& comp)
+		: comp(comp)
+	{
+	}
+
+	bool      empty() const noexcept { return heap.empty(); }
+	size_type size() const noexcept  { return heap.size(); }
+
+	const T&    top() const noexcept        { return heap.front().value; }
+	handle_type top_handle() const noexcept { return heap.front().handle; }
+
+	bool contains(handle_type h) const noexcept
+	{
+		return h < position.size() && position[h] != npos;
+	}
+
+	// the value of a live handle
+	const T& operator[](handle_type h) const noexcept { return heap[position[h]].value; }
+
+	const T& at(handle_type h) const
+	{
+		check(h, "indexed_priority_queue::at -- invalid handle");
+		return (*this)[h];
+	}
+
+	void reserve(size_type n)
+	{
+		heap.reserve(n);
+		position.reserve(n);
+	}
+
+	template<class... Args>
+	handle_type emplace(Args&&... args)
+	{
+		handle_type h;
+		if (!free_handles.empty())
+		{
+			h = free_handles.back();
+			free_handles.pop_back();
+		}
+		else
+		{
+			h = position.size();
+			position.push_back(npos);
+		}
+
+		try
+		{
+			heap.emplace_back(node{ T(toy::forward<Args>(args)...), h });
+		}
+		catch (...)
+		{
+			free_handles.push_back(h);
+			throw;
+		}
+		node value = toy::move(heap.back());
+		sift_up(heap.size() - 1, toy::move(value));
+		return h;
+	}
+
+	handle_type push(const T& value) { return emplace(value); }
+	handle_type push(T&& value)      { return emplace(toy::move(value)); }
+
+	void pop()
+	{
+		release(heap.front().handle);
+		remove_at(0);
+	}
+
+	void erase(handle_type h)
+	{
+		check(h, "indexed_priority_queue::erase -- invalid handle");
+		size_type pos = position[h];
+		release(h);
+		remove_at(pos);
+	}
+
+	void update(handle_type h, T value)
+	{	// a new value, the element moves up or down as needed
+		check(h, "indexed_priority_queue::update -- invalid handle");
+		size_type pos = position[h];
+		node moved{ toy::move(value), h };
+		if (pos > 0 && node_compare{ comp }(heap[(pos - 1) / Arity], moved))
+			sift_up(pos, toy::move(moved));
+		else
+			sift_down(pos, toy::move(moved));
+	}
+
+	void decrease_key(handle_type h, T value)
+	{	// a value that is not lower in priority: not greater for a min queue,
+		// not less for a max queue, so the element only moves up
+		check(h, "indexed_priority_queue::decrease_key -- invalid handle");
+		sift_up(position[h], node{ toy::move(value), h });
+	}
+
+	void clear() noexcept
+	{
+		heap.clear();
+		position.clear();
+		free_handles.clear();
+	}
+
+	void swap(indexed_priority_queue& right) noexcept
+	{
+		using std::swap;
+		heap.swap(right.heap);
+		position.swap(right.position);
+		free_handles.swap(right.free_handles);
+		swap(comp, right.comp);
+	}
+
+private:
+	struct node
+	{
+		T           value;
+		handle_type handle;
+	};
+
+	struct node_compare
+	{
+		Compare& comp;
+
+		bool operator()(const node& a, const node& b) const { return comp(a.value, b.value); }
+	};
+
+	struct node_notify
+	{
+		indexed_priority_queue* owner;
+
+		void operator()(node* it) const noexcept
+		{
+			owner->position[it->handle] = static_cast<size_type>(it - owner->heap.data());
+		}
+	};
+
+	void check(handle_type h, const char* message) const
+	{
+		if (!contains(h))
+			throw std::out_of_range(message);
+	}
+
+	void release(handle_type h)
+	{
+		free_handles.push_back(h);
+		position[h] = npos;
+	}
+
+	void remove_at(size_type pos)
+	{	// the last node fills the hole at pos
+		node last = toy::move(heap.back());
+		heap.pop_back();
+		if (pos == heap.size())
+			return;
+		if (pos > 0 && node_compare{ comp }(heap[(pos - 1) / Arity], last))
+			sift_up(pos, toy::move(last));
+		else
+			sift_down(pos, toy::move(last));
+	}
+
+	void sift_up(size_type pos, node&& value)
+	{
+		node_compare compare{ comp };
+		node_notify notify{ this };
+		detail::dary_sift_up<Arity>(heap.data(), static_cast<ptrdiff_t>(pos), toy::move(value), compare, notify);
+	}
+
+	void sift_down(size_type pos, node&& value)
+	{
+		node_compare compare{ comp };
+		node_notify notify{ this };
+		detail::dary_sift_down<Arity>(heap.data(), static_cast<ptrdiff_t>(heap.size()),
+			static_cast<ptrdiff_t>(pos), toy::move(value), compare, notify);
+	}
+
+private:
+	vector<node>        heap;
+	vector<size_type>   position;		// of each handle in heap, npos when free
+	vector<handle_type> free_handles;
+	Compare             comp;
+};
+
+template<class T, class C, size_t A>
+inline void swap(indexed_priority_queue<T, C, A>& a, indexed_priority_queue<T, C, A>& b) noexcept
+{
+	a.swap(b);
+}
+
+}	// namespace toy
+
+#endif // TOY_CORE_PRIORITY_QUEUE_H
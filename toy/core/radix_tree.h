@@ -0,0 +1,1130 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_RADIX_TREE_H
+#define TOY_CORE_RADIX_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TOY_ART_SSE2 1
+#include <emmintrin.h>
+#else
+#define TOY_ART_SSE2 0
+#endif
+
+#include "toy/core/list.h"
+#include "toy/core/memory.h"
+#include "toy/core/type_traits.h"
+#include "toy/core/utility.h"
+#include "toy/core/vector.h"
+#include "toy/utility/byte.h"
+
+namespace toy
+{
+
+// adaptive radix tree -----------------------------------------------------------
+// Leis et al., "The Adaptive Radix Tree: ARTful Indexing for Main-Memory
+// Databases". A trie over the bytes of the key whose inner nodes grow from 4
+// to 16, 48 and 256 children as they fill, so a sparse level costs a few
+// bytes and a dense one is a direct index. A chain of nodes with one child
+// each is collapsed into a prefix of the node below (path compression), the
+// first 8 bytes of it are kept in the node, the rest is checked against a
+// leaf. A lookup costs one node per distinct byte of the key, independent
+// of the number of keys and without a full key compare per level.
+
+namespace detail
+{
+
+struct art_key
+{	// the bytes of a key, compared as unsigned
+	const uint8_t* data;
+	size_t         size;
+};
+
+using art_ref = uintptr_t;		// a node, or a leaf with the low bit set, 0 for none
+
+enum class art_kind : uint8_t { node4, node16, node48, node256 };
+
+constexpr uint32_t art_max_prefix = 8;
+
+struct art_node
+{
+	art_kind kind;
+	uint16_t count{ 0 };			// children, the terminal leaf is not one
+	uint32_t prefix_len{ 0 };		// may be longer than the stored bytes
+	uint8_t  prefix[art_max_prefix];
+	art_ref  terminal{ 0 };			// the leaf whose key ends at this node
+
+	explicit art_node(art_kind kind) noexcept : kind(kind) {}
+};
+
+struct art_node4 : art_node
+{
+	art_node4() noexcept : art_node(art_kind::node4) {}
+	uint8_t keys[4];				// sorted
+	art_ref children[4];
+};
+
+struct art_node16 : art_node
+{
+	art_node16() noexcept : art_node(art_kind::node16) {}
+	uint8_t keys[16];				// sorted
+	art_ref children[16];
+};
+
+struct art_node48 : art_node
+{
+	art_node48() noexcept : art_node(art_kind::node48) {}
+	uint8_t index[256] = {};		// slot + 1 of each byte, 0 for none
+	art_ref children[48] = {};
+};
+
+struct art_node256 : art_node
+{
+	art_node256() noexcept : art_node(art_kind::node256) {}
+	art_ref children[256] = {};
+};
+
+inline bool     art_is_leaf(art_ref r) noexcept { return (r & 1) != 0; }
+inline art_node* art_as_node(art_ref r) noexcept { return reinterpret_cast<art_node*>(r); }
+
+inline int art_find16(const uint8_t* keys, unsigned count, uint8_t b) noexcept
+{	// the index of b among the keys of a node16, -1 if absent
+#if TOY_ART_SSE2
+	__m128i eq = _mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(b)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys)));
+	unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(eq)) & ((1u << count) - 1);
+	return mask ? static_cast<int>(countr_zero(mask)) : -1;
+#else
+	for (unsigned i = 0; i < count; ++i)
+		if (keys[i] == b)
+			return static_cast<int>(i);
+	return -1;
+#endif
+}
+
+inline unsigned art_less16(const uint8_t* keys, unsigned count, uint8_t b) noexcept
+{	// the number of keys of a node16 below b, unsigned bytes compared as signed with the top bit flipped
+#if TOY_ART_SSE2
+	__m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+	__m128i lt = _mm_cmplt_epi8(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys)), flip),
+		_mm_xor_si128(_mm_set1_epi8(static_cast<char>(b)), flip));
+	return popcount(static_cast<unsigned>(_mm_movemask_epi8(lt)) & ((1u << count) - 1));
+#else
+	unsigned n = 0;
+	while (n < count && keys[n] < b)
+		++n;
+	return n;
+#endif
+}
+
+inline art_ref* art_find_child(art_node* n, uint8_t b) noexcept
+{
+	switch (n->kind)
+	{
+	case art_kind::node4:
+	{
+		art_node4* p = static_cast<art_node4*>(n);
+		for (unsigned i = 0; i < p->count; ++i)
+			if (p->keys[i] == b)
+				return &p->children[i];
+		return nullptr;
+	}
+	case art_kind::node16:
+	{
+		art_node16* p = static_cast<art_node16*>(n);
+		int i = art_find16(p->keys, p->count, b);
+		return i < 0 ? nullptr : &p->children[i];
+	}
+	case art_kind::node48:
+	{
+		art_node48* p = static_cast<art_node48*>(n);
+		return p->index[b] ? &p->children[p->index[b] - 1] : nullptr;
+	}
+	default:
+	{
+		art_node256* p = static_cast<art_node256*>(n);
+		return p->children[b] ? &p->children[b] : nullptr;
+	}
+	}
+}
+
+// the child of the smallest byte above 'after', -1 for the first child, 0 if none
+inline art_ref art_next_child(const art_node* n, int after, uint8_t* byte = nullptr) noexcept
+{
+	switch (n->kind)
+	{
+	case art_kind::node4:
+	{
+		const art_node4* p = static_cast<const art_node4*>(n);
+		for (unsigned i = 0; i < p->count; ++i)
+		{
+			if (int(p->keys[i]) > after)
+			{
+				if (byte)
+					*byte = p->keys[i];
+				return p->children[i];
+			}
+		}
+		return 0;
+	}
+	case art_kind::node16:
+	{
+		const art_node16* p = static_cast<const art_node16*>(n);
+		unsigned i = after < 0 ? 0 : art_less16(p->keys, p->count, static_cast<uint8_t>(after));
+		if (i < p->count && int(p->keys[i]) == after)
+			++i;
+		if (i == p->count)
+			return 0;
+		if (byte)
+			*byte = p->keys[i];
+		return p->children[i];
+	}
+	case art_kind::node48:
+	{
+		const art_node48* p = static_cast<const art_node48*>(n);
+		for (int b = after + 1; b < 256; ++b)
+		{
+			if (p->index[b])
+			{
+				if (byte)
+					*byte = static_cast<uint8_t>(b);
+				return p->children[p->index[b] - 1];
+			}
+		}
+		return 0;
+	}
+	default:
+	{
+		const art_node256* p = static_cast<const art_node256*>(n);
+		for (int b = after + 1; b < 256; ++b)
+		{
+			if (p->children[b])
+			{
+				if (byte)
+					*byte = static_cast<uint8_t>(b);
+				return p->children[b];
+			}
+		}
+		return 0;
+	}
+	}
+}
+
+inline void art_remove_child(art_node* n, uint8_t b) noexcept
+{
+	switch (n->kind)
+	{
+	case art_kind::node4:
+	{
+		art_node4* p = static_cast<art_node4*>(n);
+		unsigned i = 0;
+		while (p->keys[i] != b)
+			++i;
+		for (; i + 1 < p->count; ++i)
+		{
+			p->keys[i] = p->keys[i + 1];
+			p->children[i] = p->children[i + 1];
+		}
+		break;
+	}
+	case art_kind::node16:
+	{
+		art_node16* p = static_cast<art_node16*>(n);
+		unsigned i = static_cast<unsigned>(art_find16(p->keys, p->count, b));
+		std::memmove(p->keys + i, p->keys + i + 1, p->count - i - 1);
+		std::memmove(p->children + i, p->children + i + 1, (p->count - i - 1) * sizeof(art_ref));
+		break;
+	}
+	case art_kind::node48:
+	{
+		art_node48* p = static_cast<art_node48*>(n);
+		p->children[p->index[b] - 1] = 0;
+		p->index[b] = 0;
+		break;
+	}
+	default:
+		static_cast<art_node256*>(n)->children[b] = 0;
+		break;
+	}
+	--n->count;
+}
+
+// add a child to a node that has room for it
+inline void art_insert_child(art_node* n, uint8_t b, art_ref child) noexcept
+{
+	switch (n->kind)
+	{
+	case art_kind::node4:
+	{
+		art_node4* p = static_cast<art_node4*>(n);
+		unsigned i = p->count;
+		for (; i > 0 && p->keys[i - 1] > b; --i)
+		{
+			p->keys[i] = p->keys[i - 1];
+			p->children[i] = p->children[i - 1];
+		}
+		p->keys[i] = b;
+		p->children[i] = child;
+		break;
+	}
+	case art_kind::node16:
+	{
+		art_node16* p = static_cast<art_node16*>(n);
+		unsigned i = art_less16(p->keys, p->count, b);
+		std::memmove(p->keys + i + 1, p->keys + i, p->count - i);
+		std::memmove(p->children + i + 1, p->children + i, (p->count - i) * sizeof(art_ref));
+		p->keys[i] = b;
+		p->children[i] = child;
+		break;
+	}
+	case art_kind::node48:
+	{
+		art_node48* p = static_cast<art_node48*>(n);
+		unsigned slot = 0;
+		while (p->children[slot])
+			++slot;
+		p->children[slot] = child;
+		p->index[b] = static_cast<uint8_t>(slot + 1);
+		break;
+	}
+	default:
+		static_cast<art_node256*>(n)->children[b] = child;
+		break;
+	}
+	++n->count;
+}
+
+inline unsigned art_capacity(art_kind kind) noexcept
+{
+	switch (kind)
+	{
+	case art_kind::node4:  return 4;
+	case art_kind::node16: return 16;
+	case art_kind::node48: return 48;
+	default:               return 256;
+	}
+}
+
+// move the header and the children of 'from' into the empty node 'to'
+inline void art_copy_node(art_node* to, const art_node* from) noexcept
+{
+	to->prefix_len = from->prefix_len;
+	std::memcpy(to->prefix, from->prefix, art_max_prefix);
+	to->terminal = from->terminal;
+	uint8_t b = 0;
+	for (art_ref child = art_next_child(from, -1, &b); child; child = art_next_child(from, b, &b))
+		art_insert_child(to, b, child);
+}
+
+}	// namespace detail
+
+// radix_key_traits ------------------------------------------------------------
+// the bytes of a key, in an order that sorts as the keys do. Strings are their
+// own bytes (contiguous, char sized elements: std::string, toy::string,
+// string_view), integers are written big endian with the sign bit flipped
+
+template<class Key, class = void>
+struct radix_key_traits
+{
+	static constexpr size_t buffer_size = 1;
+
+	static detail::art_key encode(const Key& key, uint8_t*) noexcept
+	{
+		static_assert(sizeof(*key.data()) == 1, "radix_tree keys are byte strings or integers");
+		return detail::art_key{ reinterpret_cast<const uint8_t*>(key.data()), static_cast<size_t>(key.size()) };
+	}
+};
+
+template<class Key>
+struct radix_key_traits<Key, enable_if_t<std::is_integral<Key>::value>>
+{
+	static constexpr size_t buffer_size = sizeof(Key);
+
+	static detail::art_key encode(const Key& key, uint8_t* buffer) noexcept
+	{
+		using U = std::make_unsigned_t<Key>;
+		U u = static_cast<U>(key);
+		if (std::is_signed<Key>::value)
+			u ^= static_cast<U>(U(1) << (sizeof(U) * 8 - 1));
+		for (size_t i = sizeof(U); i-- > 0;)
+		{
+			buffer[i] = static_cast<uint8_t>(u);
+			u = static_cast<U>(u >> 4 >> 4);
+		}
+		return detail::art_key{ buffer, sizeof(U) };
+	}
+};
+
+// radix_tree ------------------------------------------------------------------
+// An ordered map on an adaptive radix tree, with the interface of std::map
+// for what it shares with it. The leaves are linked in key order, so
+// iteration is a list walk and an iterator stays valid until its element is
+// erased. lower_bound, upper_bound and prefix_range find their first leaf in
+// one descent:
+//
+//	radix_tree<std::string, route> routes;
+//	routes["/api/v1/users"] = ...;
+//	for (auto& r : routes.prefix_range("/api/v1/")) ...
+//
+// An insert descends twice, once to find where the key goes in the leaf
+// order and once to link it into the tree.
+
+template<class Key, class T, class Allocator = allocator<pair<const Key, T>>>
+class radix_tree
+{
+public:
+	using key_type        = Key;
+	using mapped_type     = T;
+	using value_type      = pair<const Key, T>;
+	using size_type       = size_t;
+	using difference_type = ptrdiff_t;
+	using allocator_type  = Allocator;
+	using reference       = value_type&;
+	using const_reference = const value_type&;
+
+private:
+	using traits  = radix_key_traits<Key>;
+	using art_key = detail::art_key;
+	using art_ref = detail::art_ref;
+
+	static constexpr size_t key_buffer = traits::buffer_size;
+
+	struct leaf : intrusive_list_hook<>
+	{
+		template<class KeyArg, class... Args>
+		leaf(KeyArg&& key, Args&&... args)
+			: value(toy::forward<KeyArg>(key), T(toy::forward<Args>(args)...))
+		{
+		}
+
+		value_type value;
+	};
+
+	using leaf_list    = intrusive_list<leaf>;
+	using alloc_traits = std::allocator_traits<Allocator>;
+
+public:
+	template<bool Const>
+	class tree_iterator
+	{
+		using base = conditional_t<Const, typename leaf_list::const_iterator, typename leaf_list::iterator>;
+
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type        = radix_tree::value_type;
+		using difference_type   = ptrdiff_t;
+		using pointer           = conditional_t<Const, const value_type*, value_type*>;
+		using reference         = conditional_t<Const, const value_type&, value_type&>;
+
+		tree_iterator() noexcept = default;
+
+		template<bool C = Const, class = enable_if_t<C>>
+		tree_iterator(const tree_iterator<false>& right) noexcept
+			: it(right.it)
+		{
+		}
+
+		reference operator*() const noexcept  { return it->value; }
+		pointer   operator->() const noexcept { return &it->value; }
+
+		tree_iterator& operator++() noexcept { ++it; return *this; }
+		tree_iterator& operator--() noexcept { --it; return *this; }
+		tree_iterator  operator++(int) noexcept { tree_iterator tmp = *this; ++it; return tmp; }
+		tree_iterator  operator--(int) noexcept { tree_iterator tmp = *this; --it; return tmp; }
+
+		friend bool operator==(const tree_iterator& a, const tree_iterator& b) noexcept { return a.it == b.it; }
+		friend bool operator!=(const tree_iterator& a, const tree_iterator& b) noexcept { return a.it != b.it; }
+
+	private:
+		friend class radix_tree;
+		template<bool> friend class tree_iterator;
+
+		explicit tree_iterator(base it) noexcept
+			: it(it)
+		{
+		}
+
+	private:
+		base it;
+	};
+
+	using iterator               = tree_iterator<false>;
+	using const_iterator         = tree_iterator<true>;
+	using reverse_iterator       = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	// a range of elements, for range-for over prefix_range
+	template<class It>
+	struct range
+	{
+		It first;
+		It last;
+
+		It begin() const noexcept { return first; }
+		It end() const noexcept   { return last; }
+		bool empty() const noexcept { return first == last; }
+	};
+
+	// constructors
+
+	radix_tree() = default;
+
+	explicit radix_tree(const Allocator& a)
+		: storage(a)
+	{
+	}
+
+	template<class InputIt>
+	radix_tree(InputIt first, InputIt last, const Allocator& a = Allocator())
+		: storage(a)
+	{
+		insert(first, last);
+	}
+
+	radix_tree(std::initializer_list<value_type> il, const Allocator& a = Allocator())
+		: radix_tree(il.begin(), il.end(), a)
+	{
+	}
+
+	radix_tree(const radix_tree& right)
+		: storage(alloc_traits::select_on_container_copy_construction(right.storage))
+	{
+		for (const value_type& value : right)
+			try_emplace(value.first, value.second);
+	}
+
+	radix_tree(radix_tree&& right) noexcept
+		: storage(toy::move(static_cast<Allocator&>(right.storage)))
+	{
+		swap_contents(right);
+	}
+
+	~radix_tree()
+	{
+		clear();
+	}
+
+	radix_tree& operator=(const radix_tree& right)
+	{
+		if (this != &right)
+			radix_tree(right).swap(*this);
+		return *this;
+	}
+
+	radix_tree& operator=(radix_tree&& right) noexcept
+	{
+		if (this != &right)
+		{
+			clear();
+			static_cast<Allocator&>(storage) = toy::move(static_cast<Allocator&>(right.storage));
+			swap_contents(right);
+		}
+		return *this;
+	}
+
+	allocator_type get_allocator() const noexcept { return storage; }
+
+	// iterators
+
+	iterator       begin() noexcept        { return iterator(storage.leaves.begin()); }
+	const_iterator begin() const noexcept  { return const_iterator(storage.leaves.begin()); }
+	const_iterator cbegin() const noexcept { return begin(); }
+	iterator       end() noexcept          { return iterator(storage.leaves.end()); }
+	const_iterator end() const noexcept    { return const_iterator(storage.leaves.end()); }
+	const_iterator cend() const noexcept   { return end(); }
+
+	reverse_iterator       rbegin() noexcept       { return reverse_iterator(end()); }
+	const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+	reverse_iterator       rend() noexcept         { return reverse_iterator(begin()); }
+	const_reverse_iterator rend() const noexcept   { return const_reverse_iterator(begin()); }
+
+	// capacity
+
+	bool      empty() const noexcept { return storage.leaves.empty(); }
+	size_type size() const noexcept  { return storage.leaves.size(); }
+
+	// lookup
+
+	iterator find(const Key& key)
+	{
+		uint8_t buffer[key_buffer];
+		leaf* l = find_leaf(traits::encode(key, buffer));
+		return l ? iterator_to(l) : end();
+	}
+
+	const_iterator find(const Key& key) const { return const_cast<radix_tree*>(this)->find(key); }
+
+	bool      contains(const Key& key) const { return find(key) != end(); }
+	size_type count(const Key& key) const    { return contains(key) ? 1 : 0; }
+
+	T& at(const Key& key)
+	{
+		iterator it = find(key);
+		if (it == end())
+			throw std::out_of_range("radix_tree::at -- key not found");
+		return it->second;
+	}
+
+	const T& at(const Key& key) const { return const_cast<radix_tree*>(this)->at(key); }
+
+	T& operator[](const Key& key) { return try_emplace(key).first->second; }
+	T& operator[](Key&& key)      { return try_emplace(toy::move(key)).first->second; }
+
+	// the first element not less than key
+	iterator lower_bound(const Key& key)
+	{
+		uint8_t buffer[key_buffer];
+		leaf* l = lower_bound_leaf(traits::encode(key, buffer));
+		return l ? iterator_to(l) : end();
+	}
+
+	const_iterator lower_bound(const Key& key) const { return const_cast<radix_tree*>(this)->lower_bound(key); }
+
+	// the first element greater than key
+	iterator upper_bound(const Key& key)
+	{
+		uint8_t buffer[key_buffer];
+		art_key k = traits::encode(key, buffer);
+		leaf* l = lower_bound_leaf(k);
+		if (l && equal_key(l, k))
+			return std::next(iterator_to(l));
+		return l ? iterator_to(l) : end();
+	}
+
+	const_iterator upper_bound(const Key& key) const { return const_cast<radix_tree*>(this)->upper_bound(key); }
+
+	// the elements whose key starts with the bytes of 'prefix', in order
+	range<iterator> prefix_range(const Key& prefix)
+	{
+		static_assert(!std::is_integral<Key>::value, "radix_tree::prefix_range -- integer keys have no prefixes");
+		uint8_t buffer[key_buffer];
+		art_key k = traits::encode(prefix, buffer);
+		leaf* first = lower_bound_leaf(k);
+		if (!first)
+			return range<iterator>{ end(), end() };
+
+		// the keys past the range start at the prefix with its last byte
+		// below 0xff incremented, the bytes after it dropped
+		size_t n = k.size;
+		while (n > 0 && k.data[n - 1] == 0xff)
+			--n;
+		if (n == 0)
+			return range<iterator>{ iterator_to(first), end() };
+		vector<uint8_t> upper(k.data, k.data + n);
+		++upper[n - 1];
+		leaf* last = lower_bound_leaf(art_key{ upper.data(), n });
+		return range<iterator>{ iterator_to(first), last ? iterator_to(last) : end() };
+	}
+
+	range<const_iterator> prefix_range(const Key& prefix) const
+	{
+		range<iterator> r = const_cast<radix_tree*>(this)->prefix_range(prefix);
+		return range<const_iterator>{ r.first, r.last };
+	}
+
+	// modifiers
+
+	template<class... Args>
+	pair<iterator, bool> try_emplace(const Key& key, Args&&... args)
+	{
+		return emplace_key(key, toy::forward<Args>(args)...);
+	}
+
+	template<class... Args>
+	pair<iterator, bool> try_emplace(Key&& key, Args&&... args)
+	{
+		return emplace_key(toy::move(key), toy::forward<Args>(args)...);
+	}
+
+	pair<iterator, bool> insert(const value_type& value) { return try_emplace(value.first, value.second); }
+
+	template<class InputIt>
+	void insert(InputIt first, InputIt last)
+	{
+		for (; first != last; ++first)
+			insert(*first);
+	}
+
+	template<class M>
+	pair<iterator, bool> insert_or_assign(const Key& key, M&& value)
+	{
+		auto result = try_emplace(key, toy::forward<M>(value));
+		if (!result.second)
+			result.first->second = toy::forward<M>(value);
+		return result;
+	}
+
+	size_type erase(const Key& key)
+	{
+		iterator it = find(key);
+		if (it == end())
+			return 0;
+		erase(it);
+		return 1;
+	}
+
+	iterator erase(const_iterator pos)
+	{	// the iterator after pos
+		leaf* l = const_cast<leaf*>(&*pos.it);
+		iterator next(std::next(storage.leaves.iterator_to(*l)));
+		uint8_t buffer[key_buffer];
+		erase_ref(traits::encode(l->value.first, buffer));
+		storage.leaves.erase(*l);
+		destroy_leaf(l);
+		return next;
+	}
+
+	void clear() noexcept
+	{
+		if (storage.root && !detail::art_is_leaf(storage.root))
+			destroy_nodes(storage.root);
+		storage.root = 0;
+		storage.leaves.clear_and_dispose([this](leaf* l) { destroy_leaf(l); });
+	}
+
+	void swap(radix_tree& right) noexcept
+	{
+		toy::swap(static_cast<Allocator&>(storage), static_cast<Allocator&>(right.storage));
+		swap_contents(right);
+	}
+
+	friend bool operator==(const radix_tree& a, const radix_tree& b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (auto i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j)
+			if (!(i->first == j->first) || !(i->second == j->second))
+				return false;
+		return true;
+	}
+
+	friend bool operator!=(const radix_tree& a, const radix_tree& b) { return !(a == b); }
+
+private:
+	static art_ref leaf_ref(leaf* l) noexcept { return reinterpret_cast<art_ref>(l) | 1; }
+	static leaf*   as_leaf(art_ref r) noexcept { return reinterpret_cast<leaf*>(r & ~art_ref(1)); }
+
+	iterator iterator_to(leaf* l) noexcept { return iterator(storage.leaves.iterator_to(*l)); }
+
+	static art_key key_of(const leaf* l, uint8_t* buffer) noexcept { return traits::encode(l->value.first, buffer); }
+
+	static bool equal_key(const leaf* l, art_key k) noexcept
+	{
+		uint8_t buffer[key_buffer];
+		art_key lk = key_of(l, buffer);
+		return lk.size == k.size && (k.size == 0 || std::memcmp(lk.data, k.data, k.size) == 0);
+	}
+
+	static int compare_key(const leaf* l, art_key k) noexcept
+	{	// as memcmp, then by length
+		uint8_t buffer[key_buffer];
+		art_key lk = key_of(l, buffer);
+		size_t n = lk.size < k.size ? lk.size : k.size;
+		int c = n ? std::memcmp(lk.data, k.data, n) : 0;
+		if (c != 0)
+			return c;
+		return lk.size < k.size ? -1 : lk.size > k.size ? 1 : 0;
+	}
+
+	static leaf* min_leaf(art_ref r) noexcept
+	{	// the first leaf under r
+		while (!detail::art_is_leaf(r))
+		{
+			detail::art_node* n = detail::art_as_node(r);
+			r = n->terminal ? n->terminal : detail::art_next_child(n, -1);
+		}
+		return as_leaf(r);
+	}
+
+	static void set_prefix(detail::art_node* n, art_key k, size_t from, size_t length) noexcept
+	{	// the bytes from 'from' of k, which is the key of a leaf under n
+		n->prefix_len = static_cast<uint32_t>(length);
+		size_t stored = length < detail::art_max_prefix ? length : detail::art_max_prefix;
+		if (stored)
+			std::memcpy(n->prefix, k.data + from, stored);
+	}
+
+	static size_t match_prefix(art_ref r, art_key k, size_t depth) noexcept
+	{	// how many bytes of the prefix of the node r match k from depth on
+		detail::art_node* n = detail::art_as_node(r);
+		size_t stored = n->prefix_len < detail::art_max_prefix ? n->prefix_len : detail::art_max_prefix;
+		size_t i = 0;
+		for (; i < stored; ++i)
+			if (depth + i >= k.size || n->prefix[i] != k.data[depth + i])
+				return i;
+		if (n->prefix_len > stored)
+		{	// the bytes past the stored ones are those of any leaf below
+			uint8_t buffer[key_buffer];
+			art_key sample = key_of(min_leaf(r), buffer);
+			for (; i < n->prefix_len; ++i)
+				if (depth + i >= k.size || sample.data[depth + i] != k.data[depth + i])
+					return i;
+		}
+		return n->prefix_len;
+	}
+
+	leaf* find_leaf(art_key k) const noexcept
+	{	// only the stored prefix bytes are compared on the way, the leaf has the rest
+		art_ref r = storage.root;
+		size_t depth = 0;
+		while (r)
+		{
+			if (detail::art_is_leaf(r))
+				return equal_key(as_leaf(r), k) ? as_leaf(r) : nullptr;
+
+			detail::art_node* n = detail::art_as_node(r);
+			size_t stored = n->prefix_len < detail::art_max_prefix ? n->prefix_len : detail::art_max_prefix;
+			if (depth + n->prefix_len > k.size)
+				return nullptr;
+			for (size_t i = 0; i < stored; ++i)
+				if (n->prefix[i] != k.data[depth + i])
+					return nullptr;
+			depth += n->prefix_len;
+
+			if (depth == k.size)
+			{
+				r = n->terminal;
+				continue;
+			}
+			art_ref* child = detail::art_find_child(n, k.data[depth]);
+			if (!child)
+				return nullptr;
+			r = *child;
+			++depth;
+		}
+		return nullptr;
+	}
+
+	leaf* lower_bound_leaf(art_key k) const noexcept
+	{
+		return storage.root ? lower_bound_in(storage.root, k, 0) : nullptr;
+	}
+
+	static leaf* lower_bound_in(art_ref r, art_key k, size_t depth) noexcept
+	{	// the first leaf under r not less than k, nullptr if all are
+		if (detail::art_is_leaf(r))
+			return compare_key(as_leaf(r), k) >= 0 ? as_leaf(r) : nullptr;
+
+		detail::art_node* n = detail::art_as_node(r);
+		if (n->prefix_len)
+		{
+			uint8_t buffer[key_buffer];
+			art_key sample{ nullptr, 0 };
+			for (size_t i = 0; i < n->prefix_len; ++i)
+			{
+				if (depth + i == k.size)
+					return min_leaf(r);		// k is a prefix of every key below
+				if (i == detail::art_max_prefix)
+					sample = key_of(min_leaf(r), buffer);
+				uint8_t p = i < detail::art_max_prefix ? n->prefix[i] : sample.data[depth + i];
+				if (p != k.data[depth + i])
+					return p > k.data[depth + i] ? min_leaf(r) : nullptr;
+			}
+			depth += n->prefix_len;
+		}
+		if (depth == k.size)
+			return min_leaf(r);
+
+		// the terminal key is a prefix of k, so less than it
+		uint8_t b = k.data[depth];
+		if (art_ref* child = detail::art_find_child(n, b))
+			if (leaf* found = lower_bound_in(*child, k, depth + 1))
+				return found;
+		art_ref next = detail::art_next_child(n, b);
+		return next ? min_leaf(next) : nullptr;
+	}
+
+	template<class KeyArg, class... Args>
+	pair<iterator, bool> emplace_key(KeyArg&& key, Args&&... args)
+	{
+		uint8_t buffer[key_buffer];
+		art_key k = traits::encode(key, buffer);
+		leaf* next = lower_bound_leaf(k);
+		if (next && equal_key(next, k))
+			return pair<iterator, bool>(iterator_to(next), false);
+
+		leaf* l = create_leaf(toy::forward<KeyArg>(key), toy::forward<Args>(args)...);
+		try
+		{	// the key may have been moved into the leaf, take its bytes from there
+			insert_leaf(key_of(l, buffer), l);
+		}
+		catch (...)
+		{
+			destroy_leaf(l);
+			throw;
+		}
+		storage.leaves.insert(next ? storage.leaves.iterator_to(*next) : storage.leaves.end(), *l);
+		return pair<iterator, bool>(iterator_to(l), true);
+	}
+
+	void insert_leaf(art_key k, leaf* l)
+	{	// k is absent, every node is allocated before the tree is changed
+		art_ref* slot = &storage.root;
+		size_t depth = 0;
+		for (;;)
+		{
+			art_ref r = *slot;
+			if (r == 0)
+			{
+				*slot = leaf_ref(l);
+				return;
+			}
+
+			if (detail::art_is_leaf(r))
+			{	// two leaves under a node4 holding their common bytes
+				uint8_t buffer[key_buffer];
+				art_key other = key_of(as_leaf(r), buffer);
+				size_t common = depth;
+				while (common < k.size && common < other.size && k.data[common] == other.data[common])
+					++common;
+				detail::art_node4* n = create_node<detail::art_node4>();
+				set_prefix(n, k, depth, common - depth);
+				place(n, other, common, r);
+				place(n, k, common, leaf_ref(l));
+				*slot = reinterpret_cast<art_ref>(n);
+				return;
+			}
+
+			detail::art_node* n = detail::art_as_node(r);
+			size_t matched = match_prefix(r, k, depth);
+			if (matched < n->prefix_len)
+			{	// split the prefix: a node4 with the matched bytes over n and the leaf
+				detail::art_node4* parent = create_node<detail::art_node4>();
+				uint8_t buffer[key_buffer];
+				art_key sample = key_of(min_leaf(r), buffer);
+				set_prefix(parent, sample, depth, matched);
+				uint8_t edge = sample.data[depth + matched];
+				set_prefix(n, sample, depth + matched + 1, n->prefix_len - matched - 1);
+				detail::art_insert_child(parent, edge, r);
+				place(parent, k, depth + matched, leaf_ref(l));
+				*slot = reinterpret_cast<art_ref>(parent);
+				return;
+			}
+
+			depth += n->prefix_len;
+			if (depth == k.size)
+			{
+				n->terminal = leaf_ref(l);
+				return;
+			}
+			art_ref* child = detail::art_find_child(n, k.data[depth]);
+			if (child)
+			{
+				slot = child;
+				++depth;
+				continue;
+			}
+			add_child(slot, k.data[depth], leaf_ref(l));
+			return;
+		}
+	}
+
+	static void place(detail::art_node4* n, art_key k, size_t depth, art_ref r) noexcept
+	{	// r, whose key is k, below n at depth
+		if (k.size == depth)
+			n->terminal = r;
+		else
+			detail::art_insert_child(n, k.data[depth], r);
+	}
+
+	void add_child(art_ref* slot, uint8_t b, art_ref child)
+	{	// into the node at *slot, grown to the next kind when full
+		detail::art_node* n = detail::art_as_node(*slot);
+		if (n->count == detail::art_capacity(n->kind))
+		{
+			detail::art_node* grown;
+			switch (n->kind)
+			{
+			case detail::art_kind::node4:  grown = create_node<detail::art_node16>(); break;
+			case detail::art_kind::node16: grown = create_node<detail::art_node48>(); break;
+			default:                       grown = create_node<detail::art_node256>(); break;
+			}
+			detail::art_copy_node(grown, n);
+			destroy_node(n);
+			*slot = reinterpret_cast<art_ref>(grown);
+			n = grown;
+		}
+		detail::art_insert_child(n, b, child);
+	}
+
+	void erase_ref(art_key k) noexcept
+	{	// unlink the leaf of k, which is in the tree
+		if (detail::art_is_leaf(storage.root))
+		{
+			storage.root = 0;
+			return;
+		}
+		art_ref* slot = &storage.root;
+		size_t depth = 0;
+		for (;;)
+		{
+			detail::art_node* n = detail::art_as_node(*slot);
+			size_t node_depth = depth;
+			depth += n->prefix_len;
+			if (depth == k.size)
+			{
+				n->terminal = 0;
+				shrink(slot, node_depth);
+				return;
+			}
+			art_ref* child = detail::art_find_child(n, k.data[depth]);
+			if (detail::art_is_leaf(*child))
+			{
+				detail::art_remove_child(n, k.data[depth]);
+				shrink(slot, node_depth);
+				return;
+			}
+			slot = child;
+			++depth;
+		}
+	}
+
+	void shrink(art_ref* slot, size_t depth) noexcept
+	{	// after a removal from the node at *slot, which starts at depth
+		detail::art_node* n = detail::art_as_node(*slot);
+		if (n->count == 0)
+		{	// only the terminal leaf is left
+			*slot = n->terminal;
+			destroy_node(n);
+			return;
+		}
+		if (n->count == 1 && !n->terminal)
+		{	// merge n into its only child, the prefix of which grows by n's and the edge
+			uint8_t edge = 0;
+			art_ref child = detail::art_next_child(n, -1, &edge);
+			if (!detail::art_is_leaf(child))
+			{
+				detail::art_node* c = detail::art_as_node(child);
+				uint8_t buffer[key_buffer];
+				set_prefix(c, key_of(min_leaf(child), buffer), depth, n->prefix_len + 1 + c->prefix_len);
+			}
+			*slot = child;
+			destroy_node(n);
+			return;
+		}
+
+		// a node much emptier than the next smaller kind holds is replaced by
+		// one, a node that can't be allocated now stays as it is
+		try
+		{
+			detail::art_node* smaller = nullptr;
+			if (n->kind == detail::art_kind::node256 && n->count < 37)
+				smaller = create_node<detail::art_node48>();
+			else if (n->kind == detail::art_kind::node48 && n->count < 12)
+				smaller = create_node<detail::art_node16>();
+			else if (n->kind == detail::art_kind::node16 && n->count < 3)
+				smaller = create_node<detail::art_node4>();
+			if (smaller)
+			{
+				detail::art_copy_node(smaller, n);
+				destroy_node(n);
+				*slot = reinterpret_cast<art_ref>(smaller);
+			}
+		}
+		catch (...)
+		{
+		}
+	}
+
+	template<class KeyArg, class... Args>
+	leaf* create_leaf(KeyArg&& key, Args&&... args)
+	{
+		using leaf_alloc = typename alloc_traits::template rebind_alloc<leaf>;
+		leaf_alloc a(storage);
+		leaf* l = std::allocator_traits<leaf_alloc>::allocate(a, 1);
+		try
+		{
+			::new (static_cast<void*>(l)) leaf(toy::forward<KeyArg>(key), toy::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			std::allocator_traits<leaf_alloc>::deallocate(a, l, 1);
+			throw;
+		}
+		return l;
+	}
+
+	void destroy_leaf(leaf* l) noexcept
+	{
+		using leaf_alloc = typename alloc_traits::template rebind_alloc<leaf>;
+		leaf_alloc a(storage);
+		l->~leaf();
+		std::allocator_traits<leaf_alloc>::deallocate(a, l, 1);
+	}
+
+	template<class Node>
+	Node* create_node()
+	{
+		using node_alloc = typename alloc_traits::template rebind_alloc<Node>;
+		node_alloc a(storage);
+		Node* n = std::allocator_traits<node_alloc>::allocate(a, 1);
+		return ::new (static_cast<void*>(n)) Node();
+	}
+
+	template<class Node>
+	void destroy_node_as(detail::art_node* n) noexcept
+	{
+		using node_alloc = typename alloc_traits::template rebind_alloc<Node>;
+		node_alloc a(storage);
+		std::allocator_traits<node_alloc>::deallocate(a, static_cast<Node*>(n), 1);
+	}
+
+	void destroy_node(detail::art_node* n) noexcept
+	{	// the node only, its children are elsewhere by now
+		switch (n->kind)
+		{
+		case detail::art_kind::node4:  destroy_node_as<detail::art_node4>(n); break;
+		case detail::art_kind::node16: destroy_node_as<detail::art_node16>(n); break;
+		case detail::art_kind::node48: destroy_node_as<detail::art_node48>(n); break;
+		default:                       destroy_node_as<detail::art_node256>(n); break;
+		}
+	}
+
+	void destroy_nodes(art_ref r) noexcept
+	{	// the inner nodes under r, the leaves are freed from the list
+		detail::art_node* n = detail::art_as_node(r);
+		uint8_t b = 0;
+		for (art_ref child = detail::art_next_child(n, -1, &b); child; child = detail::art_next_child(n, b, &b))
+			if (!detail::art_is_leaf(child))
+				destroy_nodes(child);
+		destroy_node(n);
+	}
+
+	void swap_contents(radix_tree& right) noexcept
+	{
+		toy::swap(storage.root, right.storage.root);
+		storage.leaves.swap(right.storage.leaves);
+	}
+
+private:
+	struct impl : Allocator
+	{	// the allocator is a base, an empty one takes no room
+		impl() = default;
+		explicit impl(const Allocator& a) : Allocator(a) {}
+		explicit impl(Allocator&& a) : Allocator(toy::move(a)) {}
+
+		art_ref   root{ 0 };
+		leaf_list leaves;		// in key order
+	};
+
+	impl storage;
+};
+
+template<class K, class T, class A>
+inline void swap(radix_tree<K, T, A>& a, radix_tree<K, T, A>& b) noexcept
+{
+	a.swap(b);
+}
+
+}	// namespace toy
+
+#endif // TOY_CORE_RADIX_TREE_H
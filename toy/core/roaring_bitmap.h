@@ -0,0 +1,1789 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_ROARING_BITMAP_H
+#define TOY_CORE_ROARING_BITMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "toy/core/bitset.h"
+#include "toy/core/span.h"
+#include "toy/core/utility.h"
+#include "toy/core/vector.h"
+#include "toy/utility/byte.h"
+
+namespace toy
+{
+
+// roaring bitmap --------------------------------------------------------------
+// A set of 32 bit integers, split by the high 16 bits into blocks of 65536
+// values, each stored the way that is smallest for what it holds (Chambi,
+// Lemire et al., "Better bitmap performance with Roaring bitmaps"):
+//
+//	array   up to 4096 values, sorted 16 bit integers
+//	bitmap  more than 4096 values, 1024 words of 64 bits
+//	run     sorted runs of consecutive values, a start and a length each
+//
+// Array and bitmap are chosen by the cardinality as the set changes. Runs
+// come from add_range and from run_optimize(), which converts every block to
+// runs where they are the smallest of the three.
+//
+// Every block knows its cardinality, so cardinality() is a sum over the
+// blocks, and and_cardinality() and its relatives count a result block by
+// block without building it. Two bitmaps combine with AVX2 on the words,
+// two arrays with SSE4.2 string compares 8 values at a time.
+//
+// serialize() writes the portable format of the other Roaring
+// implementations (CRoaring, the Java and Go libraries): little endian,
+// no padding, readable on any machine. roaring_bitmap_view answers contains()
+// and cardinality() from such a buffer in place, e.g. a mapped file.
+
+namespace detail
+{
+
+enum class roaring_kind : uint8_t { array, bitmap, run };
+
+constexpr uint32_t roaring_array_max    = 4096;		// an array holds at most this many
+constexpr size_t   roaring_bitmap_words = 1024;
+constexpr uint32_t roaring_cookie       = 12346;	// the serialized format without run blocks
+constexpr uint32_t roaring_run_cookie   = 12347;	// with, in the low 16 bits
+constexpr size_t   roaring_no_offsets   = 4;		// the run format has offsets from this many blocks
+
+struct roaring_container
+{
+	roaring_kind     kind{ roaring_kind::array };
+	uint32_t         cardinality{ 0 };
+	vector<uint16_t> values;	// array: the values, run: start and length - 1 of each run
+	vector<uint64_t> words;		// bitmap
+
+	size_t run_count() const noexcept { return values.size() / 2; }
+};
+
+inline uint32_t roaring_run_last(const uint16_t* runs, size_t i) noexcept
+{
+	return uint32_t(runs[2 * i]) + runs[2 * i + 1];
+}
+
+inline size_t roaring_run_upper(const uint16_t* runs, size_t n, uint32_t v) noexcept
+{	// the number of runs starting at or before v
+	size_t lo = 0;
+	while (n > 0)
+	{
+		size_t half = n / 2;
+		if (runs[2 * (lo + half)] <= v)
+		{
+			lo += half + 1;
+			n -= half + 1;
+		}
+		else
+		{
+			n = half;
+		}
+	}
+	return lo;
+}
+
+inline bool roaring_contains(const roaring_container& c, uint16_t v) noexcept
+{
+	switch (c.kind)
+	{
+	case roaring_kind::array:
+		return std::binary_search(c.values.begin(), c.values.end(), v);
+	case roaring_kind::bitmap:
+		return (c.words[v / 64] >> (v % 64)) & 1;
+	default:
+	{
+		size_t i = roaring_run_upper(c.values.data(), c.run_count(), v);
+		return i > 0 && v <= roaring_run_last(c.values.data(), i - 1);
+	}
+	}
+}
+
+template<class F>
+inline void roaring_for_each(const roaring_container& c, uint32_t high, F& f)
+{
+	switch (c.kind)
+	{
+	case roaring_kind::array:
+		for (uint16_t v : c.values)
+			f(high | v);
+		break;
+	case roaring_kind::bitmap:
+		for (size_t i = 0; i < roaring_bitmap_words; ++i)
+			for (uint64_t w = c.words[i]; w; w &= w - 1)
+				f(high | uint32_t(i * 64 + countr_zero(w)));
+		break;
+	default:
+		for (size_t i = 0; i < c.run_count(); ++i)
+			for (uint32_t v = c.values[2 * i], last = roaring_run_last(c.values.data(), i); v <= last; ++v)
+				f(high | v);
+		break;
+	}
+}
+
+inline void roaring_to_bitmap(roaring_container& c)
+{
+	vector<uint64_t> words(roaring_bitmap_words, 0);
+	if (c.kind == roaring_kind::array)
+	{
+		for (uint16_t v : c.values)
+			words[v / 64] |= uint64_t(1) << (v % 64);
+	}
+	else if (c.kind == roaring_kind::run)
+	{
+		for (size_t i = 0; i < c.run_count(); ++i)
+			bit_words_fill(words.data(), c.values[2 * i], roaring_run_last(c.values.data(), i) + 1, true);
+	}
+	else
+	{
+		return;
+	}
+	c.words.swap(words);
+	c.values = vector<uint16_t>();
+	c.kind = roaring_kind::bitmap;
+}
+
+inline void roaring_to_array(roaring_container& c)
+{
+	if (c.kind == roaring_kind::array)
+		return;
+	vector<uint16_t> values;
+	values.reserve(c.cardinality);
+	auto add = [&](uint32_t v) { values.push_back(static_cast<uint16_t>(v)); };
+	roaring_for_each(c, 0, add);
+	c.values.swap(values);
+	c.words = vector<uint64_t>();
+	c.kind = roaring_kind::array;
+}
+
+// an array or a bitmap, as the cardinality asks, for a block that is not runs
+inline void roaring_normalize(roaring_container& c)
+{
+	if (c.kind == roaring_kind::bitmap && c.cardinality <= roaring_array_max)
+		roaring_to_array(c);
+	else if (c.kind == roaring_kind::array && c.cardinality > roaring_array_max)
+		roaring_to_bitmap(c);
+}
+
+inline void roaring_from_runs(roaring_container& c)
+{	// runs to an array or a bitmap
+	if (c.cardinality <= roaring_array_max)
+		roaring_to_array(c);
+	else
+		roaring_to_bitmap(c);
+}
+
+inline size_t roaring_count_runs(const roaring_container& c) noexcept
+{
+	switch (c.kind)
+	{
+	case roaring_kind::array:
+	{
+		size_t n = 0;
+		for (size_t i = 0; i < c.values.size(); ++i)
+			n += i == 0 || c.values[i] != c.values[i - 1] + 1;
+		return n;
+	}
+	case roaring_kind::bitmap:
+	{	// a run starts at each 1 bit after a 0 bit
+		size_t n = 0;
+		uint64_t carry = 0;
+		for (size_t i = 0; i < roaring_bitmap_words; ++i)
+		{
+			uint64_t w = c.words[i];
+			n += popcount(w & ~((w << 1) | carry));
+			carry = w >> 63;
+		}
+		return n;
+	}
+	default:
+		return c.run_count();
+	}
+}
+
+inline size_t roaring_size_as(roaring_kind kind, uint32_t cardinality, size_t runs) noexcept
+{	// the serialized bytes of a block
+	switch (kind)
+	{
+	case roaring_kind::array:  return 2 * size_t(cardinality);
+	case roaring_kind::bitmap: return roaring_bitmap_words * 8;
+	default:                   return 2 + 4 * runs;
+	}
+}
+
+inline void roaring_run_optimize(roaring_container& c)
+{	// to whichever of the three is the smallest, runs only when strictly so
+	size_t runs = roaring_count_runs(c);
+	roaring_kind plain = c.cardinality <= roaring_array_max ? roaring_kind::array : roaring_kind::bitmap;
+	if (roaring_size_as(roaring_kind::run, c.cardinality, runs) >= roaring_size_as(plain, c.cardinality, runs))
+	{
+		if (c.kind == roaring_kind::run)
+			roaring_from_runs(c);
+		return;
+	}
+	if (c.kind == roaring_kind::run)
+		return;
+
+	vector<uint16_t> values;
+	values.reserve(2 * runs);
+	uint32_t start = 0, last = 0;
+	bool open = false;
+	auto add = [&](uint32_t v)
+	{
+		if (open && v == last + 1)
+		{
+			last = v;
+			return;
+		}
+		if (open)
+		{
+			values.push_back(static_cast<uint16_t>(start));
+			values.push_back(static_cast<uint16_t>(last - start));
+		}
+		start = last = v;
+		open = true;
+	};
+	roaring_for_each(c, 0, add);
+	values.push_back(static_cast<uint16_t>(start));
+	values.push_back(static_cast<uint16_t>(last - start));
+	c.values.swap(values);
+	c.words = vector<uint64_t>();
+	c.kind = roaring_kind::run;
+}
+
+inline bool roaring_add(roaring_container& c, uint16_t v)
+{
+	switch (c.kind)
+	{
+	case roaring_kind::array:
+	{
+		auto it = std::lower_bound(c.values.begin(), c.values.end(), v);
+		if (it != c.values.end() && *it == v)
+			return false;
+		if (c.cardinality == roaring_array_max)
+		{
+			roaring_to_bitmap(c);
+			return roaring_add(c, v);
+		}
+		c.values.insert(it, v);
+		break;
+	}
+	case roaring_kind::bitmap:
+	{
+		uint64_t bit = uint64_t(1) << (v % 64);
+		if (c.words[v / 64] & bit)
+			return false;
+		c.words[v / 64] |= bit;
+		break;
+	}
+	default:
+	{
+		uint16_t* runs = c.values.data();
+		size_t i = roaring_run_upper(runs, c.run_count(), v);	// the run after v
+		if (i > 0 && v <= roaring_run_last(runs, i - 1))
+			return false;
+		bool after_previous = i > 0 && roaring_run_last(runs, i - 1) + 1 == v;
+		bool before_next = i < c.run_count() && runs[2 * i] == v + 1;
+		if (after_previous && before_next)
+		{	// v joins two runs
+			runs[2 * (i - 1) + 1] = static_cast<uint16_t>(roaring_run_last(runs, i) - runs[2 * (i - 1)]);
+			c.values.erase(c.values.begin() + 2 * i, c.values.begin() + 2 * i + 2);
+		}
+		else if (after_previous)
+		{
+			++runs[2 * (i - 1) + 1];
+		}
+		else if (before_next)
+		{
+			--runs[2 * i];
+			++runs[2 * i + 1];
+		}
+		else
+		{
+			uint16_t run[2] = { v, 0 };
+			c.values.insert(c.values.begin() + 2 * i, run, run + 2);
+		}
+		break;
+	}
+	}
+	++c.cardinality;
+	return true;
+}
+
+inline bool roaring_remove(roaring_container& c, uint16_t v)
+{
+	switch (c.kind)
+	{
+	case roaring_kind::array:
+	{
+		auto it = std::lower_bound(c.values.begin(), c.values.end(), v);
+		if (it == c.values.end() || *it != v)
+			return false;
+		c.values.erase(it);
+		--c.cardinality;
+		return true;
+	}
+	case roaring_kind::bitmap:
+	{
+		uint64_t bit = uint64_t(1) << (v % 64);
+		if (!(c.words[v / 64] & bit))
+			return false;
+		c.words[v / 64] &= ~bit;
+		--c.cardinality;
+		roaring_normalize(c);
+		return true;
+	}
+	default:
+	{
+		uint16_t* runs = c.values.data();
+		size_t i = roaring_run_upper(runs, c.run_count(), v);
+		if (i == 0 || v > roaring_run_last(runs, i - 1))
+			return false;
+		size_t r = i - 1;
+		uint32_t start = runs[2 * r], last = roaring_run_last(runs, r);
+		if (start == last)
+		{
+			c.values.erase(c.values.begin() + 2 * r, c.values.begin() + 2 * r + 2);
+		}
+		else if (v == start)
+		{
+			++runs[2 * r];
+			--runs[2 * r + 1];
+		}
+		else if (v == last)
+		{
+			--runs[2 * r + 1];
+		}
+		else
+		{	// split in two around v
+			runs[2 * r + 1] = static_cast<uint16_t>(v - 1 - start);
+			uint16_t run[2] = { static_cast<uint16_t>(v + 1), static_cast<uint16_t>(last - v - 1) };
+			c.values.insert(c.values.begin() + 2 * i, run, run + 2);
+		}
+		--c.cardinality;
+		return true;
+	}
+	}
+}
+
+// array against array ---------------------------------------------------------
+// Each block of 8 values of a is compared with the blocks of b its range
+// overlaps by _mm_cmpestrm, which gives a bit for each value of a equal to
+// any of b. _mm_shuffle_epi8 then packs the values to keep to the front of
+// the register, with a mask picked from a table by those 8 bits.
+
+struct roaring_shuffle_table
+{
+	uint8_t masks[256][16];
+
+	constexpr roaring_shuffle_table() : masks()
+	{
+		for (int m = 0; m < 256; ++m)
+		{
+			int out = 0;
+			for (int lane = 0; lane < 8; ++lane)
+			{
+				if (m & (1 << lane))
+				{
+					masks[m][out++] = static_cast<uint8_t>(2 * lane);
+					masks[m][out++] = static_cast<uint8_t>(2 * lane + 1);
+				}
+			}
+			for (; out < 16; ++out)
+				masks[m][out] = 0x80;
+		}
+	}
+};
+
+#if defined(__AVX2__)
+inline constexpr roaring_shuffle_table roaring_shuffle{};
+
+inline __m128i roaring_load8(const uint16_t* p, size_t n) noexcept
+{	// n of 8 values, without reading past them
+	if (n == 8)
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+	uint16_t buffer[8] = {};
+	std::memcpy(buffer, p, n * sizeof(uint16_t));
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer));
+}
+#endif
+
+// the values of a that are in b (InB) or are not, written to out when given,
+// which has room for na + 8 values. Returns how many there are
+template<bool InB>
+inline size_t roaring_array_match(const uint16_t* a, size_t na, const uint16_t* b, size_t nb, uint16_t* out) noexcept
+{
+	size_t count = 0;
+	if (nb / 64 > na)
+	{	// a few values against many, a binary search each
+		const uint16_t* from = b;
+		for (size_t i = 0; i < na; ++i)
+		{
+			from = std::lower_bound(from, b + nb, a[i]);
+			bool found = from != b + nb && *from == a[i];
+			if (found == InB)
+			{
+				if (out)
+					out[count] = a[i];
+				++count;
+			}
+		}
+		return count;
+	}
+
+#if defined(__AVX2__)
+	size_t j = 0;
+	for (size_t i = 0; i < na; i += 8)
+	{
+		size_t la = na - i < 8 ? na - i : 8;
+		__m128i va = roaring_load8(a + i, la);
+		uint16_t first = a[i], last = a[i + la - 1];
+		while (j < nb && b[(j + 8 < nb ? j + 8 : nb) - 1] < first)
+			j += 8;
+		unsigned found = 0;
+		for (size_t k = j; k < nb && b[k] <= last; k += 8)
+		{
+			int lb = static_cast<int>(nb - k < 8 ? nb - k : 8);
+			__m128i match = _mm_cmpestrm(roaring_load8(b + k, lb), lb, va, static_cast<int>(la),
+				_SIDD_UWORD_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK);
+			found |= static_cast<unsigned>(_mm_cvtsi128_si32(match));
+		}
+		unsigned keep = (InB ? found : ~found) & ((1u << la) - 1);
+		if (out)
+		{
+			__m128i packed = _mm_shuffle_epi8(va, _mm_loadu_si128(reinterpret_cast<const __m128i*>(roaring_shuffle.masks[keep])));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + count), packed);
+		}
+		count += popcount(keep);
+	}
+#else
+	size_t i = 0, j = 0;
+	while (i < na)
+	{
+		while (j < nb && b[j] < a[i])
+			++j;
+		bool found = j < nb && b[j] == a[i];
+		if (found == InB)
+		{
+			if (out)
+				out[count] = a[i];
+			++count;
+		}
+		++i;
+	}
+#endif
+	return count;
+}
+
+inline size_t roaring_union_arrays(const uint16_t* a, size_t na, const uint16_t* b, size_t nb, uint16_t* out) noexcept
+{
+	size_t i = 0, j = 0, count = 0;
+	while (i < na && j < nb)
+	{
+		uint16_t x = a[i], y = b[j];
+		out[count++] = x < y ? x : y;
+		i += x <= y;
+		j += y <= x;
+	}
+	for (; i < na; ++i)
+		out[count++] = a[i];
+	for (; j < nb; ++j)
+		out[count++] = b[j];
+	return count;
+}
+
+// bitmap against bitmap -------------------------------------------------------
+
+inline size_t roaring_and_count_words(const uint64_t* a, const uint64_t* b, size_t n) noexcept
+{	// popcount(a & b), with AVX2 by nibble lookups summed per byte (Mula's method)
+	size_t i = 0, count = 0;
+#if defined(__AVX2__)
+	const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	__m256i sum = _mm256_setzero_si256();
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i v = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+		__m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, nibble));
+		__m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+		sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+	}
+	count = static_cast<size_t>(_mm256_extract_epi64(sum, 0) + _mm256_extract_epi64(sum, 1) +
+		_mm256_extract_epi64(sum, 2) + _mm256_extract_epi64(sum, 3));
+#endif
+	for (; i < n; ++i)
+		count += popcount(a[i] & b[i]);
+	return count;
+}
+
+inline size_t roaring_count_range(const uint64_t* words, uint32_t first, uint32_t last) noexcept
+{	// the 1 bits in [first, last]
+	size_t i = first / 64, j = last / 64;
+	uint64_t head = ~uint64_t(0) << (first % 64);
+	uint64_t tail = ~uint64_t(0) >> (63 - last % 64);
+	if (i == j)
+		return popcount(words[i] & head & tail);
+	size_t count = popcount(words[i] & head) + popcount(words[j] & tail);
+	return count + bit_words_count(words + i + 1, j - i - 1);
+}
+
+// block against block ---------------------------------------------------------
+
+// a run block as an array or a bitmap, in tmp, for the operations that have
+// no case of their own for runs
+inline const roaring_container& roaring_plain(const roaring_container& c, roaring_container& tmp)
+{
+	if (c.kind != roaring_kind::run)
+		return c;
+	tmp = c;
+	roaring_from_runs(tmp);
+	return tmp;
+}
+
+inline void roaring_runs_and(const roaring_container& a, const roaring_container& b, roaring_container& out)
+{
+	const uint16_t* x = a.values.data();
+	const uint16_t* y = b.values.data();
+	size_t i = 0, j = 0;
+	out.kind = roaring_kind::run;
+	out.values.clear();
+	out.cardinality = 0;
+	while (i < a.run_count() && j < b.run_count())
+	{
+		uint32_t first = std::max<uint32_t>(x[2 * i], y[2 * j]);
+		uint32_t last = std::min(roaring_run_last(x, i), roaring_run_last(y, j));
+		if (first <= last)
+		{
+			out.values.push_back(static_cast<uint16_t>(first));
+			out.values.push_back(static_cast<uint16_t>(last - first));
+			out.cardinality += last - first + 1;
+		}
+		if (roaring_run_last(x, i) < roaring_run_last(y, j))
+			++i;
+		else
+			++j;
+	}
+}
+
+inline void roaring_runs_or(const roaring_container& a, const roaring_container& b, roaring_container& out)
+{
+	const uint16_t* x = a.values.data();
+	const uint16_t* y = b.values.data();
+	size_t i = 0, j = 0;
+	out.kind = roaring_kind::run;
+	out.values.clear();
+	out.cardinality = 0;
+	uint32_t start = 0, last = 0;
+	bool open = false;
+	auto flush = [&]()
+	{
+		out.values.push_back(static_cast<uint16_t>(start));
+		out.values.push_back(static_cast<uint16_t>(last - start));
+		out.cardinality += last - start + 1;
+	};
+	while (i < a.run_count() || j < b.run_count())
+	{	// the run that starts first, merged into the open one if they touch
+		bool take_x = j == b.run_count() || (i < a.run_count() && x[2 * i] <= y[2 * j]);
+		uint32_t s = take_x ? x[2 * i] : y[2 * j];
+		uint32_t l = take_x ? roaring_run_last(x, i++) : roaring_run_last(y, j++);
+		if (open && s <= last + 1)
+		{
+			last = std::max(last, l);
+			continue;
+		}
+		if (open)
+			flush();
+		start = s;
+		last = l;
+		open = true;
+	}
+	if (open)
+		flush();
+}
+
+// runs kept only while they are no larger than the plain form
+inline void roaring_shrink_runs(roaring_container& c)
+{
+	if (c.kind != roaring_kind::run)
+		return;
+	roaring_kind plain = c.cardinality <= roaring_array_max ? roaring_kind::array : roaring_kind::bitmap;
+	if (roaring_size_as(roaring_kind::run, c.cardinality, c.run_count()) > roaring_size_as(plain, c.cardinality, 0))
+		roaring_from_runs(c);
+}
+
+inline void roaring_and(const roaring_container& a, const roaring_container& b, roaring_container& out)
+{
+	if (a.kind == roaring_kind::run && b.kind == roaring_kind::run)
+	{
+		roaring_runs_and(a, b, out);
+		roaring_shrink_runs(out);
+		return;
+	}
+	if (b.kind == roaring_kind::array && a.kind != roaring_kind::array)
+	{
+		roaring_and(b, a, out);
+		return;
+	}
+
+	roaring_container tmp;
+	out.words = vector<uint64_t>();
+	if (a.kind == roaring_kind::array)
+	{
+		out.kind = roaring_kind::array;
+		if (b.kind == roaring_kind::array)
+		{
+			out.values.resize(std::min(a.cardinality, b.cardinality) + 8);
+			if (a.cardinality <= b.cardinality)
+				out.cardinality = static_cast<uint32_t>(roaring_array_match<true>(a.values.data(), a.cardinality, b.values.data(), b.cardinality, out.values.data()));
+			else
+				out.cardinality = static_cast<uint32_t>(roaring_array_match<true>(b.values.data(), b.cardinality, a.values.data(), a.cardinality, out.values.data()));
+			out.values.resize(out.cardinality);
+			return;
+		}
+		out.values.clear();
+		for (uint16_t v : a.values)
+			if (roaring_contains(b, v))
+				out.values.push_back(v);
+		out.cardinality = static_cast<uint32_t>(out.values.size());
+		return;
+	}
+
+	const roaring_container& x = roaring_plain(a, tmp);
+	roaring_container tmp2;
+	const roaring_container& y = roaring_plain(b, tmp2);
+	if (x.kind == roaring_kind::array || y.kind == roaring_kind::array)
+	{
+		roaring_and(x, y, out);
+		return;
+	}
+	out.kind = roaring_kind::bitmap;
+	out.values = vector<uint16_t>();
+	out.words.resize(roaring_bitmap_words);
+	bit_words_apply<bit_op::and_>(out.words.data(), x.words.data(), y.words.data(), roaring_bitmap_words);
+	out.cardinality = static_cast<uint32_t>(bit_words_count(out.words.data(), roaring_bitmap_words));
+	roaring_normalize(out);
+}
+
+inline void roaring_or(const roaring_container& a, const roaring_container& b, roaring_container& out)
+{
+	if (a.kind == roaring_kind::run && b.kind == roaring_kind::run)
+	{
+		roaring_runs_or(a, b, out);
+		roaring_shrink_runs(out);
+		return;
+	}
+	if (a.cardinality == 65536 && a.kind == roaring_kind::run)
+	{
+		out = a;
+		return;
+	}
+	if (b.cardinality == 65536 && b.kind == roaring_kind::run)
+	{
+		out = b;
+		return;
+	}
+
+	roaring_container tmp, tmp2;
+	const roaring_container& x = roaring_plain(a, tmp);
+	const roaring_container& y = roaring_plain(b, tmp2);
+	if (x.kind == roaring_kind::array && y.kind == roaring_kind::array && x.cardinality + y.cardinality <= roaring_array_max)
+	{
+		out.kind = roaring_kind::array;
+		out.words = vector<uint64_t>();
+		out.values.resize(x.cardinality + y.cardinality);
+		out.cardinality = static_cast<uint32_t>(roaring_union_arrays(x.values.data(), x.cardinality, y.values.data(), y.cardinality, out.values.data()));
+		out.values.resize(out.cardinality);
+		return;
+	}
+
+	// at least one bitmap, or two arrays that may not fit in one
+	out.kind = roaring_kind::bitmap;
+	out.values = vector<uint16_t>();
+	if (x.kind == roaring_kind::bitmap && y.kind == roaring_kind::bitmap)
+	{
+		out.words.resize(roaring_bitmap_words);
+		bit_words_apply<bit_op::or_>(out.words.data(), x.words.data(), y.words.data(), roaring_bitmap_words);
+	}
+	else
+	{
+		const roaring_container& bits = x.kind == roaring_kind::bitmap ? x : y;
+		const roaring_container& other = x.kind == roaring_kind::bitmap ? y : x;
+		if (bits.kind == roaring_kind::bitmap)
+			out.words = bits.words;
+		else
+			out.words.assign(roaring_bitmap_words, 0);
+		for (uint16_t v : other.values)
+			out.words[v / 64] |= uint64_t(1) << (v % 64);
+		if (bits.kind != roaring_kind::bitmap)
+			for (uint16_t v : bits.values)
+				out.words[v / 64] |= uint64_t(1) << (v % 64);
+	}
+	out.cardinality = static_cast<uint32_t>(bit_words_count(out.words.data(), roaring_bitmap_words));
+	roaring_normalize(out);
+}
+
+inline void roaring_andnot(const roaring_container& a, const roaring_container& b, roaring_container& out)
+{
+	roaring_container tmp, tmp2;
+	const roaring_container& x = roaring_plain(a, tmp);
+	if (x.kind == roaring_kind::array)
+	{
+		out.kind = roaring_kind::array;
+		out.words = vector<uint64_t>();
+		if (b.kind == roaring_kind::array)
+		{
+			out.values.resize(x.cardinality + 8);
+			out.cardinality = static_cast<uint32_t>(roaring_array_match<false>(x.values.data(), x.cardinality, b.values.data(), b.cardinality, out.values.data()));
+			out.values.resize(out.cardinality);
+			return;
+		}
+		out.values.clear();
+		for (uint16_t v : x.values)
+			if (!roaring_contains(b, v))
+				out.values.push_back(v);
+		out.cardinality = static_cast<uint32_t>(out.values.size());
+		return;
+	}
+
+	const roaring_container& y = roaring_plain(b, tmp2);
+	out.kind = roaring_kind::bitmap;
+	out.values = vector<uint16_t>();
+	if (y.kind == roaring_kind::bitmap)
+	{
+		out.words.resize(roaring_bitmap_words);
+		bit_words_apply<bit_op::and_not>(out.words.data(), x.words.data(), y.words.data(), roaring_bitmap_words);
+		out.cardinality = static_cast<uint32_t>(bit_words_count(out.words.data(), roaring_bitmap_words));
+	}
+	else
+	{
+		out.words = x.words;
+		out.cardinality = x.cardinality;
+		for (uint16_t v : y.values)
+		{
+			uint64_t bit = uint64_t(1) << (v % 64);
+			out.cardinality -= (out.words[v / 64] & bit) != 0;
+			out.words[v / 64] &= ~bit;
+		}
+	}
+	roaring_normalize(out);
+}
+
+inline size_t roaring_and_count(const roaring_container& a, const roaring_container& b)
+{
+	if (b.kind == roaring_kind::array && a.kind != roaring_kind::array)
+		return roaring_and_count(b, a);
+	if (b.kind == roaring_kind::run && a.kind == roaring_kind::bitmap)
+		return roaring_and_count(b, a);
+
+	switch (a.kind)
+	{
+	case roaring_kind::array:
+	{
+		if (b.kind == roaring_kind::array)
+		{
+			return a.cardinality <= b.cardinality
+				? roaring_array_match<true>(a.values.data(), a.cardinality, b.values.data(), b.cardinality, nullptr)
+				: roaring_array_match<true>(b.values.data(), b.cardinality, a.values.data(), a.cardinality, nullptr);
+		}
+		size_t count = 0;
+		for (uint16_t v : a.values)
+			count += roaring_contains(b, v);
+		return count;
+	}
+	case roaring_kind::bitmap:	// against a bitmap
+		return roaring_and_count_words(a.words.data(), b.words.data(), roaring_bitmap_words);
+	default:
+	{
+		size_t count = 0;
+		if (b.kind == roaring_kind::bitmap)
+		{
+			for (size_t i = 0; i < a.run_count(); ++i)
+				count += roaring_count_range(b.words.data(), a.values[2 * i], roaring_run_last(a.values.data(), i));
+			return count;
+		}
+		const uint16_t* x = a.values.data();
+		const uint16_t* y = b.values.data();
+		size_t i = 0, j = 0;
+		while (i < a.run_count() && j < b.run_count())
+		{
+			uint32_t first = std::max<uint32_t>(x[2 * i], y[2 * j]);
+			uint32_t last = std::min(roaring_run_last(x, i), roaring_run_last(y, j));
+			if (first <= last)
+				count += last - first + 1;
+			if (roaring_run_last(x, i) < roaring_run_last(y, j))
+				++i;
+			else
+				++j;
+		}
+		return count;
+	}
+	}
+}
+
+// portable format -------------------------------------------------------------
+//
+//	cookie      uint32   12346, or 12347 | (blocks - 1) << 16 when some block is runs
+//	blocks      uint32   only after 12346
+//	run flags   bit i    block i is runs, (blocks + 7) / 8 bytes, only after 12347
+//	keys        uint16   the high 16 bits and the cardinality - 1 of each block
+//	offsets     uint32   where each block starts, from the start of the buffer;
+//	                     after 12347 only when there are at least 4 blocks
+//	blocks      array:  cardinality uint16 values, cardinality <= 4096
+//	            bitmap: 1024 uint64, cardinality > 4096
+//	            runs:   uint16 count, then start and length - 1 uint16 each
+//
+// All of it little endian, and nothing aligned.
+
+inline uint16_t roaring_load16(const unsigned char* p) noexcept
+{
+	return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t roaring_load32(const unsigned char* p) noexcept
+{
+	return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+inline uint64_t roaring_load64(const unsigned char* p) noexcept
+{
+	return uint64_t(roaring_load32(p)) | (uint64_t(roaring_load32(p + 4)) << 32);
+}
+
+inline unsigned char* roaring_store16(unsigned char* p, uint16_t v) noexcept
+{
+	p[0] = static_cast<unsigned char>(v);
+	p[1] = static_cast<unsigned char>(v >> 8);
+	return p + 2;
+}
+
+inline unsigned char* roaring_store32(unsigned char* p, uint32_t v) noexcept
+{
+	roaring_store16(p, static_cast<uint16_t>(v));
+	return roaring_store16(p + 2, static_cast<uint16_t>(v >> 16));
+}
+
+inline unsigned char* roaring_store64(unsigned char* p, uint64_t v) noexcept
+{
+	roaring_store32(p, static_cast<uint32_t>(v));
+	return roaring_store32(p + 4, static_cast<uint32_t>(v >> 32));
+}
+
+// the header of a serialized bitmap, checked against the buffer length
+struct roaring_layout
+{
+	const unsigned char* data{ nullptr };
+	size_t               blocks{ 0 };
+	const unsigned char* run_flags{ nullptr };	// nullptr when no block is runs
+	const unsigned char* keys{ nullptr };
+	vector<uint32_t>     offsets;
+	size_t               size{ 0 };				// the bytes read, header and blocks
+
+	roaring_kind kind(size_t i) const noexcept
+	{
+		if (run_flags && (run_flags[i / 8] >> (i % 8)) & 1)
+			return roaring_kind::run;
+		return cardinality(i) > roaring_array_max ? roaring_kind::bitmap : roaring_kind::array;
+	}
+
+	uint16_t key(size_t i) const noexcept          { return roaring_load16(keys + 4 * i); }
+	uint32_t cardinality(size_t i) const noexcept  { return uint32_t(roaring_load16(keys + 4 * i + 2)) + 1; }
+	const unsigned char* block(size_t i) const noexcept { return data + offsets[i]; }
+
+	explicit roaring_layout(span<const unsigned char> buffer, const char* message)
+		: data(buffer.data())
+	{
+		size_t length = buffer.size();
+		auto need = [&](size_t n)
+		{
+			if (n > length)
+				throw std::invalid_argument(message);
+		};
+
+		need(4);
+		uint32_t cookie = roaring_load32(data);
+		size_t at = 4;
+		if ((cookie & 0xffff) == roaring_run_cookie)
+		{
+			blocks = (cookie >> 16) + 1;
+			run_flags = data + at;
+			at += (blocks + 7) / 8;
+		}
+		else if (cookie == roaring_cookie)
+		{
+			need(8);
+			blocks = roaring_load32(data + 4);
+			at = 8;
+			if (blocks > 65536)
+				throw std::invalid_argument(message);
+		}
+		else
+		{
+			throw std::invalid_argument(message);
+		}
+
+		need(at + 4 * blocks);
+		keys = data + at;
+		at += 4 * blocks;
+		for (size_t i = 1; i < blocks; ++i)
+			if (key(i) <= key(i - 1))
+				throw std::invalid_argument(message);
+
+		offsets.resize(blocks);
+		bool stored = !run_flags || blocks >= roaring_no_offsets;
+		if (stored)
+		{
+			need(at + 4 * blocks);
+			for (size_t i = 0; i < blocks; ++i)
+				offsets[i] = roaring_load32(data + at + 4 * i);
+			at += 4 * blocks;
+		}
+
+		// every block inside the buffer, and where the last one ends
+		for (size_t i = 0; i < blocks; ++i)
+		{
+			if (stored)
+				at = offsets[i];
+			else
+				offsets[i] = static_cast<uint32_t>(at);
+			need(at);
+			switch (kind(i))
+			{
+			case roaring_kind::array:  at += 2 * size_t(cardinality(i)); break;
+			case roaring_kind::bitmap: at += 8 * roaring_bitmap_words; break;
+			default:
+				need(at + 2);
+				at += 2 + 4 * size_t(roaring_load16(data + at));
+				break;
+			}
+			need(at);
+			size = std::max(size, at);
+		}
+		size = std::max(size, at);
+	}
+
+	size_t find(uint16_t high) const noexcept
+	{	// the block of high, blocks if there is none
+		size_t lo = 0, n = blocks;
+		while (n > 0)
+		{
+			size_t half = n / 2;
+			if (key(lo + half) < high)
+			{
+				lo += half + 1;
+				n -= half + 1;
+			}
+			else
+			{
+				n = half;
+			}
+		}
+		return lo < blocks && key(lo) == high ? lo : blocks;
+	}
+
+	bool contains(size_t i, uint16_t low) const noexcept
+	{
+		const unsigned char* p = block(i);
+		switch (kind(i))
+		{
+		case roaring_kind::array:
+		{
+			size_t lo = 0, n = cardinality(i);
+			while (n > 0)
+			{
+				size_t half = n / 2;
+				if (roaring_load16(p + 2 * (lo + half)) < low)
+				{
+					lo += half + 1;
+					n -= half + 1;
+				}
+				else
+				{
+					n = half;
+				}
+			}
+			return lo < cardinality(i) && roaring_load16(p + 2 * lo) == low;
+		}
+		case roaring_kind::bitmap:
+			return (p[low / 8] >> (low % 8)) & 1;		// little endian words are bytes in bit order
+		default:
+		{
+			size_t runs = roaring_load16(p);
+			size_t lo = 0, n = runs;
+			while (n > 0)
+			{	// the runs starting at or before low
+				size_t half = n / 2;
+				if (roaring_load16(p + 2 + 4 * (lo + half)) <= low)
+				{
+					lo += half + 1;
+					n -= half + 1;
+				}
+				else
+				{
+					n = half;
+				}
+			}
+			if (lo == 0)
+				return false;
+			const unsigned char* run = p + 2 + 4 * (lo - 1);
+			return low <= uint32_t(roaring_load16(run)) + roaring_load16(run + 2);
+		}
+		}
+	}
+
+	template<class F>
+	void for_each(size_t i, F& f) const
+	{
+		const unsigned char* p = block(i);
+		uint32_t high = uint32_t(key(i)) << 16;
+		switch (kind(i))
+		{
+		case roaring_kind::array:
+			for (size_t k = 0, n = cardinality(i); k < n; ++k)
+				f(high | roaring_load16(p + 2 * k));
+			break;
+		case roaring_kind::bitmap:
+			for (size_t k = 0; k < roaring_bitmap_words; ++k)
+				for (uint64_t w = roaring_load64(p + 8 * k); w; w &= w - 1)
+					f(high | uint32_t(k * 64 + countr_zero(w)));
+			break;
+		default:
+			for (size_t k = 0, n = roaring_load16(p); k < n; ++k)
+			{
+				uint32_t start = roaring_load16(p + 2 + 4 * k);
+				uint32_t last = std::min<uint32_t>(start + roaring_load16(p + 4 + 4 * k), 65535);
+				for (uint32_t v = start; v <= last; ++v)
+					f(high | v);
+			}
+			break;
+		}
+	}
+};
+
+}	// namespace detail
+
+// roaring_bitmap --------------------------------------------------------------
+
+class roaring_bitmap
+{
+	using container = detail::roaring_container;
+
+public:
+	class const_iterator
+	{	// the values in order
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type        = uint32_t;
+		using difference_type   = ptrdiff_t;
+		using pointer           = const uint32_t*;
+		using reference         = uint32_t;
+
+		const_iterator() noexcept = default;
+
+		uint32_t operator*() const noexcept { return value; }
+
+		const_iterator& operator++() noexcept
+		{
+			const container& c = owner->blocks[block];
+			uint32_t high = value & 0xffff0000u;
+			uint32_t low = value & 0xffff;
+			switch (c.kind)
+			{
+			case detail::roaring_kind::array:
+				if (++index < c.values.size())
+				{
+					value = high | c.values[index];
+					return *this;
+				}
+				break;
+			case detail::roaring_kind::bitmap:
+			{
+				size_t next = low == 0xffff ? size_t(-1) : detail::bit_words_find_next(c.words.data(), detail::roaring_bitmap_words, low + 1);
+				if (next != size_t(-1))
+				{
+					value = high | uint32_t(next);
+					return *this;
+				}
+				break;
+			}
+			default:
+				if (low < detail::roaring_run_last(c.values.data(), index))
+				{
+					++value;
+					return *this;
+				}
+				if (++index < c.run_count())
+				{
+					value = high | c.values[2 * index];
+					return *this;
+				}
+				break;
+			}
+			++block;
+			seek();
+			return *this;
+		}
+
+		const_iterator operator++(int) noexcept
+		{
+			const_iterator tmp = *this;
+			++*this;
+			return tmp;
+		}
+
+		friend bool operator==(const const_iterator& a, const const_iterator& b) noexcept
+		{
+			return a.block == b.block && a.value == b.value;
+		}
+
+		friend bool operator!=(const const_iterator& a, const const_iterator& b) noexcept { return !(a == b); }
+
+	private:
+		friend class roaring_bitmap;
+
+		const_iterator(const roaring_bitmap* owner, size_t block) noexcept
+			: owner(owner), block(block)
+		{
+			seek();
+		}
+
+		void seek() noexcept
+		{	// to the first value of the block, which is not empty, or to end() as 0
+			index = 0;
+			value = 0;
+			if (block == owner->blocks.size())
+				return;
+			const container& c = owner->blocks[block];
+			uint32_t high = uint32_t(owner->keys[block]) << 16;
+			if (c.kind == detail::roaring_kind::bitmap)
+				value = high | uint32_t(detail::bit_words_find_next(c.words.data(), detail::roaring_bitmap_words, 0));
+			else
+				value = high | c.values[0];
+		}
+
+	private:
+		const roaring_bitmap* owner{ nullptr };
+		size_t                block{ 0 };
+		size_t                index{ 0 };	// in the array, or the run
+		uint32_t              value{ 0 };
+	};
+
+	using iterator   = const_iterator;
+	using value_type = uint32_t;
+	using size_type  = size_t;
+
+	// constructors
+
+	roaring_bitmap() = default;
+
+	roaring_bitmap(std::initializer_list<uint32_t> il)
+	{
+		add(il.begin(), il.end());
+	}
+
+	template<class InputIt>
+	roaring_bitmap(InputIt first, InputIt last)
+	{
+		add(first, last);
+	}
+
+	// the values in [first, last)
+	static roaring_bitmap range(uint64_t first, uint64_t last)
+	{
+		roaring_bitmap result;
+		result.add_range(first, last);
+		return result;
+	}
+
+	// iterators
+
+	const_iterator begin() const noexcept { return const_iterator(this, 0); }
+	const_iterator end() const noexcept   { return const_iterator(this, blocks.size()); }
+
+	template<class F>
+	void for_each(F f) const
+	{	// f(value) for each value in order, faster than the iterators
+		for (size_t i = 0; i < blocks.size(); ++i)
+			detail::roaring_for_each(blocks[i], uint32_t(keys[i]) << 16, f);
+	}
+
+	// queries
+
+	bool empty() const noexcept { return blocks.empty(); }
+
+	size_t cardinality() const noexcept
+	{
+		size_t n = 0;
+		for (const container& c : blocks)
+			n += c.cardinality;
+		return n;
+	}
+
+	bool contains(uint32_t value) const noexcept
+	{
+		size_t i = find_block(static_cast<uint16_t>(value >> 16));
+		return i < blocks.size() && keys[i] == (value >> 16) && detail::roaring_contains(blocks[i], static_cast<uint16_t>(value));
+	}
+
+	uint32_t minimum() const
+	{
+		if (empty())
+			throw std::out_of_range("roaring_bitmap::minimum -- the bitmap is empty");
+		return *begin();
+	}
+
+	uint32_t maximum() const
+	{
+		if (empty())
+			throw std::out_of_range("roaring_bitmap::maximum -- the bitmap is empty");
+		const container& c = blocks.back();
+		uint32_t high = uint32_t(keys.back()) << 16;
+		switch (c.kind)
+		{
+		case detail::roaring_kind::array:
+			return high | c.values.back();
+		case detail::roaring_kind::bitmap:
+		{
+			size_t i = detail::roaring_bitmap_words;
+			while (c.words[--i] == 0)
+			{
+			}
+			return high | uint32_t(i * 64 + 63 - countl_zero(c.words[i]));
+		}
+		default:
+			return high | detail::roaring_run_last(c.values.data(), c.run_count() - 1);
+		}
+	}
+
+	// the number of values not greater than value
+	size_t rank(uint32_t value) const noexcept
+	{
+		uint16_t high = static_cast<uint16_t>(value >> 16), low = static_cast<uint16_t>(value);
+		size_t n = 0, i = 0;
+		for (; i < blocks.size() && keys[i] < high; ++i)
+			n += blocks[i].cardinality;
+		if (i == blocks.size() || keys[i] != high)
+			return n;
+
+		const container& c = blocks[i];
+		switch (c.kind)
+		{
+		case detail::roaring_kind::array:
+			return n + (std::upper_bound(c.values.begin(), c.values.end(), low) - c.values.begin());
+		case detail::roaring_kind::bitmap:
+			return n + detail::roaring_count_range(c.words.data(), 0, low);
+		default:
+			for (size_t r = 0; r < c.run_count() && c.values[2 * r] <= low; ++r)
+				n += std::min<uint32_t>(low, detail::roaring_run_last(c.values.data(), r)) - c.values[2 * r] + 1;
+			return n;
+		}
+	}
+
+	// the value of the given rank, from 0
+	uint32_t select(size_t rank) const
+	{
+		for (size_t i = 0; i < blocks.size(); ++i)
+		{
+			const container& c = blocks[i];
+			if (rank >= c.cardinality)
+			{
+				rank -= c.cardinality;
+				continue;
+			}
+			uint32_t high = uint32_t(keys[i]) << 16;
+			switch (c.kind)
+			{
+			case detail::roaring_kind::array:
+				return high | c.values[rank];
+			case detail::roaring_kind::bitmap:
+				for (size_t w = 0;; ++w)
+				{
+					size_t n = popcount(c.words[w]);
+					if (rank < n)
+						return high | uint32_t(w * 64 + select_bit(c.words[w], static_cast<int>(rank)));
+					rank -= n;
+				}
+			default:
+				for (size_t r = 0;; ++r)
+				{
+					size_t n = c.values[2 * r + 1] + size_t(1);
+					if (rank < n)
+						return high | uint32_t(c.values[2 * r] + rank);
+					rank -= n;
+				}
+			}
+		}
+		throw std::out_of_range("roaring_bitmap::select -- rank out of range");
+	}
+
+	// modifiers
+
+	bool add(uint32_t value)
+	{	// true if the value was not there
+		return detail::roaring_add(block_for(static_cast<uint16_t>(value >> 16)), static_cast<uint16_t>(value));
+	}
+
+	template<class InputIt>
+	void add(InputIt first, InputIt last)
+	{
+		for (; first != last; ++first)
+			add(static_cast<uint32_t>(*first));
+	}
+
+	// the values in [first, last), as runs in the blocks they fill
+	void add_range(uint64_t first, uint64_t last)
+	{
+		if (last > (uint64_t(1) << 32))
+			throw std::out_of_range("roaring_bitmap::add_range -- past the 32 bit range");
+		while (first < last)
+		{
+			uint16_t high = static_cast<uint16_t>(first >> 16);
+			uint32_t lo = static_cast<uint32_t>(first & 0xffff);
+			uint32_t hi = static_cast<uint32_t>(std::min<uint64_t>(last - (first & ~uint64_t(0xffff)), 65536));	// exclusive
+			container& c = block_for(high);
+			container range_block;
+			range_block.kind = detail::roaring_kind::run;
+			range_block.values.push_back(static_cast<uint16_t>(lo));
+			range_block.values.push_back(static_cast<uint16_t>(hi - 1 - lo));
+			range_block.cardinality = hi - lo;
+			if (c.cardinality == 0)
+			{
+				c = toy::move(range_block);
+			}
+			else
+			{
+				container merged;
+				detail::roaring_or(c, range_block, merged);
+				c = toy::move(merged);
+			}
+			first = (first & ~uint64_t(0xffff)) + hi;
+		}
+	}
+
+	bool remove(uint32_t value)
+	{	// true if the value was there
+		size_t i = find_block(static_cast<uint16_t>(value >> 16));
+		if (i == blocks.size() || keys[i] != (value >> 16))
+			return false;
+		if (!detail::roaring_remove(blocks[i], static_cast<uint16_t>(value)))
+			return false;
+		if (blocks[i].cardinality == 0)
+		{
+			keys.erase(keys.begin() + i);
+			blocks.erase(blocks.begin() + i);
+		}
+		return true;
+	}
+
+	void clear() noexcept
+	{
+		keys.clear();
+		blocks.clear();
+	}
+
+	// every block as runs where that is smallest; true if any block is runs
+	bool run_optimize()
+	{
+		bool runs = false;
+		for (container& c : blocks)
+		{
+			detail::roaring_run_optimize(c);
+			runs |= c.kind == detail::roaring_kind::run;
+		}
+		return runs;
+	}
+
+	void swap(roaring_bitmap& right) noexcept
+	{
+		keys.swap(right.keys);
+		blocks.swap(right.blocks);
+	}
+
+	// set algebra
+
+	friend roaring_bitmap operator&(const roaring_bitmap& a, const roaring_bitmap& b)
+	{
+		roaring_bitmap result;
+		size_t i = 0, j = 0;
+		while (i < a.blocks.size() && j < b.blocks.size())
+		{
+			if (a.keys[i] < b.keys[j])
+			{
+				++i;
+			}
+			else if (b.keys[j] < a.keys[i])
+			{
+				++j;
+			}
+			else
+			{
+				container c;
+				detail::roaring_and(a.blocks[i], b.blocks[j], c);
+				result.append(a.keys[i], toy::move(c));
+				++i;
+				++j;
+			}
+		}
+		return result;
+	}
+
+	friend roaring_bitmap operator|(const roaring_bitmap& a, const roaring_bitmap& b)
+	{
+		roaring_bitmap result;
+		result.keys.reserve(a.keys.size() + b.keys.size());
+		result.blocks.reserve(a.keys.size() + b.keys.size());
+		size_t i = 0, j = 0;
+		while (i < a.blocks.size() || j < b.blocks.size())
+		{
+			if (j == b.blocks.size() || (i < a.blocks.size() && a.keys[i] < b.keys[j]))
+			{
+				result.append(a.keys[i], container(a.blocks[i]));
+				++i;
+			}
+			else if (i == a.blocks.size() || b.keys[j] < a.keys[i])
+			{
+				result.append(b.keys[j], container(b.blocks[j]));
+				++j;
+			}
+			else
+			{
+				container c;
+				detail::roaring_or(a.blocks[i], b.blocks[j], c);
+				result.append(a.keys[i], toy::move(c));
+				++i;
+				++j;
+			}
+		}
+		return result;
+	}
+
+	friend roaring_bitmap operator-(const roaring_bitmap& a, const roaring_bitmap& b)
+	{	// the values of a not in b
+		roaring_bitmap result;
+		size_t j = 0;
+		for (size_t i = 0; i < a.blocks.size(); ++i)
+		{
+			while (j < b.blocks.size() && b.keys[j] < a.keys[i])
+				++j;
+			if (j < b.blocks.size() && b.keys[j] == a.keys[i])
+			{
+				container c;
+				detail::roaring_andnot(a.blocks[i], b.blocks[j], c);
+				result.append(a.keys[i], toy::move(c));
+			}
+			else
+			{
+				result.append(a.keys[i], container(a.blocks[i]));
+			}
+		}
+		return result;
+	}
+
+	roaring_bitmap& operator&=(const roaring_bitmap& right) { *this = *this & right; return *this; }
+	roaring_bitmap& operator|=(const roaring_bitmap& right) { *this = *this | right; return *this; }
+	roaring_bitmap& operator-=(const roaring_bitmap& right) { *this = *this - right; return *this; }
+
+	// the cardinality of a & b, a | b and a - b, without building them
+
+	friend size_t and_cardinality(const roaring_bitmap& a, const roaring_bitmap& b)
+	{
+		size_t n = 0, i = 0, j = 0;
+		while (i < a.blocks.size() && j < b.blocks.size())
+		{
+			if (a.keys[i] < b.keys[j])
+				++i;
+			else if (b.keys[j] < a.keys[i])
+				++j;
+			else
+				n += detail::roaring_and_count(a.blocks[i++], b.blocks[j++]);
+		}
+		return n;
+	}
+
+	friend size_t or_cardinality(const roaring_bitmap& a, const roaring_bitmap& b)
+	{
+		return a.cardinality() + b.cardinality() - and_cardinality(a, b);
+	}
+
+	friend size_t andnot_cardinality(const roaring_bitmap& a, const roaring_bitmap& b)
+	{
+		return a.cardinality() - and_cardinality(a, b);
+	}
+
+	friend bool intersects(const roaring_bitmap& a, const roaring_bitmap& b)
+	{
+		size_t i = 0, j = 0;
+		while (i < a.blocks.size() && j < b.blocks.size())
+		{
+			if (a.keys[i] < b.keys[j])
+				++i;
+			else if (b.keys[j] < a.keys[i])
+				++j;
+			else if (detail::roaring_and_count(a.blocks[i++], b.blocks[j++]) != 0)
+				return true;
+		}
+		return false;
+	}
+
+	friend bool operator==(const roaring_bitmap& a, const roaring_bitmap& b)
+	{	// the same values, however they are stored
+		if (a.keys.size() != b.keys.size())
+			return false;
+		for (size_t i = 0; i < a.keys.size(); ++i)
+		{
+			if (a.keys[i] != b.keys[i] || a.blocks[i].cardinality != b.blocks[i].cardinality)
+				return false;
+			if (detail::roaring_and_count(a.blocks[i], b.blocks[i]) != a.blocks[i].cardinality)
+				return false;
+		}
+		return true;
+	}
+
+	friend bool operator!=(const roaring_bitmap& a, const roaring_bitmap& b) { return !(a == b); }
+
+	// serialization
+
+	size_t serialized_size() const noexcept
+	{
+		bool runs = has_runs();
+		size_t n = blocks.size();
+		size_t size = runs ? 4 + (n + 7) / 8 : 8;
+		size += 4 * n;
+		if (!runs || n >= detail::roaring_no_offsets)
+			size += 4 * n;
+		for (const container& c : blocks)
+			size += detail::roaring_size_as(c.kind, c.cardinality, c.run_count());
+		return size;
+	}
+
+	// the portable format, serialized_size() bytes; returns that size
+	size_t serialize(span<unsigned char> out) const
+	{
+		size_t size = serialized_size();
+		if (out.size() < size)
+			throw std::length_error("roaring_bitmap::serialize -- buffer too small");
+
+		bool runs = has_runs();
+		size_t n = blocks.size();
+		unsigned char* p = out.data();
+		if (runs)
+		{
+			p = detail::roaring_store32(p, detail::roaring_run_cookie | uint32_t(n - 1) << 16);
+			std::memset(p, 0, (n + 7) / 8);
+			for (size_t i = 0; i < n; ++i)
+				if (blocks[i].kind == detail::roaring_kind::run)
+					p[i / 8] |= static_cast<unsigned char>(1 << (i % 8));
+			p += (n + 7) / 8;
+		}
+		else
+		{
+			p = detail::roaring_store32(p, detail::roaring_cookie);
+			p = detail::roaring_store32(p, static_cast<uint32_t>(n));
+		}
+		for (size_t i = 0; i < n; ++i)
+		{
+			p = detail::roaring_store16(p, keys[i]);
+			p = detail::roaring_store16(p, static_cast<uint16_t>(blocks[i].cardinality - 1));
+		}
+		if (!runs || n >= detail::roaring_no_offsets)
+		{
+			size_t offset = (p - out.data()) + 4 * n;
+			for (const container& c : blocks)
+			{
+				p = detail::roaring_store32(p, static_cast<uint32_t>(offset));
+				offset += detail::roaring_size_as(c.kind, c.cardinality, c.run_count());
+			}
+		}
+		for (const container& c : blocks)
+		{
+			switch (c.kind)
+			{
+			case detail::roaring_kind::array:
+				for (uint16_t v : c.values)
+					p = detail::roaring_store16(p, v);
+				break;
+			case detail::roaring_kind::bitmap:
+				for (uint64_t w : c.words)
+					p = detail::roaring_store64(p, w);
+				break;
+			default:
+				p = detail::roaring_store16(p, static_cast<uint16_t>(c.run_count()));
+				for (uint16_t v : c.values)
+					p = detail::roaring_store16(p, v);
+				break;
+			}
+		}
+		return size;
+	}
+
+	static roaring_bitmap deserialize(span<const unsigned char> data)
+	{
+		const char* message = "roaring_bitmap::deserialize -- not a serialized bitmap";
+		detail::roaring_layout layout(data, message);
+		roaring_bitmap result;
+		result.keys.reserve(layout.blocks);
+		result.blocks.reserve(layout.blocks);
+		for (size_t i = 0; i < layout.blocks; ++i)
+		{
+			const unsigned char* p = layout.block(i);
+			container c;
+			c.kind = layout.kind(i);
+			c.cardinality = layout.cardinality(i);
+			switch (c.kind)
+			{
+			case detail::roaring_kind::array:
+				c.values.resize(c.cardinality);
+				for (size_t k = 0; k < c.cardinality; ++k)
+					c.values[k] = detail::roaring_load16(p + 2 * k);
+				for (size_t k = 1; k < c.cardinality; ++k)
+					if (c.values[k] <= c.values[k - 1])
+						throw std::invalid_argument(message);
+				break;
+			case detail::roaring_kind::bitmap:
+				c.words.resize(detail::roaring_bitmap_words);
+				for (size_t k = 0; k < detail::roaring_bitmap_words; ++k)
+					c.words[k] = detail::roaring_load64(p + 8 * k);
+				if (detail::bit_words_count(c.words.data(), detail::roaring_bitmap_words) != c.cardinality)
+					throw std::invalid_argument(message);
+				break;
+			default:
+			{
+				size_t runs = detail::roaring_load16(p);
+				c.values.resize(2 * runs);
+				uint32_t count = 0, next = 0;
+				for (size_t k = 0; k < 2 * runs; ++k)
+					c.values[k] = detail::roaring_load16(p + 2 + 2 * k);
+				for (size_t k = 0; k < runs; ++k)
+				{	// sorted, apart and inside the block
+					uint32_t last = detail::roaring_run_last(c.values.data(), k);
+					if ((k > 0 && c.values[2 * k] < next) || last > 65535)
+						throw std::invalid_argument(message);
+					count += last - c.values[2 * k] + 1;
+					next = last + 1;
+				}
+				if (runs == 0 || count != c.cardinality)
+					throw std::invalid_argument(message);
+				break;
+			}
+			}
+			result.append(layout.key(i), toy::move(c));
+		}
+		return result;
+	}
+
+private:
+	friend class roaring_bitmap_view;
+
+	size_t find_block(uint16_t high) const noexcept
+	{	// the first block not below high
+		return static_cast<size_t>(std::lower_bound(keys.begin(), keys.end(), high) - keys.begin());
+	}
+
+	container& block_for(uint16_t high)
+	{	// the block of high, a new empty one if there is none
+		size_t i = find_block(high);
+		if (i == keys.size() || keys[i] != high)
+		{
+			blocks.insert(blocks.begin() + i, container());
+			try
+			{
+				keys.insert(keys.begin() + i, high);
+			}
+			catch (...)
+			{
+				blocks.erase(blocks.begin() + i);
+				throw;
+			}
+		}
+		return blocks[i];
+	}
+
+	void append(uint16_t high, container&& c)
+	{	// a block after the last, dropped if empty
+		if (c.cardinality == 0)
+			return;
+		keys.push_back(high);
+		blocks.push_back(toy::move(c));
+	}
+
+	bool has_runs() const noexcept
+	{
+		for (const container& c : blocks)
+			if (c.kind == detail::roaring_kind::run)
+				return true;
+		return false;
+	}
+
+private:
+	vector<uint16_t>  keys;		// the high 16 bits of each block, ascending
+	vector<container> blocks;	// none of them empty
+};
+
+inline void swap(roaring_bitmap& a, roaring_bitmap& b) noexcept
+{
+	a.swap(b);
+}
+
+// roaring_bitmap_view ---------------------------------------------------------
+// a serialized roaring_bitmap, queried where it is. The buffer must outlive
+// the view; it is checked to hold the blocks its header names, not that
+// their values are sorted
+
+class roaring_bitmap_view
+{
+public:
+	explicit roaring_bitmap_view(span<const unsigned char> data)
+		: layout(data, "roaring_bitmap_view -- not a serialized bitmap")
+	{
+	}
+
+	bool empty() const noexcept { return layout.blocks == 0; }
+
+	size_t cardinality() const noexcept
+	{	// from the header alone
+		size_t n = 0;
+		for (size_t i = 0; i < layout.blocks; ++i)
+			n += layout.cardinality(i);
+		return n;
+	}
+
+	bool contains(uint32_t value) const noexcept
+	{
+		size_t i = layout.find(static_cast<uint16_t>(value >> 16));
+		return i < layout.blocks && layout.contains(i, static_cast<uint16_t>(value));
+	}
+
+	template<class F>
+	void for_each(F f) const
+	{
+		for (size_t i = 0; i < layout.blocks; ++i)
+			layout.for_each(i, f);
+	}
+
+	// the bytes of the serialized bitmap, from the start of the buffer
+	size_t serialized_size() const noexcept { return layout.size; }
+
+	roaring_bitmap to_bitmap() const
+	{
+		return roaring_bitmap::deserialize(span<const unsigned char>(layout.data, layout.size));
+	}
+
+private:
+	detail::roaring_layout layout;
+};
+
+}	// namespace toy
+
+#endif // TOY_CORE_ROARING_BITMAP_H
@@ -0,0 +1,302 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_SLOT_MAP_H
+#define TOY_CORE_SLOT_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+#include "toy/core/functional.h"
+#include "toy/core/memory.h"
+#include "toy/core/type_traits.h"
+#include "toy/core/vector.h"
+
+namespace toy
+{
+
+// slot_map_key ----------------------------------------------------------------
+// a 64 bit handle into a slot_map: the index of a slot and the generation
+// the slot had when the value was inserted. Erasing bumps the generation, so
+// a key kept past the erase no longer matches and finds nothing. Live
+// generations are odd, so the default key {0, 0} is a null key. A slot whose
+// generation would wrap around is retired for good rather than reused, since
+// keys of its first generations would match again after 2^31 reuses
+
+struct slot_map_key
+{
+	uint32_t index{ 0 };
+	uint32_t generation{ 0 };
+
+	constexpr uint64_t to_integer() const noexcept
+	{
+		return (uint64_t(generation) << 32) | index;
+	}
+
+	static constexpr slot_map_key from_integer(uint64_t value) noexcept
+	{
+		return slot_map_key{ static_cast<uint32_t>(value), static_cast<uint32_t>(value >> 32) };
+	}
+
+	constexpr bool is_null() const noexcept { return (generation & 1) == 0; }
+
+	friend constexpr bool operator==(slot_map_key a, slot_map_key b) noexcept
+	{
+		return a.index == b.index && a.generation == b.generation;
+	}
+
+	friend constexpr bool operator!=(slot_map_key a, slot_map_key b) noexcept { return !(a == b); }
+};
+
+template<>
+struct hash<slot_map_key>
+{
+	size_t operator()(slot_map_key key) const noexcept
+	{
+		return static_cast<size_t>(hash_mix(key.to_integer()));
+	}
+};
+
+// slot_map --------------------------------------------------------------------
+
+// The values are kept packed in one array in no particular order, so a loop
+// over a slot_map is a loop over a vector. The keys point at slots, and a
+// slot points at the dense position of its value:
+//
+//	key.index -> slots[index] { dense position, generation } -> values[position]
+//
+// erase moves the last value into the hole and repoints its slot, insert
+// appends and takes a slot from the free list; both are O(1) and neither
+// invalidates the keys of other values. Pointers and iterators into the
+// values are invalidated like those of a vector.
+template<typename T, typename Allocator = allocator<T>>
+class slot_map
+{
+private:
+	struct slot
+	{
+		uint32_t position;		// into values when occupied, the next free slot when not
+		uint32_t generation;	// odd when occupied
+	};
+
+	using alloc_traits      = std::allocator_traits<Allocator>;
+	using slot_allocator    = typename alloc_traits::template rebind_alloc<slot>;
+	using index_allocator   = typename alloc_traits::template rebind_alloc<uint32_t>;
+
+	static constexpr uint32_t end_of_free_list = ~uint32_t(0);
+
+public:
+	using key_type               = slot_map_key;
+	using value_type             = T;
+	using allocator_type         = Allocator;
+	using size_type              = size_t;
+	using difference_type        = ptrdiff_t;
+	using reference              = value_type&;
+	using const_reference        = const value_type&;
+	using pointer                = value_type*;
+	using const_pointer          = const value_type*;
+	using iterator               = typename vector<T, Allocator>::iterator;
+	using const_iterator         = typename vector<T, Allocator>::const_iterator;
+
+	// one slot stays unused for the free list terminator
+	static constexpr size_type max_slots = end_of_free_list - 1;
+
+	slot_map() = default;
+
+	explicit slot_map(const allocator_type& a)
+		: values(a), keys(index_allocator(a)), slots(slot_allocator(a))
+	{
+	}
+
+	allocator_type get_allocator() const noexcept { return values.get_allocator(); }
+
+	// iterators, over the dense values
+
+	iterator       begin() noexcept        { return values.begin(); }
+	const_iterator begin() const noexcept  { return values.begin(); }
+	const_iterator cbegin() const noexcept { return values.begin(); }
+	iterator       end() noexcept          { return values.end(); }
+	const_iterator end() const noexcept    { return values.end(); }
+	const_iterator cend() const noexcept   { return values.end(); }
+
+	pointer       data() noexcept       { return values.data(); }
+	const_pointer data() const noexcept { return values.data(); }
+
+	// capacity
+
+	bool      empty() const noexcept    { return values.empty(); }
+	size_type size() const noexcept     { return values.size(); }
+	size_type capacity() const noexcept { return values.capacity(); }
+
+	void reserve(size_type n)
+	{
+		values.reserve(n);
+		keys.reserve(n);
+		slots.reserve(n);
+	}
+
+	// lookup
+
+	bool contains(key_type key) const noexcept { return find_position(key) != npos; }
+
+	pointer find(key_type key) noexcept
+	{	// nullptr for a stale or null key
+		size_type pos = find_position(key);
+		return pos != npos ? values.data() + pos : nullptr;
+	}
+
+	const_pointer find(key_type key) const noexcept
+	{
+		size_type pos = find_position(key);
+		return pos != npos ? values.data() + pos : nullptr;
+	}
+
+	reference at(key_type key)
+	{
+		pointer p = find(key);
+		if (p == nullptr)
+			throw std::out_of_range("slot_map::at -- stale or invalid key");
+		return *p;
+	}
+
+	const_reference at(key_type key) const
+	{
+		const_pointer p = find(key);
+		if (p == nullptr)
+			throw std::out_of_range("slot_map::at -- stale or invalid key");
+		return *p;
+	}
+
+	// unchecked, the key must be live
+	reference       operator[](key_type key) noexcept       { return values[slots[key.index].position]; }
+	const_reference operator[](key_type key) const noexcept { return values[slots[key.index].position]; }
+
+	key_type key_of(const_iterator it) const noexcept
+	{	// the key of the value at 'it'
+		uint32_t index = keys[static_cast<size_type>(it - values.begin())];
+		return key_type{ index, slots[index].generation };
+	}
+
+	// modifiers
+
+	template<class... Args>
+	key_type emplace(Args&&... args)
+	{
+		if (free_head == end_of_free_list)
+		{	// a new slot, through the free list so a throw below leaves it there
+			if (slots.size() >= max_slots)
+				throw std::length_error("slot_map::emplace -- too many slots");
+			slots.push_back(slot{ end_of_free_list, 0 });
+			free_head = static_cast<uint32_t>(slots.size() - 1);
+		}
+		if (keys.size() == keys.capacity())
+			keys.reserve(values.capacity() > keys.size() ? values.capacity() : keys.size() * 2 + 1);
+
+		values.emplace_back(toy::forward<Args>(args)...);
+		uint32_t index = free_head;
+		keys.push_back(index);	// no reallocation, it can't throw
+
+		slot& s = slots[index];
+		free_head = s.position;
+		s.position = static_cast<uint32_t>(values.size() - 1);
+		++s.generation;
+		return key_type{ index, s.generation };
+	}
+
+	key_type insert(const value_type& value) { return emplace(value); }
+	key_type insert(value_type&& value)      { return emplace(toy::move(value)); }
+
+	bool erase(key_type key)
+	{	// false for a stale key
+		size_type pos = find_position(key);
+		if (pos == npos)
+			return false;
+		erase_at(pos);
+		return true;
+	}
+
+	iterator erase(const_iterator it)
+	{	// the last value moves into 'it', which then points at the next one to visit
+		size_type pos = static_cast<size_type>(it - values.begin());
+		erase_at(pos);
+		return values.begin() + pos;
+	}
+
+	void clear() noexcept
+	{	// every key handed out so far goes stale
+		for (uint32_t index : keys)
+			release(index);
+		values.clear();
+		keys.clear();
+	}
+
+	void swap(slot_map& right) noexcept
+	{
+		values.swap(right.values);
+		keys.swap(right.keys);
+		slots.swap(right.slots);
+		toy::swap(free_head, right.free_head);
+	}
+
+private:
+	static constexpr size_type npos = ~size_type(0);
+
+	size_type find_position(key_type key) const noexcept
+	{
+		if (key.index >= slots.size())
+			return npos;
+		const slot& s = slots[key.index];
+		if (s.generation != key.generation || (key.generation & 1) == 0)
+			return npos;
+		return s.position;
+	}
+
+	void erase_at(size_type pos)
+	{
+		size_type last = values.size() - 1;
+		uint32_t index = keys[pos];
+		if (pos != last)
+		{
+			values[pos] = toy::move(values[last]);
+			keys[pos] = keys[last];
+			slots[keys[pos]].position = static_cast<uint32_t>(pos);
+		}
+		values.pop_back();
+		keys.pop_back();
+		release(index);
+	}
+
+	void release(uint32_t index) noexcept
+	{	// an even generation for the slot, it goes to the front of the free list
+		slot& s = slots[index];
+		if (++s.generation == 0)
+		{	// wrapped, the slot is retired: it leaves the free list and no key matches it again
+			s.position = end_of_free_list;
+			return;
+		}
+		s.position = free_head;
+		free_head = index;
+	}
+
+private:
+	vector<T, Allocator>                values;
+	vector<uint32_t, index_allocator>   keys;		// the slot of values[i]
+	vector<slot, slot_allocator>        slots;
+	uint32_t                            free_head{ end_of_free_list };
+};
+
+template<typename T, typename A>
+inline void swap(slot_map<T, A>& a, slot_map<T, A>& b) noexcept
+{
+	a.swap(b);
+}
+
+template<typename T, typename A>
+struct is_trivially_relocatable<slot_map<T, A>> : is_trivially_relocatable<A> {};
+
+}	// namespace toy
+
+#endif // TOY_CORE_SLOT_MAP_H
@@ -0,0 +1,528 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_SOA_VECTOR_H
+#define TOY_CORE_SOA_VECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "toy/core/memory.h"
+#include "toy/core/span.h"
+#include "toy/core/type_traits.h"
+#include "toy/core/utility.h"
+#include "toy/core/vector.h"
+
+namespace toy
+{
+
+// soa_vector ------------------------------------------------------------------
+
+// A vector of rows stored as a structure of arrays: every field has its own
+// contiguous column, so a loop over one field reads only that field, with
+// unit stride, and vectorizes.
+//
+//	soa_vector<float, float, float, int> particles;	// x, y, z, id
+//	particles.push_back(0.f, 1.f, 2.f, 7);
+//	for (float& x : particles.column<0>())
+//		x += 1.f;
+//	auto [x, y, z, id] = particles[0];				// references into the columns
+//
+// All columns share one allocation, each starts on a 64 byte boundary, and
+// they grow together with the growth policy of vector_base. A row is a
+// std::tuple of references, so it supports std::get, structured bindings and
+// assignment from a tuple of values.
+template<class... Fields>
+class soa_vector : private vector_base<unsigned char, allocator<unsigned char>>
+{
+	static_assert(sizeof...(Fields) > 0, "soa_vector needs at least one field");
+
+	using base = vector_base<unsigned char, allocator<unsigned char>>;
+
+	using indexes = std::index_sequence_for<Fields...>;
+
+	static constexpr size_t max_of(std::initializer_list<size_t> values) noexcept
+	{
+		size_t m = 0;
+		for (size_t v : values)
+			m = v > m ? v : m;
+		return m;
+	}
+
+	static constexpr bool nothrow_relocatable =
+		((is_trivially_relocatable<Fields>::value || std::is_nothrow_move_constructible<Fields>::value) && ...);
+
+public:
+	using value_type             = std::tuple<Fields...>;
+	using reference              = std::tuple<Fields&...>;
+	using const_reference        = std::tuple<const Fields&...>;
+	using size_type              = size_t;
+	using difference_type        = ptrdiff_t;
+
+	template<size_t I>
+	using field_type = std::tuple_element_t<I, value_type>;
+
+	static constexpr size_t column_count     = sizeof...(Fields);
+	static constexpr size_t column_alignment = max_of({ size_t(64), alignof(Fields)... });
+
+	template<bool Const> class row_iterator;
+
+	using iterator               = row_iterator<false>;
+	using const_iterator         = row_iterator<true>;
+
+	soa_vector() = default;
+
+	explicit soa_vector(size_type n)
+	{
+		resize(n);
+	}
+
+	soa_vector(size_type n, const Fields&... values)
+	{
+		resize(n, values...);
+	}
+
+	soa_vector(const soa_vector& right)
+		: base()
+	{
+		reserve(right.count);
+		construct_columns(indexes(), columns, 0, right.count, [&](auto first, auto last, auto i) {
+			auto source = std::get<decltype(i)::value>(right.columns);
+			std::uninitialized_copy(source, source + (last - first), first);
+		});
+		count = right.count;
+	}
+
+	soa_vector(soa_vector&& right) noexcept
+	{
+		swap(right);
+	}
+
+	~soa_vector()
+	{
+		destroy_rows(0, count);
+	}
+
+	soa_vector& operator=(const soa_vector& right)
+	{
+		if (this != &right)
+			soa_vector(right).swap(*this);
+		return *this;
+	}
+
+	soa_vector& operator=(soa_vector&& right) noexcept
+	{
+		soa_vector(toy::move(right)).swap(*this);
+		return *this;
+	}
+
+	// iterators, over rows
+
+	iterator       begin() noexcept        { return iterator(this, 0); }
+	const_iterator begin() const noexcept  { return const_iterator(this, 0); }
+	const_iterator cbegin() const noexcept { return const_iterator(this, 0); }
+	iterator       end() noexcept          { return iterator(this, count); }
+	const_iterator end() const noexcept    { return const_iterator(this, count); }
+	const_iterator cend() const noexcept   { return const_iterator(this, count); }
+
+	// capacity
+
+	bool      empty() const noexcept    { return count == 0; }
+	size_type size() const noexcept     { return count; }
+	size_type capacity() const noexcept { return rows; }
+
+	size_type max_size() const noexcept
+	{
+		return (max_capacity() - (column_count + 1) * column_alignment) / (sizeof(Fields) + ...);
+	}
+
+	void reserve(size_type n)
+	{
+		if (n > rows)
+		{
+			if (n > max_size())
+				throw std::length_error("soa_vector::reserve -- capacity too large");
+			reallocate(n);
+		}
+	}
+
+	void shrink_to_fit()
+	{
+		if (count < rows)
+			reallocate(count);
+	}
+
+	// element access
+
+	reference       operator[](size_type i) noexcept       { return row(indexes(), i); }
+	const_reference operator[](size_type i) const noexcept { return row(indexes(), i); }
+
+	reference at(size_type i)
+	{
+		if (i >= count)
+			throw std::out_of_range("soa_vector::at -- invalid position");
+		return row(indexes(), i);
+	}
+
+	const_reference at(size_type i) const
+	{
+		if (i >= count)
+			throw std::out_of_range("soa_vector::at -- invalid position");
+		return row(indexes(), i);
+	}
+
+	reference       front() noexcept       { return row(indexes(), 0); }
+	const_reference front() const noexcept { return row(indexes(), 0); }
+	reference       back() noexcept        { return row(indexes(), count - 1); }
+	const_reference back() const noexcept  { return row(indexes(), count - 1); }
+
+	// the I-th field of every row, 64 byte aligned
+	template<size_t I>
+	span<field_type<I>> column() noexcept { return span<field_type<I>>(std::get<I>(columns), count); }
+
+	template<size_t I>
+	span<const field_type<I>> column() const noexcept { return span<const field_type<I>>(std::get<I>(columns), count); }
+
+	template<size_t I>
+	field_type<I>* data() noexcept { return std::get<I>(columns); }
+
+	template<size_t I>
+	const field_type<I>* data() const noexcept { return std::get<I>(columns); }
+
+	// modifiers
+
+	template<class... Args>
+	reference emplace_back(Args&&... args)
+	{	// one argument per field
+		static_assert(sizeof...(Args) == column_count, "soa_vector::emplace_back -- one argument per field");
+		auto values = std::forward_as_tuple(toy::forward<Args>(args)...);
+		auto construct_row = [&](column_pointers& dest) {
+			construct_columns(indexes(), dest, count, count + 1, [&](auto first, auto, auto i) {
+				using field = std::remove_pointer_t<decltype(first)>;
+				::new(static_cast<void*>(first)) field(std::get<decltype(i)::value>(toy::move(values)));
+			});
+		};
+
+		if (count == rows)	// the arguments may be fields of this vector, the new row is made before the old columns go
+			reallocate(grow_capacity(count + 1), construct_row);
+		else
+			construct_row(columns);
+		++count;
+		return back();
+	}
+
+	void push_back(const Fields&... values) { emplace_back(values...); }
+	void push_back(Fields&&... values)      { emplace_back(toy::move(values)...); }
+
+	void pop_back() noexcept
+	{
+		destroy_rows(count - 1, count);
+		--count;
+	}
+
+	void resize(size_type n)
+	{	// new rows are value initialized
+		if (n <= count)
+			return erase_at_end(n);
+		reserve_for(n);
+		construct_columns(indexes(), columns, count, n, [](auto first, auto last, auto) {
+			std::uninitialized_value_construct(first, last);
+		});
+		count = n;
+	}
+
+	void resize(size_type n, const Fields&... values)
+	{
+		if (n <= count)
+			return erase_at_end(n);
+		reserve_for(n);
+		auto fill = std::forward_as_tuple(values...);
+		construct_columns(indexes(), columns, count, n, [&](auto first, auto last, auto i) {
+			std::uninitialized_fill(first, last, std::get<decltype(i)::value>(fill));
+		});
+		count = n;
+	}
+
+	iterator erase(const_iterator pos)
+	{	// keeps the order, every column shifts down by one
+		size_type i = pos.index;
+		move_down(indexes(), i);
+		pop_back();
+		return iterator(this, i);
+	}
+
+	void swap_erase(size_type i)
+	{	// O(1), the last row takes the place of row i
+		if (i + 1 != count)
+			move_row(indexes(), count - 1, i);
+		pop_back();
+	}
+
+	void clear() noexcept { erase_at_end(0); }
+
+	void swap(soa_vector& right) noexcept
+	{
+		toy::swap(storage.begin, right.storage.begin);
+		toy::swap(storage.end, right.storage.end);
+		toy::swap(storage.capacity, right.storage.capacity);
+		toy::swap(columns, right.columns);
+		toy::swap(count, right.count);
+		toy::swap(rows, right.rows);
+	}
+
+	// row_iterator, a random access iterator of proxy rows like that of
+	// vector<bool>: operator* returns the tuple of references by value
+	template<bool Const>
+	class row_iterator
+	{
+		using owner_type = conditional_t<Const, const soa_vector, soa_vector>;
+
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type        = soa_vector::value_type;
+		using difference_type   = ptrdiff_t;
+		using reference         = conditional_t<Const, soa_vector::const_reference, soa_vector::reference>;
+		using pointer           = void;
+
+		row_iterator() noexcept = default;
+
+		template<bool C = Const, class = enable_if_t<C>>
+		row_iterator(const row_iterator<false>& right) noexcept
+			: owner(right.owner), index(right.index)
+		{
+		}
+
+		reference operator*() const noexcept                   { return (*owner)[index]; }
+		reference operator[](difference_type n) const noexcept { return (*owner)[index + n]; }
+
+		row_iterator& operator++() noexcept { ++index; return *this; }
+		row_iterator& operator--() noexcept { --index; return *this; }
+		row_iterator  operator++(int) noexcept { row_iterator tmp = *this; ++index; return tmp; }
+		row_iterator  operator--(int) noexcept { row_iterator tmp = *this; --index; return tmp; }
+
+		row_iterator& operator+=(difference_type n) noexcept { index += n; return *this; }
+		row_iterator& operator-=(difference_type n) noexcept { index -= n; return *this; }
+
+		friend row_iterator operator+(row_iterator it, difference_type n) noexcept { return it += n; }
+		friend row_iterator operator+(difference_type n, row_iterator it) noexcept { return it += n; }
+		friend row_iterator operator-(row_iterator it, difference_type n) noexcept { return it -= n; }
+
+		friend difference_type operator-(const row_iterator& a, const row_iterator& b) noexcept
+		{
+			return static_cast<difference_type>(a.index) - static_cast<difference_type>(b.index);
+		}
+
+		friend bool operator==(const row_iterator& a, const row_iterator& b) noexcept { return a.index == b.index; }
+		friend bool operator!=(const row_iterator& a, const row_iterator& b) noexcept { return a.index != b.index; }
+		friend bool operator<(const row_iterator& a, const row_iterator& b) noexcept  { return a.index < b.index; }
+		friend bool operator>(const row_iterator& a, const row_iterator& b) noexcept  { return a.index > b.index; }
+		friend bool operator<=(const row_iterator& a, const row_iterator& b) noexcept { return a.index <= b.index; }
+		friend bool operator>=(const row_iterator& a, const row_iterator& b) noexcept { return a.index >= b.index; }
+
+	private:
+		friend class soa_vector;
+		template<bool> friend class row_iterator;
+
+		row_iterator(owner_type* owner, size_type index) noexcept
+			: owner(owner), index(index)
+		{
+		}
+
+	private:
+		owner_type* owner{ nullptr };
+		size_type   index{ 0 };
+	};
+
+private:
+	using column_pointers = std::tuple<Fields*...>;
+
+	template<size_t... I>
+	reference row(std::index_sequence<I...>, size_type i) noexcept
+	{
+		return reference(std::get<I>(columns)[i]...);
+	}
+
+	template<size_t... I>
+	const_reference row(std::index_sequence<I...>, size_type i) const noexcept
+	{
+		return const_reference(std::get<I>(columns)[i]...);
+	}
+
+	template<size_t... I>
+	void move_row(std::index_sequence<I...>, size_type from, size_type to)
+	{
+		((std::get<I>(columns)[to] = toy::move(std::get<I>(columns)[from])), ...);
+	}
+
+	static size_type align_up(size_type n) noexcept
+	{
+		return (n + column_alignment - 1) & ~(column_alignment - 1);
+	}
+
+	static size_type block_bytes(size_type n) noexcept
+	{	// the columns of n rows, and the slack to align the first one
+		if (n == 0)
+			return 0;
+		size_type bytes = 0;
+		for (size_type size : { sizeof(Fields)... })
+			bytes = align_up(bytes) + n * size;
+		return bytes + column_alignment - 1;
+	}
+
+	template<size_t... I>
+	static column_pointers layout(std::index_sequence<I...>, unsigned char* block, size_type n) noexcept
+	{
+		if (block == nullptr)
+			return column_pointers();
+		unsigned char* first = reinterpret_cast<unsigned char*>(align_up(reinterpret_cast<uintptr_t>(block)));
+		size_type offsets[column_count];
+		size_type bytes = 0, k = 0;
+		for (size_type size : { sizeof(Fields)... })
+		{
+			bytes = align_up(bytes);
+			offsets[k++] = bytes;
+			bytes += n * size;
+		}
+		return column_pointers(reinterpret_cast<Fields*>(first + offsets[I])...);
+	}
+
+	size_type grow_capacity(size_type needed) const
+	{
+		if (needed > max_size())
+			throw std::length_error("soa_vector -- size too large");
+		size_type n = get_new_capacity(rows, needed);
+		return n < max_size() ? n : max_size();
+	}
+
+	void reserve_for(size_type n)
+	{
+		if (n > rows)
+			reallocate(grow_capacity(n));
+	}
+
+	void reallocate(size_type n)
+	{
+		reallocate(n, nullptr);
+	}
+
+	template<class ConstructLast>
+	void reallocate(size_type n, ConstructLast construct_last)
+	{	// every column to a new block of n rows, after the row at count is constructed there unless construct_last is nullptr
+		constexpr bool with_last = !std::is_same<ConstructLast, std::nullptr_t>::value;
+		size_type bytes = block_bytes(n);
+		unsigned char* block = do_allocate(bytes);
+		column_pointers fresh = layout(indexes(), block, n);
+
+		if constexpr (with_last)
+		{
+			try
+			{
+				construct_last(fresh);
+			}
+			catch (...)
+			{
+				do_free(block, bytes);
+				throw;
+			}
+		}
+
+		if constexpr (nothrow_relocatable)
+		{
+			relocate_columns(indexes(), fresh);
+		}
+		else
+		{	// the old rows stay intact until every column is moved
+			try
+			{
+				construct_columns(indexes(), fresh, 0, count, [&](auto first, auto last, auto i) {
+					auto source = std::get<decltype(i)::value>(columns);
+					std::uninitialized_move(source, source + (last - first), first);
+				});
+			}
+			catch (...)
+			{
+				if constexpr (with_last)
+					destroy_columns(indexes(), fresh, count, count + 1, column_count);
+				do_free(block, bytes);
+				throw;
+			}
+			destroy_rows(0, count);
+		}
+
+		do_free(storage.begin, static_cast<size_type>(storage.capacity - storage.begin));
+		storage.begin    = block;
+		storage.end      = block;
+		storage.capacity = block + bytes;
+		columns          = fresh;
+		rows             = n;
+	}
+
+	template<size_t... I>
+	void relocate_columns(std::index_sequence<I...>, column_pointers& dest) noexcept
+	{
+		(toy::uninitialized_relocate(std::get<I>(columns), std::get<I>(columns) + count, std::get<I>(dest)), ...);
+	}
+
+	template<size_t... I, class Construct>
+	void construct_columns(std::index_sequence<I...>, column_pointers& dest, size_type from, size_type to, Construct construct)
+	{	// the rows [from, to) of every column, all or nothing
+		size_type done = 0;
+		try
+		{
+			((construct(std::get<I>(dest) + from, std::get<I>(dest) + to, std::integral_constant<size_t, I>()), ++done), ...);
+		}
+		catch (...)
+		{
+			destroy_columns(indexes(), dest, from, to, done);
+			throw;
+		}
+	}
+
+	void destroy_rows(size_type from, size_type to) noexcept
+	{
+		destroy_columns(indexes(), columns, from, to, column_count);
+	}
+
+	template<size_t... I>
+	static void destroy_columns(std::index_sequence<I...>, column_pointers& dest, size_type from, size_type to, size_type ncolumns) noexcept
+	{	// the rows [from, to) of the first ncolumns columns
+		((I < ncolumns ? std::destroy(std::get<I>(dest) + from, std::get<I>(dest) + to) : void()), ...);
+	}
+
+	template<size_t... I>
+	void move_down(std::index_sequence<I...>, size_type i)
+	{	// rows (i, count) to [i, count - 1)
+		(std::move(std::get<I>(columns) + i + 1, std::get<I>(columns) + count, std::get<I>(columns) + i), ...);
+	}
+
+	void erase_at_end(size_type n) noexcept
+	{
+		destroy_rows(n, count);
+		count = n;
+	}
+
+private:
+	column_pointers columns;
+	size_type       count{ 0 };
+	size_type       rows{ 0 };
+};
+
+template<class... Fields>
+inline void swap(soa_vector<Fields...>& a, soa_vector<Fields...>& b) noexcept
+{
+	a.swap(b);
+}
+
+template<class... Fields>
+struct is_trivially_relocatable<soa_vector<Fields...>> : true_type {};
+
+}	// namespace toy
+
+#endif // TOY_CORE_SOA_VECTOR_H
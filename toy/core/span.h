@@ -0,0 +1,174 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_SPAN_H
+#define TOY_CORE_SPAN_H
+
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+#include "toy/core/type_traits.h"
+
+namespace toy
+{
+
+// span ------------------------------------------------------------------------
+// a view of a contiguous sequence, the C++20 std::span for C++17. A span
+// with a static extent stores only the pointer
+
+constexpr size_t dynamic_extent = static_cast<size_t>(-1);
+
+namespace detail
+{
+
+template<size_t Extent>
+struct span_extent
+{
+	constexpr span_extent(size_t) noexcept {}
+	constexpr size_t size() const noexcept { return Extent; }
+};
+
+template<>
+struct span_extent<dynamic_extent>
+{
+	constexpr span_extent(size_t n) noexcept : n(n) {}
+	constexpr size_t size() const noexcept { return n; }
+
+	size_t n;
+};
+
+}	// namespace detail
+
+template<class T, size_t Extent = dynamic_extent>
+class span : private detail::span_extent<Extent>
+{
+	using extent_type = detail::span_extent<Extent>;
+
+	template<class U>
+	using if_convertible = enable_if_t<std::is_convertible<U(*)[], T(*)[]>::value>;
+
+public:
+	using element_type           = T;
+	using value_type             = std::remove_cv_t<T>;
+	using size_type              = size_t;
+	using difference_type        = ptrdiff_t;
+	using pointer                = T*;
+	using const_pointer          = const T*;
+	using reference              = T&;
+	using const_reference        = const T&;
+	using iterator               = T*;
+	using reverse_iterator       = std::reverse_iterator<iterator>;
+
+	static constexpr size_t extent = Extent;
+
+	template<size_t E = Extent, class = enable_if_t<E == 0 || E == dynamic_extent>>
+	constexpr span() noexcept
+		: extent_type(0), ptr(nullptr)
+	{
+	}
+
+	constexpr span(pointer first, size_type count) noexcept
+		: extent_type(count), ptr(first)
+	{
+	}
+
+	constexpr span(pointer first, pointer last) noexcept
+		: extent_type(static_cast<size_type>(last - first)), ptr(first)
+	{
+	}
+
+	template<size_t N, class = enable_if_t<Extent == dynamic_extent || Extent == N>>
+	constexpr span(element_type (&arr)[N]) noexcept
+		: extent_type(N), ptr(arr)
+	{
+	}
+
+	template<class Container, class = enable_if_t<Extent == dynamic_extent &&
+		!std::is_array<Container>::value &&
+		std::is_convertible<std::remove_pointer_t<decltype(std::declval<Container&>().data())>(*)[], T(*)[]>::value>>
+	constexpr span(Container& c) noexcept(noexcept(c.data()))
+		: extent_type(static_cast<size_type>(c.size())), ptr(c.data())
+	{	// vector, string, array, ...
+	}
+
+	template<class U, size_t N, class = enable_if_t<(Extent == dynamic_extent || Extent == N)>,
+		class = if_convertible<U>>
+	constexpr span(const span<U, N>& s) noexcept
+		: extent_type(s.size()), ptr(s.data())
+	{	// span<const T> from span<T>
+	}
+
+	constexpr span(const span&) noexcept = default;
+	constexpr span& operator=(const span&) noexcept = default;
+
+	// iterators
+
+	constexpr iterator         begin() const noexcept  { return ptr; }
+	constexpr iterator         end() const noexcept    { return ptr + size(); }
+	constexpr reverse_iterator rbegin() const noexcept { return reverse_iterator(end()); }
+	constexpr reverse_iterator rend() const noexcept   { return reverse_iterator(begin()); }
+
+	// element access
+
+	constexpr reference operator[](size_type i) const noexcept { return ptr[i]; }
+	constexpr reference front() const noexcept { return ptr[0]; }
+	constexpr reference back() const noexcept  { return ptr[size() - 1]; }
+	constexpr pointer   data() const noexcept  { return ptr; }
+
+	constexpr reference at(size_type i) const
+	{
+		if (i >= size())
+			throw std::out_of_range("span::at -- invalid position");
+		return ptr[i];
+	}
+
+	// observers
+
+	constexpr size_type size() const noexcept       { return extent_type::size(); }
+	constexpr size_type size_bytes() const noexcept { return size() * sizeof(T); }
+	constexpr bool      empty() const noexcept      { return size() == 0; }
+
+	// subviews, unchecked like those of std::span
+
+	template<size_t Count>
+	constexpr span<T, Count> first() const noexcept { return span<T, Count>(ptr, Count); }
+
+	template<size_t Count>
+	constexpr span<T, Count> last() const noexcept { return span<T, Count>(ptr + size() - Count, Count); }
+
+	constexpr span<T> first(size_type count) const noexcept { return span<T>(ptr, count); }
+	constexpr span<T> last(size_type count) const noexcept  { return span<T>(ptr + size() - count, count); }
+
+	constexpr span<T> subspan(size_type offset, size_type count = dynamic_extent) const noexcept
+	{
+		return span<T>(ptr + offset, count == dynamic_extent ? size() - offset : count);
+	}
+
+private:
+	pointer ptr;
+};
+
+template<class T, size_t N>
+span(T (&)[N]) -> span<T, N>;
+
+template<class Container>
+span(Container&) -> span<std::remove_pointer_t<decltype(std::declval<Container&>().data())>>;
+
+template<class T, size_t N>
+inline span<const unsigned char> as_bytes(span<T, N> s) noexcept
+{
+	return span<const unsigned char>(reinterpret_cast<const unsigned char*>(s.data()), s.size_bytes());
+}
+
+template<class T, size_t N, class = enable_if_t<!std::is_const<T>::value>>
+inline span<unsigned char> as_writable_bytes(span<T, N> s) noexcept
+{
+	return span<unsigned char>(reinterpret_cast<unsigned char*>(s.data()), s.size_bytes());
+}
+
+}	// namespace toy
+
+#endif // TOY_CORE_SPAN_H
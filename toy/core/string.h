@@ -0,0 +1,912 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_STRING_H
+#define TOY_CORE_STRING_H
+
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "toy/core/functional.h"
+#include "toy/core/initializer_list.h"
+#include "toy/core/memory.h"
+#include "toy/core/string_view.h"
+
+namespace toy
+{
+
+// C++17 Standard, section 24.3.
+
+// basic_string ----------------------------------------------------------------
+
+// A string with the small string optimization: the 24 bytes that hold
+// { data, size, capacity } of a heap string store up to 23 chars inline
+// instead. The last inline char holds '23 - size', so it doubles as the
+// terminator of a full 23 char string; a heap string sets the top bit of its
+// capacity, which on a little endian machine is the top bit of that same
+// byte. Short strings are then built and copied without touching the heap.
+//
+// The inline buffer is addressed from 'this' only through data(), so a
+// string can be moved with memcpy and is trivially relocatable.
+
+template<class CharT, class Traits = std::char_traits<CharT>, class Allocator = allocator<CharT>>
+class basic_string
+{
+	static_assert(std::is_trivial<CharT>::value, "basic_string needs a trivial char type");
+
+public:
+	using traits_type            = Traits;
+	using value_type             = CharT;
+	using allocator_type         = Allocator;
+	using size_type              = size_t;
+	using difference_type        = ptrdiff_t;
+	using reference              = CharT&;
+	using const_reference        = const CharT&;
+	using pointer                = CharT*;
+	using const_pointer          = const CharT*;
+	using iterator               = CharT*;
+	using const_iterator         = const CharT*;
+	using reverse_iterator       = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	using view_type              = basic_string_view<CharT, Traits>;
+
+	static constexpr size_type npos = size_type(-1);
+
+private:
+	using alloc_traits = std::allocator_traits<allocator_type>;
+
+	struct heap_rep
+	{
+		CharT*    data;
+		size_type size;
+		size_type capacity;	// without the terminator, or'ed with heap_flag
+	};
+
+	static constexpr size_type heap_flag = size_type(1) << (sizeof(size_type) * 8 - 1);
+
+public:
+	// chars stored inline, 23 for char on a 64 bit target
+	static constexpr size_type sso_capacity = sizeof(heap_rep) / sizeof(CharT) - 1;
+
+	// construct
+
+	basic_string() noexcept(std::is_nothrow_default_constructible<allocator_type>::value)
+		: storage()
+	{
+		set_small_size(0);
+	}
+
+	explicit basic_string(const allocator_type& a) noexcept
+		: storage(a)
+	{
+		set_small_size(0);
+	}
+
+	basic_string(size_type count, CharT c, const allocator_type& a = allocator_type())
+		: storage(a)
+	{
+		Traits::assign(init(count), count, c);
+	}
+
+	basic_string(const CharT* s, size_type count, const allocator_type& a = allocator_type())
+		: storage(a)
+	{
+		Traits::copy(init(count), s, count);
+	}
+
+	basic_string(const CharT* s, const allocator_type& a = allocator_type())
+		: basic_string(s, Traits::length(s), a)
+	{
+	}
+
+	explicit basic_string(view_type v, const allocator_type& a = allocator_type())
+		: basic_string(v.data(), v.size(), a)
+	{
+	}
+
+	basic_string(const basic_string& right, size_type pos, size_type count = npos, const allocator_type& a = allocator_type())
+		: basic_string(view_type(right).substr(pos, count), a)
+	{
+	}
+
+	template<class InputIt, class = enable_if_t<!std::is_integral<InputIt>::value>>
+	basic_string(InputIt first, InputIt last, const allocator_type& a = allocator_type())
+		: storage(a)
+	{
+		set_small_size(0);
+		append(first, last);
+	}
+
+	basic_string(std::initializer_list<CharT> il, const allocator_type& a = allocator_type())
+		: basic_string(il.begin(), il.size(), a)
+	{
+	}
+
+	basic_string(const basic_string& right)
+		: storage(alloc_traits::select_on_container_copy_construction(right.internal_allocator()))
+	{
+		copy_from(right);
+	}
+
+	basic_string(const basic_string& right, const allocator_type& a)
+		: storage(a)
+	{
+		copy_from(right);
+	}
+
+	basic_string(basic_string&& right) noexcept
+		: storage(toy::move(right.internal_allocator()))
+	{
+		storage.r = right.storage.r;
+		right.set_small_size(0);
+	}
+
+	basic_string(basic_string&& right, const allocator_type& a)
+		: storage(a)
+	{
+		if (right.is_small() || a == right.internal_allocator())
+		{
+			storage.r = right.storage.r;
+			right.set_small_size(0);
+		}
+		else
+		{
+			copy_from(right);
+		}
+	}
+
+	~basic_string()
+	{
+		free_heap();
+	}
+
+	// assign
+
+	basic_string& operator=(const basic_string& right)
+	{
+		if (this != &right)
+		{
+			if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+			{
+				if (internal_allocator() != right.internal_allocator())
+				{	// the old buffer must go back to the old allocator
+					free_heap();
+					set_small_size(0);
+				}
+				internal_allocator() = right.internal_allocator();
+			}
+			assign(right.data(), right.size());
+		}
+		return *this;
+	}
+
+	basic_string& operator=(basic_string&& right)
+		noexcept(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value)
+	{
+		if (this != &right)
+		{
+			if (alloc_traits::propagate_on_container_move_assignment::value || internal_allocator() == right.internal_allocator())
+			{
+				free_heap();
+				if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+					internal_allocator() = toy::move(right.internal_allocator());
+				storage.r = right.storage.r;
+				right.set_small_size(0);
+			}
+			else
+			{
+				assign(right.data(), right.size());
+			}
+		}
+		return *this;
+	}
+
+	basic_string& operator=(view_type v)                 { return assign(v.data(), v.size()); }
+	basic_string& operator=(const CharT* s)              { return assign(s, Traits::length(s)); }
+	basic_string& operator=(CharT c)                     { return assign(&c, 1); }
+	basic_string& operator=(std::initializer_list<CharT> il) { return assign(il.begin(), il.size()); }
+
+	basic_string& assign(const CharT* s, size_type count)
+	{
+		size_type cap = capacity();
+		if (count <= cap)
+		{	// 's' may point into this string
+			CharT* p = data();
+			Traits::move(p, s, count);
+			set_size(count);
+		}
+		else
+		{
+			size_type new_cap = get_new_capacity(cap, count);
+			CharT* p = allocate_chars(new_cap);
+			Traits::copy(p, s, count);
+			replace_buffer(p, count, new_cap);
+		}
+		return *this;
+	}
+
+	basic_string& assign(view_type v)               { return assign(v.data(), v.size()); }
+	basic_string& assign(const CharT* s)            { return assign(s, Traits::length(s)); }
+	basic_string& assign(const basic_string& right) { return *this = right; }
+	basic_string& assign(basic_string&& right)      { return *this = toy::move(right); }
+
+	basic_string& assign(size_type count, CharT c)
+	{
+		clear();
+		return append(count, c);
+	}
+
+	template<class InputIt, class = enable_if_t<!std::is_integral<InputIt>::value>>
+	basic_string& assign(InputIt first, InputIt last)
+	{
+		clear();
+		return append(first, last);
+	}
+
+	allocator_type get_allocator() const noexcept { return internal_allocator(); }
+
+	// element access
+
+	reference at(size_type pos)
+	{
+		if (pos >= size())
+			throw std::out_of_range("basic_string::at -- invalid position");
+		return data()[pos];
+	}
+
+	const_reference at(size_type pos) const
+	{
+		if (pos >= size())
+			throw std::out_of_range("basic_string::at -- invalid position");
+		return data()[pos];
+	}
+
+	reference       operator[](size_type pos) noexcept       { return data()[pos]; }
+	const_reference operator[](size_type pos) const noexcept { return data()[pos]; }
+
+	reference       front() noexcept       { return data()[0]; }
+	const_reference front() const noexcept { return data()[0]; }
+	reference       back() noexcept        { return data()[size() - 1]; }
+	const_reference back() const noexcept  { return data()[size() - 1]; }
+
+	CharT*       data() noexcept        { return is_small() ? storage.r.small : storage.r.heap.data; }
+	const CharT* data() const noexcept  { return is_small() ? storage.r.small : storage.r.heap.data; }
+	const CharT* c_str() const noexcept { return data(); }
+
+	operator view_type() const noexcept { return view_type(data(), size()); }
+
+	// iterators
+
+	iterator       begin() noexcept        { return data(); }
+	const_iterator begin() const noexcept  { return data(); }
+	const_iterator cbegin() const noexcept { return data(); }
+	iterator       end() noexcept          { return data() + size(); }
+	const_iterator end() const noexcept    { return data() + size(); }
+	const_iterator cend() const noexcept   { return data() + size(); }
+
+	reverse_iterator       rbegin() noexcept        { return reverse_iterator(end()); }
+	const_reverse_iterator rbegin() const noexcept  { return const_reverse_iterator(end()); }
+	const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+	reverse_iterator       rend() noexcept          { return reverse_iterator(begin()); }
+	const_reverse_iterator rend() const noexcept    { return const_reverse_iterator(begin()); }
+	const_reverse_iterator crend() const noexcept   { return rend(); }
+
+	// capacity
+
+	bool empty() const noexcept { return size() == 0; }
+
+	size_type size() const noexcept
+	{
+		return is_small() ? sso_capacity - static_cast<size_type>(storage.r.small[sso_capacity]) : storage.r.heap.size;
+	}
+
+	size_type length() const noexcept { return size(); }
+
+	size_type max_size() const noexcept
+	{
+		size_type n = alloc_traits::max_size(internal_allocator()) - 1;
+		return n < (heap_flag - 1) ? n : heap_flag - 1;
+	}
+
+	size_type capacity() const noexcept
+	{
+		return is_small() ? sso_capacity : storage.r.heap.capacity & ~heap_flag;
+	}
+
+	void reserve(size_type new_cap)
+	{
+		if (new_cap > capacity())
+			reallocate(new_cap);
+	}
+
+	void shrink_to_fit()
+	{
+		if (is_small())
+			return;
+
+		size_type n = size();
+		if (n <= sso_capacity)
+		{	// back inline
+			CharT* p = storage.r.heap.data;
+			size_type cap = capacity();
+			Traits::copy(storage.r.small, p, n);
+			set_small_size(n);
+			alloc_traits::deallocate(internal_allocator(), p, cap + 1);
+		}
+		else if (n < capacity())
+		{
+			reallocate(n);
+		}
+	}
+
+	// modifiers
+
+	void clear() noexcept { set_size(0); }
+
+	basic_string& insert(size_type pos, view_type v)        { return replace(pos, 0, v); }
+	basic_string& insert(size_type pos, const CharT* s)     { return replace(pos, 0, view_type(s)); }
+	basic_string& insert(size_type pos, size_type count, CharT c)
+	{
+		check_position(pos, "basic_string::insert -- invalid position");
+		replace_hole(pos, 0, count);
+		Traits::assign(data() + pos, count, c);
+		return *this;
+	}
+
+	iterator insert(const_iterator where, CharT c)
+	{
+		size_type pos = static_cast<size_type>(where - data());
+		insert(pos, 1, c);
+		return data() + pos;
+	}
+
+	basic_string& erase(size_type pos = 0, size_type count = npos)
+	{
+		check_position(pos, "basic_string::erase -- invalid position");
+		size_type n = size();
+		if (count >= n - pos)
+		{
+			set_size(pos);
+		}
+		else
+		{
+			CharT* p = data();
+			Traits::move(p + pos, p + pos + count, n - pos - count);
+			set_size(n - count);
+		}
+		return *this;
+	}
+
+	iterator erase(const_iterator where)
+	{
+		size_type pos = static_cast<size_type>(where - data());
+		erase(pos, 1);
+		return data() + pos;
+	}
+
+	iterator erase(const_iterator first, const_iterator last)
+	{
+		size_type pos = static_cast<size_type>(first - data());
+		erase(pos, static_cast<size_type>(last - first));
+		return data() + pos;
+	}
+
+	void push_back(CharT c)
+	{
+		size_type n = size();
+		if (n < capacity())
+		{
+			data()[n] = c;
+			set_size(n + 1);
+		}
+		else
+		{
+			append(&c, 1);
+		}
+	}
+
+	void pop_back() noexcept { set_size(size() - 1); }
+
+	basic_string& append(const CharT* s, size_type count)
+	{
+		size_type n, cap;
+		if (is_small())
+		{	// the fast paths test the representation once and do one memcpy
+			n = size();
+			if (count <= sso_capacity - n)
+			{
+				Traits::copy(storage.r.small + n, s, count);
+				set_small_size(n + count);
+				return *this;
+			}
+			cap = sso_capacity;
+		}
+		else
+		{
+			n = storage.r.heap.size;
+			cap = capacity();
+			if (count <= cap - n)
+			{
+				CharT* p = storage.r.heap.data;
+				Traits::copy(p + n, s, count);
+				storage.r.heap.size = n + count;
+				p[n + count] = CharT();
+				return *this;
+			}
+		}
+
+		// 's' may point into the old buffer, copy it before that is freed
+		if (count > max_size() - n)
+			throw std::length_error("basic_string::append -- size too large");
+		size_type new_cap = get_new_capacity(cap, n + count);
+		CharT* p = allocate_chars(new_cap);
+		Traits::copy(p, data(), n);
+		Traits::copy(p + n, s, count);
+		replace_buffer(p, n + count, new_cap);
+		return *this;
+	}
+
+	basic_string& append(view_type v)    { return append(v.data(), v.size()); }
+	basic_string& append(const CharT* s) { return append(s, Traits::length(s)); }
+
+	basic_string& append(view_type v, size_type pos, size_type count = npos)
+	{
+		return append(v.substr(pos, count));
+	}
+
+	basic_string& append(size_type count, CharT c)
+	{
+		size_type n = size();
+		if (count > capacity() - n)
+			reserve_for_append(n, count);
+		Traits::assign(data() + n, count, c);
+		set_size(n + count);
+		return *this;
+	}
+
+	template<class InputIt, class = enable_if_t<!std::is_integral<InputIt>::value>>
+	basic_string& append(InputIt first, InputIt last)
+	{
+		using category = typename std::iterator_traits<InputIt>::iterator_category;
+		if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+		{
+			size_type n = size();
+			size_type count = static_cast<size_type>(std::distance(first, last));
+			if (count <= capacity() - n)
+			{
+				CharT* p = data() + n;
+				for (; first != last; ++first, ++p)
+					Traits::assign(*p, *first);
+				set_size(n + count);
+				return *this;
+			}
+
+			// the range may be in the old buffer, copy it before that is freed
+			if (count > max_size() - n)
+				throw std::length_error("basic_string::append -- size too large");
+			size_type new_cap = get_new_capacity(capacity(), n + count);
+			CharT* p = allocate_chars(new_cap);
+			Traits::copy(p, data(), n);
+			for (CharT* q = p + n; first != last; ++first, ++q)
+				Traits::assign(*q, *first);
+			replace_buffer(p, n + count, new_cap);
+		}
+		else
+		{
+			for (; first != last; ++first)
+				push_back(*first);
+		}
+		return *this;
+	}
+
+	basic_string& append(std::initializer_list<CharT> il) { return append(il.begin(), il.size()); }
+
+	basic_string& operator+=(view_type v)    { return append(v.data(), v.size()); }
+	basic_string& operator+=(const CharT* s) { return append(s, Traits::length(s)); }
+	basic_string& operator+=(CharT c)        { push_back(c); return *this; }
+	basic_string& operator+=(std::initializer_list<CharT> il) { return append(il.begin(), il.size()); }
+
+	basic_string& replace(size_type pos, size_type count, view_type v)
+	{
+		check_position(pos, "basic_string::replace -- invalid position");
+		const CharT* p = data();
+		if (v.data() + v.size() > p && v.data() <= p + size())
+		{	// 'v' is a part of this string, take a copy
+			basic_string copy(v, internal_allocator());
+			return replace(pos, count, view_type(copy));
+		}
+
+		size_type n = size();
+		count = count < n - pos ? count : n - pos;
+		replace_hole(pos, count, v.size());
+		Traits::copy(data() + pos, v.data(), v.size());
+		return *this;
+	}
+
+	basic_string& replace(const_iterator first, const_iterator last, view_type v)
+	{
+		return replace(static_cast<size_type>(first - data()), static_cast<size_type>(last - first), v);
+	}
+
+	void resize(size_type count, CharT c = CharT())
+	{
+		size_type n = size();
+		if (count > n)
+			append(count - n, c);
+		else
+			set_size(count);
+	}
+
+	void swap(basic_string& right) noexcept
+	{
+		if constexpr (alloc_traits::propagate_on_container_swap::value)
+		{
+			using std::swap;
+			swap(internal_allocator(), right.internal_allocator());
+		}
+		rep tmp   = storage.r;
+		storage.r = right.storage.r;
+		right.storage.r = tmp;
+	}
+
+	// operations
+
+	size_type copy(CharT* dest, size_type count, size_type pos = 0) const
+	{
+		return view_type(*this).copy(dest, count, pos);
+	}
+
+	basic_string substr(size_type pos = 0, size_type count = npos) const
+	{
+		return basic_string(view_type(*this).substr(pos, count), internal_allocator());
+	}
+
+	int compare(view_type v) const noexcept { return view_type(*this).compare(v); }
+	int compare(const CharT* s) const { return view_type(*this).compare(view_type(s)); }
+	int compare(size_type pos, size_type count, view_type v) const { return view_type(*this).compare(pos, count, v); }
+
+	bool starts_with(view_type v) const noexcept { return view_type(*this).starts_with(v); }
+	bool starts_with(CharT c) const noexcept     { return view_type(*this).starts_with(c); }
+	bool ends_with(view_type v) const noexcept   { return view_type(*this).ends_with(v); }
+	bool ends_with(CharT c) const noexcept       { return view_type(*this).ends_with(c); }
+	bool contains(view_type v) const noexcept    { return view_type(*this).find(v) != npos; }
+	bool contains(CharT c) const noexcept        { return view_type(*this).find(c) != npos; }
+
+	// searching, by the SIMD kernels of string_view
+
+	size_type find(view_type v, size_type pos = 0) const noexcept          { return view_type(*this).find(v, pos); }
+	size_type find(const CharT* s, size_type pos, size_type count) const noexcept { return view_type(*this).find(view_type(s, count), pos); }
+	size_type find(const CharT* s, size_type pos = 0) const noexcept       { return view_type(*this).find(view_type(s), pos); }
+	size_type find(CharT c, size_type pos = 0) const noexcept              { return view_type(*this).find(c, pos); }
+
+	size_type rfind(view_type v, size_type pos = npos) const noexcept      { return view_type(*this).rfind(v, pos); }
+	size_type rfind(const CharT* s, size_type pos = npos) const noexcept   { return view_type(*this).rfind(view_type(s), pos); }
+	size_type rfind(CharT c, size_type pos = npos) const noexcept          { return view_type(*this).rfind(c, pos); }
+
+	size_type find_first_of(view_type v, size_type pos = 0) const noexcept        { return view_type(*this).find_first_of(v, pos); }
+	size_type find_first_of(CharT c, size_type pos = 0) const noexcept            { return view_type(*this).find(c, pos); }
+	size_type find_last_of(view_type v, size_type pos = npos) const noexcept      { return view_type(*this).find_last_of(v, pos); }
+	size_type find_last_of(CharT c, size_type pos = npos) const noexcept          { return view_type(*this).rfind(c, pos); }
+	size_type find_first_not_of(view_type v, size_type pos = 0) const noexcept    { return view_type(*this).find_first_not_of(v, pos); }
+	size_type find_first_not_of(CharT c, size_type pos = 0) const noexcept        { return view_type(*this).find_first_not_of(c, pos); }
+	size_type find_last_not_of(view_type v, size_type pos = npos) const noexcept  { return view_type(*this).find_last_not_of(v, pos); }
+	size_type find_last_not_of(CharT c, size_type pos = npos) const noexcept      { return view_type(*this).find_last_not_of(c, pos); }
+
+private:
+	union rep
+	{
+		heap_rep heap;
+		CharT    small[sso_capacity + 1];
+	};
+
+	static_assert(sizeof(rep) == sizeof(heap_rep), "the inline buffer overlays the heap representation");
+
+	struct impl : allocator_type
+	{	// the allocator is a base, an empty one takes no room
+		impl() noexcept(std::is_nothrow_default_constructible<allocator_type>::value) : allocator_type() {}
+		impl(const allocator_type& a) noexcept : allocator_type(a) {}
+		impl(allocator_type&& a) noexcept : allocator_type(toy::move(a)) {}
+
+		rep r{};
+	};
+
+	impl storage;
+
+	allocator_type&       internal_allocator() noexcept { return storage; }
+	const allocator_type& internal_allocator() const noexcept { return storage; }
+
+	bool is_small() const noexcept
+	{	// the top bit of the last byte, see the comment of the class
+		return (reinterpret_cast<const unsigned char*>(&storage.r)[sizeof(rep) - 1] & 0x80) == 0;
+	}
+
+	void set_small_size(size_type n) noexcept
+	{
+		storage.r.small[n] = CharT();
+		storage.r.small[sso_capacity] = static_cast<CharT>(sso_capacity - n);
+	}
+
+	void set_heap(CharT* p, size_type n, size_type cap) noexcept
+	{
+		storage.r.heap.data     = p;
+		storage.r.heap.size     = n;
+		storage.r.heap.capacity = cap | heap_flag;
+		p[n] = CharT();
+	}
+
+	void set_size(size_type n) noexcept
+	{
+		if (is_small())
+		{
+			set_small_size(n);
+		}
+		else
+		{
+			storage.r.heap.size = n;
+			storage.r.heap.data[n] = CharT();
+		}
+	}
+
+	CharT* init(size_type n)
+	{	// room for 'n' chars, the caller fills them
+		if (n <= sso_capacity)
+		{
+			set_small_size(n);
+			return storage.r.small;
+		}
+		if (n > max_size())
+			throw std::length_error("basic_string -- size too large");
+		CharT* p = allocate_chars(n);
+		set_heap(p, n, n);
+		return p;
+	}
+
+	void copy_from(const basic_string& right)
+	{
+		if (right.is_small())
+			storage.r = right.storage.r;	// 24 bytes, no allocation
+		else
+			Traits::copy(init(right.size()), right.data(), right.size());
+	}
+
+	CharT* allocate_chars(size_type cap)
+	{	// one more for the terminator
+		return alloc_traits::allocate(internal_allocator(), cap + 1);
+	}
+
+	void free_heap() noexcept
+	{
+		if (!is_small())
+			alloc_traits::deallocate(internal_allocator(), storage.r.heap.data, capacity() + 1);
+	}
+
+	void replace_buffer(CharT* p, size_type n, size_type cap) noexcept
+	{
+		free_heap();
+		set_heap(p, n, cap);
+	}
+
+	void reallocate(size_type new_cap)
+	{
+		if (new_cap > max_size())
+			throw std::length_error("basic_string::reserve -- capacity too large");
+		size_type n = size();
+		CharT* p = allocate_chars(new_cap);
+		Traits::copy(p, data(), n);
+		replace_buffer(p, n, new_cap);
+	}
+
+	void reserve_for_append(size_type n, size_type count)
+	{
+		if (count > max_size() - n)
+			throw std::length_error("basic_string::append -- size too large");
+		reallocate(get_new_capacity(capacity(), n + count));
+	}
+
+	size_type get_new_capacity(size_type current, size_type needed) const
+	{	// grow by a factor of 2
+		if (needed > max_size())
+			throw std::length_error("basic_string -- size too large");
+		size_type n = current > max_size() / 2 ? max_size() : current * 2;
+		return n < needed ? needed : n;
+	}
+
+	void replace_hole(size_type pos, size_type count, size_type new_count)
+	{	// make [pos, pos + count) 'new_count' chars long, the caller fills it
+		size_type n = size();
+		if (new_count > count && new_count - count > max_size() - n)
+			throw std::length_error("basic_string::replace -- size too large");
+		size_type new_size = n - count + new_count;
+		size_type cap = capacity();
+		if (new_size <= cap)
+		{
+			CharT* p = data();
+			Traits::move(p + pos + new_count, p + pos + count, n - pos - count);
+			set_size(new_size);
+		}
+		else
+		{
+			size_type new_cap = get_new_capacity(cap, new_size);
+			CharT* p = allocate_chars(new_cap);
+			const CharT* old = data();
+			Traits::copy(p, old, pos);
+			Traits::copy(p + pos + new_count, old + pos + count, n - pos - count);
+			replace_buffer(p, new_size, new_cap);
+		}
+	}
+
+	void check_position(size_type pos, const char* message) const
+	{
+		if (pos > size())
+			throw std::out_of_range(message);
+	}
+};
+
+using string    = basic_string<char>;
+using wstring   = basic_string<wchar_t>;
+using u16string = basic_string<char16_t>;
+using u32string = basic_string<char32_t>;
+
+template<class C, class T, class A>
+struct is_trivially_relocatable<basic_string<C, T, A>> : is_trivially_relocatable<A> {};
+
+// operator+ -------------------------------------------------------------------
+
+template<class C, class T, class A>
+inline basic_string<C, T, A> operator+(const basic_string<C, T, A>& a, basic_string_view<C, T> b)
+{
+	basic_string<C, T, A> result(a.get_allocator());
+	result.reserve(a.size() + b.size());
+	result.append(a.data(), a.size());
+	result.append(b.data(), b.size());
+	return result;
+}
+
+template<class C, class T, class A>
+inline basic_string<C, T, A> operator+(const basic_string<C, T, A>& a, const basic_string<C, T, A>& b)
+{
+	return a + basic_string_view<C, T>(b);
+}
+
+template<class C, class T, class A>
+inline basic_string<C, T, A> operator+(const basic_string<C, T, A>& a, const C* b)
+{
+	return a + basic_string_view<C, T>(b);
+}
+
+template<class C, class T, class A>
+inline basic_string<C, T, A> operator+(const C* a, const basic_string<C, T, A>& b)
+{
+	basic_string<C, T, A> result(a, b.get_allocator());
+	result.append(b.data(), b.size());
+	return result;
+}
+
+template<class C, class T, class A>
+inline basic_string<C, T, A> operator+(const basic_string<C, T, A>& a, C b)
+{
+	basic_string<C, T, A> result(a);
+	result.push_back(b);
+	return result;
+}
+
+template<class C, class T, class A>
+inline basic_string<C, T, A> operator+(basic_string<C, T, A>&& a, basic_string_view<C, T> b)
+{	// reuse the buffer of 'a'
+	return toy::move(a.append(b));
+}
+
+template<class C, class T, class A>
+inline basic_string<C, T, A> operator+(basic_string<C, T, A>&& a, const basic_string<C, T, A>& b)
+{
+	return toy::move(a.append(b));
+}
+
+template<class C, class T, class A>
+inline basic_string<C, T, A> operator+(basic_string<C, T, A>&& a, const C* b)
+{
+	return toy::move(a.append(b));
+}
+
+template<class C, class T, class A>
+inline basic_string<C, T, A> operator+(basic_string<C, T, A>&& a, C b)
+{
+	a.push_back(b);
+	return toy::move(a);
+}
+
+// comparisons, against a view they go through the operators of
+// basic_string_view
+
+template<class C, class T, class A>
+inline bool operator==(const basic_string<C, T, A>& a, const basic_string<C, T, A>& b) noexcept
+{
+	return a.size() == b.size() && a.compare(b) == 0;
+}
+
+template<class C, class T, class A>
+inline bool operator==(const basic_string<C, T, A>& a, const C* b)
+{
+	return a.compare(b) == 0;
+}
+
+template<class C, class T, class A>
+inline bool operator==(const C* a, const basic_string<C, T, A>& b)
+{
+	return b.compare(a) == 0;
+}
+
+template<class C, class T, class A>
+inline bool operator!=(const basic_string<C, T, A>& a, const basic_string<C, T, A>& b) noexcept { return !(a == b); }
+
+template<class C, class T, class A>
+inline bool operator!=(const basic_string<C, T, A>& a, const C* b) { return !(a == b); }
+
+template<class C, class T, class A>
+inline bool operator!=(const C* a, const basic_string<C, T, A>& b) { return !(a == b); }
+
+#define TOY_STRING_COMPARE(op)                                                                    \
+template<class C, class T, class A>                                                               \
+inline bool operator op(const basic_string<C, T, A>& a, const basic_string<C, T, A>& b) noexcept \
+{ return a.compare(b) op 0; }                                                                     \
+template<class C, class T, class A>                                                               \
+inline bool operator op(const basic_string<C, T, A>& a, const C* b)                               \
+{ return a.compare(b) op 0; }                                                                     \
+template<class C, class T, class A>                                                               \
+inline bool operator op(const C* a, const basic_string<C, T, A>& b)                               \
+{ return 0 op b.compare(a); }
+
+TOY_STRING_COMPARE(<)
+TOY_STRING_COMPARE(>)
+TOY_STRING_COMPARE(<=)
+TOY_STRING_COMPARE(>=)
+
+#undef TOY_STRING_COMPARE
+
+template<class C, class T, class A>
+inline void swap(basic_string<C, T, A>& a, basic_string<C, T, A>& b) noexcept
+{
+	a.swap(b);
+}
+
+template<class C, class T, class A>
+inline std::basic_ostream<C, T>& operator<<(std::basic_ostream<C, T>& os, const basic_string<C, T, A>& s)
+{
+	return os.write(s.data(), static_cast<std::streamsize>(s.size()));
+}
+
+// hash ------------------------------------------------------------------------
+
+template<class C, class T, class A>
+struct hash<basic_string<C, T, A>> : hash<basic_string_view<C, T>>
+{	// equal to the hash of the view, for lookups by string_view
+};
+
+inline namespace literals
+{
+
+inline string operator""_s(const char* s, size_t n)
+{
+	return string(s, n);
+}
+
+}	// namespace literals
+
+}	// namespace toy
+
+namespace std
+{
+
+template<class C, class T, class A>
+struct hash<toy::basic_string<C, T, A>> : toy::hash<toy::basic_string<C, T, A>> {};
+
+}	// namespace std
+
+#endif	// TOY_CORE_STRING_H
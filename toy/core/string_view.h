@@ -0,0 +1,525 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_STRING_VIEW_H
+#define TOY_CORE_STRING_VIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TOY_STRING_SSE2 1
+#include <emmintrin.h>
+#else
+#define TOY_STRING_SSE2 0
+#endif
+
+#include "toy/core/functional.h"
+#include "toy/utility/byte.h"
+
+namespace toy
+{
+
+// C++17 Standard, section 24.4.
+
+// search kernels --------------------------------------------------------------
+// byte searches used by string_view and string. With SSE2 they compare 16
+// bytes per step and only read whole blocks inside [first, first + n), the
+// tail is done one byte at a time, so they never read past the buffer
+
+namespace detail
+{
+
+inline const char* find_byte(const char* first, size_t n, char c) noexcept
+{	// memchr
+#if TOY_STRING_SSE2
+	const __m128i pattern = _mm_set1_epi8(c);
+	for (; n >= 64; first += 64, n -= 64)
+	{	// four blocks per test of the result, the hit is found again below
+		__m128i a = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first)), pattern);
+		__m128i b = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 16)), pattern);
+		__m128i x = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 32)), pattern);
+		__m128i d = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 48)), pattern);
+		if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(x, d))) != 0)
+			break;
+	}
+	for (; n >= 16; first += 16, n -= 16)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern)));
+		if (mask != 0)
+			return first + countr_zero(mask);
+	}
+#endif
+	for (; n != 0; ++first, --n)
+		if (*first == c)
+			return first;
+	return nullptr;
+}
+
+inline const char* find_last_byte(const char* first, size_t n, char c) noexcept
+{	// memrchr
+	const char* last = first + n;
+#if TOY_STRING_SSE2
+	const __m128i pattern = _mm_set1_epi8(c);
+	for (; last - first >= 16; last -= 16)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(last - 16));
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern)));
+		if (mask != 0)
+			return last - 16 + (31 - countl_zero(mask));
+	}
+#endif
+	while (last != first)
+		if (*--last == c)
+			return last;
+	return nullptr;
+}
+
+inline const char* find_bytes(const char* first, size_t n, const char* needle, size_t m) noexcept
+{	// memmem, 'm' != 0
+	if (m > n)
+		return nullptr;
+	if (m == 1)
+		return find_byte(first, n, *needle);
+
+	const char* last = first + (n - m + 1);	// one past the last candidate
+#if TOY_STRING_SSE2
+	// test the first and the last byte of the needle at 16 candidates at
+	// once, compare the whole needle only where both of them match
+	const __m128i head = _mm_set1_epi8(needle[0]);
+	const __m128i tail = _mm_set1_epi8(needle[m - 1]);
+	for (; last - first >= 32; first += 32)
+	{	// two blocks per test, the usual case is no candidate at all
+		__m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+		__m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 16));
+		__m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + m - 1));
+		__m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + m + 15));
+		__m128i x0 = _mm_and_si128(_mm_cmpeq_epi8(a0, head), _mm_cmpeq_epi8(b0, tail));
+		__m128i x1 = _mm_and_si128(_mm_cmpeq_epi8(a1, head), _mm_cmpeq_epi8(b1, tail));
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(x0)) | (static_cast<uint32_t>(_mm_movemask_epi8(x1)) << 16);
+		while (mask != 0)
+		{
+			int i = countr_zero(mask);
+			if (std::memcmp(first + i + 1, needle + 1, m - 2) == 0)
+				return first + i;
+			mask &= mask - 1;
+		}
+	}
+	for (; last - first >= 16; first += 16)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + m - 1));
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+			_mm_and_si128(_mm_cmpeq_epi8(a, head), _mm_cmpeq_epi8(b, tail))));
+		while (mask != 0)
+		{
+			int i = countr_zero(mask);
+			if (std::memcmp(first + i + 1, needle + 1, m - 2) == 0)
+				return first + i;
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for (; first != last; ++first)
+	{
+		first = find_byte(first, static_cast<size_t>(last - first), needle[0]);
+		if (first == nullptr)
+			return nullptr;
+		if (std::memcmp(first + 1, needle + 1, m - 1) == 0)
+			return first;
+	}
+	return nullptr;
+}
+
+template<class CharT, class Traits>
+constexpr bool use_byte_kernels = std::is_same<CharT, char>::value && std::is_same<Traits, std::char_traits<char>>::value;
+
+}	// namespace detail
+
+// basic_string_view -----------------------------------------------------------
+
+template<class CharT, class Traits = std::char_traits<CharT>>
+class basic_string_view
+{
+public:
+	using traits_type            = Traits;
+	using value_type             = CharT;
+	using pointer                = CharT*;
+	using const_pointer          = const CharT*;
+	using reference              = CharT&;
+	using const_reference        = const CharT&;
+	using const_iterator         = const CharT*;
+	using iterator               = const_iterator;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+	using reverse_iterator       = const_reverse_iterator;
+	using size_type              = size_t;
+	using difference_type        = ptrdiff_t;
+
+	static constexpr size_type npos = size_type(-1);
+
+	constexpr basic_string_view() noexcept = default;
+	constexpr basic_string_view(const basic_string_view&) noexcept = default;
+	constexpr basic_string_view& operator=(const basic_string_view&) noexcept = default;
+
+	constexpr basic_string_view(const CharT* s, size_type count) noexcept
+		: ptr(s), len(count)
+	{
+	}
+
+	constexpr basic_string_view(const CharT* s) noexcept
+		: ptr(s), len(Traits::length(s))
+	{
+	}
+
+	template<class A>
+	basic_string_view(const std::basic_string<CharT, Traits, A>& s) noexcept
+		: ptr(s.data()), len(s.size())
+	{	// views of std::string, so callers need not copy
+	}
+
+	template<class A>
+	explicit operator std::basic_string<CharT, Traits, A>() const
+	{
+		return std::basic_string<CharT, Traits, A>(ptr, len);
+	}
+
+	// iterators
+
+	constexpr const_iterator begin()  const noexcept { return ptr; }
+	constexpr const_iterator end()    const noexcept { return ptr + len; }
+	constexpr const_iterator cbegin() const noexcept { return ptr; }
+	constexpr const_iterator cend()   const noexcept { return ptr + len; }
+
+	const_reverse_iterator rbegin()  const noexcept { return const_reverse_iterator(end()); }
+	const_reverse_iterator rend()    const noexcept { return const_reverse_iterator(begin()); }
+	const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+	const_reverse_iterator crend()   const noexcept { return rend(); }
+
+	// element access
+
+	constexpr const_reference operator[](size_type pos) const noexcept { return ptr[pos]; }
+
+	constexpr const_reference at(size_type pos) const
+	{
+		if (pos >= len)
+			throw std::out_of_range("basic_string_view::at -- invalid position");
+		return ptr[pos];
+	}
+
+	constexpr const_reference front() const noexcept { return ptr[0]; }
+	constexpr const_reference back()  const noexcept { return ptr[len - 1]; }
+	constexpr const_pointer   data()  const noexcept { return ptr; }
+
+	// capacity
+
+	constexpr size_type size()     const noexcept { return len; }
+	constexpr size_type length()   const noexcept { return len; }
+	constexpr size_type max_size() const noexcept { return npos / sizeof(CharT) - 1; }
+	constexpr bool      empty()    const noexcept { return len == 0; }
+
+	// modifiers
+
+	constexpr void remove_prefix(size_type n) noexcept { ptr += n; len -= n; }
+	constexpr void remove_suffix(size_type n) noexcept { len -= n; }
+
+	constexpr void swap(basic_string_view& right) noexcept
+	{
+		const CharT* p = ptr; ptr = right.ptr; right.ptr = p;
+		size_type    n = len; len = right.len; right.len = n;
+	}
+
+	// operations
+
+	size_type copy(CharT* dest, size_type count, size_type pos = 0) const
+	{
+		check_position(pos, "basic_string_view::copy -- invalid position");
+		size_type n = clamp_count(pos, count);
+		Traits::copy(dest, ptr + pos, n);
+		return n;
+	}
+
+	constexpr basic_string_view substr(size_type pos = 0, size_type count = npos) const
+	{
+		check_position(pos, "basic_string_view::substr -- invalid position");
+		return basic_string_view(ptr + pos, clamp_count(pos, count));
+	}
+
+	constexpr int compare(basic_string_view v) const noexcept
+	{
+		size_type n = len < v.len ? len : v.len;
+		int result = n == 0 ? 0 : Traits::compare(ptr, v.ptr, n);
+		if (result != 0)
+			return result;
+		return len == v.len ? 0 : (len < v.len ? -1 : 1);
+	}
+
+	constexpr int compare(size_type pos, size_type count, basic_string_view v) const
+	{
+		return substr(pos, count).compare(v);
+	}
+
+	constexpr int compare(const CharT* s) const { return compare(basic_string_view(s)); }
+
+	constexpr bool starts_with(basic_string_view v) const noexcept
+	{
+		return len >= v.len && (v.len == 0 || Traits::compare(ptr, v.ptr, v.len) == 0);
+	}
+
+	constexpr bool starts_with(CharT c) const noexcept { return len != 0 && Traits::eq(ptr[0], c); }
+
+	constexpr bool ends_with(basic_string_view v) const noexcept
+	{
+		return len >= v.len && (v.len == 0 || Traits::compare(ptr + len - v.len, v.ptr, v.len) == 0);
+	}
+
+	constexpr bool ends_with(CharT c) const noexcept { return len != 0 && Traits::eq(ptr[len - 1], c); }
+
+	bool contains(basic_string_view v) const noexcept { return find(v) != npos; }
+	bool contains(CharT c) const noexcept { return find(c) != npos; }
+
+	// searching
+
+	size_type find(CharT c, size_type pos = 0) const noexcept
+	{
+		if (pos >= len)
+			return npos;
+		const CharT* p;
+		if constexpr (detail::use_byte_kernels<CharT, Traits>)
+			p = detail::find_byte(ptr + pos, len - pos, c);
+		else
+			p = Traits::find(ptr + pos, len - pos, c);
+		return p ? static_cast<size_type>(p - ptr) : npos;
+	}
+
+	size_type find(basic_string_view v, size_type pos = 0) const noexcept
+	{
+		if (v.len == 0)
+			return pos <= len ? pos : npos;
+		if (pos >= len || len - pos < v.len)
+			return npos;
+		if constexpr (detail::use_byte_kernels<CharT, Traits>)
+		{
+			const char* p = detail::find_bytes(ptr + pos, len - pos, v.ptr, v.len);
+			return p ? static_cast<size_type>(p - ptr) : npos;
+		}
+		else
+		{
+			for (const CharT* last = ptr + (len - v.len); ; ++pos)
+			{
+				const CharT* p = Traits::find(ptr + pos, static_cast<size_type>(last - ptr) - pos + 1, v.ptr[0]);
+				if (p == nullptr)
+					return npos;
+				pos = static_cast<size_type>(p - ptr);
+				if (Traits::compare(p, v.ptr, v.len) == 0)
+					return pos;
+			}
+		}
+	}
+
+	size_type find(const CharT* s, size_type pos, size_type count) const noexcept { return find(basic_string_view(s, count), pos); }
+	size_type find(const CharT* s, size_type pos = 0) const noexcept { return find(basic_string_view(s), pos); }
+
+	size_type rfind(CharT c, size_type pos = npos) const noexcept
+	{
+		if (len == 0)
+			return npos;
+		size_type n = pos < len ? pos + 1 : len;
+		if constexpr (detail::use_byte_kernels<CharT, Traits>)
+		{
+			const char* p = detail::find_last_byte(ptr, n, c);
+			return p ? static_cast<size_type>(p - ptr) : npos;
+		}
+		else
+		{
+			while (n != 0)
+				if (Traits::eq(ptr[--n], c))
+					return n;
+			return npos;
+		}
+	}
+
+	size_type rfind(basic_string_view v, size_type pos = npos) const noexcept
+	{
+		if (v.len > len)
+			return npos;
+		size_type i = len - v.len < pos ? len - v.len : pos;
+		if (v.len == 0)
+			return i;
+		for (;;)
+		{	// jump between occurrences of the first character
+			i = rfind(v.ptr[0], i);
+			if (i == npos || Traits::compare(ptr + i, v.ptr, v.len) == 0)
+				return i;
+			if (i-- == 0)
+				return npos;
+		}
+	}
+
+	size_type rfind(const CharT* s, size_type pos, size_type count) const noexcept { return rfind(basic_string_view(s, count), pos); }
+	size_type rfind(const CharT* s, size_type pos = npos) const noexcept { return rfind(basic_string_view(s), pos); }
+
+	size_type find_first_of(basic_string_view v, size_type pos = 0) const noexcept
+	{
+		if (v.len == 1)
+			return find(v.ptr[0], pos);
+		for (; pos < len; ++pos)
+			if (Traits::find(v.ptr, v.len, ptr[pos]))
+				return pos;
+		return npos;
+	}
+
+	size_type find_last_of(basic_string_view v, size_type pos = npos) const noexcept
+	{
+		if (v.len == 1)
+			return rfind(v.ptr[0], pos);
+		for (size_type n = pos < len ? pos + 1 : len; n != 0; )
+			if (Traits::find(v.ptr, v.len, ptr[--n]))
+				return n;
+		return npos;
+	}
+
+	size_type find_first_not_of(basic_string_view v, size_type pos = 0) const noexcept
+	{
+		for (; pos < len; ++pos)
+			if (!Traits::find(v.ptr, v.len, ptr[pos]))
+				return pos;
+		return npos;
+	}
+
+	size_type find_last_not_of(basic_string_view v, size_type pos = npos) const noexcept
+	{
+		for (size_type n = pos < len ? pos + 1 : len; n != 0; )
+			if (!Traits::find(v.ptr, v.len, ptr[--n]))
+				return n;
+		return npos;
+	}
+
+	size_type find_first_of(CharT c, size_type pos = 0) const noexcept     { return find(c, pos); }
+	size_type find_last_of(CharT c, size_type pos = npos) const noexcept   { return rfind(c, pos); }
+	size_type find_first_not_of(CharT c, size_type pos = 0) const noexcept { return find_first_not_of(basic_string_view(&c, 1), pos); }
+	size_type find_last_not_of(CharT c, size_type pos = npos) const noexcept { return find_last_not_of(basic_string_view(&c, 1), pos); }
+
+private:
+	constexpr void check_position(size_type pos, const char* message) const
+	{
+		if (pos > len)
+			throw std::out_of_range(message);
+	}
+
+	constexpr size_type clamp_count(size_type pos, size_type count) const noexcept
+	{
+		return count < len - pos ? count : len - pos;
+	}
+
+private:
+	const CharT* ptr{ nullptr };
+	size_type    len{ 0 };
+};
+
+using string_view    = basic_string_view<char>;
+using wstring_view   = basic_string_view<wchar_t>;
+using u16string_view = basic_string_view<char16_t>;
+using u32string_view = basic_string_view<char32_t>;
+
+// comparisons, the extra overloads let one side convert implicitly
+// (string, const char*) while the other one is deduced
+
+namespace detail
+{
+
+template<class T>
+using identity_t = typename std::common_type<T>::type;	// non-deduced context
+
+}	// namespace detail
+
+#define TOY_STRING_VIEW_COMPARE(op)                                                                  \
+template<class C, class T>                                                                           \
+inline bool operator op(basic_string_view<C, T> a, basic_string_view<C, T> b) noexcept              \
+{ return a.compare(b) op 0; }                                                                        \
+template<class C, class T>                                                                           \
+inline bool operator op(basic_string_view<C, T> a, detail::identity_t<basic_string_view<C, T>> b) noexcept  \
+{ return a.compare(b) op 0; }                                                                        \
+template<class C, class T>                                                                           \
+inline bool operator op(detail::identity_t<basic_string_view<C, T>> a, basic_string_view<C, T> b) noexcept  \
+{ return a.compare(b) op 0; }
+
+TOY_STRING_VIEW_COMPARE(<)
+TOY_STRING_VIEW_COMPARE(>)
+TOY_STRING_VIEW_COMPARE(<=)
+TOY_STRING_VIEW_COMPARE(>=)
+
+#undef TOY_STRING_VIEW_COMPARE
+
+template<class C, class T>
+inline bool operator==(basic_string_view<C, T> a, basic_string_view<C, T> b) noexcept
+{	// sizes first, the common case of unequal lengths does not touch the text
+	return a.size() == b.size() && a.compare(b) == 0;
+}
+
+template<class C, class T>
+inline bool operator==(basic_string_view<C, T> a, detail::identity_t<basic_string_view<C, T>> b) noexcept
+{
+	return a.size() == b.size() && a.compare(b) == 0;
+}
+
+template<class C, class T>
+inline bool operator==(detail::identity_t<basic_string_view<C, T>> a, basic_string_view<C, T> b) noexcept
+{
+	return a.size() == b.size() && a.compare(b) == 0;
+}
+
+template<class C, class T>
+inline bool operator!=(basic_string_view<C, T> a, basic_string_view<C, T> b) noexcept { return !(a == b); }
+
+template<class C, class T>
+inline bool operator!=(basic_string_view<C, T> a, detail::identity_t<basic_string_view<C, T>> b) noexcept { return !(a == b); }
+
+template<class C, class T>
+inline bool operator!=(detail::identity_t<basic_string_view<C, T>> a, basic_string_view<C, T> b) noexcept { return !(a == b); }
+
+template<class C, class T>
+inline std::basic_ostream<C, T>& operator<<(std::basic_ostream<C, T>& os, basic_string_view<C, T> v)
+{
+	return os.write(v.data(), static_cast<std::streamsize>(v.size()));
+}
+
+// hash ------------------------------------------------------------------------
+
+template<class C, class T>
+struct hash<basic_string_view<C, T>>
+{
+	size_t operator()(basic_string_view<C, T> v) const noexcept
+	{
+		return static_cast<size_t>(hash_bytes(v.data(), v.size() * sizeof(C)));
+	}
+};
+
+inline namespace literals
+{
+
+constexpr string_view operator""_sv(const char* s, size_t n) noexcept
+{
+	return string_view(s, n);
+}
+
+}	// namespace literals
+
+}	// namespace toy
+
+namespace std
+{
+
+template<class C, class T>
+struct hash<toy::basic_string_view<C, T>> : toy::hash<toy::basic_string_view<C, T>> {};
+
+}	// namespace std
+
+#endif	// TOY_CORE_STRING_VIEW_H
@@ -0,0 +1,65 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_THREAD_H
+#define TOY_CORE_THREAD_H
+
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace toy
+{
+
+// cpu_relax -------------------------------------------------------------------
+// hint the core that we are in a spin loop, on x86 it stops the pipeline
+// from speculating ahead and gives the sibling hyper-thread the resources
+
+inline void cpu_relax() noexcept
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+	_mm_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+// backoff ---------------------------------------------------------------------
+// exponential backoff for spin loops: pause a few times, then give up the
+// time slice
+
+class backoff
+{
+public:
+	void pause() noexcept
+	{
+		if (count < spin_limit)
+		{
+			for (unsigned i = 0; i < (1u << count); ++i)
+				cpu_relax();
+			++count;
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	void reset() noexcept { count = 0; }
+
+private:
+	static constexpr unsigned spin_limit = 6;
+
+	unsigned count{};
+};
+
+}	// namespace toy
+
+#endif	// TOY_CORE_THREAD_H
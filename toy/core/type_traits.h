@@ -3,6 +3,7 @@
 #endif
 
 #include <type_traits>
+#include <utility>
 
 #ifndef TOY_CORE_TYPE_TRAITS_H
 #define TOY_CORE_TYPE_TRAITS_H
@@ -356,6 +357,42 @@ template<class T>
 using add_rvalue_reference_t = typename add_rvalue_reference<T>::type;
 
 
+// -----------------------------------------------------------------------------
+// relocation
+// -----------------------------------------------------------------------------
+
+
+// is_trivially_relocatable ----------------------------------------------------
+// Moving a T to new storage and destroying the source can be done with a
+// memcpy of its bytes. True for trivially copyable types and for the ones that
+// opt in, which any type holding no pointer into itself can do, e.g. unique_ptr
+// or shared_ptr. Containers use it to grow and to erase with memmove instead
+// of a move and a destructor call per element.
+//
+// Opt in by specializing the trait, or with an annotation in the class:
+//     using is_trivially_relocatable = toy::true_type;
+
+template<class T, class = void>
+struct _has_relocatable_annotation : false_type {};
+
+template<class T>
+struct _has_relocatable_annotation<T, std::void_t<typename T::is_trivially_relocatable>>
+	: bool_constant<T::is_trivially_relocatable::value> {};
+
+template<class T>
+struct is_trivially_relocatable
+	: bool_constant<std::is_trivially_copyable<T>::value || _has_relocatable_annotation<T>::value> {};
+
+template<class T>
+struct is_trivially_relocatable<const T> : is_trivially_relocatable<T> {};
+
+template<class T1, class T2>
+struct is_trivially_relocatable<std::pair<T1, T2>>
+	: bool_constant<is_trivially_relocatable<T1>::value && is_trivially_relocatable<T2>::value> {};
+
+template<class T>
+constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
 // -----------------------------------------------------------------------------
 // forward & move
 // -----------------------------------------------------------------------------
@@ -0,0 +1,655 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_CORE_UNORDER_MAP_H
+#define TOY_CORE_UNORDER_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TOY_HASH_SSE2 1
+#include <emmintrin.h>
+#else
+#define TOY_HASH_SSE2 0
+#endif
+
+#include "toy/core/functional.h"
+#include "toy/core/memory.h"
+#include "toy/core/type_traits.h"
+#include "toy/core/utility.h"
+#include "toy/utility/byte.h"
+
+namespace toy
+{
+
+// control bytes ---------------------------------------------------------------
+// the flat tables keep one byte per slot in an array of their own: empty,
+// deleted, or full with 7 bits of the hash. A probe scans these bytes 16 at
+// a time and only touches a slot when its byte matches, so a miss usually
+// costs one cache line. The first 15 bytes are cloned after the last one, a
+// 16 byte load at any position then sees the wrapped bytes as well
+
+namespace detail
+{
+
+constexpr uint8_t ctrl_empty   = 0x80;
+constexpr uint8_t ctrl_deleted = 0xfe;
+
+constexpr size_t ctrl_group = 16;
+
+constexpr bool ctrl_is_full(uint8_t c) noexcept { return (c & 0x80) == 0; }
+
+constexpr uint8_t ctrl_tag(size_t h) noexcept { return static_cast<uint8_t>(h & 0x7f); }
+
+struct ctrl_match
+{	// the bytes of a group that are equal to the tag, and that are empty
+	uint32_t tags;
+	uint32_t empties;
+};
+
+inline ctrl_match match_group(const uint8_t* ctrl, uint8_t tag) noexcept
+{
+#if TOY_HASH_SSE2
+	__m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+	uint32_t tags = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(tag)))));
+	uint32_t empties = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(ctrl_empty)))));
+	return ctrl_match{ tags, empties };
+#else
+	ctrl_match m{ 0, 0 };
+	for (uint32_t i = 0; i < ctrl_group; ++i)
+	{
+		m.tags |= uint32_t(ctrl[i] == tag) << i;
+		m.empties |= uint32_t(ctrl[i] == ctrl_empty) << i;
+	}
+	return m;
+#endif
+}
+
+}	// namespace detail
+
+// unordered_map ---------------------------------------------------------------
+
+// A hash map with open addressing and linear probing over groups of 16
+// control bytes (see above), the elements stored inline in one array. Unlike
+// std::unordered_map there is no node per element: a lookup is a hash, one
+// SIMD compare and, on a tag hit, one key compare. Growth moves the elements,
+// so references and iterators are invalidated by any insert that rehashes,
+// as with vector.
+//
+// Erase leaves a tombstone unless the next slot is empty, tombstones are
+// dropped at the next rehash. The load factor stays under 7/8.
+template<class K, class V, class Hash = toy::hash<K>, class KeyEqual = std::equal_to<K>,
+	class Allocator = allocator<pair<const K, V>>>
+class unordered_map
+{
+public:
+	using key_type        = K;
+	using mapped_type     = V;
+	using value_type      = pair<const K, V>;
+	using size_type       = size_t;
+	using difference_type = ptrdiff_t;
+	using hasher          = Hash;
+	using key_equal       = KeyEqual;
+	using allocator_type  = Allocator;
+	using reference       = value_type&;
+	using const_reference = const value_type&;
+
+private:
+	using alloc_traits = std::allocator_traits<Allocator>;
+	using ctrl_alloc   = typename alloc_traits::template rebind_alloc<uint8_t>;
+	using ctrl_traits  = std::allocator_traits<ctrl_alloc>;
+
+	static constexpr size_type min_capacity = detail::ctrl_group;
+
+public:
+	template<bool Const>
+	class map_iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type        = unordered_map::value_type;
+		using difference_type   = ptrdiff_t;
+		using pointer           = conditional_t<Const, const value_type*, value_type*>;
+		using reference         = conditional_t<Const, const value_type&, value_type&>;
+
+		map_iterator() noexcept = default;
+
+		template<bool C = Const, class = enable_if_t<C>>
+		map_iterator(const map_iterator<false>& right) noexcept
+			: ctrl(right.ctrl), slot(right.slot), last(right.last)
+		{
+		}
+
+		reference operator*() const noexcept  { return *slot; }
+		pointer   operator->() const noexcept { return slot; }
+
+		map_iterator& operator++() noexcept
+		{
+			++ctrl;
+			++slot;
+			skip_free();
+			return *this;
+		}
+
+		map_iterator operator++(int) noexcept
+		{
+			map_iterator tmp = *this;
+			++*this;
+			return tmp;
+		}
+
+		friend bool operator==(const map_iterator& a, const map_iterator& b) noexcept { return a.slot == b.slot; }
+		friend bool operator!=(const map_iterator& a, const map_iterator& b) noexcept { return a.slot != b.slot; }
+
+	private:
+		friend class unordered_map;
+		template<bool> friend class map_iterator;
+
+		map_iterator(const uint8_t* ctrl, value_type* slot, const uint8_t* last) noexcept
+			: ctrl(ctrl), slot(slot), last(last)
+		{
+		}
+
+		void skip_free() noexcept
+		{
+			while (ctrl != last && !detail::ctrl_is_full(*ctrl))
+			{
+				++ctrl;
+				++slot;
+			}
+		}
+
+	private:
+		const uint8_t* ctrl{ nullptr };
+		value_type*    slot{ nullptr };
+		const uint8_t* last{ nullptr };		// the end of the control bytes, not of the clones
+	};
+
+	using iterator       = map_iterator<false>;
+	using const_iterator = map_iterator<true>;
+
+	// constructors
+
+	unordered_map() = default;
+
+	explicit unordered_map(size_type bucket_count, const Hash& hash = Hash(),
+		const KeyEqual& equal = KeyEqual(), const Allocator& a = Allocator())
+		: storage(a, hash, equal)
+	{
+		reserve(bucket_count);
+	}
+
+	template<class InputIt>
+	unordered_map(InputIt first, InputIt last, size_type bucket_count = 0, const Hash& hash = Hash(),
+		const KeyEqual& equal = KeyEqual(), const Allocator& a = Allocator())
+		: unordered_map(bucket_count, hash, equal, a)
+	{
+		insert(first, last);
+	}
+
+	unordered_map(std::initializer_list<value_type> il, size_type bucket_count = 0, const Hash& hash = Hash(),
+		const KeyEqual& equal = KeyEqual(), const Allocator& a = Allocator())
+		: unordered_map(il.begin(), il.end(), bucket_count, hash, equal, a)
+	{
+	}
+
+	unordered_map(const unordered_map& right)
+		: storage(alloc_traits::select_on_container_copy_construction(right.storage), right.storage.hash, right.storage.equal)
+	{
+		reserve(right.size());
+		for (const value_type& value : right)
+			insert_unique(hash_of(value.first), value.first, value.second);
+	}
+
+	unordered_map(unordered_map&& right) noexcept
+		: storage(toy::move(static_cast<Allocator&>(right.storage)), right.storage.hash, right.storage.equal)
+	{
+		steal(right);
+	}
+
+	~unordered_map()
+	{
+		release();
+	}
+
+	unordered_map& operator=(const unordered_map& right)
+	{
+		if (this != &right)
+			unordered_map(right).swap(*this);
+		return *this;
+	}
+
+	unordered_map& operator=(unordered_map&& right) noexcept
+	{
+		if (this != &right)
+		{
+			release();
+			static_cast<Allocator&>(storage) = toy::move(static_cast<Allocator&>(right.storage));
+			storage.hash  = right.storage.hash;
+			storage.equal = right.storage.equal;
+			steal(right);
+		}
+		return *this;
+	}
+
+	allocator_type get_allocator() const noexcept { return storage; }
+	hasher         hash_function() const { return storage.hash; }
+	key_equal      key_eq() const { return storage.equal; }
+
+	// iterators
+
+	iterator begin() noexcept
+	{
+		iterator it(storage.ctrl, storage.slots, storage.ctrl + capacity());
+		it.skip_free();
+		return it;
+	}
+
+	const_iterator begin() const noexcept { return const_cast<unordered_map*>(this)->begin(); }
+	const_iterator cbegin() const noexcept { return begin(); }
+
+	iterator       end() noexcept        { return iterator(storage.ctrl + capacity(), storage.slots + capacity(), storage.ctrl + capacity()); }
+	const_iterator end() const noexcept  { return const_cast<unordered_map*>(this)->end(); }
+	const_iterator cend() const noexcept { return end(); }
+
+	// capacity
+
+	bool      empty() const noexcept    { return storage.count == 0; }
+	size_type size() const noexcept     { return storage.count; }
+	size_type capacity() const noexcept { return storage.mask ? storage.mask + 1 : 0; }
+	size_type bucket_count() const noexcept { return capacity(); }
+
+	float load_factor() const noexcept { return capacity() ? float(storage.count) / float(capacity()) : 0.f; }
+	float max_load_factor() const noexcept { return 0.875f; }
+
+	void reserve(size_type n)
+	{	// room for n elements without a rehash
+		size_type needed = capacity_for(n);
+		if (needed > capacity())
+			rehash_to(needed);
+	}
+
+	void rehash(size_type n)
+	{	// n buckets at least, also drops the tombstones
+		size_type needed = capacity_for(storage.count);
+		if (n > needed)
+			needed = bit_ceil(n < min_capacity ? min_capacity : n);
+		if (needed == 0)
+			release();
+		else
+			rehash_to(needed);
+	}
+
+	// lookup
+
+	iterator find(const K& key)
+	{
+		size_type i = find_index(hash_of(key), key);
+		return i == npos ? end() : iterator_at(i);
+	}
+
+	const_iterator find(const K& key) const { return const_cast<unordered_map*>(this)->find(key); }
+
+	bool      contains(const K& key) const { return find_index(hash_of(key), key) != npos; }
+	size_type count(const K& key) const    { return contains(key) ? 1 : 0; }
+
+	V& at(const K& key)
+	{
+		size_type i = find_index(hash_of(key), key);
+		if (i == npos)
+			throw std::out_of_range("unordered_map::at -- key not found");
+		return storage.slots[i].second;
+	}
+
+	const V& at(const K& key) const { return const_cast<unordered_map*>(this)->at(key); }
+
+	V& operator[](const K& key) { return try_emplace(key).first->second; }
+	V& operator[](K&& key)      { return try_emplace(toy::move(key)).first->second; }
+
+	// modifiers
+
+	template<class... Args>
+	pair<iterator, bool> try_emplace(const K& key, Args&&... args)
+	{	// insert (key, V(args...)) if key is absent
+		size_t h = hash_of(key);
+		size_type i = find_index(h, key);
+		if (i != npos)
+			return pair<iterator, bool>(iterator_at(i), false);
+		i = insert_unique(h, key, toy::forward<Args>(args)...);
+		return pair<iterator, bool>(iterator_at(i), true);
+	}
+
+	template<class... Args>
+	pair<iterator, bool> try_emplace(K&& key, Args&&... args)
+	{
+		size_t h = hash_of(key);
+		size_type i = find_index(h, key);
+		if (i != npos)
+			return pair<iterator, bool>(iterator_at(i), false);
+		i = insert_unique(h, toy::move(key), toy::forward<Args>(args)...);
+		return pair<iterator, bool>(iterator_at(i), true);
+	}
+
+	pair<iterator, bool> insert(const value_type& value) { return try_emplace(value.first, value.second); }
+
+	template<class InputIt>
+	void insert(InputIt first, InputIt last)
+	{
+		for (; first != last; ++first)
+			insert(*first);
+	}
+
+	template<class M>
+	pair<iterator, bool> insert_or_assign(const K& key, M&& value)
+	{
+		auto result = try_emplace(key, toy::forward<M>(value));
+		if (!result.second)
+			result.first->second = toy::forward<M>(value);
+		return result;
+	}
+
+	template<class M>
+	pair<iterator, bool> insert_or_assign(K&& key, M&& value)
+	{
+		auto result = try_emplace(toy::move(key), toy::forward<M>(value));
+		if (!result.second)
+			result.first->second = toy::forward<M>(value);
+		return result;
+	}
+
+	template<class... Args>
+	pair<iterator, bool> emplace(Args&&... args)
+	{	// constructs the element first, to learn its key
+		value_type value(toy::forward<Args>(args)...);
+		return try_emplace(toy::move(const_cast<K&>(value.first)), toy::move(value.second));
+	}
+
+	size_type erase(const K& key)
+	{
+		size_type i = find_index(hash_of(key), key);
+		if (i == npos)
+			return 0;
+		erase_at(i);
+		return 1;
+	}
+
+	iterator erase(const_iterator pos)
+	{	// the iterator after pos
+		size_type i = static_cast<size_type>(pos.slot - storage.slots);
+		erase_at(i);
+		iterator it = iterator_at(i);
+		it.skip_free();
+		return it;
+	}
+
+	void clear() noexcept
+	{
+		if (capacity() == 0)
+			return;
+		destroy_all();
+		std::memset(storage.ctrl, detail::ctrl_empty, capacity() + detail::ctrl_group - 1);
+		storage.count = 0;
+		storage.used = 0;
+	}
+
+	void swap(unordered_map& right) noexcept
+	{
+		using std::swap;
+		swap(static_cast<Allocator&>(storage), static_cast<Allocator&>(right.storage));
+		swap(storage.hash, right.storage.hash);
+		swap(storage.equal, right.storage.equal);
+		swap(storage.ctrl, right.storage.ctrl);
+		swap(storage.slots, right.storage.slots);
+		swap(storage.mask, right.storage.mask);
+		swap(storage.count, right.storage.count);
+		swap(storage.used, right.storage.used);
+	}
+
+	friend bool operator==(const unordered_map& a, const unordered_map& b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (const value_type& value : a)
+		{
+			auto it = b.find(value.first);
+			if (it == b.end() || !(it->second == value.second))
+				return false;
+		}
+		return true;
+	}
+
+	friend bool operator!=(const unordered_map& a, const unordered_map& b) { return !(a == b); }
+
+private:
+	static constexpr size_type npos = ~size_type(0);
+
+	size_t hash_of(const K& key) const { return static_cast<size_t>(storage.hash(key)); }
+
+	static size_type capacity_for(size_type n) noexcept
+	{	// keep n under 7/8 of the capacity
+		if (n == 0)
+			return 0;
+		size_type capacity = bit_ceil(n + n / 7 + 1);
+		return capacity < min_capacity ? min_capacity : capacity;
+	}
+
+	iterator iterator_at(size_type i) noexcept
+	{
+		return iterator(storage.ctrl + i, storage.slots + i, storage.ctrl + capacity());
+	}
+
+	size_type find_index(size_t h, const K& key) const
+	{
+		if (storage.mask == 0)
+			return npos;
+		uint8_t tag = detail::ctrl_tag(h);
+		for (size_type i = (h >> 7) & storage.mask, probed = 0; probed <= storage.mask;
+			i = (i + detail::ctrl_group) & storage.mask, probed += detail::ctrl_group)
+		{
+			detail::ctrl_match m = detail::match_group(storage.ctrl + i, tag);
+			// only the slots before the first empty one are on the probe path
+			uint32_t live = m.empties ? (m.empties & (0u - m.empties)) - 1 : 0xffff;
+			for (uint32_t bits = m.tags & live; bits != 0; bits &= bits - 1)
+			{
+				size_type j = (i + countr_zero(bits)) & storage.mask;
+				if (storage.equal(storage.slots[j].first, key))
+					return j;
+			}
+			if (m.empties)
+				return npos;
+		}
+		return npos;
+	}
+
+	size_type find_free(size_t h) const noexcept
+	{	// the first empty or deleted slot on the probe path of h
+		for (size_type i = (h >> 7) & storage.mask;; i = (i + detail::ctrl_group) & storage.mask)
+		{
+#if TOY_HASH_SSE2
+			__m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(storage.ctrl + i));
+			uint32_t free = static_cast<uint32_t>(_mm_movemask_epi8(group));	// the high bit: empty or deleted
+#else
+			uint32_t free = 0;
+			for (uint32_t k = 0; k < detail::ctrl_group; ++k)
+				free |= uint32_t(!detail::ctrl_is_full(storage.ctrl[i + k])) << k;
+#endif
+			if (free)
+				return (i + countr_zero(free)) & storage.mask;
+		}
+	}
+
+	void set_ctrl(size_type i, uint8_t c) noexcept
+	{	// and its clone past the end
+		storage.ctrl[i] = c;
+		if (i < detail::ctrl_group - 1)
+			storage.ctrl[capacity() + i] = c;
+	}
+
+	template<class KeyArg, class... Args>
+	size_type insert_unique(size_t h, KeyArg&& key, Args&&... args)
+	{	// the key is known to be absent, the value is V(args...)
+		if (capacity() == 0 || (storage.used + 1) * 8 > capacity() * 7)
+		{	// grow, or only drop the tombstones when they are most of the load
+			size_type needed = capacity_for(storage.count + 1);
+			size_type doubled = capacity_for(2 * storage.count + 2);
+			rehash_to(needed > capacity() || storage.count * 2 > capacity() ? doubled : (capacity() ? capacity() : needed));
+		}
+
+		size_type i = find_free(h);
+		alloc_traits::construct(storage, storage.slots + i, toy::forward<KeyArg>(key), V(toy::forward<Args>(args)...));
+		if (storage.ctrl[i] == detail::ctrl_empty)
+			++storage.used;
+		set_ctrl(i, detail::ctrl_tag(h));
+		++storage.count;
+		return i;
+	}
+
+	void erase_at(size_type i)
+	{
+		alloc_traits::destroy(storage, storage.slots + i);
+		--storage.count;
+		// a probe stops at an empty byte, only a slot followed by one can become empty
+		if (storage.ctrl[(i + 1) & storage.mask] == detail::ctrl_empty)
+		{
+			set_ctrl(i, detail::ctrl_empty);
+			--storage.used;
+		}
+		else
+		{
+			set_ctrl(i, detail::ctrl_deleted);
+		}
+	}
+
+	void rehash_to(size_type capacity)
+	{	// every element into fresh arrays of 'capacity' slots
+		ctrl_alloc ca(storage);
+		uint8_t* ctrl = ctrl_traits::allocate(ca, capacity + detail::ctrl_group - 1);
+		value_type* slots;
+		try
+		{
+			slots = alloc_traits::allocate(storage, capacity);
+		}
+		catch (...)
+		{
+			ctrl_traits::deallocate(ca, ctrl, capacity + detail::ctrl_group - 1);
+			throw;
+		}
+		std::memset(ctrl, detail::ctrl_empty, capacity + detail::ctrl_group - 1);
+
+		uint8_t*    old_ctrl = storage.ctrl;
+		value_type* old_slots = storage.slots;
+		size_type   old_capacity = this->capacity();
+
+		storage.ctrl  = ctrl;
+		storage.slots = slots;
+		storage.mask  = capacity - 1;
+		storage.used  = storage.count;
+
+		for (size_type i = 0; i < old_capacity; ++i)
+		{
+			if (!detail::ctrl_is_full(old_ctrl[i]))
+				continue;
+			size_t h = hash_of(old_slots[i].first);
+			size_type j = find_free(h);
+			relocate(old_slots + i, slots + j);
+			set_ctrl(j, detail::ctrl_tag(h));
+		}
+
+		if (old_ctrl)
+		{
+			ctrl_traits::deallocate(ca, old_ctrl, old_capacity + detail::ctrl_group - 1);
+			alloc_traits::deallocate(storage, old_slots, old_capacity);
+		}
+	}
+
+	void relocate(value_type* from, value_type* to) noexcept
+	{	// a memcpy for trivially relocatable keys and values, the key is const
+		if constexpr (is_trivially_relocatable<K>::value && is_trivially_relocatable<V>::value)
+		{
+			std::memcpy(static_cast<void*>(to), static_cast<const void*>(from), sizeof(value_type));
+		}
+		else
+		{
+			alloc_traits::construct(storage, to, toy::move(const_cast<K&>(from->first)), toy::move(from->second));
+			alloc_traits::destroy(storage, from);
+		}
+	}
+
+	void destroy_all() noexcept
+	{
+		if constexpr (!std::is_trivially_destructible<value_type>::value)
+			for (size_type i = 0; i < capacity(); ++i)
+				if (detail::ctrl_is_full(storage.ctrl[i]))
+					alloc_traits::destroy(storage, storage.slots + i);
+	}
+
+	void release() noexcept
+	{
+		if (capacity() == 0)
+			return;
+		destroy_all();
+		ctrl_alloc ca(storage);
+		ctrl_traits::deallocate(ca, storage.ctrl, capacity() + detail::ctrl_group - 1);
+		alloc_traits::deallocate(storage, storage.slots, capacity());
+		storage.ctrl  = nullptr;
+		storage.slots = nullptr;
+		storage.mask  = 0;
+		storage.count = 0;
+		storage.used  = 0;
+	}
+
+	void steal(unordered_map& right) noexcept
+	{
+		storage.ctrl  = right.storage.ctrl;
+		storage.slots = right.storage.slots;
+		storage.mask  = right.storage.mask;
+		storage.count = right.storage.count;
+		storage.used  = right.storage.used;
+		right.storage.ctrl  = nullptr;
+		right.storage.slots = nullptr;
+		right.storage.mask  = right.storage.count = right.storage.used = 0;
+	}
+
+private:
+	struct impl : Allocator
+	{	// the allocator is a base, an empty one takes no room
+		impl() = default;
+		impl(const Allocator& a, const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual())
+			: Allocator(a), hash(hash), equal(equal) {}
+		impl(Allocator&& a, const Hash& hash, const KeyEqual& equal)
+			: Allocator(toy::move(a)), hash(hash), equal(equal) {}
+
+		Hash        hash;
+		KeyEqual    equal;
+		uint8_t*    ctrl{ nullptr };		// capacity + 15 bytes, the last 15 clone the first
+		value_type* slots{ nullptr };
+		size_type   mask{ 0 };				// capacity - 1, 0 before the first insert
+		size_type   count{ 0 };				// full slots
+		size_type   used{ 0 };				// full and deleted slots
+	};
+
+	impl storage;
+};
+
+template<class K, class V, class H, class E, class A>
+inline void swap(unordered_map<K, V, H, E, A>& a, unordered_map<K, V, H, E, A>& b) noexcept
+{
+	a.swap(b);
+}
+
+template<class K, class V, class H, class E, class A>
+struct is_trivially_relocatable<unordered_map<K, V, H, E, A>>
+	: bool_constant<is_trivially_relocatable<A>::value && is_trivially_relocatable<H>::value &&
+		is_trivially_relocatable<E>::value> {};
+
+}	// namespace toy
+
+#endif // TOY_CORE_UNORDER_MAP_H
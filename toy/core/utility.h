@@ -2,6 +2,7 @@
 #pragma once
 #endif
 
+#include <tuple>
 #include <type_traits>
 #include <utility>
 
@@ -176,6 +177,21 @@ struct pair
 	}
 };
 
+template<class T1, class T2>
+template<class Tuple1, class Tuple2, size_t... Indexes1, size_t... Indexes2>
+inline pair<T1, T2>::pair(Tuple1& a, Tuple2& b,
+	std::index_sequence<Indexes1...>, std::index_sequence<Indexes2...>)
+	: first(std::get<Indexes1>(toy::move(a))...), second(std::get<Indexes2>(toy::move(b))...)
+{	// construct from pair of tuples
+}
+
+template<class T1, class T2>
+template<class... Types1, class... Types2>
+inline pair<T1, T2>::pair(std::piecewise_construct_t, std::tuple<Types1...> a, std::tuple<Types2...> b)
+	: pair(a, b, std::index_sequence_for<Types1...>(), std::index_sequence_for<Types2...>())
+{	// construct from pair of tuples
+}
+
 // pair functions --------------------------------------------------------------
 
 template<class T1, class T2,
@@ -223,6 +239,10 @@ constexpr bool operator>=(const pair<T1, T2>& left, const pair<T1, T2>& right)
 	return (!(left < right));
 }
 
+template<class T1, class T2>
+struct is_trivially_relocatable<pair<T1, T2>>
+	: bool_constant<is_trivially_relocatable<T1>::value && is_trivially_relocatable<T2>::value> {};
+
 //  make_pair ------------------------------------------------------------------
 
 template<class T1, class T2>
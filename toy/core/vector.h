@@ -6,63 +6,777 @@
 #define TOY_CORE_VECTOR_H
 
 #include <algorithm>
-#include <allocators>
+#include <cstring>
 #include <iterator>
 #include <memory>
+#include <stdexcept>
 #include <type_traits>
-#include <vector>
 
 #include "toy/core/initializer_list.h"
+#include "toy/core/memory.h"
 #include "toy/core/utility.h"
 
 namespace toy
 {
 
-// base class for vector to handle allocator
+// vector_base -----------------------------------------------------------------
+
+// base class for vector to handle allocator: owns the storage, not the objects
 template <typename T, typename Allocator>
 struct vector_base
 {
 	using allocator_type  = Allocator;
 	using size_type       = size_t;
 	using difference_type = ptrdiff_t;
-	
+
+	using alloc_traits    = std::allocator_traits<allocator_type>;
+
 	// 'npos' means non-valid position or simply non-position.
-	static const size_type npos     = (size_type)-1;      
-	// -1 is reserved for 'npos'. It also happens to be slightly beneficial 
-	// that kMaxSize is a value less than -1, as it helps us deal with potential 
+	static const size_type npos     = (size_type)-1;
+	// -1 is reserved for 'npos'. It also happens to be slightly beneficial
+	// that kMaxSize is a value less than -1, as it helps us deal with potential
 	// integer wraparound issues.
-	static const size_type kMaxSize = (size_type)-2;      
+	static const size_type kMaxSize = (size_type)-2;
 
 protected:
-	T*                                          mpBegin;
-	T*                                          mpEnd;
-	eastl::compressed_pair<T*, allocator_type>  mCapacityAllocator;
+	struct impl : allocator_type
+	{	// the allocator is a base, an empty one takes no room
+		impl() noexcept(std::is_nothrow_default_constructible<allocator_type>::value) : allocator_type() {}
+		impl(const allocator_type& a) noexcept : allocator_type(a) {}
 
-	T*& internalCapacityPtr() EA_NOEXCEPT { return mCapacityAllocator.first(); }
-	T* const& internalCapacityPtr() const EA_NOEXCEPT { return mCapacityAllocator.first(); }
-	allocator_type&  internalAllocator() EA_NOEXCEPT { return mCapacityAllocator.second(); }
-	const allocator_type&  internalAllocator() const EA_NOEXCEPT { return mCapacityAllocator.second(); }
+		T* begin{ nullptr };
+		T* end{ nullptr };
+		T* capacity{ nullptr };
+	};
+
+	impl storage;
+
+	allocator_type&       internal_allocator() noexcept { return storage; }
+	const allocator_type& internal_allocator() const noexcept { return storage; }
 
 public:
-	vector_base();
-	vector_base(const allocator_type& allocator);
-	vector_base(size_type n, const allocator_type& allocator);
+	vector_base() {}
+	vector_base(const allocator_type& allocator) : storage(allocator) {}
+	vector_base(size_type n, const allocator_type& allocator) : storage(allocator)
+	{
+		storage.begin    = do_allocate(n);
+		storage.end      = storage.begin;
+		storage.capacity = storage.begin + n;
+	}
 
-	~vector_base();
+	~vector_base()
+	{
+		do_free(storage.begin, static_cast<size_type>(storage.capacity - storage.begin));
+	}
 
-	const allocator_type& get_allocator() const EA_NOEXCEPT;
-	allocator_type&       get_allocator() EA_NOEXCEPT;
-	void                  set_allocator(const allocator_type& allocator);
+	allocator_type get_allocator() const noexcept { return internal_allocator(); }
 
 protected:
-	T*        DoAllocate(size_type n);
-	void      DoFree(T* p, size_type n);
-	size_type GetNewCapacity(size_type currentCapacity);
+	T* do_allocate(size_type n)
+	{
+		if (n == 0)
+			return nullptr;
+		if (n > max_capacity())
+			throw std::length_error("vector::do_allocate -- capacity too large");
+		return alloc_traits::allocate(internal_allocator(), n);
+	}
+
+	void do_free(T* p, size_type n) noexcept
+	{
+		if (p)
+			alloc_traits::deallocate(internal_allocator(), p, n);
+	}
+
+	size_type max_capacity() const noexcept
+	{
+		size_type n = alloc_traits::max_size(internal_allocator());
+		return n < kMaxSize / sizeof(T) ? n : kMaxSize / sizeof(T);
+	}
+
+	size_type get_new_capacity(size_type current, size_type needed) const
+	{	// grow by a factor of 2
+		if (needed > max_capacity())
+			throw std::length_error("vector -- size too large");
+		size_type n = current > max_capacity() / 2 ? max_capacity() : current * 2;
+		return n < needed ? needed : n;
+	}
 
 };	// vector_base
 
+// vector ----------------------------------------------------------------------
+
+// Contiguous array. Growth, insert and erase move the elements with
+// uninitialized_relocate, so for a trivially relocatable T (unique_ptr,
+// shared_ptr, pair of them, ...) they are a memmove instead of a move
+// constructor and a destructor per element.
+
+template<typename T, typename Allocator = allocator<T>>
+class vector : public vector_base<T, Allocator>
+{
+	using base = vector_base<T, Allocator>;
+	using base::storage;
+	using base::do_allocate;
+	using base::do_free;
+	using base::internal_allocator;
+
+	using alloc_traits = typename base::alloc_traits;
+
+public:
+	using value_type             = T;
+	using allocator_type         = Allocator;
+	using pointer                = T*;
+	using const_pointer          = const T*;
+	using reference              = T&;
+	using const_reference        = const T&;
+	using iterator               = T*;
+	using const_iterator         = const T*;
+	using reverse_iterator       = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+	using size_type              = size_t;
+	using difference_type        = ptrdiff_t;
+
+public:
+	// constructors
+	vector() noexcept(std::is_nothrow_default_constructible<allocator_type>::value) {}
+	explicit vector(const allocator_type& a) noexcept : base(a) {}
+
+	explicit vector(size_type n, const allocator_type& a = allocator_type())
+		: base(n, a)
+	{
+		storage.end = construct_n(storage.begin, n);
+	}
+
+	vector(size_type n, const value_type& value, const allocator_type& a = allocator_type())
+		: base(n, a)
+	{
+		storage.end = construct_n(storage.begin, n, value);
+	}
+
+	template<class InputIt, class = enable_if_t<!std::is_integral<InputIt>::value>>
+	vector(InputIt first, InputIt last, const allocator_type& a = allocator_type())
+		: base(a)
+	{
+		assign(first, last);
+	}
+
+	vector(std::initializer_list<value_type> il, const allocator_type& a = allocator_type())
+		: vector(il.begin(), il.end(), a) {}
+
+	vector(const vector& x)
+		: vector(x, alloc_traits::select_on_container_copy_construction(x.internal_allocator())) {}
+
+	vector(const vector& x, const allocator_type& a)
+		: base(x.size(), a)
+	{
+		storage.end = copy_construct(x.begin(), x.end(), storage.begin);
+	}
+
+	vector(vector&& x) noexcept
+		: base(toy::move(x.internal_allocator()))
+	{
+		steal(x);
+	}
+
+	vector(vector&& x, const allocator_type& a)
+		: base(a)
+	{
+		if (internal_allocator() == x.internal_allocator())
+		{
+			steal(x);
+		}
+		else
+		{
+			reserve(x.size());
+			for (T& e : x)
+				emplace_back(toy::move(e));
+		}
+	}
+
+	// destructor
+	~vector() { destroy(storage.begin, storage.end); }
+
+	// assignment
+	vector& operator=(const vector& x)
+	{
+		if (this == &x)
+			return *this;
+
+		if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+		{
+			if (internal_allocator() != x.internal_allocator())
+			{	// the memory must go back to the allocator it came from
+				clear();
+				shrink_to_fit();
+			}
+			internal_allocator() = x.internal_allocator();
+		}
+		assign(x.begin(), x.end());
+		return *this;
+	}
+
+	vector& operator=(vector&& x)
+		noexcept(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value)
+	{
+		if (this == &x)
+			return *this;
+
+		if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+		{
+			release();
+			internal_allocator() = toy::move(x.internal_allocator());
+			steal(x);
+		}
+		else
+		{
+			if (internal_allocator() == x.internal_allocator())
+			{
+				release();
+				steal(x);
+			}
+			else
+			{	// element by element into our own memory
+				assign(std::make_move_iterator(x.begin()), std::make_move_iterator(x.end()));
+			}
+		}
+		return *this;
+	}
+
+	vector& operator=(std::initializer_list<value_type> il)
+	{
+		assign(il.begin(), il.end());
+		return *this;
+	}
+
+	void assign(size_type n, const value_type& value)
+	{
+		if (n > capacity())
+		{
+			vector tmp(n, value, internal_allocator());
+			swap_storage(tmp);
+		}
+		else if (n > size())
+		{
+			std::fill(storage.begin, storage.end, value);
+			storage.end = construct_n(storage.end, n - size(), value);
+		}
+		else
+		{
+			std::fill_n(storage.begin, n, value);
+			erase_at_end(storage.begin + n);
+		}
+	}
+
+	template<class InputIt, class = enable_if_t<!std::is_integral<InputIt>::value>>
+	void assign(InputIt first, InputIt last)
+	{
+		using category = typename std::iterator_traits<InputIt>::iterator_category;
+		if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+		{
+			size_type n = static_cast<size_type>(std::distance(first, last));
+			if (n > capacity())
+			{
+				pointer p = do_allocate(n);
+				try
+				{
+					copy_construct(first, last, p);
+				}
+				catch (...)
+				{
+					do_free(p, n);
+					throw;
+				}
+				release();
+				storage.begin    = p;
+				storage.end      = p + n;
+				storage.capacity = p + n;
+			}
+			else if (n > size())
+			{
+				InputIt mid = first;
+				std::advance(mid, size());
+				std::copy(first, mid, storage.begin);
+				storage.end = copy_construct(mid, last, storage.end);
+			}
+			else
+			{
+				erase_at_end(std::copy(first, last, storage.begin));
+			}
+		}
+		else
+		{
+			clear();
+			for (; first != last; ++first)
+				emplace_back(*first);
+		}
+	}
+
+	void assign(std::initializer_list<value_type> il) { assign(il.begin(), il.end()); }
+
+	using base::get_allocator;
+
+	// iterators
+	iterator begin() noexcept { return storage.begin; }
+	const_iterator begin() const noexcept { return storage.begin; }
+	iterator end() noexcept { return storage.end; }
+	const_iterator end() const noexcept { return storage.end; }
+
+	reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+	const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+	reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+	const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+
+	const_iterator cbegin() const noexcept { return begin(); }
+	const_iterator cend() const noexcept { return end(); }
+	const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+	const_reverse_iterator crend() const noexcept { return rend(); }
+
+	// capacity
+	bool empty() const noexcept { return storage.begin == storage.end; }
+	size_type size() const noexcept { return static_cast<size_type>(storage.end - storage.begin); }
+	size_type capacity() const noexcept { return static_cast<size_type>(storage.capacity - storage.begin); }
+	size_type max_size() const noexcept { return base::max_capacity(); }
+
+	void reserve(size_type n)
+	{
+		if (n > capacity())
+			reallocate(n);
+	}
+
+	void shrink_to_fit()
+	{
+		if (capacity() != size())
+			reallocate(size());
+	}
+
+	void resize(size_type n)
+	{
+		if (n > size())
+		{
+			reserve(n > capacity() ? base::get_new_capacity(capacity(), n) : n);
+			storage.end = construct_n(storage.end, n - size());
+		}
+		else
+		{
+			erase_at_end(storage.begin + n);
+		}
+	}
+
+	void resize(size_type n, const value_type& value)
+	{
+		if (n > size())
+			insert(end(), n - size(), value);
+		else
+			erase_at_end(storage.begin + n);
+	}
+
+	// element access
+	reference operator[](size_type i) { return storage.begin[i]; }
+	const_reference operator[](size_type i) const { return storage.begin[i]; }
+
+	reference at(size_type i)
+	{
+		if (i >= size())
+			throw std::out_of_range("vector::at -- out of range");
+		return storage.begin[i];
+	}
 
+	const_reference at(size_type i) const
+	{
+		if (i >= size())
+			throw std::out_of_range("vector::at -- out of range");
+		return storage.begin[i];
+	}
+
+	reference front() { return *storage.begin; }
+	const_reference front() const { return *storage.begin; }
+	reference back() { return *(storage.end - 1); }
+	const_reference back() const { return *(storage.end - 1); }
+
+	T* data() noexcept { return storage.begin; }
+	const T* data() const noexcept { return storage.begin; }
+
+	// modifiers
+	template<class... Args>
+	reference emplace_back(Args&&... args)
+	{
+		if (storage.end != storage.capacity)
+		{
+			alloc_traits::construct(internal_allocator(), storage.end, toy::forward<Args>(args)...);
+			++storage.end;
+		}
+		else
+		{
+			realloc_insert(storage.end, toy::forward<Args>(args)...);
+		}
+		return back();
+	}
+
+	void push_back(const value_type& value) { emplace_back(value); }
+	void push_back(value_type&& value) { emplace_back(toy::move(value)); }
+
+	void pop_back()
+	{
+		--storage.end;
+		alloc_traits::destroy(internal_allocator(), storage.end);
+	}
+
+	template<class... Args>
+	iterator emplace(const_iterator position, Args&&... args)
+	{
+		pointer pos = const_cast<pointer>(position);
+		if (storage.end == storage.capacity)
+			return realloc_insert(pos, toy::forward<Args>(args)...);
+
+		if (pos == storage.end)
+		{
+			alloc_traits::construct(internal_allocator(), storage.end, toy::forward<Args>(args)...);
+			++storage.end;
+			return pos;
+		}
+
+		if constexpr (is_trivially_relocatable<T>::value)
+		{	// build the value aside, then open the gap with one memmove
+			typename std::aligned_storage<sizeof(T), alignof(T)>::type tmp;
+			pointer value = reinterpret_cast<pointer>(&tmp);
+			alloc_traits::construct(internal_allocator(), value, toy::forward<Args>(args)...);
+			uninitialized_relocate_backward(pos, storage.end, storage.end + 1);
+			relocate_at(value, pos);
+		}
+		else
+		{	// the arguments may refer to an element, take the value first
+			value_type value(toy::forward<Args>(args)...);
+			alloc_traits::construct(internal_allocator(), storage.end, toy::move(*(storage.end - 1)));
+			std::move_backward(pos, storage.end - 1, storage.end);
+			*pos = toy::move(value);
+		}
+		++storage.end;
+		return pos;
+	}
+
+	iterator insert(const_iterator position, const value_type& value) { return emplace(position, value); }
+	iterator insert(const_iterator position, value_type&& value) { return emplace(position, toy::move(value)); }
+
+	iterator insert(const_iterator position, size_type n, const value_type& value)
+	{
+		pointer pos = const_cast<pointer>(position);
+		if (n == 0)
+			return pos;
+
+		value_type copy(value);	// value may be an element
+		return insert_n(pos, n, [this, &copy](pointer out, size_type k) { return construct_n(out, k, copy); });
+	}
+
+	template<class InputIt, class = enable_if_t<!std::is_integral<InputIt>::value>>
+	iterator insert(const_iterator position, InputIt first, InputIt last)
+	{
+		pointer pos = const_cast<pointer>(position);
+		using category = typename std::iterator_traits<InputIt>::iterator_category;
+		if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+		{
+			size_type n = static_cast<size_type>(std::distance(first, last));
+			if (n == 0)
+				return pos;
+			return insert_n(pos, n, [this, first, last](pointer out, size_type) { return copy_construct(first, last, out); });
+		}
+		else
+		{	// single pass: append, then rotate into place
+			difference_type offset = pos - storage.begin;
+			size_type old_size = size();
+			for (; first != last; ++first)
+				emplace_back(*first);
+			std::rotate(storage.begin + offset, storage.begin + old_size, storage.end);
+			return storage.begin + offset;
+		}
+	}
+
+	iterator insert(const_iterator position, std::initializer_list<value_type> il)
+	{
+		return insert(position, il.begin(), il.end());
+	}
+
+	iterator erase(const_iterator position)
+	{
+		return erase(position, position + 1);
+	}
+
+	iterator erase(const_iterator first, const_iterator last)
+	{
+		pointer f = const_cast<pointer>(first);
+		pointer l = const_cast<pointer>(last);
+		if (f == l)
+			return f;
+
+		if constexpr (is_trivially_relocatable<T>::value)
+		{	// destroy the range and close the gap with one memmove
+			destroy(f, l);
+			uninitialized_relocate(l, storage.end, f);
+			storage.end -= (l - f);
+		}
+		else
+		{
+			erase_at_end(std::move(l, storage.end, f));
+		}
+		return f;
+	}
+
+	void clear() noexcept { erase_at_end(storage.begin); }
+
+	void swap(vector& x) noexcept(alloc_traits::propagate_on_container_swap::value || alloc_traits::is_always_equal::value)
+	{
+		if constexpr (alloc_traits::propagate_on_container_swap::value)
+		{
+			using std::swap;
+			swap(internal_allocator(), x.internal_allocator());
+		}
+		swap_storage(x);
+	}
+
+private:
+	void steal(vector& x) noexcept
+	{
+		storage.begin    = x.storage.begin;
+		storage.end      = x.storage.end;
+		storage.capacity = x.storage.capacity;
+		x.storage.begin = x.storage.end = x.storage.capacity = nullptr;
+	}
+
+	void swap_storage(vector& x) noexcept
+	{
+		std::swap(storage.begin, x.storage.begin);
+		std::swap(storage.end, x.storage.end);
+		std::swap(storage.capacity, x.storage.capacity);
+	}
+
+	void release() noexcept
+	{	// destroy the elements and free the memory
+		destroy(storage.begin, storage.end);
+		do_free(storage.begin, capacity());
+		storage.begin = storage.end = storage.capacity = nullptr;
+	}
+
+	void destroy(pointer first, pointer last) noexcept
+	{
+		if constexpr (!std::is_trivially_destructible<T>::value)
+			for (; first != last; ++first)
+				alloc_traits::destroy(internal_allocator(), first);
+	}
+
+	void erase_at_end(pointer p) noexcept
+	{
+		destroy(p, storage.end);
+		storage.end = p;
+	}
+
+	template<class... Args>
+	pointer construct_n(pointer out, size_type n, const Args&... args)
+	{	// n objects made of args at out, all or none
+		pointer p = out;
+		try
+		{
+			for (; n > 0; --n, ++p)
+				alloc_traits::construct(internal_allocator(), p, args...);
+		}
+		catch (...)
+		{
+			destroy(out, p);
+			throw;
+		}
+		return p;
+	}
+
+	template<class ForwardIt>
+	pointer copy_construct(ForwardIt first, ForwardIt last, pointer out)
+	{	// copies of [first, last) at out, all or none
+		pointer p = out;
+		try
+		{
+			for (; first != last; ++first, ++p)
+				alloc_traits::construct(internal_allocator(), p, *first);
+		}
+		catch (...)
+		{
+			destroy(out, p);
+			throw;
+		}
+		return p;
+	}
+
+	pointer transfer_construct(pointer first, pointer last, pointer out)
+	{	// copies of [first, last) at out, or moves if T is move only, all or none
+		if constexpr (std::is_copy_constructible<T>::value)
+			return copy_construct(first, last, out);
+		else
+			return copy_construct(std::make_move_iterator(first), std::make_move_iterator(last), out);
+	}
+
+	void move_into(pointer dest) noexcept(is_trivially_relocatable<T>::value || std::is_nothrow_move_constructible<T>::value)
+	{	// the elements to the new storage dest, the old one is left uninitialized
+		if constexpr (is_trivially_relocatable<T>::value || std::is_nothrow_move_constructible<T>::value
+			|| !std::is_copy_constructible<T>::value)
+		{
+			uninitialized_relocate(storage.begin, storage.end, dest);
+		}
+		else
+		{	// a move could throw halfway, copy to keep the strong guarantee
+			copy_construct(storage.begin, storage.end, dest);
+			destroy(storage.begin, storage.end);
+		}
+	}
+
+	void adopt(pointer p, size_type size, size_type capacity) noexcept
+	{	// p holds the elements now, the old storage is uninitialized
+		do_free(storage.begin, this->capacity());
+		storage.begin    = p;
+		storage.end      = p + size;
+		storage.capacity = p + capacity;
+	}
+
+	void reallocate(size_type n)
+	{
+		size_type count = size();
+		pointer p = do_allocate(n);
+		try
+		{
+			move_into(p);
+		}
+		catch (...)
+		{
+			do_free(p, n);
+			throw;
+		}
+		adopt(p, count, n);
+	}
+
+	template<class... Args>
+	pointer realloc_insert(pointer pos, Args&&... args)
+	{	// the new element goes straight into the new storage
+		size_type count  = size();
+		size_type offset = static_cast<size_type>(pos - storage.begin);
+		size_type n = base::get_new_capacity(capacity(), count + 1);
+
+		pointer p = do_allocate(n);
+		try
+		{
+			alloc_traits::construct(internal_allocator(), p + offset, toy::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			do_free(p, n);
+			throw;
+		}
+
+		relocate_around(p, pos, 1, n);
+		adopt(p, count + 1, n);
+		return p + offset;
+	}
+
+	void relocate_around(pointer p, pointer pos, size_type gap, size_type n)
+	{	// the elements before and after pos to p, leaving gap slots at pos
+		size_type offset = static_cast<size_type>(pos - storage.begin);
+		if constexpr (is_trivially_relocatable<T>::value || std::is_nothrow_move_constructible<T>::value)
+		{
+			uninitialized_relocate(storage.begin, pos, p);
+			uninitialized_relocate(pos, storage.end, p + offset + gap);
+		}
+		else
+		{	// copies, or moves when T can't be copied; the old elements die only once both parts are made
+			try
+			{
+				transfer_construct(storage.begin, pos, p);
+				try
+				{
+					transfer_construct(pos, storage.end, p + offset + gap);
+				}
+				catch (...)
+				{
+					destroy(p, p + offset);
+					throw;
+				}
+			}
+			catch (...)
+			{
+				destroy(p + offset, p + offset + gap);
+				do_free(p, n);
+				throw;
+			}
+			destroy(storage.begin, storage.end);
+		}
+	}
+
+	template<class Construct>
+	pointer insert_n(pointer pos, size_type n, Construct construct)
+	{	// make n elements at pos with construct(out, n)
+		size_type count  = size();
+		size_type offset = static_cast<size_type>(pos - storage.begin);
+
+		if (capacity() - count < n)
+		{
+			size_type cap = base::get_new_capacity(capacity(), count + n);
+			pointer p = do_allocate(cap);
+			try
+			{
+				construct(p + offset, n);
+			}
+			catch (...)
+			{
+				do_free(p, cap);
+				throw;
+			}
+			relocate_around(p, pos, n, cap);
+			adopt(p, count + n, cap);
+			return p + offset;
+		}
+
+		if constexpr (is_trivially_relocatable<T>::value)
+		{	// open the gap with one memmove, close it again if a copy throws
+			uninitialized_relocate_backward(pos, storage.end, storage.end + n);
+			try
+			{
+				construct(pos, n);
+			}
+			catch (...)
+			{
+				uninitialized_relocate(pos + n, storage.end + n, pos);
+				throw;
+			}
+			storage.end += n;
+		}
+		else
+		{	// append, then rotate into place
+			storage.end = construct(storage.end, n);
+			std::rotate(pos, storage.begin + count, storage.end);
+		}
+		return storage.begin + offset;
+	}
+};
+
+template<class T, class A>
+inline bool operator==(const vector<T, A>& left, const vector<T, A>& right)
+{
+	return left.size() == right.size() && std::equal(left.begin(), left.end(), right.begin());
+}
+
+template<class T, class A>
+inline bool operator!=(const vector<T, A>& left, const vector<T, A>& right)
+{
+	return !(left == right);
+}
+
+template<class T, class A>
+inline bool operator<(const vector<T, A>& left, const vector<T, A>& right)
+{
+	return std::lexicographical_compare(left.begin(), left.end(), right.begin(), right.end());
+}
+
+template<class T, class A>
+inline void swap(vector<T, A>& left, vector<T, A>& right) noexcept(noexcept(left.swap(right)))
+{
+	left.swap(right);
+}
 
+// a vector holds no pointer into itself
+template<class T, class A>
+struct is_trivially_relocatable<vector<T, A>> : is_trivially_relocatable<A> {};
 
 }	// namespace toy
 
@@ -3,34 +3,420 @@
 #pragma once
 #endif
 
-#ifndef TOY_MATH_T_T_H
-#define TOY_MATH_T_T_H
+#ifndef TOY_IO_STREAM_H
+#define TOY_IO_STREAM_H
 
-#include"toy.h"
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <memory>
+
+#include "toy/core/string_view.h"
 
 namespace toy
 {
 
-class stream
+// delimiter_set ---------------------------------------------------------------
+// a set of bytes to split at. One byte is searched by the memchr kernel of
+// string_view, up to 16 bytes 16 at a time with one SSE2 compare per member,
+// larger sets one byte at a time through a 256 bit table
+
+class delimiter_set
+{
+public:
+	static constexpr size_t simd_limit = 16;
+
+	delimiter_set(char c) noexcept
+	{
+		insert(c);
+	}
+
+	delimiter_set(string_view chars) noexcept
+	{
+		for (char c : chars)
+			insert(c);
+	}
+
+	delimiter_set(const char* chars) noexcept
+		: delimiter_set(string_view(chars))
+	{
+	}
+
+	bool contains(char c) const noexcept
+	{
+		unsigned char u = static_cast<unsigned char>(c);
+		return (bits[u >> 6] >> (u & 63)) & 1;
+	}
+
+	size_t size() const noexcept { return count; }
+
+	const char* find(const char* first, size_t n) const noexcept
+	{	// the first member in [first, first + n), nullptr if none
+		if (count == 0)
+			return nullptr;
+		if (count == 1)
+			return detail::find_byte(first, n, members[0]);
+#if TOY_STRING_SSE2
+		if (count <= simd_limit)
+		{
+			__m128i patterns[simd_limit];
+			for (size_t k = 0; k < count; ++k)
+				patterns[k] = _mm_set1_epi8(members[k]);
+
+			for (; n >= 16; first += 16, n -= 16)
+			{
+				__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+				__m128i hits = _mm_cmpeq_epi8(block, patterns[0]);
+				for (size_t k = 1; k < count; ++k)
+					hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, patterns[k]));
+				uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+				if (mask != 0)
+					return first + countr_zero(mask);
+			}
+		}
+#endif
+		for (; n != 0; ++first, --n)
+			if (contains(*first))
+				return first;
+		return nullptr;
+	}
+
+private:
+	void insert(char c) noexcept
+	{
+		if (contains(c))
+			return;
+		unsigned char u = static_cast<unsigned char>(c);
+		bits[u >> 6] |= uint64_t(1) << (u & 63);
+		if (count < simd_limit)
+			members[count] = c;
+		++count;
+	}
+
+private:
+	uint64_t bits[4]{};
+	char     members[simd_limit]{};
+	size_t   count{ 0 };
+};
+
+// trim ------------------------------------------------------------------------
+// the part of 'str' between the whitespace at either end,
+// the result is a view into 'str', nothing is copied
+
+inline string_view trim_left(string_view str, const delimiter_set& whitespace = " \t") noexcept
+{
+	size_t i = 0;
+	while (i < str.size() && whitespace.contains(str[i]))
+		++i;
+	return string_view(str.data() + i, str.size() - i);
+}
+
+inline string_view trim_right(string_view str, const delimiter_set& whitespace = " \t") noexcept
 {
+	size_t n = str.size();
+	while (n != 0 && whitespace.contains(str[n - 1]))
+		--n;
+	return string_view(str.data(), n);
+}
 
-/*
-// ȡ str ݵĲ
-std::string trim(const std::string& str,
-const std::string& whitespace = " \t")
+inline string_view trim(string_view str, const delimiter_set& whitespace = " \t") noexcept
 {
-const auto strBegin = str.find_first_not_of(whitespace);
-if (strBegin == std::string::npos)
-return ""; // no content
+	return trim_right(trim_left(str, whitespace), whitespace);
+}
+
+// split -----------------------------------------------------------------------
+// a lazy range of the fields of 'text' between delimiters, every field is a
+// view into 'text'. split keeps the empty fields, "a,,b" gives "a", "", "b";
+// tokenize drops them, so runs of delimiters count as one
+//
+//	for (string_view field : split(line, ','))
+//		...
+
+class split_range
+{
+public:
+	class iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type        = string_view;
+		using difference_type   = ptrdiff_t;
+		using pointer           = const string_view*;
+		using reference         = const string_view&;
+
+		iterator() noexcept = default;
+
+		reference operator*() const noexcept  { return field; }
+		pointer   operator->() const noexcept { return &field; }
+
+		iterator& operator++() noexcept
+		{
+			advance();
+			return *this;
+		}
+
+		iterator operator++(int) noexcept
+		{
+			iterator tmp = *this;
+			advance();
+			return tmp;
+		}
+
+		bool operator==(const iterator& right) const noexcept
+		{
+			return owner == right.owner && (owner == nullptr || field.data() == right.field.data());
+		}
+
+		bool operator!=(const iterator& right) const noexcept { return !(*this == right); }
+
+	private:
+		friend class split_range;
+
+		explicit iterator(const split_range* range) noexcept
+			: owner(range), next(range->text.data())
+		{
+			advance();
+		}
+
+		void advance() noexcept
+		{
+			const char* last = owner->text.data() + owner->text.size();
+			do
+			{
+				if (!more)
+				{	// past the last field
+					owner = nullptr;
+					field = string_view();
+					return;
+				}
+
+				const char* found = owner->delims.find(next, static_cast<size_t>(last - next));
+				if (found != nullptr)
+				{
+					field = string_view(next, static_cast<size_t>(found - next));
+					next = found + 1;
+				}
+				else
+				{
+					field = string_view(next, static_cast<size_t>(last - next));
+					more = false;
+				}
+			} while (owner->skip_empty && field.empty());
+		}
+
+	private:
+		const split_range* owner{ nullptr };	// nullptr at the end
+		string_view        field;
+		const char*        next{ nullptr };		// the start of the field after 'field'
+		bool               more{ true };
+	};
+
+	using const_iterator = iterator;
+
+	split_range(string_view text, const delimiter_set& delims, bool skip_empty) noexcept
+		: text(text), delims(delims), skip_empty(skip_empty)
+	{
+	}
+
+	iterator begin() const noexcept { return iterator(this); }
+	iterator end() const noexcept   { return iterator(); }
+
+private:
+	string_view   text;
+	delimiter_set delims;
+	bool          skip_empty;
+};
 
-const auto strEnd = str.find_last_not_of(whitespace);
-const auto strRange = strEnd - strBegin + 1;
+inline split_range split(string_view text, const delimiter_set& delims) noexcept
+{
+	return split_range(text, delims, false);
+}
 
-return str.substr(strBegin, strRange);
+inline split_range tokenize(string_view text, const delimiter_set& delims = " \t\r\n") noexcept
+{
+	return split_range(text, delims, true);
 }
-*/
+
+// buffered_reader -------------------------------------------------------------
+// reads a std::istream in large blocks and hands out records as views into
+// its buffer, a view is valid until the next read. A record longer than the
+// buffer grows it, the last record of the stream needs no delimiter
+//
+//	buffered_reader reader(file);
+//	for (string_view line : reader.lines())
+//		for (string_view field : split(line, '\t'))
+//			...
+
+class buffered_reader
+{
+public:
+	class record_range;
+
+	explicit buffered_reader(std::istream& source, size_t buffer_size = 64 * 1024)
+		: source(source), buffer(new char[buffer_size > 0 ? buffer_size : 1]), capacity(buffer_size > 0 ? buffer_size : 1)
+	{
+	}
+
+	buffered_reader(const buffered_reader&) = delete;
+	buffered_reader& operator=(const buffered_reader&) = delete;
+
+	bool read_until(const delimiter_set& delims, string_view& record)
+	{	// the text up to the next delimiter, the delimiter is consumed
+		size_t scanned = first;
+		for (;;)
+		{
+			const char* found = delims.find(buffer.get() + scanned, last - scanned);
+			if (found != nullptr)
+			{
+				size_t pos = static_cast<size_t>(found - buffer.get());
+				record = string_view(buffer.get() + first, pos - first);
+				first = pos + 1;
+				return true;
+			}
+
+			size_t offset = last - first;	// already searched
+			if (!refill())
+			{
+				if (first == last)
+					return false;
+				record = string_view(buffer.get() + first, last - first);
+				first = last;
+				return true;
+			}
+			scanned = first + offset;
+		}
+	}
+
+	bool read_line(string_view& line)
+	{	// without the '\n', and without the '\r' of a "\r\n"
+		if (!read_until('\n', line))
+			return false;
+		if (line.ends_with('\r'))
+			line.remove_suffix(1);
+		return true;
+	}
+
+	bool eof() const noexcept { return at_eof && first == last; }
+
+	size_t buffer_size() const noexcept { return capacity; }
+
+	inline record_range records(const delimiter_set& delims);
+	inline record_range lines();
+
+private:
+	bool refill()
+	{	// false when the stream has no more bytes
+		if (at_eof)
+			return false;
+
+		if (first != 0)
+		{	// keep the unread part, at the front
+			std::memmove(buffer.get(), buffer.get() + first, last - first);
+			last -= first;
+			first = 0;
+		}
+		if (last == capacity)
+		{	// one record fills the whole buffer
+			std::unique_ptr<char[]> larger(new char[capacity * 2]);
+			std::memcpy(larger.get(), buffer.get(), last);
+			buffer.swap(larger);
+			capacity *= 2;
+		}
+
+		source.read(buffer.get() + last, static_cast<std::streamsize>(capacity - last));
+		size_t n = static_cast<size_t>(source.gcount());
+		if (n == 0)
+		{
+			at_eof = true;
+			return false;
+		}
+		last += n;
+		return true;
+	}
+
+private:
+	std::istream&           source;
+	std::unique_ptr<char[]> buffer;
+	size_t                  capacity;
+	size_t                  first{ 0 };		// [first, last) is read but not handed out
+	size_t                  last{ 0 };
+	bool                    at_eof{ false };
 };
 
+// an input range of the records of a reader
+class buffered_reader::record_range
+{
+public:
+	class iterator
+	{
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type        = string_view;
+		using difference_type   = ptrdiff_t;
+		using pointer           = const string_view*;
+		using reference         = const string_view&;
+
+		iterator() noexcept = default;
+
+		reference operator*() const noexcept  { return record; }
+		pointer   operator->() const noexcept { return &record; }
+
+		iterator& operator++()
+		{
+			read();
+			return *this;
+		}
+
+		bool operator==(const iterator& right) const noexcept { return owner == right.owner; }
+		bool operator!=(const iterator& right) const noexcept { return owner != right.owner; }
+
+	private:
+		friend class record_range;
+
+		explicit iterator(record_range* range)
+			: owner(range)
+		{
+			read();
+		}
+
+		void read()
+		{
+			buffered_reader& reader = *owner->reader;
+			bool ok = owner->line ? reader.read_line(record) : reader.read_until(owner->delims, record);
+			if (!ok)
+				owner = nullptr;
+		}
+
+	private:
+		record_range* owner{ nullptr };	// nullptr at the end
+		string_view   record;
+	};
+
+	record_range(buffered_reader& reader, const delimiter_set& delims, bool line) noexcept
+		: reader(&reader), delims(delims), line(line)
+	{
+	}
+
+	iterator begin() { return iterator(this); }
+	iterator end() noexcept { return iterator(); }
+
+private:
+	buffered_reader* reader;
+	delimiter_set    delims;
+	bool             line;
+};
+
+inline buffered_reader::record_range buffered_reader::records(const delimiter_set& delims)
+{
+	return record_range(*this, delims, false);
+}
+
+inline buffered_reader::record_range buffered_reader::lines()
+{
+	return record_range(*this, '\n', true);
+}
+
 }	//namespace toy
 
-#endif //TOY_MATH_T_T_H
+#endif //TOY_IO_STREAM_H
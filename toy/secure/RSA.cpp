@@ -180,7 +180,7 @@ void RSA::generate_key()
 	pri_key = { n, d };
 }
 
-vector<int> RSA_encode(string plaintext, pair<size_t, size_t> public_key)
+vector<int> RSA_encode(string_view plaintext, pair<size_t, size_t> public_key)
 {
 	auto n = public_key.first, e = public_key.second;
 
@@ -190,12 +190,9 @@ vector<int> RSA_encode(string plaintext, pair<size_t, size_t> public_key)
 	else bytes = 1;
 
 	// 㳤ȣ
+	// the padding is not copied in, chars past the end of the view read as '\0'
 	auto pad_len = bytes - plaintext.length() % bytes;
-	for(size_t i = 0; i < pad_len; ++i)
-		// plaintext.append('\0');
-		plaintext.push_back('\0');
-
-	size_t cipher_len = plaintext.length() / bytes;
+	size_t cipher_len = (plaintext.length() + pad_len) / bytes;
 	vector<int> ciphertext(cipher_len);
 
 	for (size_t i = 0; i < cipher_len; ++i)
@@ -206,7 +203,9 @@ vector<int> RSA_encode(string plaintext, pair<size_t, size_t> public_key)
 		for (int j = 0; j < bytes; ++j)
 		{
 			// cout << '\"' << plaintext[i + j] << "\"\n";
-			m += plaintext[i*bytes + j] * (1 << (7 * j));
+			size_t k = i*bytes + j;
+			char c = k < plaintext.length() ? plaintext[k] : '\0';
+			m += c * (1 << (7 * j));
 		}
 		ciphertext[i] = encode(m, e, n);
 	}
@@ -11,9 +11,12 @@
 #include <ctime>
 #include <cstring>
 #include <iostream>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "toy/core/string_view.h"
+
 namespace toy
 {
 
@@ -35,7 +38,7 @@ private:
 	std::pair<size_t, size_t> pri_key{};
 };
 
-std::vector<int> RSA_encode(std::string plaintext, std::pair<size_t, size_t> public_key);
+std::vector<int> RSA_encode(string_view plaintext, std::pair<size_t, size_t> public_key);
 
 std::string RSA_decode(const std::vector<int>& ciphertext, std::pair<size_t, size_t> private_key);
 
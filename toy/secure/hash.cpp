@@ -48,9 +48,9 @@ void II(block& a, block b, block c, block d, block Mj, block s, block Ti)
 
 }	// namespace
 
-void MD5::encode(const string& message)
+void MD5::encode(string_view message)
 {
-	encode((const byte*)(message.c_str()), message.length());
+	encode((const byte*)(message.data()), message.length());
 }
 
 void MD5::encode(const ifstream& file)
@@ -9,6 +9,8 @@
 #include <string>
 #include <toy/utility/byte.h>
 
+#include "toy/core/string_view.h"
+
 namespace toy
 {
 
@@ -24,7 +26,7 @@ using block = uint32_t;
 class MD5
 {
 public:
-	void encode(const std::string& message);
+	void encode(string_view message);
 	void encode(const std::ifstream& file);
 
 	const uint8_t* to_hash();
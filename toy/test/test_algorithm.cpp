@@ -0,0 +1,661 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <new>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "toy/algorithm/heap.h"
+#include "toy/algorithm/parallel_sort.h"
+#include "toy/algorithm/sort.h"
+#include "toy/core/priority_queue.h"
+
+// using namespace toy;
+
+// test d-ary heap -------------------------------------------------------------
+
+TEST(heap_test, dary_heap)
+{
+	std::mt19937 random(1);
+	for (size_t n : { 0, 1, 2, 5, 17, 1000 })
+	{
+		std::vector<int> v(n);
+		for (int& x : v)
+			x = static_cast<int>(random() % 100);
+		std::vector<int> sorted = v;
+		std::sort(sorted.begin(), sorted.end());
+
+		toy::make_dary_heap<4>(v.begin(), v.end());
+		ASSERT_EQ(true, toy::is_dary_heap<4>(v.begin(), v.end()));
+		toy::sort_dary_heap<4>(v.begin(), v.end());
+		ASSERT_EQ(sorted, v);
+
+		// one at a time, an 8-ary min heap
+		std::vector<int> h;
+		for (int x : sorted)
+		{
+			h.push_back(x);
+			toy::push_dary_heap<8>(h.begin(), h.end(), std::greater<>());
+		}
+		ASSERT_EQ(true, (toy::is_dary_heap<8>(h.begin(), h.end(), std::greater<>())));
+		for (size_t i = 0; i < n; ++i)
+		{
+			ASSERT_EQ(sorted[i], h.front());
+			toy::pop_dary_heap<8>(h.begin(), h.end(), std::greater<>());
+			h.pop_back();
+		}
+	}
+}
+
+// test priority_queue ---------------------------------------------------------
+
+TEST(heap_test, priority_queue)
+{
+	std::vector<int> values = { 5, 1, 9, 3, 7, 9, 0 };
+	toy::priority_queue<int> queue(values.begin(), values.end());
+	ASSERT_EQ(7, queue.size());
+	ASSERT_EQ(9, queue.top());
+
+	int more[] = { 4, 12, 2 };
+	queue.push_range(more, more + 3);	// a few, sifted up
+	ASSERT_EQ(12, queue.top());
+	std::vector<int> many(100);
+	for (int i = 0; i < 100; ++i)
+		many[i] = i * 7 % 101;
+	queue.push_range(many.begin(), many.end());	// many, heapified
+	ASSERT_EQ(110, queue.size());
+	ASSERT_EQ(true, toy::is_dary_heap<4>(queue.container().begin(), queue.container().end()));
+
+	int previous = queue.take_top();
+	ASSERT_EQ(100, previous);
+	while (!queue.empty())
+	{
+		ASSERT_LE(queue.top(), previous);
+		previous = queue.top();
+		queue.pop();
+	}
+
+	toy::priority_queue<std::string, std::greater<std::string>, 8> strings;
+	strings.emplace(3, 'b');
+	strings.push("a");
+	strings.push("c");
+	ASSERT_EQ("a", strings.top());
+	strings.pop();
+	ASSERT_EQ("bbb", strings.top());
+}
+
+TEST(heap_test, indexed_priority_queue)
+{
+	toy::indexed_priority_queue<int, std::greater<int>> queue;
+	std::vector<size_t> handles;
+	for (int i = 0; i < 50; ++i)
+		handles.push_back(queue.push(100 + i));
+	ASSERT_EQ(100, queue.top());
+	ASSERT_EQ(handles[0], queue.top_handle());
+
+	queue.decrease_key(handles[30], 5);
+	ASSERT_EQ(5, queue.top());
+	ASSERT_EQ(handles[30], queue.top_handle());
+	queue.update(handles[30], 1000);	// down again
+	ASSERT_EQ(100, queue.top());
+	queue.erase(handles[0]);
+	ASSERT_EQ(false, queue.contains(handles[0]));
+	ASSERT_EQ(101, queue.top());
+	ASSERT_EQ(1000, queue[handles[30]]);
+	ASSERT_THROW(queue.erase(handles[0]), std::out_of_range);
+
+	// a popped handle is reused
+	queue.pop();
+	ASSERT_EQ(false, queue.contains(handles[1]));
+	size_t reused = queue.push(7);
+	ASSERT_EQ(handles[1], reused);
+	ASSERT_EQ(7, queue.at(reused));
+
+	std::vector<int> order;
+	while (!queue.empty())
+	{
+		order.push_back(queue.top());
+		queue.pop();
+	}
+	ASSERT_EQ(true, std::is_sorted(order.begin(), order.end()));
+	ASSERT_EQ(49, order.size());
+	ASSERT_EQ(1000, order.back());
+}
+
+TEST(heap_test, dijkstra)
+{	// shortest paths on a grid with random weights, checked against Bellman-Ford
+	const int side = 30, n = side * side;
+	std::mt19937 random(3);
+	std::vector<std::vector<std::pair<int, int>>> edges(n);
+	for (int v = 0; v < n; ++v)
+	{
+		if (v % side + 1 < side)
+		{
+			int w = static_cast<int>(random() % 20 + 1);
+			edges[v].push_back({ v + 1, w });
+			edges[v + 1].push_back({ v, w });
+		}
+		if (v + side < n)
+		{
+			int w = static_cast<int>(random() % 20 + 1);
+			edges[v].push_back({ v + side, w });
+			edges[v + side].push_back({ v, w });
+		}
+	}
+
+	const int infinity = 1 << 30;
+	std::vector<int> distance(n, infinity);
+	std::vector<size_t> handle(n, toy::indexed_priority_queue<int>::npos);
+	toy::indexed_priority_queue<int, std::greater<int>> open;
+	distance[0] = 0;
+	handle[0] = open.push(0);
+	std::vector<int> node_of(n);
+	node_of[handle[0]] = 0;
+	while (!open.empty())
+	{
+		int u = node_of[open.top_handle()];
+		open.pop();
+		handle[u] = toy::indexed_priority_queue<int>::npos;
+		for (auto [v, w] : edges[u])
+		{
+			if (distance[u] + w >= distance[v])
+				continue;
+			bool queued = distance[v] != infinity && handle[v] != toy::indexed_priority_queue<int>::npos;
+			distance[v] = distance[u] + w;
+			if (queued)
+			{
+				open.decrease_key(handle[v], distance[v]);
+			}
+			else
+			{
+				handle[v] = open.push(distance[v]);
+				node_of[handle[v]] = v;
+			}
+		}
+	}
+
+	std::vector<int> expected(n, infinity);
+	expected[0] = 0;
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+		for (int u = 0; u < n; ++u)
+			for (auto [v, w] : edges[u])
+				if (expected[u] != infinity && expected[u] + w < expected[v])
+				{
+					expected[v] = expected[u] + w;
+					changed = true;
+				}
+	}
+	ASSERT_EQ(expected, distance);
+}
+
+// test sort -------------------------------------------------------------------
+
+namespace
+{
+
+// the inputs quicksorts are known to fall over on, by name
+std::vector<std::pair<const char*, std::vector<int>>> sort_patterns(int n)
+{
+	std::mt19937 random(11);
+	std::vector<std::pair<const char*, std::vector<int>>> patterns;
+	auto add = [&](const char* name, auto&& make)
+	{
+		std::vector<int> v(n);
+		for (int i = 0; i < n; ++i)
+			v[i] = make(i);
+		patterns.emplace_back(name, toy::move(v));
+	};
+	add("random", [&](int) { return int(random()); });
+	add("few distinct", [&](int) { return int(random() % 4); });
+	add("all equal", [&](int) { return 7; });
+	add("sorted", [&](int i) { return i; });
+	add("reversed", [&](int i) { return n - i; });
+	add("organ pipe", [&](int i) { return i < n / 2 ? i : n - i; });
+	add("sawtooth", [&](int i) { return i % 100; });
+	add("sorted, a few swapped", [&](int i) { return random() % 100 == 0 ? int(random() % n) : i; });
+	add("sorted, random tail", [&](int i) { return i < n - 20 ? i : int(random()); });
+	return patterns;
+}
+
+struct record
+{
+	int      key;
+	int      order;		// its place in the input, to check stability
+	std::string payload;
+};
+
+}	// namespace
+
+TEST(sort_test, sort)
+{
+	for (int n : { 0, 1, 2, 3, 23, 24, 25, 100, 129, 1000, 100000 })
+	{
+		for (auto& pattern : sort_patterns(n))
+		{
+			std::vector<int> expected = pattern.second, v = pattern.second;
+			std::sort(expected.begin(), expected.end());
+			toy::sort(v.begin(), v.end());
+			ASSERT_EQ(v, expected) << pattern.first << ", n = " << n;
+
+			// a comparator that is not branchless, and descending
+			v = pattern.second;
+			toy::sort(v.begin(), v.end(), [](int a, int b) { return a > b; });
+			ASSERT_TRUE(std::equal(v.begin(), v.end(), expected.rbegin())) << pattern.first << ", n = " << n;
+		}
+	}
+
+	std::vector<std::string> words;
+	std::mt19937 random(12);
+	for (int i = 0; i < 20000; ++i)
+		words.push_back(std::to_string(random() % 5000));
+	std::vector<std::string> expected = words;
+	std::sort(expected.begin(), expected.end());
+	toy::sort(words.begin(), words.end());
+	ASSERT_EQ(words, expected);
+
+	std::vector<double> doubles(50000);
+	for (double& d : doubles)
+		d = std::ldexp(double(random()) - double(1u << 31), int(random() % 40) - 20);
+	toy::sort(doubles.begin(), doubles.end(), std::greater<>());
+	ASSERT_TRUE(std::is_sorted(doubles.begin(), doubles.end(), std::greater<>()));
+}
+
+TEST(sort_test, stable_sort)
+{
+	std::mt19937 random(13);
+	for (int n : { 0, 1, 31, 33, 1000, 50000 })
+	{
+		std::vector<record> v;
+		for (int i = 0; i < n; ++i)
+			v.push_back(record{ int(random() % 64), i, std::to_string(i) });
+		auto by_key = [](const record& a, const record& b) { return a.key < b.key; };
+		std::vector<record> expected = v;
+		std::stable_sort(expected.begin(), expected.end(), by_key);
+
+		std::vector<record> buffered = v;
+		toy::stable_sort(buffered.begin(), buffered.end(), by_key);
+		std::vector<record> in_place = v;
+		toy::detail::stable_sort_in_place(in_place.begin(), in_place.end(), by_key);
+		for (int i = 0; i < n; ++i)
+		{
+			ASSERT_EQ(buffered[i].order, expected[i].order);
+			ASSERT_EQ(buffered[i].payload, expected[i].payload);
+			ASSERT_EQ(in_place[i].order, expected[i].order);
+		}
+	}
+}
+
+TEST(sort_test, radix_sort)
+{
+	std::mt19937_64 random(14);
+	for (size_t n : { 0, 1, 255, 256, 100000 })
+	{
+		std::vector<uint64_t> u(n);
+		std::vector<int32_t> s(n);
+		std::vector<int16_t> narrow(n);
+		std::vector<double> d(n);
+		std::vector<float> f(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			u[i] = random() >> (random() % 64);
+			s[i] = int32_t(random());
+			narrow[i] = int16_t(int(random() % 200) - 100);	// the high byte is 0x00 or 0xff
+			d[i] = std::ldexp(double(int64_t(random())), int(random() % 200) - 100);
+			f[i] = float(d[i]);
+		}
+		if (n > 10)
+		{
+			d[3] = -0.0;
+			d[4] = 0.0;
+			d[5] = std::numeric_limits<double>::infinity();
+			d[6] = -std::numeric_limits<double>::infinity();
+			f[7] = -std::numeric_limits<float>::max();
+		}
+
+		auto check = [](auto v)
+		{
+			auto expected = v;
+			std::sort(expected.begin(), expected.end());
+			toy::radix_sort(v.begin(), v.end());
+			ASSERT_TRUE(v == expected);
+		};
+		check(u);
+		check(s);
+		check(narrow);
+		check(d);
+		check(f);
+	}
+
+	// records by a key, stable
+	std::vector<record> v;
+	for (int i = 0; i < 30000; ++i)
+		v.push_back(record{ int(random() % 1000) - 500, i, std::to_string(i) });
+	std::vector<record> expected = v;
+	std::stable_sort(expected.begin(), expected.end(), [](const record& a, const record& b) { return a.key < b.key; });
+	toy::radix_sort(v.begin(), v.end(), [](const record& r) { return r.key; });
+	for (size_t i = 0; i < v.size(); ++i)
+	{
+		ASSERT_EQ(v[i].order, expected[i].order);
+		ASSERT_EQ(v[i].payload, expected[i].payload);
+	}
+
+	// keys alike in all but the low byte: one pass, the rest skipped
+	std::vector<uint64_t> close(1000);
+	for (size_t i = 0; i < close.size(); ++i)
+		close[i] = 0x1234567800000000ull | ((i * 37) % 256);
+	toy::radix_sort(close.begin(), close.end());
+	ASSERT_TRUE(std::is_sorted(close.begin(), close.end()));
+}
+
+TEST(sort_test, sort_network)
+{
+	std::mt19937_64 random(18);
+	auto check = [&](auto key, auto comp)
+	{
+		using K = decltype(key);
+		for (size_t n = 0; n <= toy::sort_network_max; ++n)
+		{
+			// few distinct keys, with the largest and smallest among them
+			std::vector<K> keys(n);
+			std::vector<uint64_t> values(n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				switch (random() % 4)
+				{
+				case 0: keys[i] = (std::numeric_limits<K>::max)(); break;
+				case 1: keys[i] = std::numeric_limits<K>::lowest(); break;
+				default: keys[i] = K(random() % 16); break;
+				}
+				values[i] = i;
+			}
+
+			std::vector<K> expected = keys, sorted = keys;
+			std::sort(expected.begin(), expected.end(), comp);
+			toy::sort_network(sorted.begin(), sorted.end(), comp);
+			ASSERT_TRUE(sorted == expected) << n;
+
+			// the values go with their keys, each of them once
+			std::vector<std::conditional_t<sizeof(K) == 4, uint32_t, uint64_t>> narrow(values.begin(), values.end());
+			sorted = keys;
+			toy::sort_network_by_key(sorted.begin(), sorted.end(), narrow.begin(), comp);
+			ASSERT_TRUE(sorted == expected) << n;
+			std::vector<bool> seen(n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				ASSERT_TRUE(keys[narrow[i]] == sorted[i]);
+				ASSERT_FALSE(seen[narrow[i]]);
+				seen[narrow[i]] = true;
+			}
+
+			sorted = keys;
+			toy::sort_network_by_key(sorted.begin(), sorted.end(), values.begin(), comp);
+			ASSERT_TRUE(sorted == expected) << n;
+			for (size_t i = 0; i < n; ++i)
+				ASSERT_TRUE(keys[values[i]] == sorted[i]);
+		}
+	};
+	check(int32_t(), std::less<>());
+	check(int32_t(), std::greater<>());
+	check(uint32_t(), std::less<>());
+	check(float(), std::less<float>());
+	check(float(), std::greater<>());
+	check(int64_t(), std::greater<int64_t>());
+	check(uint64_t(), std::less<>());
+	check(double(), std::less<>());
+	check(int16_t(), std::less<>());
+	check(int32_t(), [](int32_t a, int32_t b) { return a < b; });
+
+	std::vector<std::string> words;
+	for (int i = 0; i < 64; ++i)
+		words.push_back(std::to_string(random() % 100));
+	std::vector<std::string> expected = words;
+	std::sort(expected.begin(), expected.end());
+	toy::sort_network(words.begin(), words.end());
+	ASSERT_EQ(words, expected);
+	words.push_back("65");
+	ASSERT_THROW(toy::sort_network(words.begin(), words.end()), std::length_error);
+}
+
+TEST(sort_test, parallel_sort)
+{
+	toy::thread_pool pool(4);
+	for (int n : { 0, 1000, 5000, 100000 })
+	{
+		for (auto& pattern : sort_patterns(n))
+		{
+			std::vector<int> expected = pattern.second, v = pattern.second;
+			std::sort(expected.begin(), expected.end());
+			toy::parallel_sort(pool, v.begin(), v.end(), std::less<>(), 256);
+			ASSERT_EQ(v, expected) << pattern.first << ", n = " << n;
+
+			v = pattern.second;
+			toy::parallel_sort(pool, v.begin(), v.end(), [](int a, int b) { return a > b; }, 256);
+			ASSERT_TRUE(std::equal(v.begin(), v.end(), expected.rbegin())) << pattern.first << ", n = " << n;
+		}
+	}
+
+	// elements that own memory, through the buffer and back
+	std::vector<std::string> words;
+	std::mt19937 random(15);
+	for (int i = 0; i < 50000; ++i)
+		words.push_back(std::to_string(random() % 20000) + std::string(random() % 40, 'x'));
+	std::vector<std::string> expected = words;
+	std::sort(expected.begin(), expected.end());
+	toy::parallel_sort(pool, words.begin(), words.end(), std::less<>(), 1000);
+	ASSERT_EQ(words, expected);
+
+	// a comparison that throws while the buckets are sorted leaves every
+	// element in the range
+	std::vector<int> v(20000);
+	for (int& x : v)
+		x = int(random() % 100000);
+	std::vector<int> before = v;
+	std::atomic<int> calls{ 0 };
+	ASSERT_THROW(toy::parallel_sort(pool, v.begin(), v.end(), [&calls](int a, int b)
+	{
+		if (++calls == 250000)
+			throw std::out_of_range("comparison");
+		return a < b;
+	}, 1000), std::out_of_range);
+	std::sort(before.begin(), before.end());
+	std::sort(v.begin(), v.end());
+	ASSERT_EQ(v, before);
+}
+
+TEST(sort_test, parallel_merge)
+{
+	toy::thread_pool pool(3);
+	std::mt19937 random(16);
+	for (auto [n1, n2] : { std::pair<int, int>{ 0, 0 }, { 0, 5000 }, { 5000, 0 }, { 1, 9999 }, { 30000, 20000 }, { 7777, 7777 } })
+	{
+		// equal keys on both sides, the order says which side they come from
+		std::vector<std::pair<int, int>> a(n1), b(n2);
+		for (int i = 0; i < n1; ++i)
+			a[i] = { int(random() % 500), i };
+		for (int i = 0; i < n2; ++i)
+			b[i] = { int(random() % 500), n1 + i };
+		auto by_key = [](const std::pair<int, int>& x, const std::pair<int, int>& y) { return x.first < y.first; };
+		std::sort(a.begin(), a.end());
+		std::sort(b.begin(), b.end());
+
+		std::vector<std::pair<int, int>> expected(n1 + n2), merged(n1 + n2);
+		std::merge(a.begin(), a.end(), b.begin(), b.end(), expected.begin(), by_key);
+		auto end = toy::parallel_merge(pool, a.begin(), a.end(), b.begin(), b.end(), merged.begin(), by_key, 100);
+		ASSERT_TRUE(end == merged.end());
+		ASSERT_EQ(merged, expected) << n1 << " + " << n2;
+	}
+}
+
+// benchmark -------------------------------------------------------------------
+
+TEST(heap_test, DISABLED_benchmark_priority_queue)
+{
+	const int n = 5000000;
+	std::mt19937 random(5);
+	std::vector<uint32_t> values(n);
+	for (uint32_t& x : values)
+		x = random();
+
+	auto start = std::chrono::steady_clock::now();
+	toy::priority_queue<uint32_t> queue;
+	for (uint32_t x : values)
+		queue.push(x);
+	uint64_t sum = 0;
+	while (!queue.empty())
+	{
+		sum += queue.top();
+		queue.pop();
+	}
+	double toy_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	std::priority_queue<uint32_t> std_queue;
+	for (uint32_t x : values)
+		std_queue.push(x);
+	uint64_t std_sum = 0;
+	while (!std_queue.empty())
+	{
+		std_sum += std_queue.top();
+		std_queue.pop();
+	}
+	double std_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	toy::priority_queue<uint32_t> built(values.begin(), values.end());
+	double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::printf("push + pop 5M  4-ary priority_queue %8.2f ms  std::priority_queue %8.2f ms  (bulk build %6.2f ms)\n",
+		toy_ms, std_ms, build_ms);
+	ASSERT_EQ(std_sum, sum);
+	ASSERT_EQ(n, built.size());
+}
+
+TEST(sort_test, DISABLED_benchmark_sort)
+{
+	const size_t n = 10000000;
+	std::mt19937_64 random(15);
+	std::vector<uint64_t> keys(n);
+	for (uint64_t& k : keys)
+		k = random();
+
+	auto time = [&](const char* name, std::vector<uint64_t> v, auto&& run)
+	{
+		auto start = std::chrono::steady_clock::now();
+		run(v);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::printf("%-32s %8.1f ms  %5.1f ns per key\n", name, ms, ms * 1e6 / double(v.size()));
+		ASSERT_TRUE(std::is_sorted(v.begin(), v.end()));
+	};
+
+	std::printf("10M random uint64\n");
+	time("std::sort", keys, [](auto& v) { std::sort(v.begin(), v.end()); });
+	time("toy::sort", keys, [](auto& v) { toy::sort(v.begin(), v.end()); });
+	time("toy::sort, opaque comparator", keys, [](auto& v) { toy::sort(v.begin(), v.end(), [](uint64_t a, uint64_t b) { return a < b; }); });
+	time("std::stable_sort", keys, [](auto& v) { std::stable_sort(v.begin(), v.end()); });
+	time("toy::stable_sort", keys, [](auto& v) { toy::stable_sort(v.begin(), v.end()); });
+	time("toy::radix_sort", keys, [](auto& v) { toy::radix_sort(v.begin(), v.end()); });
+
+	std::vector<uint64_t> small(n);
+	for (uint64_t& k : small)
+		k = random() % 1000000;		// 3 bytes of 8 vary
+	std::vector<uint64_t> sorted(n);
+	for (size_t i = 0; i < n; ++i)
+		sorted[i] = i + (random() % 1000 == 0 ? random() % 1000 : 0);
+	std::printf("10M uint64 below 1M\n");
+	time("std::sort", small, [](auto& v) { std::sort(v.begin(), v.end()); });
+	time("toy::sort", small, [](auto& v) { toy::sort(v.begin(), v.end()); });
+	time("toy::radix_sort", small, [](auto& v) { toy::radix_sort(v.begin(), v.end()); });
+	std::printf("10M nearly sorted\n");
+	time("std::sort", sorted, [](auto& v) { std::sort(v.begin(), v.end()); });
+	time("toy::sort", sorted, [](auto& v) { toy::sort(v.begin(), v.end()); });
+}
+
+TEST(sort_test, DISABLED_benchmark_sort_network)
+{
+	const size_t total = 1 << 24;
+	for (size_t n : { 8, 16, 32, 64 })
+	{
+		std::mt19937 random(19);
+		std::vector<uint32_t> keys(total);
+		for (uint32_t& x : keys)
+			x = random();
+
+		auto time = [&](const char* name, auto&& sort)
+		{
+			std::vector<uint32_t> v = keys;
+			auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i + n <= total; i += n)
+				sort(v.begin() + i, v.begin() + (i + n));
+			double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			printf("%2zu uint32, %-20s %6.1f ns per sort\n", n, name, elapsed / (total / n));
+		};
+		time("std::sort", [](auto first, auto last) { std::sort(first, last); });
+		time("insertion sort", [](auto first, auto last) { std::less<> less; toy::detail::insertion_sort(first, last, less); });
+		time("toy::sort_network", [](auto first, auto last) { toy::sort_network(first, last); });
+	}
+}
+
+// TOY_SORT_BENCHMARK_MAX caps the size, the largest run needs 17 GB
+TEST(sort_test, DISABLED_benchmark_parallel_sort)
+{
+	size_t max_n = size_t(1) << 30;
+	if (const char* cap = std::getenv("TOY_SORT_BENCHMARK_MAX"))
+		max_n = std::strtoull(cap, nullptr, 10);
+
+	std::vector<size_t> threads;
+	for (size_t t = 1; t < std::thread::hardware_concurrency(); t *= 2)
+		threads.push_back(t);
+	threads.push_back(std::thread::hardware_concurrency());
+
+	for (size_t n = 1000000; n <= max_n; n = n < 1000000000 ? n * 10 : n * 2)
+	{
+		size_t size = (std::min)(n, max_n);
+		std::vector<uint64_t> keys;
+		try
+		{
+			keys.resize(size);
+		}
+		catch (const std::bad_alloc&)
+		{
+			break;
+		}
+		std::mt19937_64 random(17);
+		for (uint64_t& x : keys)
+			x = random();
+
+		printf("%zu random uint64\n", size);
+		std::vector<uint64_t> v = keys;
+		auto start = std::chrono::steady_clock::now();
+		toy::sort(v.begin(), v.end());
+		double serial = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		printf("%-30s %9.1f ms\n", "toy::sort", serial);
+
+		for (size_t t : threads)
+		{
+			toy::thread_pool pool(t);
+			v = keys;
+			start = std::chrono::steady_clock::now();
+			toy::parallel_sort(pool, v.begin(), v.end());
+			double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			char name[64];
+			snprintf(name, sizeof(name), "toy::parallel_sort, %zu threads", t);
+			printf("%-30s %9.1f ms  %5.2fx\n", name, elapsed, serial / elapsed);
+			ASSERT_TRUE(std::is_sorted(v.begin(), v.end()));
+		}
+		if (size == max_n)
+			break;
+	}
+}
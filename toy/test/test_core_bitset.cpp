@@ -0,0 +1,203 @@
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "toy/core/bitset.h"
+#include "toy/utility/byte.h"
+
+// using namespace toy;
+
+// test bit helpers ------------------------------------------------------------
+
+TEST(bit_test, helpers)
+{
+	ASSERT_EQ(0, toy::popcount(uint64_t(0)));
+	ASSERT_EQ(64, toy::popcount(~uint64_t(0)));
+	ASSERT_EQ(3, toy::popcount(uint32_t(0x10101)));
+	ASSERT_EQ(64, toy::countr_zero(uint64_t(0)));
+	ASSERT_EQ(40, toy::countr_zero(uint64_t(1) << 40));
+	ASSERT_EQ(32, toy::countr_zero(uint32_t(0)));
+	ASSERT_EQ(23, toy::countl_zero(uint64_t(1) << 40));
+	ASSERT_EQ(31, toy::countl_zero(uint32_t(1)));
+	ASSERT_EQ(0, toy::bit_width(0u));
+	ASSERT_EQ(41, toy::bit_width(uint64_t(1) << 40));
+	ASSERT_EQ(1u, toy::bit_ceil(0u));
+	ASSERT_EQ(8u, toy::bit_ceil(5u));
+	ASSERT_EQ(uint64_t(1) << 40, toy::bit_ceil(uint64_t(1) << 40));
+	ASSERT_EQ(0u, toy::bit_floor(0u));
+	ASSERT_EQ(4u, toy::bit_floor(7u));
+
+	uint64_t x = 0x8000100000000ff1ULL;
+	int expected[] = { 0, 4, 5, 6, 7, 8, 9, 10, 11, 44, 63 };
+	for (int k = 0; k < 11; ++k)
+		ASSERT_EQ(expected[k], toy::select_bit(x, k));
+}
+
+// test bitset -----------------------------------------------------------------
+
+TEST(bitset_test, fixed)
+{
+	toy::bitset<200> a, b;
+	std::bitset<200> sa, sb;
+	for (size_t i = 0; i < 200; i += 3) { a.set(i); sa.set(i); }
+	for (size_t i = 0; i < 200; i += 5) { b[i] = true; sb[i] = true; }
+
+	ASSERT_EQ(sa.count(), a.count());
+	ASSERT_EQ((sa & sb).count(), (a & b).count());
+	ASSERT_EQ((sa | sb).count(), (a | b).count());
+	ASSERT_EQ((sa ^ sb).count(), (a ^ b).count());
+	ASSERT_EQ((sa & ~sb).count(), toy::bitset<200>(a).and_not(b).count());
+	ASSERT_EQ((~sa).count(), (~a).count());
+
+	for (size_t shift : { 0, 1, 63, 64, 65, 130, 199, 200 })
+	{
+		toy::bitset<200> l = a << shift, r = a >> shift;
+		for (size_t i = 0; i < 200; ++i)
+		{
+			ASSERT_EQ((sa << shift)[i], l[i]);
+			ASSERT_EQ((sa >> shift)[i], r[i]);
+		}
+	}
+
+	ASSERT_EQ(0, a.find_first());
+	ASSERT_EQ(3, a.find_next(0));
+	ASSERT_EQ(198, a.find_next(197));
+	ASSERT_EQ(toy::bitset<200>::npos, a.find_next(198));
+	ASSERT_EQ(true, a.intersects(b));
+	ASSERT_EQ(true, toy::bitset<200>().none());
+	ASSERT_EQ(true, toy::bitset<200>().set().all());
+	ASSERT_EQ(true, toy::bitset<70>(~0ULL).count() == 64);
+	ASSERT_THROW(a.test(200), std::out_of_range);
+}
+
+TEST(bitset_test, dynamic)
+{
+	std::mt19937_64 random(42);
+	const size_t n = 100003;	// not a multiple of the word or the SIMD block
+	toy::dynamic_bitset a(n), b(n);
+	std::vector<bool> va(n), vb(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		bool x = random() % 3 == 0, y = random() % 7 == 0;
+		a[i] = x; va[i] = x;
+		b[i] = y; vb[i] = y;
+	}
+
+	toy::dynamic_bitset c = a & b, d = a | b, e = a ^ b, f = toy::dynamic_bitset(a).and_not(b);
+	size_t count_a = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		count_a += va[i];
+		ASSERT_EQ(va[i] && vb[i], c[i]);
+		ASSERT_EQ(va[i] || vb[i], d[i]);
+		ASSERT_EQ(va[i] != vb[i], e[i]);
+		ASSERT_EQ(va[i] && !vb[i], f[i]);
+	}
+	ASSERT_EQ(count_a, a.count());
+	ASSERT_EQ(n - count_a, (~a).count());
+	ASSERT_EQ(true, c.is_subset_of(a));
+	ASSERT_EQ(false, f.intersects(b));
+
+	size_t visited = 0;
+	for (size_t i = a.find_first(); i != toy::dynamic_bitset::npos; i = a.find_next(i))
+	{
+		ASSERT_EQ(true, va[i]);
+		++visited;
+	}
+	ASSERT_EQ(count_a, visited);
+
+	// sparse bits, the search skips long runs of zero words
+	toy::dynamic_bitset sparse(n);
+	sparse.set(5).set(70000).set(n - 1);
+	ASSERT_EQ(70000, sparse.find_next(5));
+	ASSERT_EQ(n - 1, sparse.find_next(70000));
+
+	toy::dynamic_bitset grow;
+	for (int i = 0; i < 130; ++i)
+		grow.push_back(i % 2 == 0);
+	ASSERT_EQ(65, grow.count());
+	grow.resize(200, true);
+	ASSERT_EQ(135, grow.count());
+	grow.resize(10);
+	ASSERT_EQ(5, grow.count());
+	grow.set(2, 7, true);
+	ASSERT_EQ(8, grow.count());
+
+	ASSERT_THROW(a &= grow, std::invalid_argument);
+}
+
+TEST(bitset_test, rank_select)
+{
+	std::mt19937_64 random(7);
+	for (size_t n : { size_t(0), size_t(1), size_t(64), size_t(4096), size_t(300001) })
+	{
+		toy::dynamic_bitset bits(n);
+		for (size_t i = 0; i < n; ++i)
+			bits[i] = random() % 5 == 0;
+
+		toy::rank_select_index index(bits);
+		ASSERT_EQ(bits.count(), index.count());
+
+		size_t ones = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (i % 61 == 0)
+			{
+				ASSERT_EQ(ones, index.rank(i));
+			}
+			if (bits[i])
+			{
+				ASSERT_EQ(i, index.select(ones));
+				++ones;
+			}
+		}
+		ASSERT_EQ(ones, index.rank(n));
+		ASSERT_EQ(toy::rank_select_index::npos, index.select(ones));
+	}
+
+	toy::bitset<128> fixed;
+	fixed.set(3).set(100);
+	toy::rank_select_index index(fixed);
+	ASSERT_EQ(1, index.rank(100));
+	ASSERT_EQ(100, index.select(1));
+}
+
+// benchmark -------------------------------------------------------------------
+
+TEST(bitset_test, DISABLED_benchmark_bitset)
+{
+	const size_t n = 100000000;
+	toy::dynamic_bitset a(n), b(n);
+	std::vector<bool> va(n), vb(n);
+	for (size_t i = 0; i < n; i += 3) { a[i] = true; va[i] = true; }
+	for (size_t i = 0; i < n; i += 7) { b[i] = true; vb[i] = true; }
+
+	auto start = std::chrono::steady_clock::now();
+	a &= b;
+	size_t count = a.count();
+	double bitset_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	size_t vector_count = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		va[i] = va[i] && vb[i];
+		vector_count += va[i];
+	}
+	double vector_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::printf("and + count of 100M bits  dynamic_bitset %8.2f ms  vector<bool> %8.2f ms\n", bitset_ms, vector_ms);
+	ASSERT_EQ(vector_count, count);
+
+	start = std::chrono::steady_clock::now();
+	toy::rank_select_index index(a);
+	size_t sum = 0;
+	for (size_t k = 0; k < count; k += 97)
+		sum += index.select(k) - index.rank(index.select(k));
+	double index_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::printf("rank_select_index build + %zu queries %8.2f ms (%zu)\n", count / 97 * 2, index_ms, sum);
+}
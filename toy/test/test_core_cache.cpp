@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "toy/core/list.h"
+#include "toy/core/lru_cache.h"
+#include "toy/core/unorder_map.h"
+
+// using namespace toy;
+
+namespace
+{
+
+struct list_node : toy::intrusive_list_hook<>
+{
+	explicit list_node(int value = 0) : value(value) {}
+	int value;
+};
+
+template<class List>
+std::vector<int> values_of(const List& list)
+{
+	std::vector<int> result;
+	for (const list_node& node : list)
+		result.push_back(node.value);
+	return result;
+}
+
+// ranks 0 .. n - 1 drawn with probability ~ 1 / (rank + 1)^s, from a table
+class zipf_distribution
+{
+public:
+	zipf_distribution(size_t n, double s)
+		: cdf(n)
+	{
+		double sum = 0;
+		for (size_t i = 0; i < n; ++i)
+			cdf[i] = sum += 1.0 / std::pow(double(i + 1), s);
+		for (double& c : cdf)
+			c /= sum;
+	}
+
+	template<class Random>
+	size_t operator()(Random& random) const
+	{
+		double u = std::uniform_real_distribution<double>(0.0, 1.0)(random);
+		return static_cast<size_t>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+	}
+
+private:
+	std::vector<double> cdf;
+};
+
+}	// namespace
+
+// test intrusive_list ---------------------------------------------------------
+
+TEST(intrusive_list_test, link_unlink)
+{
+	list_node a(1), b(2), c(3);
+	toy::intrusive_list<list_node> list;
+	ASSERT_TRUE(list.empty());
+
+	list.push_back(a);
+	list.push_back(b);
+	list.push_front(c);
+	ASSERT_EQ(list.size(), 3u);
+	ASSERT_EQ(values_of(list), (std::vector<int>{ 3, 1, 2 }));
+	ASSERT_TRUE(b.is_linked());
+
+	list.move_to_front(b);
+	ASSERT_EQ(values_of(list), (std::vector<int>{ 2, 3, 1 }));
+	list.move_to_back(b);
+	ASSERT_EQ(values_of(list), (std::vector<int>{ 3, 1, 2 }));
+
+	list.erase(a);
+	ASSERT_FALSE(a.is_linked());
+	ASSERT_EQ(values_of(list), (std::vector<int>{ 3, 2 }));
+	ASSERT_EQ(list.front().value, 3);
+	ASSERT_EQ(list.back().value, 2);
+
+	auto it = list.erase(list.iterator_to(c));
+	ASSERT_EQ(it->value, 2);
+	list.insert(it, a);
+	ASSERT_EQ(values_of(list), (std::vector<int>{ 1, 2 }));
+
+	list.pop_front();
+	list.pop_back();
+	ASSERT_TRUE(list.empty());
+	ASSERT_FALSE(b.is_linked());
+}
+
+TEST(intrusive_list_test, splice_swap_dispose)
+{
+	list_node nodes[6] = { list_node(0), list_node(1), list_node(2), list_node(3), list_node(4), list_node(5) };
+	toy::intrusive_list<list_node> a, b;
+	for (int i = 0; i < 3; ++i)
+		a.push_back(nodes[i]);
+	for (int i = 3; i < 6; ++i)
+		b.push_back(nodes[i]);
+
+	a.swap(b);
+	ASSERT_EQ(values_of(a), (std::vector<int>{ 3, 4, 5 }));
+	ASSERT_EQ(values_of(b), (std::vector<int>{ 0, 1, 2 }));
+
+	a.splice(a.begin(), b);
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(a.size(), 6u);
+	ASSERT_EQ(values_of(a), (std::vector<int>{ 0, 1, 2, 3, 4, 5 }));
+
+	toy::intrusive_list<list_node> moved(std::move(a));
+	ASSERT_TRUE(a.empty());
+	ASSERT_EQ(moved.size(), 6u);
+
+	int disposed = 0;
+	moved.clear_and_dispose([&](list_node* node) { disposed += node->value; });
+	ASSERT_EQ(disposed, 15);
+	ASSERT_TRUE(moved.empty());
+	ASSERT_FALSE(nodes[0].is_linked());
+}
+
+// test unordered_map ----------------------------------------------------------
+
+TEST(unordered_map_test, insert_find_erase)
+{
+	toy::unordered_map<std::string, int> map;
+	ASSERT_TRUE(map.empty());
+	ASSERT_TRUE(map.find("a") == map.end());
+
+	ASSERT_TRUE(map.try_emplace("a", 1).second);
+	ASSERT_FALSE(map.try_emplace("a", 2).second);
+	ASSERT_EQ(map.at("a"), 1);
+	map["b"] = 2;
+	map.insert_or_assign("a", 3);
+	ASSERT_EQ(map["a"], 3);
+	ASSERT_EQ(map.size(), 2u);
+	ASSERT_TRUE(map.contains("b"));
+	ASSERT_THROW(map.at("c"), std::out_of_range);
+
+	ASSERT_EQ(map.erase("a"), 1u);
+	ASSERT_EQ(map.erase("a"), 0u);
+	ASSERT_EQ(map.size(), 1u);
+	ASSERT_EQ(map.begin()->first, "b");
+
+	toy::unordered_map<std::string, int> copy = map;
+	ASSERT_TRUE(copy == map);
+	copy.clear();
+	ASSERT_TRUE(copy.empty());
+	ASSERT_TRUE(copy != map);
+}
+
+TEST(unordered_map_test, random_against_std)
+{
+	// many erases in a small key range, the tombstones get reused and dropped
+	std::mt19937 random(42);
+	toy::unordered_map<int, std::string> map;
+	std::unordered_map<int, std::string> reference;
+	for (int i = 0; i < 100000; ++i)
+	{
+		int key = static_cast<int>(random() % 3000);
+		switch (random() % 4)
+		{
+		case 0:
+		case 1:
+			map[key] = std::to_string(i);
+			reference[key] = std::to_string(i);
+			break;
+		case 2:
+			ASSERT_EQ(map.erase(key), reference.erase(key));
+			break;
+		default:
+		{
+			auto it = map.find(key);
+			auto ref = reference.find(key);
+			ASSERT_EQ(it == map.end(), ref == reference.end());
+			if (ref != reference.end())
+			{
+				ASSERT_EQ(it->second, ref->second);
+			}
+		}
+		}
+		ASSERT_EQ(map.size(), reference.size());
+	}
+	ASSERT_LE(map.load_factor(), map.max_load_factor());
+
+	size_t n = 0;
+	for (auto it = map.begin(); it != map.end(); ++it, ++n)
+		ASSERT_EQ(reference.at(it->first), it->second);
+	ASSERT_EQ(n, reference.size());
+
+	// erase while iterating
+	for (auto it = map.begin(); it != map.end();)
+		it = it->first % 2 ? map.erase(it) : std::next(it);
+	for (auto& value : map)
+		ASSERT_EQ(value.first % 2, 0);
+
+	map.rehash(0);
+	for (auto& value : reference)
+		ASSERT_EQ(map.contains(value.first), value.first % 2 == 0);
+}
+
+TEST(unordered_map_test, reserve_keeps_elements)
+{
+	toy::unordered_map<int, int> map;
+	map.reserve(1000);
+	size_t capacity = map.capacity();
+	for (int i = 0; i < 1000; ++i)
+		map[i] = i * i;
+	ASSERT_EQ(map.capacity(), capacity);
+
+	toy::unordered_map<int, int> moved(std::move(map));
+	ASSERT_TRUE(map.empty());
+	for (int i = 0; i < 1000; ++i)
+		ASSERT_EQ(moved.at(i), i * i);
+}
+
+// test caches -----------------------------------------------------------------
+
+TEST(lru_cache_test, evicts_least_recently_used)
+{
+	toy::lru_cache<int, std::string> cache(3, 1);
+	cache.put(1, "one");
+	cache.put(2, "two");
+	cache.put(3, "three");
+
+	std::string value;
+	ASSERT_TRUE(cache.get(1, value));	// 2 is now the oldest
+	ASSERT_EQ(value, "one");
+	cache.put(4, "four");
+
+	ASSERT_EQ(cache.size(), 3u);
+	ASSERT_FALSE(cache.contains(2));
+	ASSERT_TRUE(cache.contains(1));
+	ASSERT_TRUE(cache.contains(3));
+	ASSERT_TRUE(cache.contains(4));
+
+	cache.put(3, "THREE");
+	ASSERT_TRUE(cache.get(3, value));
+	ASSERT_EQ(value, "THREE");
+
+	ASSERT_TRUE(cache.erase(4));
+	ASSERT_FALSE(cache.erase(4));
+	ASSERT_EQ(cache.size(), 2u);
+
+	toy::cache_stats stats = cache.stats();
+	ASSERT_EQ(stats.hits, 2u);
+	ASSERT_EQ(stats.evictions, 1u);
+
+	cache.clear();
+	ASSERT_EQ(cache.size(), 0u);
+	ASSERT_EQ(cache.weight(), 0u);
+}
+
+TEST(lru_cache_test, weighted_by_size)
+{
+	struct string_weigher
+	{
+		size_t operator()(int, const std::string& s) const noexcept { return s.size(); }
+	};
+
+	toy::lru_cache<int, std::string, toy::hash<int>, std::equal_to<int>, string_weigher> cache(100, 1);
+	cache.put(1, std::string(40, 'a'));
+	cache.put(2, std::string(40, 'b'));
+	ASSERT_EQ(cache.weight(), 80u);
+
+	cache.put(3, std::string(30, 'c'));		// 110 > 100, 1 goes
+	ASSERT_EQ(cache.weight(), 70u);
+	ASSERT_FALSE(cache.contains(1));
+
+	cache.put(2, std::string(90, 'b'));		// a value that grows evicts the others
+	ASSERT_EQ(cache.weight(), 90u);
+	ASSERT_EQ(cache.size(), 1u);
+
+	cache.put(4, std::string(200, 'd'));	// larger than the whole cache
+	ASSERT_FALSE(cache.contains(4));
+	ASSERT_LE(cache.weight(), 100u);
+}
+
+TEST(lru_cache_test, get_or_load)
+{
+	toy::tinylfu_cache<int, int> cache(100);
+	int loads = 0;
+	auto square = [&](int key) { ++loads; return key * key; };
+	ASSERT_EQ(cache.get_or_load(7, square), 49);
+	ASSERT_EQ(cache.get_or_load(7, square), 49);
+	ASSERT_EQ(loads, 1);
+}
+
+TEST(lru_cache_test, tinylfu_capacity_and_weight)
+{
+	toy::tinylfu_cache<int, int> cache(1000, 4);
+	std::mt19937 random(3);
+	for (int i = 0; i < 100000; ++i)
+	{
+		int key = static_cast<int>(random() % 5000);
+		int value;
+		if (cache.get(key, value))
+			ASSERT_EQ(value, key + 1);
+		else
+			cache.put(key, key + 1);
+		if (i % 1000 == 0)
+			cache.erase(static_cast<int>(random() % 5000));
+	}
+	ASSERT_LE(cache.size(), 1000u);
+	ASSERT_EQ(cache.weight(), cache.size());
+	ASSERT_GT(cache.size(), 900u);
+}
+
+TEST(lru_cache_test, tinylfu_resists_scans)
+{
+	// a hot zipf set read between scans of keys seen once: the scans flush
+	// an LRU, the frequency filter keeps them out of the main area
+	const size_t capacity = 1000;
+	toy::lru_cache<int, int> lru(capacity, 1);
+	toy::tinylfu_cache<int, int> lfu(capacity, 1);
+	zipf_distribution zipf(10000, 0.9);
+	std::mt19937 random(11);
+
+	int scan_key = 1000000;
+	for (int round = 0; round < 50; ++round)
+	{
+		for (int i = 0; i < 5000; ++i)
+		{
+			int key = static_cast<int>(zipf(random));
+			int value;
+			if (!lru.get(key, value))
+				lru.put(key, key);
+			if (!lfu.get(key, value))
+				lfu.put(key, key);
+		}
+		for (int i = 0; i < 2000; ++i, ++scan_key)
+		{
+			int value;
+			if (!lru.get(scan_key, value))
+				lru.put(scan_key, scan_key);
+			if (!lfu.get(scan_key, value))
+				lfu.put(scan_key, scan_key);
+		}
+	}
+	ASSERT_GT(lfu.stats().hit_rate(), lru.stats().hit_rate() + 0.05);
+}
+
+TEST(lru_cache_test, concurrent_put_get)
+{
+	toy::lru_cache<int, int> cache(4096);
+	std::vector<std::thread> threads;
+	std::atomic<bool> wrong{ false };
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&, t]()
+		{
+			std::mt19937 random(t);
+			for (int i = 0; i < 50000; ++i)
+			{
+				int key = static_cast<int>(random() % 8192);
+				int value;
+				if (cache.get(key, value))
+				{
+					if (value != key * 3)
+						wrong = true;
+				}
+				else
+				{
+					cache.put(key, key * 3);
+				}
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	ASSERT_FALSE(wrong);
+	ASSERT_LE(cache.size(), 4096u);
+	ASSERT_EQ(cache.weight(), cache.size());
+}
+
+TEST(lru_cache_test, DISABLED_benchmark_zipf_hit_rate)
+{
+	const size_t keys = 1000000;
+	const int n = 5000000;
+	zipf_distribution zipf(keys, 0.99);
+	std::mt19937 random(7);
+	std::vector<int> trace(n);
+	for (int& key : trace)
+		key = static_cast<int>(zipf(random));
+
+	for (size_t capacity : { 1000, 10000, 100000 })
+	{
+		toy::lru_cache<int, int> lru(capacity);
+		toy::tinylfu_cache<int, int> lfu(capacity);
+		for (int key : trace)
+		{
+			int value;
+			if (!lru.get(key, value))
+				lru.put(key, key);
+			if (!lfu.get(key, value))
+				lfu.put(key, key);
+		}
+		printf("zipf 0.99 capacity %zu: lru %.2f%%, tinylfu %.2f%%\n",
+			capacity, 100 * lru.stats().hit_rate(), 100 * lfu.stats().hit_rate());
+	}
+}
+
+TEST(lru_cache_test, DISABLED_benchmark_ops_per_second)
+{
+	const size_t keys = 1000000;
+	const int n = 2000000;
+	zipf_distribution zipf(keys, 0.99);
+	std::mt19937 random(9);
+	std::vector<int> trace(n);
+	for (int& key : trace)
+		key = static_cast<int>(zipf(random));
+
+	for (unsigned threads : { 1u, 2u, 4u, 8u })
+	{
+		for (int kind = 0; kind < 2; ++kind)
+		{
+			toy::lru_cache<int, int> lru(100000);
+			toy::tinylfu_cache<int, int> lfu(100000);
+			auto run = [&](auto& cache)
+			{
+				std::vector<std::thread> pool;
+				auto start = std::chrono::steady_clock::now();
+				for (unsigned t = 0; t < threads; ++t)
+				{
+					pool.emplace_back([&, t]()
+					{
+						for (size_t i = t * 7919 % n, k = 0; k < size_t(n); ++k, i = i + 1 == size_t(n) ? 0 : i + 1)
+						{
+							int value;
+							if (!cache.get(trace[i], value))
+								cache.put(trace[i], trace[i]);
+						}
+					});
+				}
+				for (std::thread& thread : pool)
+					thread.join();
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				return double(n) * threads / seconds / 1e6;
+			};
+			double mops = kind ? run(lfu) : run(lru);
+			printf("%-8s %u threads: %.1f Mops/s\n", kind ? "tinylfu" : "lru", threads, mops);
+		}
+	}
+}
@@ -0,0 +1,443 @@
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "toy/core/concurrent_queue.h"
+#include "toy/core/concurrent_unordered_map.h"
+
+// using namespace toy;
+
+// test concurrent_unordered_map -----------------------------------------------
+
+TEST(concurrent_unordered_map_test, insert_find_erase)
+{
+	toy::concurrent_unordered_map<int, int> map(4);
+
+	ASSERT_EQ(true, map.empty());
+	ASSERT_EQ(true, map.insert(1, 10));
+	ASSERT_EQ(false, map.insert(1, 11));
+	ASSERT_EQ(false, map.insert_or_assign(1, 12));
+
+	int value = 0;
+	ASSERT_EQ(true, map.find(1, value));
+	ASSERT_EQ(12, value);
+	ASSERT_EQ(false, map.find(2, value));
+
+	ASSERT_EQ(true, map.erase(1));
+	ASSERT_EQ(false, map.erase(1));
+	ASSERT_EQ(false, map.contains(1));
+	ASSERT_EQ(0, map.size());
+}
+
+TEST(concurrent_unordered_map_test, grow_and_clear)
+{
+	toy::concurrent_unordered_map<int, int> map(2);
+
+	for (int i = 0; i < 10000; ++i)
+		map.insert(i, i * 2);
+	for (int i = 0; i < 10000; i += 2)
+		map.erase(i);
+
+	ASSERT_EQ(5000, map.size());
+
+	int value = 0;
+	for (int i = 1; i < 10000; i += 2)
+	{
+		ASSERT_EQ(true, map.find(i, value));
+		ASSERT_EQ(i * 2, value);
+	}
+
+	map.clear();
+	ASSERT_EQ(0, map.size());
+	ASSERT_EQ(false, map.contains(1));
+}
+
+TEST(concurrent_unordered_map_test, churn)
+{	// erase and insert with a steady number of keys, the tombstones are purged
+	// in place and the tables a shard grew out of are freed
+	toy::concurrent_unordered_map<int, int> map(2);
+	toy::concurrent_unordered_map<std::string, std::string> strings(2);
+	for (int i = 0; i < 1000; ++i)
+	{
+		map.insert(i, i);
+		strings.insert(std::to_string(i), std::to_string(i));
+	}
+	size_t bytes = map.size_in_bytes();
+	size_t string_bytes = strings.size_in_bytes();
+
+	std::atomic<bool> done{ false };
+	std::thread reader([&]()
+	{
+		int value = 0;
+		for (int i = 0; !done.load(); i = (i + 1) % 1000)
+			map.find(i, value);
+	});
+
+	for (int i = 1000; i < 200000; ++i)
+	{
+		map.erase(i - 1000);
+		map.insert(i, i);
+		if (i % 4 == 0)
+		{
+			strings.erase(std::to_string(i - 1000));
+			strings.insert(std::to_string(i), std::to_string(i));
+		}
+	}
+	done = true;
+	reader.join();
+
+	ASSERT_EQ(1000, map.size());
+	ASSERT_GE(2 * bytes, map.size_in_bytes());
+	ASSERT_GE(2 * string_bytes, strings.size_in_bytes());
+
+	int value = 0;
+	for (int i = 199000; i < 200000; ++i)
+	{
+		ASSERT_EQ(true, map.find(i, value));
+		ASSERT_EQ(i, value);
+	}
+	std::string text;
+	ASSERT_EQ(true, strings.find("199996", text));
+	ASSERT_EQ("199996", text);
+	ASSERT_EQ(false, strings.contains("1000"));
+}
+
+TEST(concurrent_unordered_map_test, non_trivial_type)
+{
+	toy::concurrent_unordered_map<std::string, std::string> map(4);
+
+	for (int i = 0; i < 1000; ++i)
+		map.insert(std::to_string(i), std::string(i % 40, 'x'));
+
+	std::string value;
+	ASSERT_EQ(true, map.find("999", value));
+	ASSERT_EQ(std::string(999 % 40, 'x'), value);
+
+	size_t count = 0;
+	map.for_each([&](const std::string&, const std::string&) { ++count; });
+	ASSERT_EQ(1000, count);
+
+	ASSERT_EQ(true, map.visit("7", [](const std::string& v) { ASSERT_EQ(7, v.size()); }));
+}
+
+TEST(concurrent_unordered_map_test, concurrent_upsert)
+{
+	toy::concurrent_unordered_map<int, long> map;
+	const int threads = 4, keys = 1000, rounds = 20;
+
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+		workers.emplace_back([&]()
+		{
+			for (int r = 0; r < rounds; ++r)
+				for (int k = 0; k < keys; ++k)
+				{
+					map.upsert(k, [](long& v) { ++v; }, []() { return 1L; });
+					long v = 0;
+					map.find(k, v);
+				}
+		});
+	for (auto& w : workers)
+		w.join();
+
+	ASSERT_EQ(keys, map.size());
+	for (int k = 0; k < keys; ++k)
+	{
+		long v = 0;
+		ASSERT_EQ(true, map.find(k, v));
+		ASSERT_EQ(threads * rounds, v);
+	}
+}
+
+TEST(concurrent_unordered_map_test, find_or_insert_runs_once)
+{
+	toy::concurrent_unordered_map<int, int> map;
+	std::atomic<int> made{ 0 };
+
+	std::vector<std::thread> workers;
+	for (int t = 0; t < 4; ++t)
+		workers.emplace_back([&]()
+		{
+			for (int k = 0; k < 500; ++k)
+				ASSERT_EQ(k + 1, map.find_or_insert(k, [&]() { ++made; return k + 1; }));
+		});
+	for (auto& w : workers)
+		w.join();
+
+	ASSERT_EQ(500, made.load());
+}
+
+// run with --gtest_also_run_disabled_tests, prints ops/s per read ratio and thread count
+TEST(concurrent_unordered_map_test, DISABLED_benchmark_scaling)
+{
+	const int keys = 1 << 16, ops = 1 << 20;
+
+	for (int read_percent : { 50, 90, 99 })
+		for (unsigned threads = 1; threads <= std::thread::hardware_concurrency(); threads *= 2)
+		{
+			toy::concurrent_unordered_map<uint64_t, uint64_t> map;
+			for (int k = 0; k < keys; ++k)
+				map.insert(k, k);
+
+			auto begin = std::chrono::steady_clock::now();
+			std::vector<std::thread> workers;
+			for (unsigned t = 0; t < threads; ++t)
+				workers.emplace_back([&, t]()
+				{
+					uint64_t x = 0x9E3779B97F4A7C15ULL * (t + 1), v = 0;
+					for (int i = 0; i < ops; ++i)
+					{
+						x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+						uint64_t k = x % keys;
+						if (int(x >> 40) % 100 < read_percent)
+							map.find(k, v);
+						else
+							map.insert_or_assign(k, v + 1);
+					}
+				});
+			for (auto& w : workers)
+				w.join();
+
+			std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+			std::printf("reads %d%%, threads %u: %.1f Mops/s\n", read_percent, threads,
+				threads * double(ops) / seconds.count() / 1e6);
+		}
+}
+
+// test spsc_queue -------------------------------------------------------------
+
+TEST(spsc_queue_test, push_pop)
+{
+	toy::spsc_queue<std::string> queue(3);
+	ASSERT_EQ(4, queue.capacity());
+
+	for (int i = 0; i < 4; ++i)
+		ASSERT_EQ(true, queue.try_push(std::to_string(i)));
+	ASSERT_EQ(false, queue.try_push("full"));
+
+	std::string value;
+	ASSERT_EQ(true, queue.try_pop(value));
+	ASSERT_EQ("0", value);
+
+	std::string batch[8];
+	ASSERT_EQ(3, queue.try_pop_n(batch, 8));
+	ASSERT_EQ("3", batch[2]);
+	ASSERT_EQ(false, queue.try_pop(value));
+
+	const char* words[] = { "a", "b", "c", "d", "e" };
+	ASSERT_EQ(4, queue.try_push_n(words, 5));
+	ASSERT_EQ(4, queue.size());
+}
+
+TEST(spsc_queue_test, producer_consumer)
+{
+	toy::spsc_queue<int> queue(64);
+	const int count = 100000;
+
+	std::thread producer([&]()
+	{
+		int batch[7];
+		for (int i = 0; i < count;)
+		{
+			int n = 0;
+			for (; n < 7 && i + n < count; ++n)
+				batch[n] = i + n;
+			size_t pushed = queue.try_push_n(batch, n);
+			if (pushed == 0)
+				std::this_thread::yield();
+			i += static_cast<int>(pushed);
+		}
+	});
+
+	long long sum = 0;
+	int expected = 0, batch[5];
+	while (expected < count)
+	{
+		size_t n = queue.try_pop_n(batch, 5);
+		if (n == 0)
+			std::this_thread::yield();
+		for (size_t i = 0; i < n; ++i, ++expected)
+		{
+			ASSERT_EQ(expected, batch[i]);
+			sum += batch[i];
+		}
+	}
+	producer.join();
+
+	ASSERT_EQ((long long)count * (count - 1) / 2, sum);
+}
+
+// test mpmc_queue -------------------------------------------------------------
+
+TEST(mpmc_queue_test, push_pop)
+{
+	toy::mpmc_queue<std::string> queue(4);
+
+	for (int i = 0; i < 4; ++i)
+		ASSERT_EQ(true, queue.try_emplace(3, char('a' + i)));
+	ASSERT_EQ(false, queue.try_push("full"));
+
+	std::string value;
+	ASSERT_EQ(true, queue.try_pop(value));
+	ASSERT_EQ("aaa", value);
+
+	const char* words[] = { "x", "y" };
+	ASSERT_EQ(1, queue.try_push_n(words, 2));
+
+	std::string batch[8];
+	ASSERT_EQ(4, queue.try_pop_n(batch, 8));
+	ASSERT_EQ("x", batch[3]);
+	ASSERT_EQ(0, queue.try_pop_n(batch, 8));
+}
+
+namespace
+{
+
+struct throwing_item
+{
+	static inline int  copies_until_throw = -1;	// 0: the next copy throws, -1: none does
+	static inline int  assigns_until_throw = -1;
+	static inline int  live = 0;
+
+	int value = 0;
+
+	throwing_item(int value) : value(value) { ++live; }
+	throwing_item(const throwing_item& other) : value(other.value)
+	{
+		if (copies_until_throw >= 0 && copies_until_throw-- == 0)
+			throw std::runtime_error("copy");
+		++live;
+	}
+	throwing_item(throwing_item&& other) noexcept : value(other.value) { ++live; }
+	~throwing_item() { --live; }
+	throwing_item& operator=(throwing_item&& other)
+	{
+		if (assigns_until_throw >= 0 && assigns_until_throw-- == 0)
+			throw std::runtime_error("assign");
+		value = other.value;
+		return *this;
+	}
+};
+
+}	// namespace
+
+TEST(mpmc_queue_test, throwing_element)
+{	// a throw in a push or a pop must not leave a claimed cell behind
+	toy::mpmc_queue<throwing_item> queue(4);
+	throwing_item item(1);
+
+	throwing_item::copies_until_throw = 0;
+	ASSERT_THROW(queue.try_push(item), std::runtime_error);
+	throwing_item items[] = { 2, 3 };
+	throwing_item::copies_until_throw = 1;
+	ASSERT_THROW(queue.try_push_n(items, 2), std::runtime_error);	// 2 stays pushed
+	throwing_item::copies_until_throw = -1;
+	ASSERT_EQ(1, queue.size());
+	throwing_item first(0);
+	ASSERT_EQ(true, queue.try_pop(first));
+	ASSERT_EQ(2, first.value);
+
+	ASSERT_EQ(true, queue.try_push(item));
+	ASSERT_EQ(2, queue.try_push_n(items, 2));
+	ASSERT_EQ(true, queue.try_emplace(4));
+
+	throwing_item out(0);
+	throwing_item::assigns_until_throw = 0;
+	ASSERT_THROW(queue.try_pop(out), std::runtime_error);	// 1 is lost
+	throwing_item batch[] = { 0, 0, 0 };
+	throwing_item::assigns_until_throw = 1;
+	ASSERT_THROW(queue.try_pop_n(batch, 3), std::runtime_error);	// 2 is popped, 3 and 4 are lost
+	ASSERT_EQ(2, batch[0].value);
+	ASSERT_EQ(true, queue.empty());
+
+	for (int i = 5; i < 9; ++i)
+		ASSERT_EQ(true, queue.try_emplace(i));
+	ASSERT_EQ(4, queue.try_pop_n(batch, 3) + queue.try_pop_n(batch, 3));
+	ASSERT_EQ(8, batch[0].value);
+}
+
+TEST(spsc_queue_test, throwing_element)
+{	// a throwing copy pushes nothing, a throwing assignment pops the elements before it
+	int live = throwing_item::live;
+	{
+		toy::spsc_queue<throwing_item> queue(4);
+		throwing_item items[] = { 1, 2, 3 };
+
+		throwing_item::copies_until_throw = 2;
+		ASSERT_THROW(queue.try_push_n(items, 3), std::runtime_error);
+		throwing_item::copies_until_throw = -1;
+		ASSERT_EQ(true, queue.empty());
+		ASSERT_EQ(live + 3, throwing_item::live);
+
+		ASSERT_EQ(3, queue.try_push_n(items, 3));
+		throwing_item batch[] = { 0, 0, 0 };
+		throwing_item::assigns_until_throw = 1;
+		ASSERT_THROW(queue.try_pop_n(batch, 3), std::runtime_error);
+		ASSERT_EQ(1, batch[0].value);
+		ASSERT_EQ(2, queue.size());
+
+		ASSERT_EQ(2, queue.try_pop_n(batch, 3));
+		ASSERT_EQ(3, batch[1].value);
+		ASSERT_EQ(true, queue.try_emplace(4));
+	}
+	ASSERT_EQ(live, throwing_item::live);
+}
+
+TEST(mpmc_queue_test, many_producers_many_consumers)
+{
+	toy::mpmc_queue<int> queue(128);
+	const int producers = 3, consumers = 3, per_producer = 20000;
+
+	std::atomic<long long> sum{ 0 };
+	std::atomic<int> popped{ 0 };
+
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; ++p)
+		threads.emplace_back([&, p]()
+		{
+			int batch[4];
+			for (int i = 0; i < per_producer;)
+			{
+				if (i % 2)
+				{
+					if (queue.try_push(p * per_producer + i))
+						++i;
+					else
+						std::this_thread::yield();
+					continue;
+				}
+				int n = 0;
+				for (; n < 4 && i + n < per_producer; ++n)
+					batch[n] = p * per_producer + i + n;
+				size_t pushed = queue.try_push_n(batch, n);
+				if (pushed == 0)
+					std::this_thread::yield();
+				i += static_cast<int>(pushed);
+			}
+		});
+	for (int c = 0; c < consumers; ++c)
+		threads.emplace_back([&]()
+		{
+			int batch[3];
+			while (popped.load() < producers * per_producer)
+			{
+				size_t n = queue.try_pop_n(batch, 3);
+				if (n == 0)
+					std::this_thread::yield();
+				for (size_t i = 0; i < n; ++i)
+					sum += batch[i];
+				popped += static_cast<int>(n);
+			}
+		});
+	for (auto& t : threads)
+		t.join();
+
+	long long total = (long long)producers * per_producer;
+	ASSERT_EQ(total * (total - 1) / 2, sum.load());
+	ASSERT_EQ(true, queue.empty());
+}
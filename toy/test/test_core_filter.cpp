@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "toy/core/bloom_filter.h"
+
+// using namespace toy;
+
+namespace
+{
+
+// a serialized filter in a buffer aligned as a mapped file would be
+struct aligned_bytes
+{
+	explicit aligned_bytes(size_t size)
+		: data(static_cast<unsigned char*>(::operator new(size, std::align_val_t(64)))), size(size)
+	{
+	}
+
+	~aligned_bytes()
+	{
+		::operator delete(data, std::align_val_t(64));
+	}
+
+	toy::span<unsigned char>       bytes() noexcept       { return toy::span<unsigned char>(data, size); }
+	toy::span<const unsigned char> bytes() const noexcept { return toy::span<const unsigned char>(data, size); }
+
+	unsigned char* data;
+	size_t         size;
+};
+
+}	// namespace
+
+// test bloom_filter -----------------------------------------------------------
+
+TEST(bloom_filter_test, no_false_negatives)
+{
+	toy::bloom_filter filter(10000, 0.01);
+	ASSERT_FALSE(filter.contains(1));
+	for (int i = 0; i < 10000; ++i)
+		filter.insert(i);
+	ASSERT_EQ(filter.insert_count(), 10000u);
+	for (int i = 0; i < 10000; ++i)
+		ASSERT_TRUE(filter.contains(i));
+
+	filter.clear();
+	ASSERT_EQ(filter.insert_count(), 0u);
+	ASSERT_FALSE(filter.contains(1));
+
+	toy::bloom_filter empty;
+	ASSERT_FALSE(empty.contains(1));
+	ASSERT_THROW(toy::bloom_filter(10, 0.0), std::invalid_argument);
+}
+
+TEST(bloom_filter_test, false_positive_rate)
+{
+	for (double fpp : { 0.1, 0.01, 0.001 })
+	{
+		toy::bloom_filter filter(100000, fpp);
+		for (uint64_t i = 0; i < 100000; ++i)
+			filter.insert(i);
+		size_t positives = 0;
+		for (uint64_t i = 100000; i < 1100000; ++i)
+			positives += filter.contains(i);
+		double rate = double(positives) / 1000000.0;
+		ASSERT_LT(rate, fpp * 1.5);
+		ASSERT_GT(rate, fpp * 0.3);
+	}
+}
+
+TEST(bloom_filter_test, batch_and_merge)
+{
+	toy::bloom_filter a(1000, 0.01, 7), b(1000, 0.01, 7);
+	std::vector<std::string> keys;
+	for (int i = 0; i < 2000; ++i)
+		keys.push_back("key" + std::to_string(i));
+	for (int i = 0; i < 500; ++i)
+		a.insert(keys[i]);
+	for (int i = 500; i < 1000; ++i)
+		b.insert(keys[i]);
+
+	std::unique_ptr<bool[]> results(new bool[keys.size()]);
+	size_t found = a.contains_batch(keys.data(), keys.size(), results.get());
+	size_t expected = 0;
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		ASSERT_EQ(results[i], a.contains(keys[i]));
+		expected += results[i];
+	}
+	ASSERT_EQ(found, expected);
+
+	a.merge(b);
+	for (int i = 0; i < 1000; ++i)
+		ASSERT_TRUE(a.contains(keys[i]));
+	ASSERT_THROW(a.merge(toy::bloom_filter(1000, 0.01, 8)), std::invalid_argument);
+}
+
+TEST(bloom_filter_test, serialize_and_view)
+{
+	toy::bloom_filter filter(5000, 0.01, 42);
+	for (uint64_t i = 0; i < 5000; i += 2)
+		filter.insert_hash(toy::hash_bytes(&i, sizeof(i)));
+
+	aligned_bytes buffer(filter.serialized_size());
+	filter.serialize(buffer.bytes());
+	ASSERT_THROW(filter.serialize(buffer.bytes().first(10)), std::length_error);
+
+	toy::bloom_filter copy = toy::bloom_filter::deserialize(buffer.bytes());
+	toy::bloom_filter_view view(buffer.bytes());
+	ASSERT_EQ(copy.block_count(), filter.block_count());
+	ASSERT_EQ(copy.insert_count(), filter.insert_count());
+	ASSERT_EQ(view.hash_seed(), 42u);
+
+	std::vector<uint64_t> hashes;
+	for (uint64_t i = 0; i < 5000; ++i)
+	{
+		uint64_t h = toy::hash_bytes(&i, sizeof(i));
+		hashes.push_back(h);
+		ASSERT_EQ(copy.contains_hash(h), filter.contains_hash(h));
+		ASSERT_EQ(view.contains_hash(h), filter.contains_hash(h));
+	}
+	std::unique_ptr<bool[]> results(new bool[hashes.size()]);
+	view.contains_hash_batch(hashes.data(), hashes.size(), results.get());
+	for (size_t i = 0; i < hashes.size(); i += 2)
+		ASSERT_TRUE(results[i]);
+
+	buffer.data[0] = 'X';
+	ASSERT_THROW(toy::bloom_filter_view(buffer.bytes()), std::invalid_argument);
+	ASSERT_THROW(toy::cuckoo_filter::deserialize(buffer.bytes()), std::invalid_argument);
+}
+
+TEST(bloom_filter_test, empty)
+{	// default constructed and moved from filters have no blocks
+	toy::bloom_filter a, b;
+	a.merge(b);
+	ASSERT_FALSE(a.contains(1));
+
+	aligned_bytes buffer(a.serialized_size());
+	a.serialize(buffer.bytes());
+	ASSERT_THROW(toy::bloom_filter::deserialize(buffer.bytes()), std::invalid_argument);	// an empty filter is not read back
+
+	a.insert(1);
+	ASSERT_TRUE(a.contains(1));
+	ASSERT_EQ(1, a.block_count());
+
+	toy::bloom_filter c(toy::move(a));
+	a.insert(2);
+	ASSERT_TRUE(a.contains(2) && c.contains(1));
+}
+
+// test cuckoo_filter ----------------------------------------------------------
+
+TEST(cuckoo_filter_test, insert_contains_erase)
+{
+	toy::cuckoo_filter filter(10000);
+	for (int i = 0; i < 10000; ++i)
+		ASSERT_TRUE(filter.insert(i));
+	ASSERT_EQ(filter.size(), 10000u);
+	for (int i = 0; i < 10000; ++i)
+		ASSERT_TRUE(filter.contains(i));
+
+	size_t positives = 0;
+	for (int i = 10000; i < 1010000; ++i)
+		positives += filter.contains(i);
+	ASSERT_LT(positives, 1000u);	// about 8 / 2^16 of them
+
+	for (int i = 0; i < 10000; i += 2)
+		ASSERT_TRUE(filter.erase(i));
+	ASSERT_EQ(filter.size(), 5000u);
+	for (int i = 1; i < 10000; i += 2)
+		ASSERT_TRUE(filter.contains(i));
+	size_t left = 0;
+	for (int i = 0; i < 10000; i += 2)
+		left += filter.contains(i);
+	ASSERT_LT(left, 10u);
+
+	// a key inserted twice is there until erased twice
+	filter.insert(-1);
+	filter.insert(-1);
+	ASSERT_TRUE(filter.erase(-1));
+	ASSERT_TRUE(filter.contains(-1));
+	ASSERT_TRUE(filter.erase(-1));
+}
+
+TEST(cuckoo_filter_test, empty)
+{
+	toy::cuckoo_filter filter;
+	ASSERT_FALSE(filter.insert(1));
+	ASSERT_FALSE(filter.contains(1));
+	ASSERT_FALSE(filter.erase(1));
+
+	aligned_bytes buffer(filter.serialized_size());
+	filter.serialize(buffer.bytes());
+	ASSERT_THROW(toy::cuckoo_filter::deserialize(buffer.bytes()), std::invalid_argument);	// an empty filter is not read back
+
+	ASSERT_THROW(toy::cuckoo_filter(SIZE_MAX), std::length_error);
+	ASSERT_THROW(toy::cuckoo_filter::bucket_count_for(SIZE_MAX / 2), std::length_error);
+}
+
+TEST(cuckoo_filter_test, fills_up)
+{
+	toy::cuckoo_filter filter(1000);
+	size_t inserted = 0;
+	while (filter.insert(inserted))
+		++inserted;
+	ASSERT_GT(filter.load_factor(), 0.9);
+	ASSERT_EQ(filter.size(), inserted);
+	for (size_t i = 0; i < inserted; ++i)
+		ASSERT_TRUE(filter.contains(i));
+
+	// an erase gives the victim another try, no other key is lost
+	ASSERT_TRUE(filter.erase(size_t(0)));
+	for (size_t i = 1; i < inserted; ++i)
+		ASSERT_TRUE(filter.contains(i));
+	ASSERT_EQ(filter.size(), inserted - 1);
+}
+
+TEST(cuckoo_filter_test, serialize_and_view)
+{
+	toy::cuckoo_filter filter(1000, 3);
+	for (int i = 0; filter.insert(i); ++i)
+	{
+	}
+
+	aligned_bytes buffer(filter.serialized_size());
+	filter.serialize(buffer.bytes());
+	toy::cuckoo_filter copy = toy::cuckoo_filter::deserialize(buffer.bytes());
+	toy::cuckoo_filter_view view(buffer.bytes());
+	ASSERT_EQ(view.size(), filter.size());
+	ASSERT_EQ(copy.bucket_count(), filter.bucket_count());
+
+	std::vector<int> keys(5000);
+	for (int i = 0; i < 5000; ++i)
+		keys[i] = i;
+	std::unique_ptr<bool[]> results(new bool[keys.size()]);
+	size_t found = view.contains_batch(keys.data(), keys.size(), results.get());
+	size_t expected = 0;
+	for (int i = 0; i < 5000; ++i)
+	{
+		ASSERT_EQ(results[i], filter.contains(i));
+		ASSERT_EQ(copy.contains(i), filter.contains(i));
+		expected += results[i];
+	}
+	ASSERT_EQ(found, expected);
+
+	ASSERT_TRUE(copy.erase(0));
+	ASSERT_EQ(copy.size(), filter.size() - 1);
+	for (int i = 1; i < 5000; ++i)
+		ASSERT_TRUE(!filter.contains(i) || copy.contains(i));
+}
+
+TEST(cuckoo_filter_test, DISABLED_benchmark_batch_contains)
+{
+	// tables far larger than the cache, every lookup misses it
+	const size_t n = 1 << 24;
+	const size_t queries = 1 << 24;
+	std::mt19937_64 random(5);
+	std::vector<uint64_t> hashes(queries);
+	for (uint64_t& h : hashes)
+		h = random();
+
+	toy::bloom_filter bloom(n, 0.01);
+	toy::cuckoo_filter cuckoo(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		bloom.insert_hash(hashes[i]);
+		cuckoo.insert_hash(hashes[i]);
+	}
+	std::shuffle(hashes.begin(), hashes.end(), random);
+	std::unique_ptr<bool[]> results(new bool[queries]);
+
+	auto time = [&](const char* name, auto&& run)
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t found = run();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		printf("%-22s %8.1f ms, %.1f ns per key, %zu found\n", name, ms, ms * 1e6 / queries, found);
+	};
+
+	time("bloom one by one", [&]()
+	{
+		size_t found = 0;
+		for (uint64_t h : hashes)
+			found += bloom.contains_hash(h);
+		return found;
+	});
+	time("bloom batch", [&]() { return bloom.contains_hash_batch(hashes.data(), queries, results.get()); });
+	time("cuckoo one by one", [&]()
+	{
+		size_t found = 0;
+		for (uint64_t h : hashes)
+			found += cuckoo.contains_hash(h);
+		return found;
+	});
+	time("cuckoo batch", [&]() { return cuckoo.contains_hash_batch(hashes.data(), queries, results.get()); });
+}
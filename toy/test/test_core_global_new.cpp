@@ -0,0 +1,132 @@
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+// every new and delete of this test program goes through toy::heap_allocate,
+// which is why it is a program of its own and not a part of toy_test
+#define TOY_GLOBAL_NEW_IMPLEMENTATION
+#include "toy/core/new.h"
+#include "toy/core/concurrent_queue.h"
+#include "toy/core/memory.h"
+
+// using namespace toy;
+
+// test global new -------------------------------------------------------------
+
+TEST(global_new_test, heap)
+{
+	size_t before = toy::heap_mapped_bytes();
+	std::vector<std::unique_ptr<std::string>> strings;
+	for (int i = 0; i < 10000; ++i)
+		strings.push_back(std::make_unique<std::string>(100, 'a'));
+	ASSERT_LE(before + 10000 * 100, toy::heap_mapped_bytes());	// the strings came from the heap
+	strings.clear();
+
+	struct alignas(128) line { char c[100]; };
+	std::vector<line> lines(100);
+	ASSERT_EQ(0, reinterpret_cast<uintptr_t>(lines.data()) % 128);
+
+	int* p = new (std::nothrow) int[16]();
+	ASSERT_NE(nullptr, p);
+	delete[] p;
+}
+
+TEST(global_new_test, cross_thread_delete)
+{
+	toy::spsc_queue<int*> queue(1024);
+	const int count = 200000;
+
+	std::thread consumer([&]()
+	{
+		int* p = nullptr;
+		for (int i = 0; i < count;)
+		{
+			if (queue.try_pop(p))
+			{
+				ASSERT_EQ(i, *p);
+				delete p;
+				++i;
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	for (int i = 0; i < count; ++i)
+	{
+		int* p = new int(i);
+		while (!queue.try_push(p))
+			std::this_thread::yield();
+	}
+	consumer.join();
+}
+
+TEST(global_new_test, new_handler)
+{	// called until it gives up, then bad_alloc
+	static int calls = 0;
+	std::set_new_handler([]()
+	{
+		if (++calls == 3)
+			std::set_new_handler(nullptr);
+	});
+	ASSERT_THROW((void)::operator new(size_t(1) << 62), std::bad_alloc);
+	ASSERT_EQ(3, calls);
+	ASSERT_EQ(nullptr, ::operator new(size_t(1) << 62, std::nothrow));
+	ASSERT_EQ(3, calls);
+}
+
+TEST(global_new_test, foreign_pointer)
+{	// not from the heap, ignored
+	void* p = std::malloc(64);
+	toy::heap_deallocate(p);
+	ASSERT_EQ(0, toy::heap_usable_size(p));
+	std::free(p);
+}
+
+// test alloc stats ------------------------------------------------------------
+
+TEST(global_new_test, alloc_stats)
+{	// the global operators are counted as toy::allocator is
+	static const toy::alloc_tag_id tag = toy::alloc_register_tag("global_new_test.alloc_stats");
+
+	std::vector<int>* numbers;
+	{
+		toy::alloc_scope scope(tag);
+		numbers = new std::vector<int>(100000);
+	}
+
+	// freed on another thread, out of the scope, still charged to the tag
+	std::thread([&]() { delete numbers; }).join();
+
+	toy::alloc_snapshot snapshot = toy::alloc_stats_snapshot();
+#if TOY_ALLOC_STATS
+	ASSERT_LT(tag, snapshot.tags.size());
+	const toy::alloc_tag_stats& s = snapshot.tags[tag];
+
+	ASSERT_STREQ("global_new_test.alloc_stats", s.name);
+	ASSERT_EQ(2, s.allocations);
+	ASSERT_EQ(2, s.deallocations);
+	ASSERT_EQ(0, s.live_bytes);
+	ASSERT_EQ(1, s.histogram[18]);		// the 400000 bytes of the vector
+#else
+	ASSERT_EQ(0, tag);
+	ASSERT_EQ(true, snapshot.tags.empty());
+#endif
+}
+
+// -----------------------------------------------------------------------------
+
+GTEST_API_ int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	auto result = RUN_ALL_TESTS();
+	getchar();
+	return result;
+}
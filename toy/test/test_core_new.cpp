@@ -0,0 +1,186 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "toy/core/new.h"
+#include "toy/core/concurrent_queue.h"
+#include "toy/core/memory.h"
+
+// using namespace toy;
+
+// test heap -------------------------------------------------------------------
+
+TEST(heap_test, size_classes)
+{
+	for (size_t size = 1; size <= 40000; size += size < 512 ? 1 : 97)
+	{
+		void* p = toy::heap_allocate(size);
+		ASSERT_EQ(0, reinterpret_cast<uintptr_t>(p) % alignof(std::max_align_t));
+		ASSERT_LE(size, toy::heap_usable_size(p));
+		std::memset(p, 0xcd, size);
+		toy::heap_deallocate(p);
+	}
+
+	for (size_t alignment = 32; alignment <= 1024 * 1024; alignment *= 2)
+	{
+		void* p = toy::heap_allocate(24, alignment);
+		ASSERT_EQ(0, reinterpret_cast<uintptr_t>(p) % alignment);
+		toy::heap_deallocate(p);
+	}
+}
+
+TEST(heap_test, cross_thread_free)
+{
+	toy::spsc_queue<int*> queue(1024);
+	const int count = 200000;
+
+	std::thread consumer([&]()
+	{
+		int* p = nullptr;
+		for (int i = 0; i < count;)
+		{
+			if (queue.try_pop(p))
+			{
+				ASSERT_EQ(i, *p);
+				toy::heap_deallocate(p);
+				++i;
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	for (int i = 0; i < count; ++i)
+	{
+		int* p = ::new (toy::heap_allocate(sizeof(int))) int(i);
+		while (!queue.try_push(p))
+			std::this_thread::yield();
+	}
+	consumer.join();
+}
+
+TEST(heap_test, trim)
+{
+	std::vector<void*> blocks;
+	blocks.reserve(100000);
+
+	size_t before = toy::heap_mapped_bytes();
+	for (int i = 0; i < 100000; ++i)
+		blocks.push_back(toy::heap_allocate(200));
+	size_t peak = toy::heap_mapped_bytes();
+	ASSERT_LE(before + 100000 * 200, peak);
+
+	for (void* p : blocks)
+		toy::heap_deallocate(p);
+	toy::heap_flush_thread_cache();
+	toy::heap_trim();
+
+	// the spans went back to the OS
+	ASSERT_GT(before + 64 * 1024, toy::heap_mapped_bytes());
+}
+
+// test alloc stats ------------------------------------------------------------
+
+TEST(heap_test, alloc_stats)
+{
+	static const toy::alloc_tag_id tag = toy::alloc_register_tag("heap_test.alloc_stats");
+
+	int* numbers;
+	int* kept;
+	{
+		toy::alloc_scope scope(tag);
+		numbers = toy::allocator<int>().allocate(100000);
+		kept = toy::allocator<int>().allocate(100);
+	}
+
+	// freed on another thread, out of the scope, still charged to the tag
+	std::thread([&]() { toy::allocator<int>().deallocate(numbers, 100000); }).join();
+
+	toy::alloc_snapshot snapshot = toy::alloc_stats_snapshot();
+#if TOY_ALLOC_STATS
+	ASSERT_LT(tag, snapshot.tags.size());
+	const toy::alloc_tag_stats& s = snapshot.tags[tag];
+
+	ASSERT_STREQ("heap_test.alloc_stats", s.name);
+	ASSERT_EQ(2, s.allocations);
+	ASSERT_EQ(1, s.deallocations);
+	ASSERT_EQ(400, s.live_bytes);
+	ASSERT_LE(400000, s.peak_bytes);	// big enough to be reported at once
+	ASSERT_EQ(1, s.histogram[18]);		// the 400000 bytes of numbers
+#else
+	ASSERT_EQ(0, tag);
+	ASSERT_EQ(true, snapshot.tags.empty());
+#endif
+
+	toy::allocator<int>().deallocate(kept, 100);
+}
+
+// benchmark -------------------------------------------------------------------
+
+namespace
+{
+
+template<class Allocate, class Deallocate>
+double small_objects(Allocate allocate, Deallocate deallocate)
+{	// many short lived small objects, freed in batches
+	std::vector<void*> live(1000);
+	auto start = std::chrono::steady_clock::now();
+	for (int round = 0; round < 2000; ++round)
+	{
+		for (size_t i = 0; i < live.size(); ++i)
+			live[i] = allocate(16 + (i * 8) % 240);
+		for (void* p : live)
+			deallocate(p);
+	}
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<class Allocate, class Deallocate>
+double cross_thread(Allocate allocate, Deallocate deallocate)
+{	// a producer allocates, a consumer frees
+	const int count = 1000000;
+	toy::spsc_queue<void*> queue(4096);
+	auto start = std::chrono::steady_clock::now();
+
+	std::thread consumer([&]()
+	{
+		void* p = nullptr;
+		for (int i = 0; i < count;)
+		{
+			if (queue.try_pop(p))
+			{
+				deallocate(p);
+				++i;
+			}
+		}
+	});
+	for (int i = 0; i < count; ++i)
+	{
+		void* p = allocate(64);
+		while (!queue.try_push(p))
+			;
+	}
+	consumer.join();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}	// namespace
+
+TEST(heap_test, DISABLED_benchmark_heap)
+{
+	auto heap_allocate   = [](size_t n) { return toy::heap_allocate(n); };
+	auto heap_deallocate = [](void* p) { toy::heap_deallocate(p); };
+	auto malloc_         = [](size_t n) { return std::malloc(n); };
+	auto free_           = [](void* p) { std::free(p); };
+
+	std::printf("small objects  heap %8.2f ms  malloc %8.2f ms\n",
+		small_objects(heap_allocate, heap_deallocate), small_objects(malloc_, free_));
+	std::printf("cross thread   heap %8.2f ms  malloc %8.2f ms\n",
+		cross_thread(heap_allocate, heap_deallocate), cross_thread(malloc_, free_));
+}
@@ -0,0 +1,247 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "toy/core/radix_tree.h"
+
+// using namespace toy;
+
+namespace
+{
+
+// paths sharing long prefixes, some of them prefixes of others
+std::string random_path(std::mt19937& random)
+{
+	static const char* const parts[] = { "api", "v1", "v2", "users", "user", "u", "orders", "", "x", "a-very-long-segment-name" };
+	std::string path;
+	int depth = 1 + random() % 5;
+	for (int i = 0; i < depth; ++i)
+	{
+		path += '/';
+		path += parts[random() % 10];
+	}
+	if (random() % 3 == 0)
+		path += std::to_string(random() % 100);
+	return path;
+}
+
+template<class Tree, class Map>
+void expect_same(const Tree& tree, const Map& map)
+{
+	ASSERT_EQ(tree.size(), map.size());
+	auto it = tree.begin();
+	for (const auto& value : map)
+	{
+		ASSERT_EQ(it->first, value.first);
+		ASSERT_EQ(it->second, value.second);
+		++it;
+	}
+	ASSERT_TRUE(it == tree.end());
+}
+
+}	// namespace
+
+// test radix_tree -------------------------------------------------------------
+
+TEST(radix_tree_test, random_against_map)
+{
+	std::mt19937 random(1);
+	toy::radix_tree<std::string, int> tree;
+	std::map<std::string, int> map;
+
+	for (int round = 0; round < 20000; ++round)
+	{
+		std::string key = random_path(random);
+		switch (random() % 4)
+		{
+		case 0:
+		case 1:
+			ASSERT_EQ(tree.try_emplace(key, round).second, map.emplace(key, round).second);
+			break;
+		case 2:
+			ASSERT_EQ(tree.erase(key), map.erase(key));
+			break;
+		default:
+		{
+			auto found = tree.find(key);
+			auto expected = map.find(key);
+			ASSERT_EQ(found == tree.end(), expected == map.end());
+			ASSERT_TRUE(found == tree.end() || found->second == expected->second);
+			auto lower = tree.lower_bound(key);
+			auto expected_lower = map.lower_bound(key);
+			ASSERT_EQ(lower == tree.end(), expected_lower == map.end());
+			ASSERT_TRUE(lower == tree.end() || lower->first == expected_lower->first);
+			auto upper = tree.upper_bound(key);
+			auto expected_upper = map.upper_bound(key);
+			ASSERT_EQ(upper == tree.end(), expected_upper == map.end());
+			ASSERT_TRUE(upper == tree.end() || upper->first == expected_upper->first);
+			break;
+		}
+		}
+		if (round % 1000 == 0)
+			expect_same(tree, map);
+	}
+	expect_same(tree, map);
+
+	// everything back out, in random order
+	std::vector<std::string> keys;
+	for (const auto& value : map)
+		keys.push_back(value.first);
+	std::shuffle(keys.begin(), keys.end(), random);
+	for (const std::string& key : keys)
+	{
+		ASSERT_EQ(tree.erase(key), 1u);
+		map.erase(key);
+		ASSERT_FALSE(tree.contains(key));
+	}
+	ASSERT_TRUE(tree.empty());
+	ASSERT_TRUE(tree.begin() == tree.end());
+}
+
+TEST(radix_tree_test, empty_and_prefix_keys)
+{
+	toy::radix_tree<std::string, int> tree{ { "abc", 3 }, { "", 0 }, { "ab", 2 }, { "abcd", 4 }, { "a", 1 } };
+	std::vector<std::string> order;
+	for (const auto& value : tree)
+		order.push_back(value.first);
+	ASSERT_EQ(order, (std::vector<std::string>{ "", "a", "ab", "abc", "abcd" }));
+	ASSERT_EQ(tree.at(""), 0);
+	ASSERT_EQ(tree.at("abc"), 3);
+	ASSERT_THROW(tree.at("abcde"), std::out_of_range);
+
+	ASSERT_EQ(tree.erase("ab"), 1u);
+	ASSERT_EQ(tree.erase("ab"), 0u);
+	ASSERT_EQ(tree.at("abcd"), 4);
+	ASSERT_EQ(tree.lower_bound("ab")->first, "abc");
+	ASSERT_EQ(tree.upper_bound("abcd"), tree.end());
+	ASSERT_EQ(tree.rbegin()->first, "abcd");
+
+	tree["ab"] = 20;
+	tree.insert_or_assign("a", 10);
+	ASSERT_EQ(tree.at("ab"), 20);
+	ASSERT_EQ(tree.at("a"), 10);
+	ASSERT_EQ(tree.size(), 5u);
+}
+
+TEST(radix_tree_test, prefix_range)
+{
+	toy::radix_tree<std::string, int> tree;
+	const char* const keys[] = { "/api/v1/users", "/api/v1/users/7", "/api/v1", "/api/v2/orders", "/api/v1/orders", "/apx", "/", "/api/v1\xff", "/api/v1\xff\xff" };
+	for (int i = 0; i < 9; ++i)
+		tree.try_emplace(keys[i], i);
+
+	std::vector<std::string> found;
+	for (const auto& value : tree.prefix_range("/api/v1/"))
+		found.push_back(value.first);
+	ASSERT_EQ(found, (std::vector<std::string>{ "/api/v1/orders", "/api/v1/users", "/api/v1/users/7" }));
+
+	found.clear();
+	for (const auto& value : tree.prefix_range("/api/v1\xff"))
+		found.push_back(value.first);
+	ASSERT_EQ(found, (std::vector<std::string>{ "/api/v1\xff", "/api/v1\xff\xff" }));
+
+	ASSERT_EQ(std::distance(tree.prefix_range("/api").begin(), tree.prefix_range("/api").end()), 7);
+	ASSERT_EQ(std::distance(tree.prefix_range("").begin(), tree.prefix_range("").end()), 9);
+	ASSERT_TRUE(tree.prefix_range("/b").empty());
+	ASSERT_TRUE(tree.prefix_range("/api/v3").empty());
+}
+
+TEST(radix_tree_test, integer_keys)
+{
+	std::mt19937_64 random(2);
+	toy::radix_tree<int64_t, int> tree;
+	std::map<int64_t, int> map;
+	for (int i = 0; i < 20000; ++i)
+	{
+		int64_t key = static_cast<int64_t>(random()) >> (random() % 64);
+		tree[key] = i;
+		map[key] = i;
+	}
+	tree[INT64_MIN] = -1;
+	map[INT64_MIN] = -1;
+	tree[INT64_MAX] = -2;
+	map[INT64_MAX] = -2;
+	expect_same(tree, map);
+	ASSERT_EQ(tree.lower_bound(0)->first, map.lower_bound(0)->first);
+	ASSERT_EQ(tree.upper_bound(-1)->first, map.upper_bound(-1)->first);
+
+	// a node of every size, on the way up and on the way down
+	toy::radix_tree<uint16_t, int> dense;
+	for (int i = 0; i < 65536; i += 3)
+		dense[static_cast<uint16_t>(i)] = i;
+	for (int i = 0; i < 65536; ++i)
+		ASSERT_EQ(dense.contains(static_cast<uint16_t>(i)), i % 3 == 0);
+	for (int i = 0; i < 65536; i += 3)
+		ASSERT_TRUE(i % 256 == 0 || dense.erase(static_cast<uint16_t>(i)) == 1);
+	ASSERT_EQ(dense.size(), 86u);
+	int previous = -1;
+	for (const auto& value : dense)
+	{
+		ASSERT_EQ(value.first, value.second);
+		ASSERT_GT(int(value.first), previous);
+		previous = value.first;
+	}
+}
+
+TEST(radix_tree_test, copy_move_swap)
+{
+	toy::radix_tree<std::string, std::string> a;
+	for (int i = 0; i < 1000; ++i)
+		a.try_emplace("key" + std::to_string(i), std::to_string(i));
+	toy::radix_tree<std::string, std::string> b(a);
+	ASSERT_TRUE(a == b);
+	b.erase("key7");
+	ASSERT_TRUE(a != b);
+
+	toy::radix_tree<std::string, std::string> c(std::move(b));
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(c.size(), 999u);
+	swap(a, c);
+	ASSERT_EQ(a.size(), 999u);
+	ASSERT_EQ(c.at("key7"), "7");
+	a = c;
+	ASSERT_TRUE(a == c);
+	a.clear();
+	ASSERT_TRUE(a.empty());
+	ASSERT_FALSE(a.contains("key7"));
+}
+
+TEST(radix_tree_test, DISABLED_benchmark_lookup)
+{
+	const int n = 1 << 20;
+	std::mt19937 random(3);
+	std::vector<std::string> keys;
+	for (int i = 0; i < n; ++i)
+		keys.push_back("/tenant/" + std::to_string(random() % 1000) + "/object/" + std::to_string(random()));
+	std::vector<std::string> queries = keys;
+	std::shuffle(queries.begin(), queries.end(), random);
+
+	auto time = [&](const char* name, auto& container)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (const std::string& key : keys)
+			container[key] = 1;
+		auto middle = std::chrono::steady_clock::now();
+		size_t found = 0;
+		for (const std::string& key : queries)
+			found += container.find(key) != container.end();
+		auto stop = std::chrono::steady_clock::now();
+		printf("%-20s insert %6.1f ns, find %6.1f ns, %zu found\n", name,
+			std::chrono::duration<double, std::nano>(middle - start).count() / n,
+			std::chrono::duration<double, std::nano>(stop - middle).count() / n, found);
+	};
+
+	toy::radix_tree<std::string, int> tree;
+	std::map<std::string, int> map;
+	std::unordered_map<std::string, int> hash_map;
+	time("toy::radix_tree", tree);
+	time("std::map", map);
+	time("std::unordered_map", hash_map);
+}
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "toy/core/roaring_bitmap.h"
+
+// using namespace toy;
+
+namespace
+{
+
+// sparse values, dense blocks and long runs, in the same set
+std::set<uint32_t> mixed_values(uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::set<uint32_t> values;
+	for (int i = 0; i < 3000; ++i)
+		values.insert(random());
+	for (int i = 0; i < 20000; ++i)
+		values.insert((3u << 16) | (random() & 0xffff));
+	uint32_t start = (5u << 16) + random() % 1000;
+	for (uint32_t v = start; v < start + 100000; ++v)
+		values.insert(v);
+	for (int i = 0; i < 2000; ++i)
+		values.insert((9u << 16) | (random() & 0xffff));
+	return values;
+}
+
+toy::roaring_bitmap to_bitmap(const std::set<uint32_t>& values)
+{
+	return toy::roaring_bitmap(values.begin(), values.end());
+}
+
+void expect_same(const toy::roaring_bitmap& bitmap, const std::set<uint32_t>& values)
+{
+	ASSERT_EQ(bitmap.cardinality(), values.size());
+	auto it = bitmap.begin();
+	for (uint32_t v : values)
+	{
+		ASSERT_TRUE(it != bitmap.end());
+		ASSERT_EQ(*it, v);
+		++it;
+	}
+	ASSERT_TRUE(it == bitmap.end());
+}
+
+}	// namespace
+
+// test roaring_bitmap ---------------------------------------------------------
+
+TEST(roaring_bitmap_test, add_remove_contains)
+{
+	std::mt19937 random(1);
+	toy::roaring_bitmap bitmap;
+	std::set<uint32_t> values;
+	ASSERT_TRUE(bitmap.empty());
+	ASSERT_THROW(bitmap.minimum(), std::out_of_range);
+
+	// a block filled past 4096 values and emptied again, and scattered values
+	for (int round = 0; round < 60000; ++round)
+	{
+		uint32_t v = round % 4 == 0 ? random() : (7u << 16) | (random() % 12000);
+		if (round < 40000 || random() % 2)
+			ASSERT_EQ(bitmap.add(v), values.insert(v).second);
+		else
+			ASSERT_EQ(bitmap.remove(v), values.erase(v) == 1);
+	}
+	expect_same(bitmap, values);
+	for (uint32_t v = 7u << 16; v < (7u << 16) + 12000; ++v)
+		ASSERT_EQ(bitmap.contains(v), values.count(v) == 1);
+	ASSERT_EQ(bitmap.minimum(), *values.begin());
+	ASSERT_EQ(bitmap.maximum(), *values.rbegin());
+
+	size_t rank = 0;
+	for (uint32_t v : values)
+	{
+		ASSERT_EQ(bitmap.select(rank), v);
+		ASSERT_EQ(bitmap.rank(v), ++rank);
+	}
+	ASSERT_THROW(bitmap.select(rank), std::out_of_range);
+
+	for (uint32_t v : values)
+		ASSERT_TRUE(bitmap.remove(v));
+	ASSERT_TRUE(bitmap.empty());
+}
+
+TEST(roaring_bitmap_test, ranges_and_runs)
+{
+	toy::roaring_bitmap bitmap = toy::roaring_bitmap::range(65530, 200010);
+	ASSERT_EQ(bitmap.cardinality(), 200010u - 65530u);
+	ASSERT_FALSE(bitmap.contains(65529));
+	ASSERT_TRUE(bitmap.contains(65530));
+	ASSERT_TRUE(bitmap.contains(131072));
+	ASSERT_FALSE(bitmap.contains(200010));
+	ASSERT_EQ(bitmap.maximum(), 200009u);
+	ASSERT_EQ(bitmap.rank(70000), 70001u - 65530u);
+	ASSERT_EQ(bitmap.select(10), 65540u);
+
+	// holes punched into the runs and filled again
+	std::set<uint32_t> values;
+	for (uint32_t v = 65530; v < 200010; ++v)
+		values.insert(v);
+	for (uint32_t v : { 65530u, 65531u, 70000u, 131071u, 131072u, 200009u, 100000u })
+	{
+		ASSERT_TRUE(bitmap.remove(v));
+		values.erase(v);
+	}
+	ASSERT_TRUE(bitmap.add(70000));
+	values.insert(70000);
+	ASSERT_FALSE(bitmap.add(70001));
+	expect_same(bitmap, values);
+
+	bitmap.add_range(uint64_t(0xffffffff) - 10, uint64_t(1) << 32);
+	ASSERT_EQ(bitmap.maximum(), 0xffffffffu);
+	ASSERT_THROW(bitmap.add_range(0, (uint64_t(1) << 32) + 1), std::out_of_range);
+
+	// run_optimize keeps the values, whatever it turns into runs
+	toy::roaring_bitmap mixed = to_bitmap(mixed_values(2));
+	toy::roaring_bitmap optimized = mixed;
+	ASSERT_TRUE(optimized.run_optimize());
+	ASSERT_TRUE(optimized == mixed);
+	ASSERT_LT(optimized.serialized_size(), mixed.serialized_size());
+	expect_same(optimized, mixed_values(2));
+}
+
+TEST(roaring_bitmap_test, set_algebra)
+{
+	std::set<uint32_t> a = mixed_values(3), b = mixed_values(4);
+	for (uint32_t v = 100; v < 5000; v += 2)
+	{
+		a.insert(v);
+		b.insert(v + 1);
+	}
+	std::vector<uint32_t> both, either, only_a;
+	std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(both));
+	std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(either));
+	std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(only_a));
+
+	toy::roaring_bitmap x = to_bitmap(a), y = to_bitmap(b);
+	for (int optimize = 0; optimize < 4; ++optimize)
+	{	// every mix of plain and run blocks
+		toy::roaring_bitmap p = x, q = y;
+		if (optimize & 1)
+			p.run_optimize();
+		if (optimize & 2)
+			q.run_optimize();
+
+		expect_same(p & q, std::set<uint32_t>(both.begin(), both.end()));
+		expect_same(p | q, std::set<uint32_t>(either.begin(), either.end()));
+		expect_same(p - q, std::set<uint32_t>(only_a.begin(), only_a.end()));
+		ASSERT_EQ(and_cardinality(p, q), both.size());
+		ASSERT_EQ(or_cardinality(p, q), either.size());
+		ASSERT_EQ(andnot_cardinality(p, q), only_a.size());
+		ASSERT_TRUE(intersects(p, q));
+	}
+
+	toy::roaring_bitmap evens, odds;
+	for (uint32_t v = 0; v < 100000; v += 2)
+	{
+		evens.add(v);
+		odds.add(v + 1);
+	}
+	ASSERT_FALSE(intersects(evens, odds));
+	ASSERT_TRUE((evens & odds).empty());
+	toy::roaring_bitmap all = evens | odds;
+	ASSERT_TRUE(all == toy::roaring_bitmap::range(0, 100000));
+	all -= odds;
+	ASSERT_TRUE(all == evens);
+	all &= toy::roaring_bitmap::range(0, 10);
+	expect_same(all, { 0, 2, 4, 6, 8 });
+}
+
+TEST(roaring_bitmap_test, serialize_and_view)
+{
+	std::set<uint32_t> values = mixed_values(5);
+	toy::roaring_bitmap bitmap = to_bitmap(values);
+	for (int optimize = 0; optimize < 2; ++optimize)
+	{	// without and with run blocks, the two cookies
+		if (optimize)
+			bitmap.run_optimize();
+		std::vector<unsigned char> buffer(bitmap.serialized_size() + 1);
+		ASSERT_EQ(bitmap.serialize(toy::span<unsigned char>(buffer.data(), buffer.size())), buffer.size() - 1);
+		ASSERT_THROW(bitmap.serialize(toy::span<unsigned char>(buffer.data(), 10)), std::length_error);
+
+		// at an odd address, nothing in the format is aligned
+		std::vector<unsigned char> shifted(buffer.size() + 1);
+		std::copy(buffer.begin(), buffer.end() - 1, shifted.begin() + 1);
+		toy::span<const unsigned char> bytes(shifted.data() + 1, buffer.size() - 1);
+
+		toy::roaring_bitmap copy = toy::roaring_bitmap::deserialize(bytes);
+		ASSERT_TRUE(copy == bitmap);
+		toy::roaring_bitmap_view view(bytes);
+		ASSERT_EQ(view.cardinality(), values.size());
+		ASSERT_EQ(view.serialized_size(), bytes.size());
+		for (uint32_t v : values)
+			ASSERT_TRUE(view.contains(v));
+		std::mt19937 random(6);
+		for (int i = 0; i < 100000; ++i)
+		{
+			uint32_t v = (random() % 12) << 16 | (random() & 0xffff);
+			ASSERT_EQ(view.contains(v), values.count(v) == 1);
+		}
+		std::vector<uint32_t> listed;
+		view.for_each([&](uint32_t v) { listed.push_back(v); });
+		ASSERT_TRUE(std::equal(listed.begin(), listed.end(), values.begin(), values.end()));
+		ASSERT_TRUE(view.to_bitmap() == bitmap);
+
+		ASSERT_THROW(toy::roaring_bitmap_view(bytes.first(bytes.size() - 1)), std::invalid_argument);
+		ASSERT_THROW(toy::roaring_bitmap::deserialize(bytes.first(20)), std::invalid_argument);
+	}
+
+	// the bytes of the other implementations for { 1, 2, 3, 1000, 1 << 20 }
+	const unsigned char portable[] = {
+		0x3a, 0x30, 0, 0, 2, 0, 0, 0,		// cookie 12346, 2 blocks
+		0, 0, 3, 0, 16, 0, 0, 0,			// keys 0 and 16, cardinality 4 and 1
+		24, 0, 0, 0, 32, 0, 0, 0,			// offsets
+		1, 0, 2, 0, 3, 0, 0xe8, 3,
+		0, 0 };
+	toy::roaring_bitmap expected{ 1, 2, 3, 1000, 1 << 20 };
+	ASSERT_EQ(expected.serialized_size(), sizeof(portable));
+	std::vector<unsigned char> written(sizeof(portable));
+	expected.serialize(toy::span<unsigned char>(written.data(), written.size()));
+	ASSERT_TRUE(std::equal(written.begin(), written.end(), portable));
+	ASSERT_TRUE(toy::roaring_bitmap::deserialize(toy::span<const unsigned char>(portable, sizeof(portable))) == expected);
+
+	toy::roaring_bitmap empty;
+	std::vector<unsigned char> nothing(empty.serialized_size());
+	empty.serialize(toy::span<unsigned char>(nothing.data(), nothing.size()));
+	ASSERT_TRUE(toy::roaring_bitmap_view(toy::span<const unsigned char>(nothing.data(), nothing.size())).empty());
+}
+
+TEST(roaring_bitmap_test, DISABLED_benchmark_set_algebra)
+{
+	// posting lists: one dense, one sparse, one clustered in runs
+	std::mt19937 random(7);
+	toy::roaring_bitmap dense, sparse, other_sparse, clustered;
+	std::vector<uint32_t> dense_list, sparse_list;
+	for (uint32_t v = 0; v < 100000000; ++v)
+	{
+		if (random() % 4 == 0)
+		{
+			dense.add(v);
+			dense_list.push_back(v);
+		}
+		if (random() % 32 == 0)
+		{
+			sparse.add(v);
+			sparse_list.push_back(v);
+		}
+		if (random() % 32 == 0)
+			other_sparse.add(v);
+	}
+	for (int i = 0; i < 2000; ++i)
+	{
+		uint64_t start = random() % 100000000;
+		clustered.add_range(start, start + random() % 20000);
+	}
+	clustered.run_optimize();
+
+	auto time = [&](const char* name, auto&& run)
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t result = 0;
+		for (int i = 0; i < 10; ++i)
+			result = run();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / 10;
+		printf("%-30s %8.2f ms  %zu\n", name, ms, result);
+	};
+
+	time("sorted vectors, intersect", [&]()
+	{
+		std::vector<uint32_t> out;
+		std::set_intersection(dense_list.begin(), dense_list.end(), sparse_list.begin(), sparse_list.end(), std::back_inserter(out));
+		return out.size();
+	});
+	time("dense & sparse", [&]() { return (dense & sparse).cardinality(); });
+	time("and_cardinality(dense, sparse)", [&]() { return and_cardinality(dense, sparse); });
+	time("dense | sparse", [&]() { return (dense | sparse).cardinality(); });
+	time("dense - sparse", [&]() { return (dense - sparse).cardinality(); });
+	time("sparse & other_sparse", [&]() { return (sparse & other_sparse).cardinality(); });
+	time("sparse - other_sparse", [&]() { return (sparse - other_sparse).cardinality(); });
+	time("dense & clustered", [&]() { return (dense & clustered).cardinality(); });
+	time("and_cardinality(dense, clustered)", [&]() { return and_cardinality(dense, clustered); });
+	printf("bytes: dense %zu, sparse %zu, clustered %zu\n", dense.serialized_size(), sparse.serialized_size(), clustered.serialized_size());
+}
@@ -1,8 +1,17 @@
+#include <chrono>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <string>
 #include <vector>
 
 #include <gtest/gtest.h>
 
+#include "toy/core/arena.h"
 #include "toy/core/initializer_list.h"
+#include "toy/core/memory_resource.h"
 #include "toy/core/memory.h"
 #include "toy/core/type_traits.h"
 #include "toy/core/utility.h"
@@ -123,6 +132,321 @@ TEST(memory_test, unique_ptr)
 	ASSERT_EQ(false, *r < *s);
 }
 
+// test shared_ptr -------------------------------------------------------------
+
+namespace
+{
+
+struct node : toy::enable_shared_from_this<node>
+{
+	explicit node(int value) : value(value) { ++alive; }
+	~node() { --alive; }
+
+	int value;
+	static int alive;
+};
+
+int node::alive = 0;
+
+template<class T>
+struct counting_allocator : toy::allocator<T>
+{
+	template<class U> struct rebind { using other = counting_allocator<U>; };
+
+	counting_allocator(int* count) noexcept : count(count) {}
+	template<class U> counting_allocator(const counting_allocator<U>& right) noexcept : count(right.count) {}
+
+	T* allocate(size_t n)
+	{
+		++*count;
+		return toy::allocator<T>::allocate(n);
+	}
+
+	int* count;
+};
+
+struct counted : toy::intrusive_ref_counter<counted>
+{
+	explicit counted(int value) : value(value) { ++alive; }
+	~counted() { --alive; }
+
+	int value;
+	static int alive;
+};
+
+int counted::alive = 0;
+
+}	// namespace
+
+TEST(memory_test, shared_ptr)
+{
+	{
+		toy::shared_ptr<node> p = toy::make_shared<node>(1);
+		toy::shared_ptr<node> q = p;
+		toy::shared_ptr<node> r(new node(2));
+
+		ASSERT_EQ(2, p.use_count());
+		ASSERT_EQ(1, q->value);
+		ASSERT_EQ(true, p == q && p != r);
+
+		// shared_from_this gives back the ownership of p
+		toy::shared_ptr<node> s = q->shared_from_this();
+		ASSERT_EQ(3, p.use_count());
+		ASSERT_EQ(2, r->shared_from_this()->value);
+
+		// aliasing and casts share the ownership
+		toy::shared_ptr<int> value(p, &p->value);
+		toy::shared_ptr<toy::enable_shared_from_this<node>> base = p;
+		ASSERT_EQ(5, p.use_count());
+		ASSERT_EQ(p, toy::static_pointer_cast<node>(base));
+
+		r = toy::move(q);
+		ASSERT_EQ(false, bool(q));
+		ASSERT_EQ(1, node::alive);
+
+		toy::shared_ptr<node> u(toy::make_unique<node>(3));
+		ASSERT_EQ(3, u->value);
+	}
+	ASSERT_EQ(0, node::alive);
+
+	// make_shared puts the object and the counts in one allocation
+	int count = 0;
+	counting_allocator<node> alloc(&count);
+	{
+		auto p = toy::allocate_shared<node>(alloc, 4);
+		ASSERT_EQ(4, p->value);
+	}
+	ASSERT_EQ(1, count);
+	toy::shared_ptr<node>(new node(5), toy::default_delete<node>(), alloc);
+	ASSERT_EQ(2, count);
+	ASSERT_EQ(0, node::alive);
+}
+
+TEST(memory_test, weak_ptr)
+{
+	toy::weak_ptr<node> w;
+	ASSERT_EQ(true, w.expired());
+	{
+		auto p = toy::make_shared<node>(1);
+		w = p;
+		ASSERT_EQ(1, w.use_count());
+		ASSERT_EQ(1, w.lock()->value);
+	}
+	ASSERT_EQ(true, w.expired());
+	ASSERT_EQ(false, bool(w.lock()));
+	ASSERT_THROW(toy::shared_ptr<node>{ w }, std::bad_weak_ptr);
+
+	// to a base, by copy and by move
+	using base_type = toy::enable_shared_from_this<node>;
+	{
+		auto p = toy::make_shared<node>(2);
+		toy::weak_ptr<node> d = p;
+		toy::weak_ptr<base_type> b = toy::move(d);
+		ASSERT_EQ(true, d.expired());
+		ASSERT_EQ(p.get(), b.lock().get());
+
+		toy::weak_ptr<base_type> c;
+		c = d = p;
+		c = toy::move(d);
+		ASSERT_EQ(true, d.expired());
+		ASSERT_EQ(1, c.use_count());
+	}
+	ASSERT_EQ(0, node::alive);
+
+	toy::local_weak_ptr<int> lw;
+	{
+		toy::local_shared_ptr<int> p = toy::make_local_shared<int>(7);
+		toy::local_shared_ptr<int> q = p;
+		lw = q;
+		ASSERT_EQ(2, p.use_count());
+		ASSERT_EQ(7, *lw.lock());
+	}
+	ASSERT_EQ(true, lw.expired());
+}
+
+TEST(memory_test, intrusive_ptr)
+{
+	{
+		toy::intrusive_ptr<counted> p(new counted(1));
+		toy::intrusive_ptr<counted> q = p;
+		ASSERT_EQ(2, p->use_count());
+
+		// the count is in the object, a raw pointer can be adopted again
+		toy::intrusive_ptr<counted> r(q.get());
+		ASSERT_EQ(3, r->use_count());
+
+		counted* raw = r.detach();
+		r.reset(raw, false);
+		ASSERT_EQ(3, r->use_count());
+	}
+	ASSERT_EQ(0, counted::alive);
+}
+
+TEST(memory_test, DISABLED_benchmark_shared_ptr)
+{	// copies of a pointer, as when a message is fanned out to its handlers
+	auto copies = [](auto p)
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::vector<decltype(p)> handlers(64);
+		for (int round = 0; round < 200000; ++round)
+		{
+			for (auto& h : handlers)
+				h = p;
+			for (auto& h : handlers)
+				h.reset();
+		}
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	std::printf("std::shared_ptr        %8.2f ms\n", copies(std::make_shared<int>(1)));
+	std::printf("toy::shared_ptr        %8.2f ms\n", copies(toy::make_shared<int>(1)));
+	std::printf("toy::local_shared_ptr  %8.2f ms\n", copies(toy::make_local_shared<int>(1)));
+	std::printf("toy::intrusive_ptr     %8.2f ms\n", copies(toy::intrusive_ptr<counted>(new counted(1))));
+}
+
+// test arena ------------------------------------------------------------------
+
+TEST(memory_test, arena)
+{
+	toy::inline_arena<256> arena;
+
+	void* a = arena.allocate(100, 8);
+	void* b = arena.allocate(64, 64);	// at most 163 + 64 bytes into the buffer
+	ASSERT_EQ(0, reinterpret_cast<uintptr_t>(b) % 64);
+	ASSERT_EQ(0, arena.block_count());	// still in the inline buffer
+
+	void* c = arena.allocate(1000);
+	ASSERT_EQ(1, arena.block_count());
+	ASSERT_EQ(true, arena.owns(a) && arena.owns(b) && arena.owns(c));
+
+	arena.reset();
+	ASSERT_EQ(a, arena.allocate(100, 8));
+	ASSERT_EQ(c, arena.allocate(1000));	// the block is reused
+	ASSERT_EQ(1, arena.block_count());
+
+	arena.release();
+	ASSERT_EQ(0, arena.block_count());
+
+	// a size that wraps around with the alignment, a bad alignment even with room
+	ASSERT_THROW(arena.allocate(SIZE_MAX - 8, 64), std::bad_alloc);
+	ASSERT_THROW(toy::arena_allocator<double>(arena).allocate(SIZE_MAX / sizeof(double)), std::bad_alloc);
+	ASSERT_THROW(arena.allocate(8, 24), std::invalid_argument);
+	ASSERT_THROW(arena.allocate(8, 0), std::invalid_argument);
+	ASSERT_EQ(0, arena.block_count());
+}
+
+TEST(memory_test, arena_allocator)
+{
+	toy::arena arena(1024);
+	toy::arena_allocator<int> alloc(arena);
+
+	std::vector<int, toy::arena_allocator<int>> v(alloc);
+	for (int i = 0; i < 1000; ++i)
+		v.push_back(i);
+
+	std::list<int, toy::arena_allocator<int>> l(alloc);
+	l.assign(v.begin(), v.end());
+
+	using string_alloc = toy::arena_allocator<std::pair<const int, std::string>>;
+	std::map<int, std::string, std::less<int>, string_alloc> m{ string_alloc(arena) };
+	m[1] = "one";
+	m[2] = "two";
+
+	ASSERT_EQ(499500, std::accumulate(l.begin(), l.end(), 0));
+	ASSERT_EQ("two", m[2]);
+	ASSERT_EQ(true, arena.owns(v.data()));
+	ASSERT_EQ(true, alloc == toy::arena_allocator<char>(arena));
+}
+
+// test memory_resource --------------------------------------------------------
+
+TEST(memory_test, memory_resource)
+{
+	toy::statistics_resource stats(toy::new_delete_resource());
+	toy::unsynchronized_pool_resource pool(&stats);
+
+	void* a = pool.allocate(24);
+	void* b = pool.allocate(24);
+	ASSERT_EQ(true, a != b);
+	pool.deallocate(a, 24);
+	ASSERT_EQ(a, pool.allocate(24));	// back from the free list
+
+	void* big = pool.allocate(100000, 64);
+	ASSERT_EQ(0, reinterpret_cast<uintptr_t>(big) % 64);
+	pool.deallocate(big, 100000, 64);
+
+	size_t chunks = stats.allocations() - 1;
+	ASSERT_EQ(true, stats.bytes_in_use() > 0);
+	ASSERT_EQ(true, stats.peak_bytes() >= 100000);
+
+	pool.release();
+	ASSERT_EQ(0, stats.bytes_in_use());
+	ASSERT_EQ(chunks + 1, stats.deallocations());
+
+	// blocks above the largest pool still in use go back on release too
+	void* large[3];
+	for (void*& p : large)
+		p = pool.allocate(10000, 128);
+	ASSERT_EQ(0, reinterpret_cast<uintptr_t>(large[1]) % 128);
+	pool.deallocate(large[1], 10000, 128);
+	pool.release();
+	ASSERT_EQ(0, stats.bytes_in_use());
+	ASSERT_EQ(stats.allocations(), stats.deallocations());
+
+	ASSERT_THROW(toy::null_memory_resource()->allocate(1), std::bad_alloc);
+}
+
+TEST(memory_test, polymorphic_allocator)
+{
+	using int_vector = std::vector<int, toy::polymorphic_allocator<int>>;
+	using value_type = std::pair<const int, int_vector>;
+	using vector_map = std::map<int, int_vector, std::less<int>, toy::polymorphic_allocator<value_type>>;
+
+	alignas(std::max_align_t) char buffer[1024];
+	toy::monotonic_buffer_resource arena(buffer, sizeof(buffer));
+	toy::statistics_resource stats(&arena);
+
+	// one container type, the resource is picked at runtime
+	for (toy::memory_resource* resource : { toy::new_delete_resource(), static_cast<toy::memory_resource*>(&stats) })
+	{
+		vector_map m(resource);
+		m[1].push_back(1);
+		m.emplace(2, int_vector{ 2, 3 });
+		m.emplace(std::piecewise_construct, std::forward_as_tuple(3), std::forward_as_tuple(4, 5));
+
+		// the nested vectors got the allocator of the map
+		for (auto& kv : m)
+			ASSERT_EQ(resource, kv.second.get_allocator().get_resource());
+		ASSERT_EQ(4, m[3].size());
+
+		// a copy goes back to the default resource
+		vector_map copy(m);
+		ASSERT_EQ(toy::get_default_resource(), copy.get_allocator().get_resource());
+	}
+
+	ASSERT_EQ(true, stats.allocations() > 3);
+	ASSERT_EQ(true, arena.get_arena().owns(buffer));
+
+	toy::polymorphic_allocator<int> alloc(&stats);
+	int_vector* v = alloc.new_object<int_vector>(3, 7);
+	ASSERT_EQ(&stats, v->get_allocator().get_resource());
+	ASSERT_EQ(21, std::accumulate(v->begin(), v->end(), 0));
+	alloc.delete_object(v);
+
+	// toy::pair members get the allocator too
+	using vector_pair = toy::pair<int_vector, int>;
+	vector_pair* p = alloc.new_object<vector_pair>(int_vector{ 1, 2 }, 3);
+	ASSERT_EQ(&stats, p->first.get_allocator().get_resource());
+	ASSERT_EQ(2, p->first.size());
+	alloc.delete_object(p);
+
+	p = alloc.new_object<vector_pair>(std::piecewise_construct, std::forward_as_tuple(4, 1), std::forward_as_tuple(5));
+	ASSERT_EQ(&stats, p->first.get_allocator().get_resource());
+	ASSERT_EQ(4, p->first.size());
+	ASSERT_EQ(5, p->second);
+	alloc.delete_object(p);
+}
+
 // -----------------------------------------------------------------------------
 
 GTEST_API_ int main(int argc, char **argv)
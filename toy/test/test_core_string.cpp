@@ -0,0 +1,293 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+
+#include <gtest/gtest.h>
+
+#include "toy/core/cord.h"
+#include "toy/core/memory_resource.h"
+#include "toy/core/string.h"
+#include "toy/core/string_view.h"
+#include "toy/core/vector.h"
+#include "toy/io/stream.h"
+
+// using namespace toy;
+
+// test string_view ------------------------------------------------------------
+
+TEST(string_view_test, find)
+{
+	// long enough for the SIMD loops and their scalar tails
+	std::string text;
+	for (int i = 0; i < 100; ++i)
+		text += "abcdefghij";
+	text += "needle in a haystack";
+
+	toy::string_view v(text);
+	ASSERT_EQ(1000, v.find("needle"));
+	ASSERT_EQ(1000, v.find('n'));
+	ASSERT_EQ(1019, v.rfind('k'));
+	ASSERT_EQ(1015, v.rfind("stack"));
+	ASSERT_EQ(990, v.rfind("abc"));
+	ASSERT_EQ(toy::string_view::npos, v.find("needles"));
+	ASSERT_EQ(toy::string_view::npos, v.find('z'));
+	ASSERT_EQ(5, v.find("", 5));
+	ASSERT_EQ(toy::string_view::npos, v.find("ab", 991));
+
+	for (size_t pos = 0; pos < text.size(); pos += 7)
+	{	// against std::string on every alignment
+		ASSERT_EQ(text.find("hij", pos), v.find("hij", pos));
+		ASSERT_EQ(text.find('e', pos), v.find('e', pos));
+		ASSERT_EQ(text.rfind('c', pos), v.rfind('c', pos));
+		ASSERT_EQ(text.rfind("jab", pos), v.rfind("jab", pos));
+	}
+
+	ASSERT_EQ(true, v.starts_with("abc"));
+	ASSERT_EQ(true, v.ends_with("stack"));
+	ASSERT_EQ(true, v.contains("in a"));
+	ASSERT_EQ("haystack", v.substr(1012));
+	ASSERT_EQ(1006, v.find_first_of("xyz ", 990));
+	ASSERT_EQ(toy::string_view::npos, toy::string_view("  \t").find_first_not_of(" \t"));
+
+	ASSERT_EQ("a b", toy::trim("\t  a b \t"));
+	ASSERT_EQ(true, toy::trim(" \t ").empty());
+}
+
+// test string -----------------------------------------------------------------
+
+TEST(string_test, small_string)
+{
+	ASSERT_EQ(24, sizeof(toy::string));
+	ASSERT_EQ(23, toy::string::sso_capacity);
+
+	toy::string a;
+	ASSERT_EQ(true, a.empty());
+	ASSERT_STREQ("", a.c_str());
+
+	toy::string b("12345678901234567890123");	// 23 chars, still inline
+	ASSERT_EQ(23, b.size());
+	ASSERT_EQ(23, b.capacity());
+	ASSERT_EQ(0, b.c_str()[23]);
+	ASSERT_EQ(true, reinterpret_cast<const char*>(&b) == b.data());
+
+	b.push_back('4');		// now on the heap
+	ASSERT_EQ(24, b.size());
+	ASSERT_LE(24, b.capacity());
+	ASSERT_EQ("123456789012345678901234", b);
+
+	b.resize(3);
+	b.shrink_to_fit();		// back inline
+	ASSERT_EQ(23, b.capacity());
+	ASSERT_EQ("123", b);
+
+	toy::string c = b;
+	ASSERT_EQ(b, c);
+	toy::string d = toy::move(b);
+	ASSERT_EQ("123", d);
+	ASSERT_EQ(true, b.empty());
+}
+
+TEST(string_test, modifiers)
+{
+	toy::string s("hello");
+	s += ", ";
+	s += toy::string_view("world");
+	s.append(3, '!');
+	ASSERT_EQ("hello, world!!!", s);
+
+	s.append(s);			// appends a copy of itself, through a reallocation
+	ASSERT_EQ("hello, world!!!hello, world!!!", s);
+
+	toy::string long_string(46, 'x');	// on the heap, full
+	long_string.append(long_string.begin(), long_string.end());	// its own iterators, through a reallocation
+	ASSERT_EQ(toy::string(92, 'x'), long_string);
+	toy::string short_string("abc");
+	short_string.append(short_string.begin(), short_string.end());
+	ASSERT_EQ("abcabc", short_string);
+
+	s.erase(15);
+	s.insert(0, "> ");
+	ASSERT_EQ("> hello, world!!!", s);
+
+	s.replace(2, 5, "goodbye");
+	ASSERT_EQ("> goodbye, world!!!", s);
+	s.replace(0, 2, toy::string_view(s).substr(2, 7));	// a part of itself
+	ASSERT_EQ("goodbyegoodbye, world!!!", s);
+
+	s.erase(s.begin() + 7, s.end());
+	ASSERT_EQ("goodbye", s);
+	ASSERT_EQ("bye", s.substr(4));
+	ASSERT_EQ(4, s.find("bye"));
+	ASSERT_EQ(6, s.rfind('e'));
+
+	toy::string t = s + " " + "world" + '!';
+	ASSERT_EQ("goodbye world!", t);
+	ASSERT_EQ(true, "a" < t);
+	ASSERT_EQ(true, t > toy::string_view("goodbye"));
+
+	std::string std_string("std");
+	toy::string from_std(std_string);
+	ASSERT_EQ(std_string, std::string(from_std.data(), from_std.size()));
+
+	std::unordered_set<toy::string> set{ "one", "two", "three" };
+	ASSERT_EQ(1, set.count("two"));
+	ASSERT_EQ(std::hash<toy::string_view>()("three"), std::hash<toy::string>()("three"));
+}
+
+TEST(string_test, in_containers)
+{
+	ASSERT_EQ(true, toy::is_trivially_relocatable<toy::string>::value);
+
+	toy::vector<toy::string> v;
+	for (int i = 0; i < 1000; ++i)
+		v.emplace_back(static_cast<size_t>(i % 40), static_cast<char>('a' + i % 26));
+	v.erase(v.begin(), v.begin() + 500);
+	for (int i = 500; i < 1000; ++i)
+		ASSERT_EQ(toy::string(i % 40, static_cast<char>('a' + i % 26)), v[i - 500]);
+
+	toy::monotonic_buffer_resource resource;
+	toy::basic_string<char, std::char_traits<char>, toy::polymorphic_allocator<char>> p(
+		"a string longer than the inline buffer", &resource);
+	p.append(p);
+	ASSERT_EQ(&resource, p.get_allocator().get_resource());
+	ASSERT_EQ(76, p.size());
+}
+
+// test cord -------------------------------------------------------------------
+
+TEST(cord_test, edit)
+{
+	toy::cord c("hello");
+	c += ", ";
+	c += toy::cord("world");
+	ASSERT_EQ("hello, world", c);
+	ASSERT_EQ(12, c.size());
+	ASSERT_EQ('w', c[7]);
+
+	std::string big(1000, 'b');
+	c.insert(5, toy::string_view(big));
+	ASSERT_EQ("hello" + big + ", world", c.flatten().c_str());
+	c.erase(5, 1000);
+	ASSERT_EQ("hello, world", c);
+
+	toy::cord part = c.substr(7, 5);
+	ASSERT_EQ("world", part);
+	ASSERT_EQ(true, c < part);
+	ASSERT_EQ(true, c.substr(0, 5) == toy::cord("hello"));
+
+	c.append(c);		// shares its own tree
+	ASSERT_EQ("hello, worldhello, world", c);
+
+	std::ostringstream os;
+	os << c;
+	ASSERT_EQ("hello, worldhello, world", os.str());
+
+	toy::cord empty;
+	ASSERT_EQ(true, empty.empty());
+	ASSERT_EQ(true, empty.chunks().begin() == empty.chunks().end());
+	ASSERT_EQ(0, empty.substr(0).size());
+}
+
+TEST(cord_test, balance)
+{
+	// reference edits on a std::string, the cord must stay balanced
+	std::string expected;
+	toy::cord c;
+	size_t leaves = 0;
+	for (int i = 0; i < 3000; ++i)
+	{
+		std::string piece(300 + i % 100, static_cast<char>('a' + i % 26));
+		size_t pos = (static_cast<size_t>(i) * 7919) % (expected.size() + 1);
+		switch (i % 4)
+		{
+		case 0: expected.append(piece); c.append(toy::string_view(piece)); break;
+		case 1: expected.insert(0, piece); c.prepend(toy::string_view(piece)); break;
+		case 2: expected.insert(pos, piece); c.insert(pos, toy::string_view(piece)); break;
+		case 3: expected.erase(pos, 200); c.erase(pos, 200); break;
+		}
+	}
+
+	for (toy::string_view chunk : c.chunks())
+	{
+		ASSERT_EQ(false, chunk.empty());
+		++leaves;
+	}
+	ASSERT_EQ(expected.size(), c.size());
+	ASSERT_EQ(0, c.compare(toy::string_view(expected)));
+	ASSERT_GE(1.45 * std::log2(leaves + 2.0), static_cast<double>(c.height()));
+
+	for (size_t pos = 0; pos < expected.size(); pos += 997)
+		ASSERT_EQ(expected[pos], c[pos]);
+
+	// short fragments are merged into the last leaf
+	toy::cord fragments;
+	for (int i = 0; i < 10000; ++i)
+		fragments.append("0123456789");
+	ASSERT_EQ(100000, fragments.size());
+	ASSERT_GE(100000 / 250, std::distance(fragments.chunks().begin(), fragments.chunks().end()));
+}
+
+TEST(cord_test, DISABLED_benchmark_cord)
+{
+	std::string fragment(100, 'x');
+	auto start = std::chrono::steady_clock::now();
+	toy::cord c;
+	for (int i = 0; i < 30000; ++i)
+		c.insert(c.size() / 2, toy::string_view(fragment));	// in the middle
+	double cord_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	std::string s;
+	for (int i = 0; i < 30000; ++i)
+		s.insert(s.size() / 2, fragment);
+	double string_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::printf("insert in the middle  cord %8.2f ms  std::string %8.2f ms  height %d\n",
+		cord_ms, string_ms, static_cast<int>(c.height()));
+	ASSERT_EQ(s.size(), c.size());
+}
+
+// benchmark -------------------------------------------------------------------
+
+TEST(string_test, DISABLED_benchmark_string)
+{
+	std::string text(1 << 20, 'x');
+	text += "needle";
+
+	auto time = [](auto&& f)
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t result = 0;
+		for (int i = 0; i < 200; ++i)
+			result += f();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return std::make_pair(ms, result);
+	};
+
+	toy::string_view v(text);
+	auto a = time([&]() { return v.find("needle"); });
+	auto b = time([&]() { return text.find("needle"); });
+	std::printf("find    toy %8.2f ms  std %8.2f ms\n", a.first, b.first);
+	ASSERT_EQ(a.second, b.second);
+
+	// the first char of the needle everywhere, a memchr of it stops at every byte
+	std::string noisy(1 << 20, 'n');
+	noisy += "needle";
+	toy::string_view w(noisy);
+	a = time([&]() { return w.find("needle"); });
+	b = time([&]() { return noisy.find("needle"); });
+	std::printf("noisy   toy %8.2f ms  std %8.2f ms\n", a.first, b.first);
+	ASSERT_EQ(a.second, b.second);
+
+	auto c = time([&]() { toy::string s; for (int i = 0; i < 10000; ++i) s.append("0123456789", 10); return s.size(); });
+	auto d = time([&]() { std::string s; for (int i = 0; i < 10000; ++i) s.append("0123456789", 10); return s.size(); });
+	std::printf("append  toy %8.2f ms  std %8.2f ms\n", c.first, d.first);
+
+	auto e = time([&]() { size_t n = 0; for (int i = 0; i < 10000; ++i) { toy::string s("short string"); toy::string t = s; n += t.size(); } return n; });
+	auto f = time([&]() { size_t n = 0; for (int i = 0; i < 10000; ++i) { std::string s("short string"); std::string t = s; n += t.size(); } return n; });
+	std::printf("copy    toy %8.2f ms  std %8.2f ms\n", e.first, f.first);
+}
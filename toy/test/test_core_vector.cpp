@@ -1,6 +1,22 @@
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include <gtest/gtest.h>
 
+#include "toy/core/circular_buffer.h"
 #include "toy/core/initializer_list.h"
+#include "toy/core/memory_resource.h"
+#include "toy/core/slot_map.h"
+#include "toy/core/soa_vector.h"
+#include "toy/core/span.h"
+#include "toy/core/vector.h"
 
 // using namespace toy; 
 
@@ -18,4 +34,570 @@ TEST(initializer_list_test, empty_vector)
 
 	ASSERT_EQ(nullptr, begin(il));
 	ASSERT_EQ(nullptr, end(il));
-}
\ No newline at end of file
+}
+
+// test relocate ---------------------------------------------------------------
+
+namespace
+{
+
+struct tracked
+{	// counts the moves and destructions that relocation saves
+	explicit tracked(int value) : value(value) {}
+	tracked(const tracked& x) : value(x.value) { ++copies; }
+	tracked(tracked&& x) noexcept : value(x.value) { ++moves; }
+	tracked& operator=(const tracked& x) { value = x.value; ++copies; return *this; }
+	tracked& operator=(tracked&& x) noexcept { value = x.value; ++moves; return *this; }
+	~tracked() { ++destroys; }
+
+	int value;
+
+	static int copies, moves, destroys;
+	static void reset() { copies = moves = destroys = 0; }
+};
+
+int tracked::copies = 0, tracked::moves = 0, tracked::destroys = 0;
+
+struct relocatable_tracked : tracked
+{
+	using tracked::tracked;
+	using is_trivially_relocatable = toy::true_type;
+};
+
+}	// namespace
+
+TEST(type_traits_test, is_trivially_relocatable)
+{
+	ASSERT_EQ(true, toy::is_trivially_relocatable_v<int>);
+	ASSERT_EQ(true, toy::is_trivially_relocatable_v<toy::unique_ptr<int>>);
+	ASSERT_EQ(true, toy::is_trivially_relocatable_v<toy::shared_ptr<int>>);
+	ASSERT_EQ(true, (toy::is_trivially_relocatable_v<toy::pair<int, toy::unique_ptr<int>>>));
+	ASSERT_EQ(true, toy::is_trivially_relocatable_v<toy::vector<toy::unique_ptr<int>>>);
+	ASSERT_EQ(true, toy::is_trivially_relocatable_v<relocatable_tracked>);
+	ASSERT_EQ(false, toy::is_trivially_relocatable_v<tracked>);
+}
+
+TEST(memory_test, relocate)
+{
+	alignas(tracked) unsigned char buffer[sizeof(tracked) * 4];
+	tracked* p = reinterpret_cast<tracked*>(buffer);
+	for (int i = 0; i < 3; ++i)
+		::new (p + i) tracked(i);
+
+	// shift right by one slot, overlapping
+	tracked::reset();
+	toy::uninitialized_relocate_backward(p, p + 3, p + 4);
+	ASSERT_EQ(3, tracked::moves);
+	ASSERT_EQ(3, tracked::destroys);
+	ASSERT_EQ(2, p[3].value);
+
+	relocatable_tracked* q = reinterpret_cast<relocatable_tracked*>(buffer);
+	tracked::reset();
+	toy::uninitialized_relocate(q + 1, q + 4, q);
+	ASSERT_EQ(0, tracked::moves + tracked::destroys);	// a memmove
+	ASSERT_EQ(0, q[0].value);
+	ASSERT_EQ(2, q[2].value);
+
+	for (int i = 0; i < 3; ++i)
+		q[i].~relocatable_tracked();
+}
+
+// test vector -----------------------------------------------------------------
+
+TEST(vector_test, basic)
+{
+	toy::vector<int> v{ 1, 2, 3 };
+	v.push_back(4);
+	v.insert(v.begin(), 0);
+	v.insert(v.begin() + 2, 2, 9);
+	ASSERT_EQ((toy::vector<int>{ 0, 1, 9, 9, 2, 3, 4 }), v);
+
+	v.erase(v.begin() + 2, v.begin() + 4);
+	v.erase(v.begin());
+	ASSERT_EQ((toy::vector<int>{ 1, 2, 3, 4 }), v);
+
+	int more[] = { 5, 6 };
+	v.insert(v.end(), more, more + 2);
+	v.resize(8, 7);
+	ASSERT_EQ((toy::vector<int>{ 1, 2, 3, 4, 5, 6, 7, 7 }), v);
+	ASSERT_THROW(v.at(8), std::out_of_range);
+
+	toy::vector<int> w = v;
+	v.clear();
+	v.shrink_to_fit();
+	ASSERT_EQ(0, v.capacity());
+	ASSERT_EQ(8, w.size());
+
+	v = toy::move(w);
+	ASSERT_EQ(8, v.size());
+	ASSERT_EQ(true, w.empty());
+
+	// the inserted value may be an element
+	v.insert(v.begin(), v.back());
+	v.insert(v.begin(), 3, v[1]);
+	ASSERT_EQ((toy::vector<int>{ 1, 1, 1, 7, 1, 2 }), toy::vector<int>(v.begin(), v.begin() + 6));
+}
+
+TEST(vector_test, strings)
+{	// not trivially relocatable in every standard library
+	toy::vector<std::string> v;
+	for (int i = 0; i < 100; ++i)
+		v.emplace_back(std::to_string(i));
+	v.emplace(v.begin() + 50, "x");
+	v.erase(v.begin());
+
+	ASSERT_EQ(100, v.size());
+	ASSERT_EQ("x", v[49]);
+	ASSERT_EQ("99", v.back());
+
+	toy::vector<std::string> w(v.begin(), v.begin() + 3);
+	w.insert(w.begin() + 1, v.begin(), v.begin() + 2);
+	ASSERT_EQ((toy::vector<std::string>{ "1", "1", "2", "2", "3" }), w);
+}
+
+TEST(vector_test, relocation)
+{
+	toy::vector<relocatable_tracked> r;
+	toy::vector<tracked> t;
+	tracked::reset();
+	for (int i = 0; i < 1000; ++i)
+		r.emplace_back(i);
+	r.erase(r.begin());
+	r.emplace(r.begin(), 0);
+
+	// growth, erase and insert never touch the other elements
+	ASSERT_EQ(0, tracked::moves);
+	ASSERT_EQ(1, tracked::destroys);
+
+	tracked::reset();
+	for (int i = 0; i < 1000; ++i)
+		t.emplace_back(i);
+	ASSERT_LT(1000, tracked::moves);
+
+	toy::vector<toy::unique_ptr<int>> u;
+	for (int i = 0; i < 100; ++i)
+		u.push_back(toy::make_unique<int>(i));
+	u.erase(u.begin() + 10, u.begin() + 20);
+	u.insert(u.begin(), toy::make_unique<int>(-1));
+	ASSERT_EQ(91, u.size());
+	ASSERT_EQ(-1, *u[0]);
+	ASSERT_EQ(20, *u[11]);
+}
+
+struct throwing_move
+{	// move only, the move constructor throws when moves_until_throw gets to 0
+	static int moves_until_throw;
+	static int live;
+
+	std::unique_ptr<int> value;
+
+	explicit throwing_move(int v) : value(std::make_unique<int>(v)) { ++live; }
+	throwing_move(throwing_move&& right) : value(std::move(right.value))
+	{
+		if (moves_until_throw >= 0 && moves_until_throw-- == 0)
+		{
+			right.value = std::move(value);
+			throw std::runtime_error("throwing_move");
+		}
+		++live;
+	}
+	throwing_move& operator=(throwing_move&&) = default;
+	~throwing_move() { --live; }
+};
+
+int throwing_move::moves_until_throw = -1;
+int throwing_move::live = 0;
+
+TEST(vector_test, throwing_move)
+{	// a failed growth leaves every element alive in the old storage
+	{
+		toy::vector<throwing_move> v;
+		v.reserve(4);
+		for (int i = 0; i < 4; ++i)
+			v.emplace_back(i);
+
+		// the third move is after pos, the first two went before it
+		throwing_move::moves_until_throw = 2;
+		ASSERT_THROW(v.emplace(v.begin() + 2, 99), std::runtime_error);
+		throwing_move::moves_until_throw = -1;
+		ASSERT_EQ(4, v.size());
+		ASSERT_EQ(4, throwing_move::live);
+
+		throwing_move::moves_until_throw = 0;
+		ASSERT_THROW(v.emplace(v.begin() + 2, 99), std::runtime_error);
+		throwing_move::moves_until_throw = -1;
+		ASSERT_EQ(4, v.size());
+		ASSERT_EQ(4, throwing_move::live);
+
+		v.emplace(v.begin() + 2, 99);
+		ASSERT_EQ(5, v.size());
+		ASSERT_EQ(99, *v[2].value);
+		ASSERT_EQ(3, *v[4].value);
+	}
+	ASSERT_EQ(0, throwing_move::live);
+}
+
+TEST(vector_test, polymorphic_allocator)
+{
+	using string_vector = toy::vector<std::string, toy::polymorphic_allocator<std::string>>;
+
+	toy::statistics_resource stats(toy::new_delete_resource());
+	toy::vector<string_vector, toy::polymorphic_allocator<string_vector>> v(&stats);
+	v.emplace_back(3, "x");
+	v.emplace_back().push_back("y");
+
+	ASSERT_EQ(&stats, v[0].get_allocator().get_resource());
+	ASSERT_EQ(&stats, v[1].get_allocator().get_resource());
+	ASSERT_EQ(3, v[0].size());
+	ASSERT_EQ(true, stats.allocations() >= 3);
+}
+
+// test slot_map ---------------------------------------------------------------
+
+TEST(slot_map_test, basic)
+{
+	toy::slot_map<std::string> map;
+	std::vector<toy::slot_map_key> keys;
+	for (int i = 0; i < 100; ++i)
+		keys.push_back(map.insert(std::to_string(i)));
+	ASSERT_EQ(100, map.size());
+	ASSERT_EQ("42", map[keys[42]]);
+	ASSERT_EQ("7", map.at(keys[7]));
+
+	// erase every third, the others keep their keys
+	for (int i = 0; i < 100; i += 3)
+		ASSERT_EQ(true, map.erase(keys[i]));
+	ASSERT_EQ(66, map.size());
+	for (int i = 0; i < 100; ++i)
+	{
+		ASSERT_EQ(i % 3 != 0, map.contains(keys[i]));
+		if (i % 3 != 0)
+		{
+			ASSERT_EQ(std::to_string(i), *map.find(keys[i]));
+		}
+	}
+
+	// stale keys stay stale when their slots are reused
+	ASSERT_EQ(false, map.erase(keys[0]));
+	ASSERT_EQ(nullptr, map.find(keys[3]));
+	ASSERT_THROW(map.at(keys[6]), std::out_of_range);
+	toy::slot_map_key reused = map.emplace(3, 'x');
+	ASSERT_EQ(keys[99].index, reused.index);
+	ASSERT_NE(keys[99].generation, reused.generation);
+	ASSERT_EQ(nullptr, map.find(keys[99]));
+	ASSERT_EQ("xxx", map[reused]);
+
+	ASSERT_EQ(false, map.contains(toy::slot_map_key()));
+	ASSERT_EQ(true, toy::slot_map_key().is_null());
+	ASSERT_EQ(reused, toy::slot_map_key::from_integer(reused.to_integer()));
+
+	// the dense values and their keys
+	size_t visited = 0;
+	for (auto it = map.begin(); it != map.end(); ++it, ++visited)
+		ASSERT_EQ(&*it, map.find(map.key_of(it)));
+	ASSERT_EQ(map.size(), visited);
+
+	// erase while iterating
+	for (auto it = map.begin(); it != map.end();)
+	{
+		if (it->size() % 2 == 0)
+			it = map.erase(it);
+		else
+			++it;
+	}
+	for (const std::string& s : map)
+		ASSERT_EQ(1, s.size() % 2);
+
+	map.clear();
+	ASSERT_EQ(true, map.empty());
+	ASSERT_EQ(false, map.contains(reused));
+	ASSERT_EQ(false, map.contains(keys[1]));
+}
+
+TEST(slot_map_test, DISABLED_benchmark_slot_map)
+{
+	const int n = 1000000;
+	toy::slot_map<uint64_t> map;
+	std::unordered_map<uint64_t, uint64_t> hash_map;
+	std::vector<toy::slot_map_key> keys;
+	for (int i = 0; i < n; ++i)
+	{
+		keys.push_back(map.insert(i));
+		hash_map.emplace(i, i);
+	}
+	for (int i = 0; i < n; i += 2)
+	{
+		map.erase(keys[i]);
+		hash_map.erase(i);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	uint64_t sum = 0;
+	for (int round = 0; round < 20; ++round)
+		for (uint64_t value : map)
+			sum += value;
+	double slot_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	uint64_t hash_sum = 0;
+	for (int round = 0; round < 20; ++round)
+		for (const auto& entry : hash_map)
+			hash_sum += entry.second;
+	double hash_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::printf("iterate 20 x 500K  slot_map %8.2f ms  unordered_map %8.2f ms\n", slot_ms, hash_ms);
+	ASSERT_EQ(hash_sum, sum);
+}
+
+// test span -------------------------------------------------------------------
+
+TEST(span_test, basic)
+{
+	int arr[] = { 1, 2, 3, 4, 5 };
+	toy::span<int, 5> fixed(arr);
+	ASSERT_EQ(sizeof(int*), sizeof(fixed));
+	ASSERT_EQ(5, fixed.size());
+
+	toy::vector<int> v = { 1, 2, 3 };
+	toy::span<int> dynamic = v;
+	toy::span<const int> view = dynamic;
+	ASSERT_EQ(3, view.size());
+	ASSERT_EQ(6, std::accumulate(view.begin(), view.end(), 0));
+	ASSERT_EQ(3, view.back());
+	ASSERT_EQ(2, fixed.subspan(1, 2).front());
+	ASSERT_EQ(4, fixed.last(2)[0]);
+	ASSERT_EQ(2, (fixed.first<2>().size()));
+	ASSERT_EQ(5 * sizeof(int), toy::as_bytes(fixed).size());
+	ASSERT_THROW(view.at(3), std::out_of_range);
+}
+
+// test soa_vector -------------------------------------------------------------
+
+TEST(soa_vector_test, basic)
+{
+	toy::soa_vector<float, double, std::string> v;
+	for (int i = 0; i < 100; ++i)
+		v.push_back(float(i), i * 0.5, std::to_string(i));
+	ASSERT_EQ(100, v.size());
+
+	auto [f, d, s] = v[42];
+	ASSERT_EQ(42.f, f);
+	ASSERT_EQ(21.0, d);
+	ASSERT_EQ("42", s);
+	std::get<2>(v[42]) = "answer";
+	ASSERT_EQ("answer", std::get<2>(v.at(42)));
+
+	// each column is aligned and dense
+	ASSERT_EQ(0, reinterpret_cast<uintptr_t>(v.data<0>()) % 64);
+	ASSERT_EQ(0, reinterpret_cast<uintptr_t>(v.data<1>()) % 64);
+	ASSERT_EQ(0, reinterpret_cast<uintptr_t>(v.data<2>()) % 64);
+	float sum = 0;
+	for (float x : v.column<0>())
+		sum += x;
+	ASSERT_EQ(4950.f, sum);
+	for (double& x : v.column<1>())
+		x *= 2;
+	ASSERT_EQ(99.0, std::get<1>(v.back()));
+
+	// rows as values
+	v[0] = std::make_tuple(-1.f, -1.0, std::string("first"));
+	ASSERT_EQ("first", std::get<2>(v.front()));
+	std::tuple<float, double, std::string> row = *v.begin();
+	ASSERT_EQ(-1.f, std::get<0>(row));
+
+	toy::soa_vector<float, double, std::string> copy = v;
+	v.erase(v.begin() + 1);
+	ASSERT_EQ(99, v.size());
+	ASSERT_EQ("2", std::get<2>(v[1]));
+	v.swap_erase(1);
+	ASSERT_EQ("99", std::get<2>(v[1]));
+	ASSERT_EQ(98, v.size());
+	ASSERT_EQ(100, copy.size());
+	ASSERT_EQ("1", std::get<2>(copy[1]));
+
+	v.resize(200, 1.f, 2.0, "x");
+	ASSERT_EQ("x", std::get<2>(v[150]));
+	v.resize(10);
+	ASSERT_EQ(10, v.end() - v.begin());
+	v.shrink_to_fit();
+	ASSERT_EQ(10, v.capacity());
+	ASSERT_EQ("first", std::get<2>(v[0]));
+
+	// a row of its own while full, the copy is made before the columns move
+	v.push_back(std::get<0>(v[0]), std::get<1>(v[0]), std::get<2>(v[0]));
+	ASSERT_EQ(11, v.size());
+	ASSERT_EQ(-1.f, std::get<0>(v[10]));
+	ASSERT_EQ("first", std::get<2>(v[10]));
+	ASSERT_EQ("first", std::get<2>(v[0]));
+
+	toy::soa_vector<float, double, std::string> moved = toy::move(v);
+	ASSERT_EQ(true, v.empty());
+	ASSERT_EQ(11, moved.size());
+	moved.clear();
+	ASSERT_EQ(true, moved.empty());
+
+	toy::soa_vector<int, char> zeros(1000);
+	ASSERT_EQ(0, std::accumulate(zeros.column<0>().begin(), zeros.column<0>().end(), 0));
+	ASSERT_THROW(zeros.at(1000), std::out_of_range);
+}
+
+TEST(soa_vector_test, DISABLED_benchmark_soa_vector)
+{
+	struct particle { float x, y, z, vx, vy, vz, mass; int id; };
+	const size_t n = 1 << 22;
+	std::vector<particle> aos(n);
+	toy::soa_vector<float, float, float, float, float, float, float, int> soa(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		aos[i] = particle{ float(i), 0, 0, 1, 0, 0, 1, int(i) };
+		soa[i] = std::make_tuple(float(i), 0.f, 0.f, 1.f, 0.f, 0.f, 1.f, int(i));
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (int round = 0; round < 10; ++round)
+		for (particle& p : aos)
+			p.x += p.vx * 0.01f;
+	double aos_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	for (int round = 0; round < 10; ++round)
+	{
+		float* x = soa.data<0>();
+		const float* vx = soa.data<3>();
+		for (size_t i = 0; i < n; ++i)
+			x[i] += vx[i] * 0.01f;
+	}
+	double soa_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::printf("x += vx * dt over 4M particles x 10  array of structs %8.2f ms  soa_vector %8.2f ms\n", aos_ms, soa_ms);
+	ASSERT_EQ(aos[n - 1].x, std::get<0>(soa[n - 1]));
+}
+
+// test circular_buffer --------------------------------------------------------
+
+TEST(circular_buffer_test, basic)
+{
+	toy::circular_buffer<int> window(5);
+	ASSERT_EQ(8, window.capacity());
+	ASSERT_EQ(true, window.empty());
+
+	for (int i = 0; i < 20; ++i)
+		window.push_back(i);
+	ASSERT_EQ(true, window.full());
+	ASSERT_EQ(12, window.front());
+	ASSERT_EQ(19, window.back());
+	ASSERT_EQ(false, window.try_push_back(20));
+	ASSERT_EQ(15, window[3]);
+	ASSERT_EQ(12 + 19, *window.begin() + *window.rbegin());
+	ASSERT_EQ(8, window.end() - window.begin());
+
+	// the two runs, the second wrapped to the start of the buffer
+	window.pop_front();
+	window.pop_front();
+	window.push_back(20);
+	auto spans = window.as_spans();
+	ASSERT_EQ(7, spans.first.size() + spans.second.size());
+	std::vector<int> joined(spans.first.begin(), spans.first.end());
+	joined.insert(joined.end(), spans.second.begin(), spans.second.end());
+	ASSERT_EQ((std::vector<int>{ 14, 15, 16, 17, 18, 19, 20 }), joined);
+	ASSERT_EQ(true, window.try_push_back(21));
+	ASSERT_EQ(true, window.full());
+
+	// bulk append keeps the newest capacity() values
+	int values[20];
+	std::iota(values, values + 20, 100);
+	window.append(values, 3);
+	ASSERT_EQ(17, window.front());
+	ASSERT_EQ(102, window.back());
+	window.append(values, 20);
+	ASSERT_EQ(112, window.front());
+	ASSERT_EQ(119, window.back());
+	ASSERT_EQ(8, window.size());
+
+	window.pop_back();
+	ASSERT_EQ(118, window.back());
+	ASSERT_THROW(window.at(7), std::out_of_range);
+	window.clear();
+	ASSERT_EQ(true, window.empty());
+	ASSERT_EQ(true, window.as_spans().first.empty());
+}
+
+TEST(circular_buffer_test, strings)
+{
+	toy::circular_buffer<std::string> lines(3);
+	ASSERT_EQ(4, lines.capacity());
+	for (int i = 0; i < 10; ++i)
+		lines.emplace_back(40, char('a' + i));
+	ASSERT_EQ(std::string(40, 'g'), lines.front());
+
+	toy::circular_buffer<std::string> copy = lines;
+	lines.push_back("new");
+	ASSERT_EQ(std::string(40, 'g'), copy.front());
+	ASSERT_EQ(std::string(40, 'h'), lines.front());
+
+	// full, the oldest element pushed again: it is copied before it is overwritten
+	lines.push_back(lines.front());
+	ASSERT_EQ(4, lines.size());
+	ASSERT_EQ(std::string(40, 'h'), lines.back());
+	ASSERT_EQ(std::string(40, 'i'), lines.front());
+
+	const std::string more[] = { "x", "y" };
+	copy.append(more, 2);
+	ASSERT_EQ("y", copy.back());
+	ASSERT_EQ(std::string(40, 'i'), copy.front());
+
+	toy::circular_buffer<std::string> moved = toy::move(copy);
+	ASSERT_EQ(4, moved.size());
+	ASSERT_EQ(0, copy.size());
+	copy = moved;
+	ASSERT_EQ(4, copy.size());
+	ASSERT_EQ("y", copy.back());
+
+	// its own elements, the front ones go before they are read
+	copy.append(&copy.front(), 2);
+	ASSERT_EQ((std::vector<std::string>{ "x", "y", std::string(40, 'i'), std::string(40, 'j') }),
+		std::vector<std::string>(copy.begin(), copy.end()));
+
+	toy::circular_buffer<int> numbers(8);
+	for (int i = 0; i < 8; ++i)
+		numbers.push_back(i);
+	numbers.append(&numbers.front(), 8);
+	for (int i = 0; i < 8; ++i)
+		ASSERT_EQ(i, numbers[i]);
+}
+
+TEST(circular_buffer_test, DISABLED_benchmark_circular_buffer)
+{
+	const int n = 50000000;
+	const size_t window_size = 1024;
+
+	auto start = std::chrono::steady_clock::now();
+	toy::circular_buffer<double> window(window_size);
+	double sum = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		if (window.full())
+			sum -= window.front();
+		window.push_back(i * 0.5);
+		sum += i * 0.5;
+	}
+	double ring_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	std::deque<double> deque;
+	double deque_sum = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		if (deque.size() == window_size)
+		{
+			deque_sum -= deque.front();
+			deque.pop_front();
+		}
+		deque.push_back(i * 0.5);
+		deque_sum += i * 0.5;
+	}
+	double deque_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::printf("sliding window of 1024 over 50M samples  circular_buffer %8.2f ms  std::deque %8.2f ms\n", ring_ms, deque_ms);
+	ASSERT_EQ(deque_sum, sum);
+}
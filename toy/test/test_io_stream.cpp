@@ -0,0 +1,139 @@
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "toy/io/stream.h"
+
+// using namespace toy;
+
+namespace
+{
+
+template<class Range>
+std::vector<std::string> collect(Range&& range)
+{
+	std::vector<std::string> result;
+	for (toy::string_view v : range)
+		result.emplace_back(v.data(), v.size());
+	return result;
+}
+
+}	// namespace
+
+// test split ------------------------------------------------------------------
+
+TEST(stream_test, split)
+{
+	using strings = std::vector<std::string>;
+
+	ASSERT_EQ((strings{ "a", "", "b", "" }), collect(toy::split("a,,b,", ',')));
+	ASSERT_EQ((strings{ "" }), collect(toy::split("", ',')));
+	ASSERT_EQ((strings{ "a", "b" }), collect(toy::tokenize("  a \t\r\n b  ")));
+	ASSERT_EQ((strings{}), collect(toy::tokenize(" \t ")));
+	ASSERT_EQ((strings{ "k", "v", "w" }), collect(toy::split("k=v;w", "=;")));
+
+	// fields across the 16 byte blocks of the SIMD search
+	std::string line;
+	strings expected;
+	for (int i = 0; i < 200; ++i)
+	{
+		expected.push_back(std::string(i % 37, 'x'));
+		line += expected.back();
+		line += i % 3 == 0 ? '\t' : (i % 3 == 1 ? ',' : '|');
+	}
+	expected.push_back("");
+	ASSERT_EQ(expected, collect(toy::split(line, "\t,|")));
+
+	// more members than the SIMD search takes
+	toy::delimiter_set large("abcdefghijklmnopqrstuvwxyz");
+	ASSERT_EQ(26, large.size());
+	ASSERT_EQ((strings{ "0", "12", "3" }), collect(toy::split("0a12z3", large)));
+
+	// no delimiter at all, the text is one field
+	ASSERT_EQ(0, toy::delimiter_set("").size());
+	ASSERT_EQ((strings{ "a,b;c d\te,f;g h\ti,j" }), collect(toy::split("a,b;c d\te,f;g h\ti,j", "")));
+	ASSERT_EQ((strings{}), collect(toy::tokenize("", "")));
+
+	ASSERT_EQ("a b", toy::trim("\t  a b \t"));
+	ASSERT_EQ("a b \t", toy::trim_left("\t  a b \t"));
+	ASSERT_EQ("\t  a b", toy::trim_right("\t  a b \t"));
+	ASSERT_EQ(true, toy::trim(" \t ").empty());
+	ASSERT_EQ("x", toy::trim("--x--", '-'));
+}
+
+// test buffered_reader --------------------------------------------------------
+
+TEST(stream_test, buffered_reader)
+{
+	std::string text;
+	for (int i = 0; i < 1000; ++i)
+		text += std::to_string(i) + ",name" + std::to_string(i) + "," + std::string(i % 50, 'v') + (i % 2 ? "\r\n" : "\n");
+	text += "last,line,without newline";
+
+	std::istringstream input(text);
+	toy::buffered_reader reader(input, 16);	// a small buffer, to refill and grow
+
+	int count = 0;
+	for (toy::string_view line : reader.lines())
+	{
+		std::vector<std::string> fields = collect(toy::split(line, ','));
+		ASSERT_EQ(3, fields.size());
+		if (count < 1000)
+		{
+			ASSERT_EQ(std::to_string(count), fields[0]);
+			ASSERT_EQ("name" + std::to_string(count), fields[1]);
+			ASSERT_EQ(std::string(count % 50, 'v'), fields[2]);
+		}
+		else
+		{
+			ASSERT_EQ("without newline", fields[2]);
+		}
+		++count;
+	}
+	ASSERT_EQ(1001, count);
+	ASSERT_EQ(true, reader.eof());
+	ASSERT_LE(64, reader.buffer_size());
+
+	std::istringstream words("alpha beta\tgamma\n\ndelta");
+	toy::buffered_reader word_reader(words);
+	std::vector<std::string> tokens;
+	for (toy::string_view word : word_reader.records(" \t\n"))
+		if (!word.empty())
+			tokens.emplace_back(word.data(), word.size());
+	ASSERT_EQ((std::vector<std::string>{ "alpha", "beta", "gamma", "delta" }), tokens);
+}
+
+// benchmark -------------------------------------------------------------------
+
+TEST(stream_test, DISABLED_benchmark_split)
+{
+	std::string text;
+	for (int i = 0; i < 200000; ++i)
+		text += "field" + std::to_string(i) + (i % 10 == 9 ? "\n" : "\t");
+
+	auto start = std::chrono::steady_clock::now();
+	size_t views = 0;
+	for (toy::string_view line : toy::split(text, '\n'))
+		for (toy::string_view field : toy::split(line, '\t'))
+			views += field.size();
+	double view_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	size_t strings = 0;
+	std::istringstream input(text);
+	std::string line, field;
+	while (std::getline(input, line))
+	{
+		std::istringstream fields(line);
+		while (std::getline(fields, field, '\t'))
+			strings += field.size();
+	}
+	double string_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::printf("split  views %8.2f ms  getline %8.2f ms\n", view_ms, string_ms);
+	ASSERT_EQ(strings, views);
+}
@@ -0,0 +1,224 @@
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "toy/utility/pool.h"
+#include "toy/utility/thread_pool.h"
+
+// using namespace toy;
+
+// test thread_pool ------------------------------------------------------------
+
+TEST(thread_pool_test, submit)
+{
+	toy::thread_pool pool(4);
+
+	auto a = pool.submit([]() { return 1 + 2; });
+	auto b = pool.submit([]() { return std::string(100, 'x'); });
+	auto c = pool.submit([]() { throw std::runtime_error("task"); });
+
+	ASSERT_EQ(3, a.get());
+	ASSERT_EQ(100, b.get().size());
+	ASSERT_THROW(c.get(), std::runtime_error);
+}
+
+TEST(thread_pool_test, aligned_task)
+{
+	struct alignas(64) block
+	{
+		float lanes[16];
+	};
+
+	toy::thread_pool pool(2);
+	std::vector<toy::task_future<bool>> futures;
+	for (int i = 0; i < 100; ++i)
+	{
+		block data{};
+		data.lanes[0] = float(i);
+		futures.push_back(pool.submit([data]() { return reinterpret_cast<uintptr_t>(&data) % 64 == 0 && data.lanes[0] >= 0; }));
+	}
+	for (auto& f : futures)
+		ASSERT_TRUE(f.get());
+}
+
+TEST(thread_pool_test, wait)
+{
+	toy::thread_pool pool(3);
+	std::atomic<int> count{ 0 };
+
+	std::vector<toy::task_future<void>> futures;
+	for (int i = 0; i < 1000; ++i)
+		futures.push_back(pool.submit([&]() { ++count; }));
+
+	pool.wait();
+	ASSERT_EQ(1000, count.load());
+	for (auto& f : futures)
+		ASSERT_EQ(true, f.ready());
+}
+
+TEST(thread_pool_test, wait_in_task)
+{	// a task waiting for the tasks it submitted, on one worker and on several
+	for (size_t threads : { 1, 3 })
+	{
+		toy::thread_pool pool(threads);
+		std::atomic<int> count{ 0 };
+
+		auto outer = pool.submit([&]()
+		{
+			for (int i = 0; i < 100; ++i)
+				pool.submit([&]()
+				{
+					pool.submit([&]() { ++count; });
+					pool.wait();	// nested, the outer task is blocked too
+					++count;
+				});
+			pool.wait();
+			return count.load();
+		});
+		ASSERT_EQ(200, outer.get());
+		pool.wait();
+	}
+}
+
+TEST(thread_pool_test, parallel_for)
+{
+	toy::thread_pool pool(4);
+	std::vector<int> v(100000);
+
+	pool.parallel_for(0, v.size(), [&](size_t i) { v[i] = static_cast<int>(i % 7); });
+
+	long long expected = 0;
+	for (size_t i = 0; i < v.size(); ++i)
+		expected += i % 7;
+	ASSERT_EQ(expected, std::accumulate(v.begin(), v.end(), 0LL));
+
+	ASSERT_THROW(pool.parallel_for(0, 100, [](size_t i)
+	{
+		if (i == 42)
+			throw std::out_of_range("42");
+	}, 1), std::out_of_range);
+}
+
+TEST(thread_pool_test, nested)
+{
+	toy::thread_pool pool(2);
+	std::atomic<long long> sum{ 0 };
+
+	pool.parallel_for(0, 16, [&](size_t i)
+	{
+		pool.parallel_for(0, 100, [&](size_t j) { sum += static_cast<long long>(i * j); }, 10);
+
+		auto inner = pool.submit([i]() { return static_cast<long long>(i); });
+		sum += inner.get();
+	}, 1);
+
+	ASSERT_EQ(120 * 4950 + 120, sum.load());
+}
+
+// test object_pool ------------------------------------------------------------
+
+namespace
+{
+
+struct message
+{
+	explicit message(int id) : id(id) { ++alive; }
+	~message() { --alive; }
+
+	int id;
+	char payload[52];
+
+	static int alive;
+};
+
+int message::alive = 0;
+
+}	// namespace
+
+TEST(object_pool_test, create_destroy)
+{
+	auto& pool = toy::object_pool<message>::global();
+
+	std::vector<message*> objects;
+	std::set<message*> unique;
+	for (int i = 0; i < 10000; ++i)
+	{
+		objects.push_back(pool.create(i));
+		unique.insert(objects.back());
+	}
+
+	ASSERT_EQ(10000, message::alive);
+	ASSERT_EQ(10000, unique.size());
+	for (int i = 0; i < 10000; ++i)
+		ASSERT_EQ(i, objects[i]->id);
+
+	for (message* m : objects)
+		pool.destroy(m);
+	ASSERT_EQ(0, message::alive);
+
+	// everything is back, the slabs can go back to the OS
+	pool.flush_local();
+	size_t slabs = pool.slab_count();
+	ASSERT_LE(1u, slabs);
+	ASSERT_EQ(slabs, pool.release_idle());
+	ASSERT_EQ(0, pool.slab_count());
+}
+
+TEST(object_pool_test, unique_ptr)
+{
+	{
+		auto p = toy::make_pooled<message>(7);
+		toy::unique_ptr<message, toy::pool_delete<message, toy::object_pool<message>>> q;
+
+		ASSERT_EQ(7, p->id);
+		ASSERT_EQ(1, message::alive);
+
+		q = toy::move(p);
+		ASSERT_EQ(false, bool(p));
+		ASSERT_EQ(7, q->id);
+	}
+	ASSERT_EQ(0, message::alive);
+}
+
+TEST(object_pool_test, cross_thread_free)
+{
+	auto& pool = toy::object_pool<message>::global();
+	toy::spsc_queue<message*> queue(256);
+	const int count = 50000;
+
+	std::thread consumer([&]()
+	{
+		message* m = nullptr;
+		for (int i = 0; i < count;)
+		{
+			if (queue.try_pop(m))
+			{
+				ASSERT_EQ(i, m->id);
+				pool.destroy(m);
+				++i;
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	for (int i = 0; i < count;)
+	{
+		message* m = pool.create(i);
+		while (!queue.try_push(m))
+			std::this_thread::yield();
+		++i;
+	}
+	consumer.join();
+
+	ASSERT_EQ(0, message::alive);
+}
@@ -5,7 +5,16 @@
 #ifndef TOY_UTILITY_BYTE_H
 #define TOY_UTILITY_BYTE_H
 
+#include <cstddef>
 #include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 namespace toy
 {
@@ -46,6 +55,127 @@ inline void block_to_byte(const block* input, byte* output, size_t length)
 	}
 }
 
+// bit manipulation ------------------------------------------------------------
+// the <bit> functions of C++20 for the unsigned types, GCC and Clang emit
+// popcnt, tzcnt and lzcnt when the target has them (-mpopcnt, -mbmi,
+// -march=...), MSVC goes through the intrinsics
+
+namespace detail
+{
+
+inline int popcount64(uint64_t x) noexcept
+{
+#if defined(_MSC_VER) && defined(_M_X64) && defined(__AVX__)
+	return static_cast<int>(__popcnt64(x));		// every AVX cpu has popcnt
+#elif defined(__GNUC__)
+	return __builtin_popcountll(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return static_cast<int>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+inline int countr_zero64(uint64_t x) noexcept
+{	// x != 0
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return static_cast<int>(index);
+#elif defined(__GNUC__)
+	return __builtin_ctzll(x);
+#else
+	int n = 0;
+	for (; (x & 1) == 0; x >>= 1)
+		++n;
+	return n;
+#endif
+}
+
+inline int countl_zero64(uint64_t x) noexcept
+{	// x != 0
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanReverse64(&index, x);
+	return 63 - static_cast<int>(index);
+#elif defined(__GNUC__)
+	return __builtin_clzll(x);
+#else
+	int n = 64;
+	for (; x != 0; x >>= 1)
+		--n;
+	return n;
+#endif
+}
+
+template<class T>
+using enable_if_unsigned_t = typename std::enable_if<std::is_unsigned<T>::value && !std::is_same<T, bool>::value, int>::type;
+
+}	// namespace detail
+
+template<class T, detail::enable_if_unsigned_t<T> = 0>
+inline int popcount(T x) noexcept
+{
+	return detail::popcount64(static_cast<uint64_t>(x));
+}
+
+// the number of 0 bits below the lowest 1 bit, all the bits for 0
+template<class T, detail::enable_if_unsigned_t<T> = 0>
+inline int countr_zero(T x) noexcept
+{
+	return x != 0 ? detail::countr_zero64(static_cast<uint64_t>(x)) : std::numeric_limits<T>::digits;
+}
+
+// the number of 0 bits above the highest 1 bit, all the bits for 0
+template<class T, detail::enable_if_unsigned_t<T> = 0>
+inline int countl_zero(T x) noexcept
+{
+	const int digits = std::numeric_limits<T>::digits;
+	return x != 0 ? detail::countl_zero64(static_cast<uint64_t>(x)) - (64 - digits) : digits;
+}
+
+// the number of bits needed to store x, 0 for 0
+template<class T, detail::enable_if_unsigned_t<T> = 0>
+inline int bit_width(T x) noexcept
+{
+	return std::numeric_limits<T>::digits - countl_zero(x);
+}
+
+// the smallest power of two not less than x, 1 for 0
+template<class T, detail::enable_if_unsigned_t<T> = 0>
+inline T bit_ceil(T x) noexcept
+{
+	return x <= 1 ? T(1) : static_cast<T>(T(1) << bit_width(static_cast<T>(x - 1)));
+}
+
+// the largest power of two not greater than x, 0 for 0
+template<class T, detail::enable_if_unsigned_t<T> = 0>
+inline T bit_floor(T x) noexcept
+{
+	return x == 0 ? T(0) : static_cast<T>(T(1) << (bit_width(x) - 1));
+}
+
+// the position of the k-th (from 0) 1 bit of x, k < popcount(x)
+inline int select_bit(uint64_t x, int k) noexcept
+{
+#if defined(__BMI2__)
+	return detail::countr_zero64(_pdep_u64(uint64_t(1) << k, x));	// deposits the bit on the k-th 1 of x
+#else
+	int base = 0;
+	for (;; base += 8, x >>= 8)
+	{	// skip whole bytes first
+		int n = detail::popcount64(x & 0xff);
+		if (k < n)
+			break;
+		k -= n;
+	}
+	for (; k > 0; --k)
+		x &= x - 1;
+	return base + detail::countr_zero64(x);
+#endif
+}
+
 }	// namespace toy	
 
 #endif	// TOY_UTILITY_BYTE_H
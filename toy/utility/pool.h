@@ -0,0 +1,303 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_UTILITY_POOL_H
+#define TOY_UTILITY_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "toy/core/memory.h"
+#include "toy/core/new.h"
+
+namespace toy
+{
+
+// object_pool -----------------------------------------------------------------
+
+// Fixed-size allocator for objects of type T, one pool per type.
+//
+// Objects are carved out of SlabSize slabs that come straight from the OS and
+// are aligned to their size, so the slab of an object is found by masking its
+// address. Every thread keeps a private free list, allocate and deallocate
+// touch nothing else in the common case. When a thread's list grows past two
+// batches, one batch goes back to the global depot under a lock, and an empty
+// list takes a whole batch from the depot, so the lock is paid once per batch.
+// The depot is a free list through the objects themselves, giving a batch back
+// never allocates and deallocate can stay noexcept.
+//
+// release_idle() returns to the OS the slabs whose objects are all back in the
+// depot, objects sitting in thread caches keep their slab alive.
+
+template<class T, size_t SlabSize = 64 * 1024>
+class object_pool
+{
+	static_assert((SlabSize & (SlabSize - 1)) == 0, "slab size must be a power of two");
+
+public:
+	using value_type   = T;
+	using deleter_type = pool_delete<T, object_pool>;
+	using pointer      = unique_ptr<T, deleter_type>;
+
+public:
+	static object_pool& global()
+	{	// never destroyed: threads hand their cached objects back when they exit
+		static object_pool* pool = new object_pool;
+		return *pool;
+	}
+
+	object_pool(const object_pool&) = delete;
+	object_pool& operator=(const object_pool&) = delete;
+
+	// allocate & deallocate
+
+	void* allocate()
+	{	// uninitialized storage for one T
+		local_cache& cache = local();
+		if (!cache.head)
+			refill(cache);
+
+		node* p = cache.head;
+		cache.head = p->next;
+		--cache.count;
+		return p;
+	}
+
+	void deallocate(void* p) noexcept
+	{	// p may come from another thread
+		local_cache& cache = local();
+		cache.head = ::new (p) node{ cache.head };
+		if (++cache.count >= 2 * batch_size)
+			flush(cache, batch_size);
+	}
+
+	// construct & destroy
+
+	template<class... Args>
+	T* create(Args&&... args)
+	{
+		void* p = allocate();
+		try
+		{
+			return ::new (p) T(toy::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			deallocate(p);
+			throw;
+		}
+	}
+
+	void destroy(T* p) noexcept
+	{
+		if (p)
+		{
+			p->~T();
+			deallocate(p);
+		}
+	}
+
+	template<class... Args>
+	pointer make(Args&&... args)
+	{	// unique_ptr that gives the object back to the pool
+		return pointer(create(toy::forward<Args>(args)...), deleter_type(this));
+	}
+
+	// maintenance
+
+	void flush_local()
+	{	// give the cache of the calling thread back to the depot
+		local_cache& cache = local();
+		if (cache.count)
+			flush(cache, cache.count);
+	}
+
+	size_t release_idle()
+	{	// free the slabs whose objects are all in the depot, return their number
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (slab* s : slabs)
+			s->free = 0;
+		for (node* p = depot; p; p = p->next)
+			++slab_of(p)->free;
+
+		size_t idle = 0;
+		for (slab* s : slabs)
+			if (s->free == s->carved)
+				++idle;
+		if (idle == 0)
+			return 0;
+
+		// unlink the objects of the idle slabs from the depot
+		node** link = &depot;
+		while (node* p = *link)
+		{
+			slab* s = slab_of(p);
+			if (s->free == s->carved)
+			{
+				*link = p->next;
+				--depot_count;
+			}
+			else
+			{
+				link = &p->next;
+			}
+		}
+
+		std::vector<slab*> live;
+		for (slab* s : slabs)
+		{
+			if (s->free == s->carved)
+			{
+				if (s == carving)
+					carving = nullptr;
+				os_release_pages(s, SlabSize);
+			}
+			else
+			{
+				live.push_back(s);
+			}
+		}
+		slabs.swap(live);
+		return idle;
+	}
+
+	size_t slab_count() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return slabs.size();
+	}
+
+	static constexpr size_t objects_per_slab() noexcept { return per_slab; }
+
+private:
+	struct node
+	{
+		node* next;
+	};
+
+	struct slab
+	{	// header at the start of every slab
+		size_t carved;	// objects handed out of the slab so far
+		size_t free;	// scratch counter of release_idle
+	};
+
+	struct local_cache
+	{
+		~local_cache()
+		{
+			if (count)
+				global().flush(*this, count);
+		}
+
+		node*  head{ nullptr };
+		size_t count{ 0 };
+	};
+
+	static constexpr size_t round_up(size_t n, size_t alignment) noexcept
+	{
+		return (n + alignment - 1) / alignment * alignment;
+	}
+
+	static constexpr size_t block_align = alignof(T) > alignof(node) ? alignof(T) : alignof(node);
+	static constexpr size_t block_size  = round_up(sizeof(T) > sizeof(node) ? sizeof(T) : sizeof(node), block_align);
+	static constexpr size_t header_size = round_up(sizeof(slab), block_align);
+	static constexpr size_t per_slab    = (SlabSize - header_size) / block_size;
+	static constexpr size_t batch_size  = per_slab / 4 > 64 ? 64 : (per_slab / 4 > 0 ? per_slab / 4 : 1);
+
+	static_assert(per_slab > 0, "object does not fit in a slab");
+
+private:
+	object_pool() = default;
+
+	static local_cache& local()
+	{
+		static thread_local local_cache cache;
+		return cache;
+	}
+
+	static slab* slab_of(void* p) noexcept
+	{
+		return reinterpret_cast<slab*>(reinterpret_cast<uintptr_t>(p) & ~uintptr_t(SlabSize - 1));
+	}
+
+	void refill(local_cache& cache)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (depot)
+		{	// a batch off the front of the depot
+			size_t n = depot_count < batch_size ? depot_count : batch_size;
+			node* tail = depot;
+			for (size_t i = 1; i < n; ++i)
+				tail = tail->next;
+
+			cache.head  = depot;
+			cache.count = n;
+			depot = tail->next;
+			depot_count -= n;
+			tail->next = nullptr;
+			return;
+		}
+
+		if (!carving || carving->carved == per_slab)
+		{
+			slabs.reserve(slabs.size() + 1);
+			carving = ::new (os_allocate_pages(SlabSize, SlabSize)) slab{ 0, 0 };
+			slabs.push_back(carving);
+		}
+
+		// carve a batch, in address order so the first ones handed out are adjacent
+		size_t n = per_slab - carving->carved;
+		if (n > batch_size)
+			n = batch_size;
+
+		unsigned char* base = reinterpret_cast<unsigned char*>(carving) + header_size;
+		node* head = nullptr;
+		for (size_t i = carving->carved + n; i-- > carving->carved;)
+			head = ::new (base + i * block_size) node{ head };
+		carving->carved += n;
+
+		cache.head  = head;
+		cache.count = n;
+	}
+
+	void flush(local_cache& cache, size_t n) noexcept
+	{	// move the first n objects of the cache to the depot
+		node* head = cache.head;
+		node* tail = head;
+		for (size_t i = 1; i < n; ++i)
+			tail = tail->next;
+
+		cache.head = tail->next;
+		cache.count -= n;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		tail->next = depot;
+		depot = head;
+		depot_count += n;
+	}
+
+private:
+	mutable std::mutex mutex;
+	node*  depot{ nullptr };	// free objects of all threads, linked through themselves
+	size_t depot_count{ 0 };
+	std::vector<slab*> slabs;
+	slab* carving{ nullptr };	// the slab new objects are carved from
+};
+
+// make_pooled -----------------------------------------------------------------
+
+template<class T, class... Args>
+inline typename object_pool<T>::pointer make_pooled(Args&&... args)
+{
+	return object_pool<T>::global().make(toy::forward<Args>(args)...);
+}
+
+}	// namespace toy
+
+#endif	// TOY_UTILITY_POOL_H
@@ -0,0 +1,791 @@
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef TOY_UTILITY_THREAD_POOL_H
+#define TOY_UTILITY_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "toy/core/concurrent_queue.h"
+#include "toy/core/new.h"
+#include "toy/core/thread.h"
+
+namespace toy
+{
+
+class thread_pool;
+
+namespace detail
+{
+
+// job -------------------------------------------------------------------------
+// the unit of work the pool moves around, a function pointer instead of a
+// vtable so a job can live anywhere: on the stack of parallel_for, or in the
+// shared state of a future
+
+struct job
+{
+	void (*execute)(job*) = nullptr;
+};
+
+// work_stealing_deque ---------------------------------------------------------
+
+// Chase-Lev deque: the owner pushes and pops at the bottom like a stack, the
+// thieves steal from the top. Only the last element is contended.
+//
+// references
+// Le, Pop, Cohen, Zappa Nardelli, "Correct and Efficient Work-Stealing for
+// Weak Memory Models", PPoPP 2013
+
+class work_stealing_deque
+{
+public:
+	explicit work_stealing_deque(size_t capacity = 256)
+	{
+		arrays.emplace_back(new array(capacity));
+		buffer.store(arrays.back().get(), std::memory_order_relaxed);
+	}
+
+	work_stealing_deque(const work_stealing_deque&) = delete;
+	work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+	bool empty() const noexcept
+	{
+		return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+	}
+
+	void push(job* j)
+	{	// owner only
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		int64_t t = top.load(std::memory_order_acquire);
+		array* a = buffer.load(std::memory_order_relaxed);
+
+		if (b - t > static_cast<int64_t>(a->mask))
+		{	// full, the old array stays alive for the thieves still reading it
+			array* bigger = new array(2 * (a->mask + 1));
+			for (int64_t i = t; i < b; ++i)
+				bigger->put(i, a->get(i));
+			arrays.emplace_back(bigger);
+			buffer.store(bigger, std::memory_order_release);
+			a = bigger;
+		}
+
+		a->put(b, j);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	job* pop()
+	{	// owner only
+		int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		array* a = buffer.load(std::memory_order_relaxed);
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+
+		job* j = nullptr;
+		if (t <= b)
+		{
+			j = a->get(b);
+			if (t == b)
+			{	// the last one, race the thieves for it
+				if (!top.compare_exchange_strong(t, t + 1,
+					std::memory_order_seq_cst, std::memory_order_relaxed))
+					j = nullptr;
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+		}
+		else
+		{
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return j;
+	}
+
+	job* steal()
+	{	// any thread
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = bottom.load(std::memory_order_acquire);
+
+		if (t < b)
+		{
+			array* a = buffer.load(std::memory_order_acquire);
+			job* j = a->get(t);
+			if (!top.compare_exchange_strong(t, t + 1,
+				std::memory_order_seq_cst, std::memory_order_relaxed))
+				return nullptr;	// lost the race
+			return j;
+		}
+		return nullptr;
+	}
+
+private:
+	struct array
+	{
+		explicit array(size_t capacity)
+			: mask(capacity - 1), slots(new std::atomic<job*>[capacity]) {}
+
+		job* get(int64_t i) const noexcept { return slots[i & mask].load(std::memory_order_relaxed); }
+		void put(int64_t i, job* j) noexcept { slots[i & mask].store(j, std::memory_order_relaxed); }
+
+		const size_t mask;
+		std::unique_ptr<std::atomic<job*>[]> slots;
+	};
+
+	alignas(hardware_destructive_interference_size) std::atomic<int64_t> top{ 0 };
+	alignas(hardware_destructive_interference_size) std::atomic<int64_t> bottom{ 0 };
+	std::atomic<array*> buffer{ nullptr };
+
+	std::vector<std::unique_ptr<array>> arrays;	// owner only
+};
+
+// task allocation -------------------------------------------------------------
+// the shared state of a small task comes from a per-thread free list of
+// fixed-size blocks, so a steady stream of submit() does not hit the heap.
+// The blocks have the alignment of operator new, a state that needs more (a
+// callable holding SIMD data) takes the aligned operator new instead
+
+constexpr size_t small_task_size  = 128;
+constexpr size_t small_task_cache = 256;
+
+struct task_block_cache
+{
+	struct node { node* next; };
+
+	~task_block_cache()
+	{
+		while (head)
+		{
+			node* next = head->next;
+			::operator delete(head);
+			head = next;
+		}
+	}
+
+	node*  head{ nullptr };
+	size_t count{ 0 };
+};
+
+inline task_block_cache& local_task_cache()
+{
+	static thread_local task_block_cache cache;
+	return cache;
+}
+
+inline void* allocate_task(size_t size, size_t alignment)
+{
+	if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		return ::operator new(size, std::align_val_t(alignment));
+	if (size <= small_task_size)
+	{
+		task_block_cache& cache = local_task_cache();
+		if (cache.head)
+		{
+			task_block_cache::node* p = cache.head;
+			cache.head = p->next;
+			--cache.count;
+			return p;
+		}
+		return ::operator new(small_task_size);
+	}
+	return ::operator new(size);
+}
+
+inline void deallocate_task(void* p, size_t size, size_t alignment) noexcept
+{
+	if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+	{
+		::operator delete(p, std::align_val_t(alignment));
+		return;
+	}
+	if (size <= small_task_size)
+	{
+		task_block_cache& cache = local_task_cache();
+		if (cache.count < small_task_cache)
+		{
+			cache.head = ::new (p) task_block_cache::node{ cache.head };
+			++cache.count;
+			return;
+		}
+	}
+	::operator delete(p);
+}
+
+// future_state ----------------------------------------------------------------
+// one allocation holds the job, the callable and the result, it is shared by
+// the pool (until the job ran) and the future
+
+template<class R>
+struct future_result
+{
+	template<class F>
+	void set(F& f) { ::new (static_cast<void*>(storage)) R(f()); }
+
+	R&   get() noexcept { return *std::launder(reinterpret_cast<R*>(storage)); }
+	void destroy() noexcept { get().~R(); }
+
+	alignas(R) unsigned char storage[sizeof(R)];
+};
+
+template<>
+struct future_result<void>
+{
+	template<class F>
+	void set(F& f) { f(); }
+
+	void get() noexcept {}
+	void destroy() noexcept {}
+};
+
+template<class R>
+struct future_state : job
+{
+	void release() noexcept
+	{
+		if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			destroy(this);
+	}
+
+	std::atomic<int>  refs{ 2 };	// the pool and the future
+	std::atomic<bool> done{ false };
+	bool has_value{ false };
+	std::exception_ptr error;
+	future_result<R> result;
+	thread_pool* pool{ nullptr };
+	void (*destroy)(future_state*) = nullptr;
+};
+
+}	// namespace detail
+
+// task_future -----------------------------------------------------------------
+
+template<class R>
+class task_future
+{
+public:
+	task_future() = default;
+	explicit task_future(detail::future_state<R>* state) noexcept : state(state) {}
+
+	task_future(task_future&& right) noexcept : state(right.state) { right.state = nullptr; }
+
+	task_future& operator=(task_future&& right) noexcept
+	{
+		if (this != &right)
+		{
+			reset();
+			state = right.state;
+			right.state = nullptr;
+		}
+		return *this;
+	}
+
+	~task_future() { reset(); }
+
+	task_future(const task_future&) = delete;
+	task_future& operator=(const task_future&) = delete;
+
+	bool valid() const noexcept { return state != nullptr; }
+
+	bool ready() const noexcept
+	{
+		return state && state->done.load(std::memory_order_acquire);
+	}
+
+	void wait() const;
+
+	R get()
+	{	// wait, then return the result or rethrow the exception of the task
+		wait();
+		if (state->error)
+			std::rethrow_exception(state->error);
+		if constexpr (std::is_void<R>::value)
+			return;
+		else
+			return toy::move(state->result.get());
+	}
+
+private:
+	void reset() noexcept
+	{
+		if (state)
+		{
+			wait();	// the task may still reference what the caller owns
+			state->release();
+			state = nullptr;
+		}
+	}
+
+	detail::future_state<R>* state{ nullptr };
+};
+
+// thread_pool -----------------------------------------------------------------
+
+// Every worker owns a Chase-Lev deque: tasks submitted from a worker go to
+// its own deque, tasks submitted from outside go through a global injection
+// queue. An idle worker takes from its own deque, then from the injection
+// queue, then steals from the other workers. When nothing is found it parks
+// on an event count (a mutex and condition variable, which is a futex on
+// Linux), so the notifier only takes the lock if somebody sleeps.
+//
+// A thread that waits for a future or a parallel_for inside a worker runs
+// other jobs meanwhile, so nested parallelism does not deadlock. So does a
+// task that calls wait(), which then waits for every task but itself and the
+// tasks below it on the stack of the worker.
+
+class thread_pool
+{
+public:
+	explicit thread_pool(size_t threads = 0)
+		: injection(injection_capacity)
+	{
+		if (threads == 0)
+			threads = (std::max)(1u, std::thread::hardware_concurrency());
+
+		workers.reserve(threads);
+		for (size_t i = 0; i < threads; ++i)
+			workers.emplace_back(new worker);
+		for (size_t i = 0; i < threads; ++i)
+			workers[i]->thread = std::thread(&thread_pool::worker_main, this, i);
+	}
+
+	~thread_pool()
+	{
+		wait();
+		stopping.store(true, std::memory_order_seq_cst);
+		{
+			std::lock_guard<std::mutex> lock(park_mutex);
+			epoch.fetch_add(1, std::memory_order_relaxed);
+		}
+		park_cv.notify_all();
+
+		for (auto& w : workers)
+			w->thread.join();
+	}
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	size_t size() const noexcept { return workers.size(); }
+
+	static thread_pool& global()
+	{	// shared pool with one worker per hardware thread
+		static thread_pool pool;
+		return pool;
+	}
+
+	// submit & wait
+
+	template<class F, class R = std::invoke_result_t<std::decay_t<F>&>>
+	task_future<R> submit(F&& f)
+	{	// run f() on the pool, the future gives the result
+		using state_type = task_state<std::decay_t<F>, R>;
+
+		void* p = detail::allocate_task(sizeof(state_type), alignof(state_type));
+		state_type* state = ::new (p) state_type(toy::forward<F>(f));
+		state->pool = this;
+
+		schedule(state);
+		return task_future<R>(state);
+	}
+
+	void wait()
+	{	// block until every submitted task has run, from inside a task every
+		// task but the ones blocked in wait() on some worker
+		worker_context& self = local_worker();
+		if (self.pool != this || self.depth == self.counted)
+		{
+			wait_until([this]() { return pending.load(std::memory_order_acquire) == 0; });
+			return;
+		}
+
+		// the tasks on this stack not counted yet by an outer wait() never
+		// finish before this one returns
+		size_t own = self.depth - self.counted;
+		unblocked.fetch_sub(own, std::memory_order_acq_rel);
+		self.counted = self.depth;
+		wait_until([this]() { return unblocked.load(std::memory_order_acquire) == 0; });
+		self.counted -= own;
+		unblocked.fetch_add(own, std::memory_order_relaxed);
+	}
+
+	// parallel loops
+
+	template<class F>
+	void parallel_for_range(size_t first, size_t last, F&& f, size_t grain = 0)
+	{	// call f(begin, end) on chunks of about grain indices of [first, last)
+		if (first >= last)
+			return;
+
+		size_t count = last - first;
+		if (grain == 0)	// about 8 chunks per worker
+			grain = (std::max)(size_t(1), count / (8 * size()));
+
+		size_t chunks = (count + grain - 1) / grain;
+		if (chunks == 1)
+		{
+			f(first, last);
+			return;
+		}
+
+		for_context<std::remove_reference_t<F>> context(first, last, grain, f);
+
+		// the caller takes chunks too, so spawn at most one helper per worker,
+		// the helper jobs live on the stack unless the pool is very wide
+		using job_type = for_job<std::remove_reference_t<F>>;
+		size_t helpers = (std::min)(chunks - 1, size());
+
+		job_type local_jobs[local_for_jobs];
+		std::unique_ptr<job_type[]> heap_jobs;
+		job_type* jobs = local_jobs;
+		if (helpers > local_for_jobs)
+		{
+			heap_jobs.reset(new job_type[helpers]);
+			jobs = heap_jobs.get();
+		}
+
+		context.active.store(helpers, std::memory_order_relaxed);
+		for (size_t i = 0; i < helpers; ++i)
+		{
+			jobs[i].context = &context;
+			schedule(&jobs[i]);
+		}
+
+		context.run();
+		wait_until([&]() { return context.active.load(std::memory_order_acquire) == 0; });
+
+		if (context.error)
+			std::rethrow_exception(context.error);
+	}
+
+	template<class F>
+	void parallel_for(size_t first, size_t last, F&& f, size_t grain = 0)
+	{	// call f(i) for every i in [first, last)
+		parallel_for_range(first, last, [&f](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+				f(i);
+		}, grain);
+	}
+
+	template<class Predicate>
+	void wait_until(Predicate&& done)
+	{	// a worker runs other jobs while it waits, other threads block
+		if (done())
+			return;
+
+		worker_context& self = local_worker();
+		if (self.pool == this)
+		{
+			for (backoff bo; !done();)
+			{
+				detail::job* j = find_job(self.index);
+				if (j)
+				{
+					run(j);
+					bo.reset();
+				}
+				else
+				{
+					bo.pause();
+				}
+			}
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(done_mutex);
+		done_waiters.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		done_cv.wait(lock, [&]() { return done(); });
+		done_waiters.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+private:
+	static constexpr size_t injection_capacity = 4096;
+	static constexpr int    spin_rounds        = 64;
+	static constexpr size_t local_for_jobs     = 16;
+
+	template<class F, class R>
+	struct task_state : detail::future_state<R>
+	{
+		template<class G>
+		explicit task_state(G&& g) : fn(toy::forward<G>(g))
+		{
+			this->execute = &task_state::run;
+			this->destroy = &task_state::free;
+		}
+
+		static void run(detail::job* j)
+		{
+			task_state* self = static_cast<task_state*>(j);
+			try
+			{
+				self->result.set(self->fn);
+				self->has_value = true;
+			}
+			catch (...)
+			{
+				self->error = std::current_exception();
+			}
+			self->done.store(true, std::memory_order_release);
+			self->release();
+		}
+
+		static void free(detail::future_state<R>* state)
+		{
+			task_state* self = static_cast<task_state*>(state);
+			if (self->has_value)
+				self->result.destroy();
+			self->~task_state();
+			detail::deallocate_task(self, sizeof(task_state), alignof(task_state));
+		}
+
+		F fn;
+	};
+
+	template<class F>
+	struct for_context
+	{
+		for_context(size_t first, size_t last, size_t grain, F& f)
+			: next(first), last(last), grain(grain), f(f) {}
+
+		void run()
+		{	// take chunks until there are none left
+			for (;;)
+			{
+				size_t begin = next.fetch_add(grain, std::memory_order_relaxed);
+				if (begin >= last || failed.load(std::memory_order_relaxed))
+					return;
+
+				try
+				{
+					f(begin, (std::min)(begin + grain, last));
+				}
+				catch (...)
+				{
+					bool expected = false;
+					if (failed.compare_exchange_strong(expected, true))
+						error = std::current_exception();
+					return;
+				}
+			}
+		}
+
+		std::atomic<size_t> next;
+		const size_t last;
+		const size_t grain;
+		F& f;
+
+		std::atomic<size_t> active{ 0 };	// helper jobs not finished yet
+		std::atomic<bool> failed{ false };
+		std::exception_ptr error;
+	};
+
+	template<class F>
+	struct for_job : detail::job
+	{
+		for_job() { execute = &for_job::run; }
+
+		static void run(detail::job* j)
+		{
+			for_context<F>* context = static_cast<for_job*>(j)->context;
+			context->run();
+			// context lives on the stack of the caller, don't touch it after this
+			context->active.fetch_sub(1, std::memory_order_release);
+		}
+
+		for_context<F>* context{ nullptr };
+	};
+
+	struct alignas(hardware_destructive_interference_size) worker
+	{
+		detail::work_stealing_deque deque;
+		std::thread thread;
+	};
+
+	struct worker_context
+	{
+		thread_pool* pool{ nullptr };
+		size_t index{ 0 };
+		size_t depth{ 0 };		// jobs running on the stack of the worker
+		size_t counted{ 0 };	// of which taken out of unblocked
+	};
+
+private:
+	static worker_context& local_worker() noexcept
+	{
+		static thread_local worker_context context;
+		return context;
+	}
+
+	void schedule(detail::job* j)
+	{
+		pending.fetch_add(1, std::memory_order_relaxed);
+		unblocked.fetch_add(1, std::memory_order_relaxed);
+
+		worker_context& self = local_worker();
+		if (self.pool == this)
+			workers[self.index]->deque.push(j);
+		else if (!injection.try_push(j))
+		{	// the injection queue is full, the submitter runs the job itself
+			run(j);
+			return;
+		}
+
+		notify_one();
+	}
+
+	void run(detail::job* j)
+	{	// j may be gone once it executed
+		worker_context& self = local_worker();
+		if (self.pool == this)
+		{
+			++self.depth;
+			j->execute(j);
+			--self.depth;
+		}
+		else
+		{
+			j->execute(j);
+		}
+		unblocked.fetch_sub(1, std::memory_order_acq_rel);
+		pending.fetch_sub(1, std::memory_order_acq_rel);
+		notify_done();
+	}
+
+	detail::job* find_job(size_t index)
+	{
+		detail::job* j = workers[index]->deque.pop();
+		if (j)
+			return j;
+
+		if (injection.try_pop(j))
+			return j;
+
+		size_t n = workers.size();
+		for (size_t i = 1; i < n; ++i)
+		{
+			j = workers[(index + i) % n]->deque.steal();
+			if (j)
+				return j;
+		}
+		return nullptr;
+	}
+
+	void worker_main(size_t index)
+	{
+		worker_context& self = local_worker();
+		self.pool  = this;
+		self.index = index;
+
+		for (;;)
+		{
+			detail::job* j = nullptr;
+			for (int i = 0; i < spin_rounds && !j; ++i)
+			{
+				j = find_job(index);
+				if (!j)
+					cpu_relax();
+			}
+			if (j)
+			{
+				run(j);
+				continue;
+			}
+
+			// announce we are going to sleep, then look once more: a job pushed
+			// before the announcement is found here, one pushed after it wakes us
+			sleepers.fetch_add(1, std::memory_order_seq_cst);
+			uint64_t observed = epoch.load(std::memory_order_acquire);
+
+			j = find_job(index);
+			if (j || stopping.load(std::memory_order_acquire))
+			{
+				sleepers.fetch_sub(1, std::memory_order_relaxed);
+				if (!j)
+					return;
+				run(j);
+				continue;
+			}
+
+			{
+				std::unique_lock<std::mutex> lock(park_mutex);
+				park_cv.wait(lock, [&]() { return epoch.load(std::memory_order_relaxed) != observed; });
+			}
+			sleepers.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	void notify_one()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleepers.load(std::memory_order_relaxed) == 0)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(park_mutex);
+			epoch.fetch_add(1, std::memory_order_relaxed);
+		}
+		park_cv.notify_one();
+	}
+
+	void notify_done()
+	{	// wake the non-worker threads blocked in wait_until
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (done_waiters.load(std::memory_order_relaxed) == 0)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(done_mutex);
+		}
+		done_cv.notify_all();
+	}
+
+private:
+	std::vector<std::unique_ptr<worker>> workers;
+	mpmc_queue<detail::job*> injection;
+
+	alignas(hardware_destructive_interference_size) std::atomic<size_t> pending{ 0 };
+	std::atomic<size_t> unblocked{ 0 };	// pending tasks but the ones blocked in wait()
+
+	// parking of idle workers
+	alignas(hardware_destructive_interference_size) std::atomic<size_t> sleepers{ 0 };
+	std::atomic<uint64_t> epoch{ 0 };
+	std::atomic<bool> stopping{ false };
+	std::mutex park_mutex;
+	std::condition_variable park_cv;
+
+	// blocking of outside threads
+	std::atomic<size_t> done_waiters{ 0 };
+	std::mutex done_mutex;
+	std::condition_variable done_cv;
+};
+
+// task_future -----------------------------------------------------------------
+
+template<class R>
+void task_future<R>::wait() const
+{
+	if (!state || state->done.load(std::memory_order_acquire))
+		return;
+
+	detail::future_state<R>* s = state;
+	s->pool->wait_until([s]() { return s->done.load(std::memory_order_acquire); });
+}
+
+}	// namespace toy
+
+#endif	// TOY_UTILITY_THREAD_POOL_H